@@ -0,0 +1,103 @@
+/*
+ @ 0xCCCCCCCC
+*/
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "winant_http/winant_http.h"
+
+namespace {
+
+constexpr char kRequestAddr[] = "http://127.0.0.1:5001";
+
+const wat::LoadFlags kNative(wat::LoadFlags::UseNativeTransport);
+
+}   // namespace
+
+namespace wat {
+
+TEST(AsyncRequest, Get)
+{
+    auto future = GetAsync(Url(kRequestAddr), kNative);
+    auto response = future.get();
+    EXPECT_EQ(200, response.status_code());
+    EXPECT_EQ("Welcome to keep-alive server via GET", response.text());
+
+    response = HeadAsync(Url(kRequestAddr), kNative).get();
+    EXPECT_EQ(200, response.status_code());
+    EXPECT_TRUE(response.text().empty());
+}
+
+TEST(AsyncRequest, PostWithCompletionHandler)
+{
+    std::promise<std::string> handled;
+    auto on_complete = [&handled](const HttpResponse* response, std::exception_ptr error) {
+        handled.set_value(error ? "error" : response->text());
+    };
+
+    RequestBody body;
+    body.Append("hello, ").AppendSource([sent = false](char* buf, size_t size) mutable {
+        if (sent || size < 5) {
+            return size_t(0);
+        }
+
+        sent = true;
+        std::copy_n("world", 5, buf);
+        return size_t(5);
+    });
+
+    auto future = PostAsync(Url(kRequestAddr), std::move(body), kNative,
+                            CompletionHandler(on_complete));
+    EXPECT_EQ("hello, world", handled.get_future().get());
+    EXPECT_EQ("hello, world", future.get().text());
+}
+
+TEST(AsyncRequest, Multiplexing)
+{
+    constexpr int kRequestCount = 50;
+    ConnectionPool::Options options;
+    options.max_idle_per_host = kRequestCount;
+    auto pool = std::make_shared<ConnectionPool>(options);
+
+    // Each response is held back for 200ms, and thus requests must be in flight together.
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::future<HttpResponse>> futures;
+    for (int i = 0; i < kRequestCount; ++i) {
+        futures.push_back(GetAsync(Url(std::string(kRequestAddr) + "/delay/200"), kNative, pool));
+    }
+
+    for (auto& future : futures) {
+        auto response = future.get();
+        EXPECT_EQ(200, response.status_code());
+        EXPECT_EQ("Welcome to keep-alive server via GET", response.text());
+    }
+
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    EXPECT_LT(elapsed, std::chrono::milliseconds(200 * kRequestCount / 4));
+
+    // Connections go back to the pool and are picked up by subsequent requests.
+    EXPECT_EQ(static_cast<size_t>(kRequestCount), pool->idle_count());
+    GetAsync(Url(kRequestAddr), kNative, pool).get();
+    EXPECT_EQ(1U, pool->stats().hits);
+}
+
+TEST(AsyncRequest, Failure)
+{
+    std::atomic<bool> failed(false);
+    auto on_complete = [&failed](const HttpResponse* response, std::exception_ptr error) {
+        failed = response == nullptr && error != nullptr;
+    };
+
+    // Nothing listens on the port.
+    auto future = GetAsync(Url("http://127.0.0.1:1"), kNative, CompletionHandler(on_complete));
+    EXPECT_ANY_THROW(future.get());
+    EXPECT_TRUE(failed);
+}
+
+}   // namespace wat
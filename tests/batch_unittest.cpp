@@ -0,0 +1,100 @@
+/*
+ @ 0xCCCCCCCC
+*/
+
+#include <chrono>
+#include <string>
+
+#include "gtest/gtest.h"
+
+#include "winant_http/winant_http.h"
+
+namespace {
+
+constexpr char kRequestAddr[] = "http://127.0.0.1:5001";
+
+const wat::LoadFlags kNative(wat::LoadFlags::UseNativeTransport);
+
+}   // namespace
+
+namespace wat {
+
+TEST(Batch, ResultsInOrder)
+{
+    Batch batch;
+    for (int i = 0; i < 20; ++i) {
+        batch.AddPost(Url(kRequestAddr), RequestBody("request " + std::to_string(i)), kNative);
+    }
+
+    EXPECT_EQ(20U, batch.size());
+    auto results = batch.Run();
+    EXPECT_EQ(0U, batch.size());
+    ASSERT_EQ(20U, results.size());
+    for (int i = 0; i < 20; ++i) {
+        ASSERT_TRUE(results[i].succeeded());
+        EXPECT_EQ(200, results[i].response.status_code());
+        EXPECT_EQ("request " + std::to_string(i), results[i].response.text());
+    }
+
+    const auto& stats = batch.stats();
+    EXPECT_EQ(20U, stats.succeeded);
+    EXPECT_EQ(0U, stats.failed);
+    EXPECT_LE(stats.min_latency, stats.mean_latency);
+    EXPECT_LE(stats.mean_latency, stats.max_latency);
+    EXPECT_EQ(20U, stats.connections_opened + stats.connections_reused);
+    EXPECT_LE(stats.connections_opened, 6U);
+}
+
+TEST(Batch, InFlightLimits)
+{
+    auto run_delayed = [](size_t max_in_flight, size_t max_in_flight_per_host) {
+        Batch::Options options;
+        options.max_in_flight = max_in_flight;
+        options.max_in_flight_per_host = max_in_flight_per_host;
+        Batch batch(options);
+        for (int i = 0; i < 8; ++i) {
+            batch.AddGet(Url(std::string(kRequestAddr) + "/delay/100"), kNative);
+        }
+
+        auto results = batch.Run();
+        for (const auto& result : results) {
+            EXPECT_TRUE(result.succeeded());
+        }
+
+        return batch.stats();
+    };
+
+    using std::chrono::milliseconds;
+
+    // 8 requests in 4 waves, 2 waves, and a single wave.
+    auto stats = run_delayed(2, 0);
+    EXPECT_GE(stats.elapsed, milliseconds(400));
+    EXPECT_LE(stats.connections_opened, 2U);
+
+    stats = run_delayed(8, 4);
+    EXPECT_GE(stats.elapsed, milliseconds(200));
+    EXPECT_LT(stats.elapsed, milliseconds(400));
+
+    stats = run_delayed(8, 0);
+    EXPECT_LT(stats.elapsed, milliseconds(200));
+}
+
+TEST(Batch, PartialFailure)
+{
+    Batch batch;
+    batch.AddGet(Url(kRequestAddr), kNative)
+         .AddGet(Url("http://127.0.0.1:1"), kNative)
+         .AddHead(Url(kRequestAddr), kNative);
+
+    auto results = batch.Run();
+    ASSERT_EQ(3U, results.size());
+    EXPECT_TRUE(results[0].succeeded());
+    EXPECT_FALSE(results[1].succeeded());
+    EXPECT_TRUE(results[2].succeeded());
+    EXPECT_EQ(2U, batch.stats().succeeded);
+    EXPECT_EQ(1U, batch.stats().failed);
+
+    EXPECT_TRUE(batch.Run().empty());
+}
+
+}   // namespace wat
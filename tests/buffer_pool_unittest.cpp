@@ -0,0 +1,143 @@
+/*
+ @ 0xCCCCCCCC
+*/
+
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <string>
+
+#include "gtest/gtest.h"
+
+#include "winant_http/winant_http.h"
+
+namespace {
+
+constexpr char kRequestAddr[] = "http://127.0.0.1:5001";
+
+const wat::LoadFlags kNative(wat::LoadFlags::UseNativeTransport);
+
+}   // namespace
+
+namespace wat {
+
+TEST(BufferPool, AcquireAndRecycle)
+{
+    BufferPool pool;
+
+    auto buf = pool.Acquire(0);
+    EXPECT_TRUE(buf.empty());
+    EXPECT_GE(buf.capacity(), pool.options().initial_buffer_size);
+
+    buf.assign(100, 'x');
+    pool.Recycle(std::move(buf));
+    EXPECT_EQ(1U, pool.idle_count());
+
+    // The recycled buffer fits, and comes back cleared.
+    buf = pool.Acquire(1024);
+    EXPECT_TRUE(buf.empty());
+    EXPECT_EQ(0U, pool.idle_count());
+
+    auto stats = pool.stats();
+    EXPECT_EQ(2U, stats.acquired);
+    EXPECT_EQ(1U, stats.reused);
+    EXPECT_EQ(1U, stats.allocations);
+
+    // Too small a buffer is grown.
+    pool.Recycle(std::move(buf));
+    buf = pool.Acquire(pool.options().initial_buffer_size * 4);
+    EXPECT_GE(buf.capacity(), pool.options().initial_buffer_size * 4);
+    EXPECT_EQ(2U, pool.stats().allocations);
+}
+
+TEST(BufferPool, RecycleLimits)
+{
+    BufferPool::Options options;
+    options.max_idle_buffers = 2;
+    options.max_buffer_size = 64 * 1024;
+    BufferPool pool(options);
+
+    for (int i = 0; i < 3; ++i) {
+        pool.Recycle(pool.Acquire(0));
+        pool.Recycle(std::string(4096, 'x'));
+    }
+
+    EXPECT_EQ(2U, pool.idle_count());
+
+    // Neither tiny nor oversized buffers are kept.
+    BufferPool another(options);
+    another.Recycle(std::string(16, 'x'));
+    another.Recycle(std::string(128 * 1024, 'x'));
+    EXPECT_EQ(0U, another.idle_count());
+
+    // A huge Content-Length isn't reserved upfront.
+    EXPECT_LT(another.Acquire(1U << 30).capacity(), 1U << 20);
+}
+
+TEST(BufferPool, Grow)
+{
+    BufferPool pool;
+    auto buf = pool.Acquire(16);
+    auto allocations = pool.stats().allocations;
+
+    pool.Grow(buf, buf.capacity());
+    EXPECT_EQ(allocations, pool.stats().allocations);
+
+    auto capacity = buf.capacity();
+    pool.Grow(buf, capacity + 1);
+    EXPECT_GE(buf.capacity(), capacity * 2);
+    EXPECT_EQ(allocations + 1, pool.stats().allocations);
+}
+
+TEST(BufferPool, ResponseRecyclesBody)
+{
+    auto pool = std::make_shared<BufferPool>();
+    {
+        auto response = Get(Url(std::string(kRequestAddr) + "/bytes/100000"), kNative, pool);
+        EXPECT_EQ(200, response.status_code());
+        EXPECT_EQ(100000U, response.text().size());
+
+        // Sized from Content-Length at once.
+        EXPECT_EQ(1U, pool->stats().allocations);
+        EXPECT_EQ(0U, pool->idle_count());
+    }
+
+    EXPECT_EQ(1U, pool->idle_count());
+
+    for (int i = 0; i < 4; ++i) {
+        auto response = Get(Url(std::string(kRequestAddr) + "/bytes/100000/chunked"), kNative,
+                            pool);
+        EXPECT_EQ(100000U, response.text().size());
+    }
+
+    auto stats = pool->stats();
+    EXPECT_EQ(5U, stats.acquired);
+    EXPECT_EQ(4U, stats.reused);
+    EXPECT_EQ(1U, stats.allocations);
+}
+
+TEST(BufferPool, DISABLED_AllocationBenchmark)
+{
+    constexpr int kRequestCount = 200;
+
+    auto run = [](const std::string& path) {
+        auto pool = std::make_shared<BufferPool>();
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < kRequestCount; ++i) {
+            auto response = Get(Url(kRequestAddr + path), kNative, pool);
+            EXPECT_EQ(200, response.status_code());
+        }
+
+        auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now() - start);
+        auto stats = pool->stats();
+        std::cout << path << ": " << elapsed.count() << "ms, "
+                  << static_cast<double>(stats.allocations) / kRequestCount
+                  << " allocations per request" << std::endl;
+    };
+
+    run("/bytes/1000000");
+    run("/bytes/1000000/chunked");
+}
+
+}   // namespace wat
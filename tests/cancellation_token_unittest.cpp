@@ -0,0 +1,252 @@
+/*
+ @ 0xCCCCCCCC
+*/
+
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <memory>
+#include <string>
+#include <thread>
+
+#include "gtest/gtest.h"
+
+#include "winant_http/winant_http.h"
+
+namespace {
+
+constexpr char kRequestAddr[] = "http://127.0.0.1:5001";
+
+const wat::LoadFlags kNative(wat::LoadFlags::UseNativeTransport);
+
+using std::chrono::milliseconds;
+using Clock = std::chrono::steady_clock;
+
+// Cancels the token from another thread after a while.
+std::future<void> CancelLater(const wat::CancellationToken& token, milliseconds delay)
+{
+    return std::async(std::launch::async, [token, delay] {
+        std::this_thread::sleep_for(delay);
+        token.Cancel();
+    });
+}
+
+template<typename F>
+void ExpectCancelled(F&& send, milliseconds max_elapsed)
+{
+    auto start = Clock::now();
+    try {
+        send();
+    } catch (const wat::CancelledError&) {
+        EXPECT_LT(Clock::now() - start, max_elapsed);
+        return;
+    } catch (const std::exception& ex) {
+        ADD_FAILURE() << "Unexpected error: " << ex.what();
+        return;
+    }
+
+    ADD_FAILURE() << "The request wasn't cancelled";
+}
+
+}   // namespace
+
+namespace wat {
+
+TEST(CancellationToken, Callbacks)
+{
+    CancellationToken token;
+    auto copy = token;
+    EXPECT_FALSE(copy.cancelled());
+
+    int runs = 0;
+    copy.AddCallback([&runs] { ++runs; });
+    auto removed = copy.AddCallback([&runs] { runs += 100; });
+    copy.RemoveCallback(removed);
+
+    token.Cancel();
+    token.Cancel();
+    EXPECT_TRUE(copy.cancelled());
+    EXPECT_EQ(1, runs);
+
+    // Run at once.
+    EXPECT_EQ(0U, copy.AddCallback([&runs] { ++runs; }));
+    EXPECT_EQ(2, runs);
+}
+
+TEST(CancellationToken, CancelledBeforehand)
+{
+    CancellationToken token;
+    token.Cancel();
+    Url url(std::string(kRequestAddr) + "/");
+
+    EXPECT_THROW(Get(url, kNative, token), CancelledError);
+    EXPECT_THROW(GetAsync(url, kNative, token).get(), CancelledError);
+}
+
+TEST(CancellationToken, WaitingForResponse)
+{
+    Url url(std::string(kRequestAddr) + "/delay/2000");
+    auto pool = std::make_shared<ConnectionPool>();
+
+    CancellationToken token;
+    auto canceller = CancelLater(token, milliseconds(100));
+    ExpectCancelled([&] {
+        Get(url, kNative, token, pool);
+    }, milliseconds(500));
+    canceller.get();
+
+    std::atomic<bool> failed(false);
+    auto on_complete = [&failed](const HttpResponse* response, std::exception_ptr error) {
+        failed = response == nullptr && error != nullptr;
+    };
+
+    CancellationToken async_token;
+    canceller = CancelLater(async_token, milliseconds(100));
+    ExpectCancelled([&] {
+        GetAsync(url, kNative, async_token, pool, CompletionHandler(on_complete)).get();
+    }, milliseconds(500));
+    canceller.get();
+    EXPECT_TRUE(failed);
+
+    // The connections are closed, as they are left amid the exchanges.
+    EXPECT_EQ(0U, pool->idle_count());
+    auto response = Get(Url(std::string(kRequestAddr) + "/"), kNative, pool);
+    EXPECT_EQ(200, response.status_code());
+    EXPECT_EQ(1U, pool->idle_count());
+}
+
+TEST(CancellationToken, WaitingForConnection)
+{
+    ConnectionPool::Options options;
+    options.max_connections_per_host = 1;
+    auto pool = std::make_shared<ConnectionPool>(options);
+    auto busy = GetAsync(Url(std::string(kRequestAddr) + "/delay/1000"), kNative, pool);
+    std::this_thread::sleep_for(milliseconds(50));
+
+    Url url(kRequestAddr);
+    CancellationToken token;
+    auto canceller = CancelLater(token, milliseconds(100));
+    ExpectCancelled([&] {
+        Get(url, kNative, token, pool);
+    }, milliseconds(500));
+    canceller.get();
+
+    CancellationToken async_token;
+    canceller = CancelLater(async_token, milliseconds(100));
+    ExpectCancelled([&] {
+        GetAsync(url, kNative, async_token, pool).get();
+    }, milliseconds(500));
+    canceller.get();
+
+    // Requests that gave up have left the line.
+    EXPECT_EQ(200, busy.get().status_code());
+    EXPECT_EQ(200, Get(url, kNative, pool).status_code());
+    EXPECT_EQ(1U, pool->stats().misses);
+}
+
+TEST(CancellationToken, ReadingBody)
+{
+    // The server stalls amid the body.
+    Url url(std::string(kRequestAddr) + "/stall/2000");
+
+    CancellationToken token;
+    auto canceller = CancelLater(token, milliseconds(100));
+    ExpectCancelled([&] {
+        Get(url, kNative, token);
+    }, milliseconds(500));
+    canceller.get();
+
+    CancellationToken async_token;
+    canceller = CancelLater(async_token, milliseconds(100));
+    ExpectCancelled([&] {
+        GetAsync(url, kNative, async_token).get();
+    }, milliseconds(500));
+    canceller.get();
+}
+
+TEST(CancellationToken, StopsDownload)
+{
+    // The body keeps coming; it's cancelled from the read handler as soon as some of it arrives.
+    constexpr size_t kBodySize = 256 * 1024 * 1024;
+    Url url(std::string(kRequestAddr) + "/bytes/" + std::to_string(kBodySize));
+
+    auto run = [&](bool async) {
+        CancellationToken token;
+        size_t bytes_read = 0;
+        bool failed = false;
+        auto on_read = [&](const char* /*data*/, int size) {
+            if (size < 0) {
+                failed = true;
+                return;
+            }
+
+            bytes_read += static_cast<size_t>(size);
+            token.Cancel();
+        };
+
+        ExpectCancelled([&] {
+            if (async) {
+                GetAsync(url, kNative, token, ReadResponseHandler(on_read)).get();
+            } else {
+                Get(url, kNative, token, ReadResponseHandler(on_read));
+            }
+        }, milliseconds(1000));
+
+        EXPECT_TRUE(failed);
+        EXPECT_LT(bytes_read, kBodySize / 4);
+    };
+
+    run(false);
+    run(true);
+}
+
+TEST(CancellationToken, WritingBody)
+{
+    // The server leaves the body unread, and thus the socket buffers fill up.
+    Url url(std::string(kRequestAddr) + "/stall/2000");
+    auto make_body = [] {
+        return RequestBody(std::string(64 * 1024 * 1024, 'x'));
+    };
+
+    CancellationToken token;
+    auto canceller = CancelLater(token, milliseconds(200));
+    ExpectCancelled([&] {
+        Post(url, kNative, token, make_body());
+    }, milliseconds(1000));
+    canceller.get();
+
+    CancellationToken async_token;
+    canceller = CancelLater(async_token, milliseconds(200));
+    ExpectCancelled([&] {
+        PostAsync(url, kNative, async_token, make_body()).get();
+    }, milliseconds(1000));
+    canceller.get();
+}
+
+TEST(CancellationToken, RetryBackoff)
+{
+    RetryPolicy policy;
+    policy.initial_backoff = milliseconds(5000);
+    policy.jitter = 0;
+    policy.budget = std::make_shared<RetryBudget>();
+    auto name = std::to_string(Clock::now().time_since_epoch().count());
+    Url url(std::string(kRequestAddr) + "/flaky/cancel-" + name + "?fail=10");
+
+    CancellationToken token;
+    auto canceller = CancelLater(token, milliseconds(100));
+    ExpectCancelled([&] {
+        Get(url, kNative, token, policy);
+    }, milliseconds(1000));
+    canceller.get();
+    EXPECT_EQ(1U, policy.budget->stats().retries);
+
+    CancellationToken async_token;
+    canceller = CancelLater(async_token, milliseconds(100));
+    ExpectCancelled([&] {
+        GetAsync(url, kNative, async_token, policy).get();
+    }, milliseconds(1000));
+    canceller.get();
+    EXPECT_EQ(2U, policy.budget->stats().retries);
+}
+
+}   // namespace wat
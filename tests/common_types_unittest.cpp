@@ -2,6 +2,17 @@
  @ 0xCCCCCCCC
 */
 
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <random>
+#include <string>
+#include <type_traits>
+#include <vector>
+
 #include "gtest/gtest.h"
 
 #include "winant_http/winant_api.h"
@@ -65,6 +76,264 @@ TEST(TypeHeaders, GeneralUsage)
     EXPECT_TRUE(headers.empty());
 }
 
+TEST(TypeHeaders, CaseInsensitive)
+{
+    Headers headers {
+        {"Content-Type", "text/plain"},
+        {"X-Custom", "1"}
+    };
+
+    EXPECT_TRUE(headers.HasHeader("content-type"));
+    EXPECT_TRUE(headers.HasHeader("CONTENT-TYPE"));
+    EXPECT_TRUE(headers.HasHeader(Headers::Known::ContentType));
+    EXPECT_TRUE(headers.HasHeader("x-custom"));
+    EXPECT_FALSE(headers.HasHeader("x-custom-"));
+
+    headers.SetHeader("content-type", "application/json");
+    EXPECT_EQ(2U, headers.size());
+    kbase::StringView value;
+    ASSERT_TRUE(headers.GetHeader(Headers::Known::ContentType, value));
+    EXPECT_EQ("application/json", value.ToString());
+
+    headers.RemoveHeader("X-CUSTOM");
+    EXPECT_EQ(1U, headers.size());
+    EXPECT_FALSE(headers.GetHeader("x-custom", value));
+
+    EXPECT_EQ(Headers::Known::ETag, Headers::LookupKnown("etag"));
+    EXPECT_EQ(Headers::Known::Count, Headers::LookupKnown("e-tag"));
+}
+
+TEST(TypeHeaders, RepeatedHeaders)
+{
+    Headers headers;
+    headers.AddHeader("Set-Cookie", "a=1");
+    headers.AddHeader("Date", "today");
+    headers.AddHeader("set-cookie", "b=2");
+
+    std::vector<std::string> expected {"a=1", "b=2"};
+    EXPECT_EQ(expected, headers.GetHeaderValues("Set-Cookie"));
+    std::string value;
+    EXPECT_TRUE(headers.GetHeader(Headers::Known::SetCookie, value));
+    EXPECT_EQ("a=1", value);
+
+    // Insertion order is kept.
+    auto it = headers.begin();
+    EXPECT_EQ("Set-Cookie", it->first);
+    EXPECT_EQ("Date", (++it)->first);
+
+    // Indexes of well-known headers follow removals.
+    headers.RemoveHeader("Set-Cookie");
+    EXPECT_FALSE(headers.HasHeader(Headers::Known::SetCookie));
+    ASSERT_TRUE(headers.GetHeader(Headers::Known::Date, value));
+    EXPECT_EQ("today", value);
+
+    headers.AddHeader("Set-Cookie", "c=3");
+    headers.AddHeader("Set-Cookie", "d=4");
+    headers.SetHeader("Set-Cookie", "e=5");
+    expected = {"e=5"};
+    EXPECT_EQ(expected, headers.GetHeaderValues("set-cookie"));
+    EXPECT_TRUE(headers.GetHeader(Headers::Known::Date, value));
+    EXPECT_EQ("today", value);
+    EXPECT_EQ(2U, headers.size());
+}
+
+TEST(TypeHeaders, Parse)
+{
+    auto headers = Headers::Parse("Content-Type:text/plain\r\n"
+                                  "X-Folded: first\r\n"
+                                  "  second\r\n"
+                                  "\tthird\n"
+                                  "not a header\r\n"
+                                  ": no name\r\n"
+                                  "Set-Cookie: a=1\r\n"
+                                  "set-cookie: b=2  \r\n"
+                                  "Empty:\r\n"
+                                  "\r\n"
+                                  "After: end\r\n");
+
+    ASSERT_EQ(5U, headers.size());
+
+    std::string value;
+    EXPECT_TRUE(headers.GetHeader(Headers::Known::ContentType, value));
+    EXPECT_EQ("text/plain", value);
+    EXPECT_TRUE(headers.GetHeader("x-folded", value));
+    EXPECT_EQ("first    second  \tthird", value);
+    std::vector<std::string> cookies {"a=1", "b=2"};
+    EXPECT_EQ(cookies, headers.GetHeaderValues("Set-Cookie"));
+    EXPECT_TRUE(headers.GetHeader("Empty", value));
+    EXPECT_TRUE(value.empty());
+    EXPECT_FALSE(headers.HasHeader("After"));
+
+    // Parsed headers can be modified as usual.
+    headers.SetHeader("Content-Type", "application/json; charset=utf-8");
+    headers.AddHeader("X-Added", "1");
+    EXPECT_TRUE(headers.GetHeader("content-type", value));
+    EXPECT_EQ("application/json; charset=utf-8", value);
+    EXPECT_EQ(6U, headers.size());
+
+    EXPECT_TRUE(Headers::Parse("").empty());
+    EXPECT_TRUE(Headers::Parse("  folded without a header\r\n").empty());
+}
+
+TEST(TypeHeaders, ParseFuzz)
+{
+    const std::string seed = "Content-Length: 12\r\nConnection: keep-alive\r\n"
+                             "X-Folded: a\r\n b\r\nSet-Cookie: x=1\r\n\r\n";
+    const char kAlphabet[] = ":\r\n \tAa-";
+
+    std::mt19937 engine(20201012);
+    for (int round = 0; round < 20000; ++round) {
+        auto input = seed;
+        auto mutations = engine() % 8 + 1;
+        for (unsigned i = 0; i < mutations; ++i) {
+            auto pos = engine() % (input.size() + 1);
+            switch (engine() % 3) {
+                case 0:
+                    input.insert(pos, 1, kAlphabet[engine() % (sizeof(kAlphabet) - 1)]);
+                    break;
+                case 1:
+                    if (pos < input.size()) {
+                        input.erase(pos, 1);
+                    }
+                    break;
+                default:
+                    input.insert(pos, 1, static_cast<char>(engine() % 256));
+                    break;
+            }
+        }
+
+        auto headers = Headers::Parse(input);
+        for (const auto& header : headers) {
+            ASSERT_FALSE(header.first.empty());
+            ASSERT_EQ(kbase::StringView::npos, header.first.find('\n'));
+            ASSERT_EQ(kbase::StringView::npos, header.second.find('\n'));
+            ASSERT_EQ(kbase::StringView::npos, header.second.find('\r'));
+            std::string value;
+            ASSERT_TRUE(headers.GetHeader(header.first, value));
+        }
+
+        // Round-trips through the serialized form.
+        auto serialized = headers.ToString();
+        EXPECT_EQ(headers.size(), Headers::Parse(serialized).size());
+    }
+}
+
+TEST(TypeHeaders, DISABLED_ParseBenchmark)
+{
+    std::string block;
+    for (int i = 0; i < 20; ++i) {
+        block += "X-Header-" + std::to_string(i) + ": some value of a typical length " +
+                 std::to_string(i) + "\r\n";
+    }
+
+    block += "\r\n";
+
+    constexpr int kRounds = 100000;
+    using Clock = std::chrono::steady_clock;
+    size_t total = 0;
+
+    // Copies each name and value, as parsing used to do.
+    auto start = Clock::now();
+    for (int i = 0; i < kRounds; ++i) {
+        std::map<std::string, std::string> headers;
+        size_t pos = 0;
+        while (true) {
+            auto eol = block.find("\r\n", pos);
+            if (eol == pos) {
+                break;
+            }
+
+            auto colon = block.find(": ", pos);
+            headers[block.substr(pos, colon - pos)] = block.substr(colon + 2, eol - colon - 2);
+            pos = eol + 2;
+        }
+
+        total += headers.size();
+    }
+
+    auto copy_elapsed = Clock::now() - start;
+
+    start = Clock::now();
+    for (int i = 0; i < kRounds; ++i) {
+        total += Headers::Parse(block).size();
+    }
+
+    auto parse_elapsed = Clock::now() - start;
+
+    using std::chrono::milliseconds;
+    std::cout << kRounds << " blocks of 20 headers: copying "
+              << std::chrono::duration_cast<milliseconds>(copy_elapsed).count()
+              << "ms, in place " << std::chrono::duration_cast<milliseconds>(parse_elapsed).count()
+              << "ms (" << total << ")" << std::endl;
+}
+
+TEST(TypeHeaders, DISABLED_Benchmark)
+{
+    const std::pair<const char*, const char*> kResponseHeaders[] {
+        {"Date", "Mon, 12 Oct 2020 08:00:00 GMT"},
+        {"Content-Type", "text/html; charset=utf-8"},
+        {"Content-Length", "12345"},
+        {"Connection", "keep-alive"},
+        {"Server", "nginx"},
+        {"Cache-Control", "max-age=3600"},
+        {"ETag", "\"5f8410b0-3039\""},
+        {"Last-Modified", "Mon, 12 Oct 2020 07:00:00 GMT"},
+        {"Vary", "Accept-Encoding"},
+        {"X-Frame-Options", "SAMEORIGIN"},
+        {"X-Content-Type-Options", "nosniff"},
+        {"Strict-Transport-Security", "max-age=31536000"},
+        {"Set-Cookie", "session=abcdef; Path=/"},
+        {"Access-Control-Allow-Origin", "*"},
+        {"X-Request-Id", "3e1c2d4f"},
+        {"Expires", "Mon, 12 Oct 2020 09:00:00 GMT"},
+        {"Accept-Ranges", "bytes"},
+        {"Age", "12"},
+        {"Via", "1.1 varnish"},
+        {"X-Cache", "HIT"}
+    };
+
+    const char* kLookups[] {"Content-Length", "Content-Type", "Connection", "ETag",
+                            "X-Cache", "Transfer-Encoding"};
+
+    constexpr int kRounds = 100000;
+    using Clock = std::chrono::steady_clock;
+    size_t found = 0;
+
+    auto start = Clock::now();
+    for (int i = 0; i < kRounds; ++i) {
+        std::map<std::string, std::string> headers;
+        for (const auto& header : kResponseHeaders) {
+            headers[header.first] = header.second;
+        }
+
+        for (auto name : kLookups) {
+            found += headers.count(name);
+        }
+    }
+
+    auto map_elapsed = Clock::now() - start;
+
+    start = Clock::now();
+    for (int i = 0; i < kRounds; ++i) {
+        Headers headers;
+        for (const auto& header : kResponseHeaders) {
+            headers.AddHeader(header.first, header.second);
+        }
+
+        for (auto name : kLookups) {
+            found += headers.HasHeader(name);
+        }
+    }
+
+    auto headers_elapsed = Clock::now() - start;
+
+    using std::chrono::milliseconds;
+    std::cout << kRounds << " rounds of 20 headers and 6 lookups: std::map "
+              << std::chrono::duration_cast<milliseconds>(map_elapsed).count() << "ms, Headers "
+              << std::chrono::duration_cast<milliseconds>(headers_elapsed).count() << "ms ("
+              << found << ")" << std::endl;
+}
+
 TEST(TypeHeaders, Iteration)
 {
     Headers headers {
@@ -78,6 +347,55 @@ TEST(TypeHeaders, Iteration)
         // Watch out if you changed literal content in headers above.
         EXPECT_EQ(header.first.back(), header.second.back());
     }
+
+    EXPECT_EQ(3, std::distance(headers.begin(), headers.end()));
+    auto it = std::find_if(headers.begin(), headers.end(), [](const Headers::value_type& header) {
+        return header.second == "value2";
+    });
+    ASSERT_TRUE(it != headers.end());
+    EXPECT_STREQ("key2", it->first.c_str());
+    EXPECT_EQ("value3", (++it)->second);
+
+    // Values can be modified through iterators, and lookups see them.
+    for (auto& header : headers) {
+        std::string& value = header.second;
+        value += "-modified";
+    }
+
+    headers.begin()->second = "value1-assigned";
+    std::string value;
+    ASSERT_TRUE(headers.GetHeader("key1", value));
+    EXPECT_EQ("value1-assigned", value);
+    ASSERT_TRUE(headers.GetHeader("key3", value));
+    EXPECT_EQ("value3-modified", value);
+    headers.AddHeader("key4", "value4");
+    EXPECT_EQ("key1: value1-assigned\r\nkey2: value2-modified\r\nkey3: value3-modified\r\n"
+              "key4: value4\r\n\r\n", headers.ToString());
+    headers.AddHeader("key2", "again");
+    headers.SetHeader("KEY2", "set");
+    headers.RemoveHeader("key3");
+    EXPECT_EQ("key1: value1-assigned\r\nKEY2: set\r\nkey4: value4\r\n\r\n", headers.ToString());
+
+    // Parsed headers are copied out as they are iterated, and the copies follow modifications.
+    const auto parsed = Headers::Parse("Content-Type: text/plain\r\nX-Id: 7\r\n\r\n");
+    std::vector<std::string> names;
+    for (const auto& header : parsed) {
+        const std::string& name = header.first;
+        names.push_back(name);
+    }
+
+    EXPECT_EQ((std::vector<std::string> {"Content-Type", "X-Id"}), names);
+    auto copy = parsed;
+    copy.SetHeader("x-id", "8");
+    EXPECT_EQ("8", std::prev(copy.cend())->second);
+    EXPECT_EQ("7", std::prev(parsed.cend())->second);
+
+    // Views iterate without copying the entries out.
+    static_assert(std::is_same<Headers::view_iterator::reference, Headers::view_type>::value, "");
+    auto view = parsed.views().begin();
+    EXPECT_EQ("Content-Type", view->first.ToString());
+    EXPECT_EQ("7", (++view)->second.ToString());
+    EXPECT_TRUE(++view == parsed.views().end());
 }
 
 TEST(TypeHeaders, ToString)
@@ -114,6 +432,24 @@ TEST(TypeParameters, GeneralUsage)
     EXPECT_EQ(query_string, params.ToString());
 }
 
+TEST(TypeParameters, AppendTo)
+{
+    Parameters params {{"q", "winant http"}, {"flag", ""}, {"a&b", "c=d"}};
+    const char query_string[] = "q=winant%20http&flag&a%26b=c%3Dd";
+    EXPECT_EQ(sizeof(query_string) - 1, params.EncodedSize());
+
+    // Separators don't depend on what the buffer holds already.
+    std::string url = "http://127.0.0.1/?";
+    params.AppendTo(url);
+    EXPECT_EQ(std::string("http://127.0.0.1/?") + query_string, url);
+
+    Payload payload {{"token", "token 123"}};
+    std::string data;
+    payload.AppendTo(data);
+    EXPECT_EQ("token=token%20123", data);
+    EXPECT_EQ(data.size(), payload.EncodedSize());
+}
+
 TEST(TypeParameters, Empty)
 {
     Parameters empty_params;
@@ -134,7 +470,7 @@ TEST(TypePayload, GeneralUsage)
     EXPECT_FALSE(payload.empty());
     payload.Add({"uid", "kcno.1"}).Add({"app", "winant http"});
 
-    const wchar_t type[] = L"Content-Type: application/x-www-form-urlencoded\r\n";
+    const char type[] = "application/x-www-form-urlencoded";
     const char data[] = "token=token123&uid=kcno.1&app=winant%20http";
     auto content = payload.ToString();
     EXPECT_EQ(type, content.first);
@@ -146,7 +482,7 @@ TEST(TypeJSONContent, GeneralUsage)
     JSONContent json_data;
     EXPECT_TRUE(json_data.empty());
 
-    const wchar_t type[] = L"Content-Type: application/json\r\n";
+    const char type[] = "application/json";
     const char json_str[] = R"({"code": 0, "msg": "success"})";
     json_data.data = json_str;
     EXPECT_FALSE(json_data.empty());
@@ -171,14 +507,12 @@ TEST(TypeMultipart, Generation)
     upload.AddPart(std::move(file)).AddPart(Multipart::Value {"file_size", "unknown"});
 
     auto content = upload.ToString();
-    kbase::WStringView type = L"Content-Type: multipart/form-data; boundary=";
+    kbase::StringView type = "multipart/form-data; boundary=";
     EXPECT_TRUE(kbase::StartsWith(content.first, type));
-    EXPECT_TRUE(kbase::EndsWith(content.first, L"\r\n"));
 
     std::cout << content.second << std::endl;
 
-    auto boundary = kbase::WideToASCII(content.first.substr(content.first.find('=') + 1));
-    kbase::EraseChars(boundary, "\r\n");
+    auto boundary = content.first.substr(content.first.find('=') + 1);
     constexpr const char* data_template =
         "--{0}\r\n"
         "Content-Disposition: form-data; name=\"file\"; filename=\"test.txt\"\r\n"
@@ -192,6 +526,87 @@ TEST(TypeMultipart, Generation)
     EXPECT_EQ(expected, content.second);
 }
 
+TEST(TypeMultipart, LocalFile)
+{
+    const char kLocalFile[] = "common_types_multipart.txt";
+    {
+        std::ofstream file(kLocalFile, std::ios::binary);
+        file << "hello, world!";
+    }
+
+    Multipart upload;
+    upload.AddPart(Multipart::Value {"file_size", "unknown"})
+          .AddPart(Multipart::LocalFile {"file", "test.txt", Multipart::File::kDefaultMimeType,
+                                         kLocalFile});
+
+    // Part headers and the file are separate segments.
+    auto content = upload.ToBody();
+    EXPECT_EQ(3U, content.second.segments().size());
+    EXPECT_EQ(RequestBody::Segment::Type::File, content.second.segments()[1].type);
+
+    auto flattened = upload.ToString();
+    auto boundary = flattened.first.substr(flattened.first.find('=') + 1);
+    constexpr const char* data_template =
+        "--{0}\r\n"
+        "Content-Disposition: form-data; name=\"file_size\"\r\n\r\n"
+        "unknown\r\n"
+        "--{0}\r\n"
+        "Content-Disposition: form-data; name=\"file\"; filename=\"test.txt\"\r\n"
+        "Content-Type: application/octet-stream\r\n\r\n"
+        "hello, world!\r\n"
+        "--{0}--\r\n";
+    EXPECT_EQ(kbase::StringFormat(data_template, boundary), flattened.second);
+    EXPECT_EQ(static_cast<int64_t>(flattened.second.size()), content.second.length());
+
+    std::remove(kLocalFile);
+}
+
+TEST(TypeMultipart, Streaming)
+{
+    const char kLocalFile[] = "common_types_multipart_streaming.txt";
+    {
+        std::ofstream file(kLocalFile, std::ios::binary);
+        file << std::string(100000, 'x');
+    }
+
+    Multipart upload;
+    upload.AddPart(Multipart::Value {"key", "value"})
+          .AddPart(Multipart::File {"first", "first.bin", Multipart::File::kDefaultMimeType,
+                                    std::string(50000, 'a')})
+          .AddPart(Multipart::File {"second", "second.bin", Multipart::File::kDefaultMimeType,
+                                    std::string(50000, 'b')})
+          .AddPart(Multipart::LocalFile {"file", "local.txt", "text/plain", kLocalFile});
+
+    auto content_length = upload.GetContentLength();
+    EXPECT_EQ(content_length, static_cast<int64_t>(upload.ToString().second.size()));
+
+    // text | first | text | second | text | local file | text
+    auto content = upload.ToBody();
+    const auto& segments = content.second.segments();
+    ASSERT_EQ(7U, segments.size());
+    EXPECT_EQ(content_length, content.second.length());
+    EXPECT_EQ(50000U, segments[1].data.size());
+    EXPECT_EQ(RequestBody::Segment::Type::File, segments[5].type);
+
+    // Boundary lines and part headers share one buffer.
+    for (size_t i : {0, 2, 4, 6}) {
+        EXPECT_EQ(RequestBody::Segment::Type::Memory, segments[i].type);
+        EXPECT_EQ(segments[0].owned_data, segments[i].owned_data);
+        EXPECT_EQ(segments[0].owned_data->size(), segments[0].owned_data->capacity());
+    }
+
+    // Data of files is moved.
+    auto moved = std::move(upload).ToBody();
+    EXPECT_EQ(content_length, moved.second.length());
+    EXPECT_TRUE(upload.files[0].data.empty());
+
+    std::remove(kLocalFile);
+    EXPECT_THROW(upload.GetContentLength(), std::exception);
+}
+
+// Only WinINet reaches https servers; the native transport, the only one elsewhere, has no TLS.
+#if defined(_WIN32)
+
 TEST(TypeLoadFlags, DoNotSaveResponseBody)
 {
     constexpr char kHost[] = "https://httpbin.org/get";
@@ -226,4 +641,6 @@ TEST(TypeReadResponseHandler, UseAsDownloader)
     std::cout << data;
 }
 
+#endif
+
 }   // namespace wat
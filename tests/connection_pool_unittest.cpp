@@ -0,0 +1,120 @@
+/*
+ @ 0xCCCCCCCC
+*/
+
+#include <chrono>
+#include <future>
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "winant_http/winant_http.h"
+
+namespace {
+
+constexpr char kRequestAddr[] = "http://127.0.0.1:5001";
+
+const wat::LoadFlags kNative(wat::LoadFlags::UseNativeTransport);
+
+}   // namespace
+
+namespace wat {
+
+TEST(ConnectionPool, ReuseConnection)
+{
+    auto pool = std::make_shared<ConnectionPool>();
+
+    for (int i = 0; i < 5; ++i) {
+        auto response = Get(Url(kRequestAddr), kNative, pool);
+        EXPECT_EQ(200, response.status_code());
+    }
+
+    auto stats = pool->stats();
+    EXPECT_EQ(1U, stats.misses);
+    EXPECT_EQ(4U, stats.hits);
+    EXPECT_EQ(1U, pool->idle_count());
+
+    pool->CloseIdleConnections();
+    EXPECT_EQ(0U, pool->idle_count());
+    auto response = Post(Url(kRequestAddr), kNative, pool);
+    EXPECT_EQ(200, response.status_code());
+    EXPECT_EQ(2U, pool->stats().misses);
+}
+
+TEST(ConnectionPool, IdleTimeout)
+{
+    ConnectionPool::Options options;
+    options.idle_timeout = std::chrono::milliseconds(0);
+    auto pool = std::make_shared<ConnectionPool>(options);
+
+    for (int i = 0; i < 3; ++i) {
+        auto response = Get(Url(kRequestAddr), kNative, pool);
+        EXPECT_EQ(200, response.status_code());
+    }
+
+    auto stats = pool->stats();
+    EXPECT_EQ(3U, stats.misses);
+    EXPECT_EQ(0U, stats.hits);
+    EXPECT_EQ(2U, stats.discarded);
+}
+
+TEST(ConnectionPool, RequestConnectionClose)
+{
+    auto pool = std::make_shared<ConnectionPool>();
+    auto response = Get(Url(kRequestAddr), Headers{{"Connection", "close"}}, kNative, pool);
+    EXPECT_EQ(200, response.status_code());
+    EXPECT_EQ(0U, pool->idle_count());
+}
+
+TEST(ConnectionPool, PerHostLimit)
+{
+    ConnectionPool::Options options;
+    options.max_connections_per_host = 2;
+    auto pool = std::make_shared<ConnectionPool>(options);
+
+    std::vector<std::thread> workers;
+    for (int i = 0; i < 6; ++i) {
+        workers.emplace_back([pool] {
+            auto response = Get(Url(kRequestAddr), kNative, pool);
+            EXPECT_EQ(200, response.status_code());
+        });
+    }
+
+    for (auto& worker : workers) {
+        worker.join();
+    }
+
+    auto stats = pool->stats();
+    EXPECT_LE(stats.misses, 2U);
+    EXPECT_EQ(6U, stats.hits + stats.misses);
+    EXPECT_LE(pool->idle_count(), 2U);
+}
+
+TEST(ConnectionPool, AsyncWaitForConnection)
+{
+    ConnectionPool::Options options;
+    options.max_connections_per_host = 1;
+    auto pool = std::make_shared<ConnectionPool>(options);
+
+    // Requests beyond the limit queue up in the pool instead of blocking the caller, and the
+    // host name is looked up off the I/O loop.
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::future<HttpResponse>> futures;
+    futures.push_back(GetAsync(Url("http://localhost:5001/delay/300"), kNative, pool));
+    for (int i = 0; i < 3; ++i) {
+        futures.push_back(GetAsync(Url("http://localhost:5001/"), kNative, pool));
+    }
+
+    EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::milliseconds(100));
+
+    for (auto& future : futures) {
+        EXPECT_EQ(200, future.get().status_code());
+    }
+
+    auto stats = pool->stats();
+    EXPECT_EQ(4U, stats.hits + stats.misses);
+    EXPECT_LE(pool->idle_count(), 1U);
+}
+
+}   // namespace wat
@@ -0,0 +1,277 @@
+/*
+ @ 0xCCCCCCCC
+*/
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+#include "gtest/gtest.h"
+
+#if defined(WINANT_HTTP_USE_ZLIB)
+#include "zlib.h"
+#endif
+
+#include "winant_http/winant_http.h"
+#include "winant_http/internal/content_decoder.h"
+
+namespace {
+
+using wat::internal::ContentDecoder;
+
+constexpr char kRequestAddr[] = "http://127.0.0.1:5001";
+
+const wat::LoadFlags kNative(wat::LoadFlags::UseNativeTransport);
+
+// Same as json_lines() of keep_alive_server.py.
+std::string JsonLines(size_t size)
+{
+    std::string lines;
+    for (int i = 0; lines.size() < size; ++i) {
+        auto id = std::to_string(i);
+        lines.append("{\"id\": ").append(id).append(", \"name\": \"item-").append(id)
+             .append("\", \"tags\": [\"winant\", \"http\"]}\n");
+    }
+
+    lines.resize(size);
+    return lines;
+}
+
+#if defined(WINANT_HTTP_USE_ZLIB) || defined(WINANT_HTTP_USE_BROTLI)
+
+// Feeds `data` in pieces of `step` bytes and collects the output.
+std::string DecodeInSteps(ContentDecoder& decoder, const std::string& data, size_t step)
+{
+    std::string decoded;
+    auto on_output = [&decoded](const char* out, size_t size) {
+        decoded.append(out, size);
+    };
+
+    for (size_t pos = 0; pos < data.size(); pos += step) {
+        decoder.Decode(data.data() + pos, std::min(step, data.size() - pos), on_output);
+    }
+
+    decoder.Finish();
+    return decoded;
+}
+
+#endif
+
+#if defined(WINANT_HTTP_USE_ZLIB)
+
+// `window_bits` as taken by deflateInit2(), i.e. 16 added for gzip and negative for raw deflate.
+std::string Compress(const std::string& data, int window_bits)
+{
+    z_stream stream {};
+    deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, window_bits, 8,
+                 Z_DEFAULT_STRATEGY);
+    std::string compressed(deflateBound(&stream, static_cast<uLong>(data.size())), '\0');
+    stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data.data()));
+    stream.avail_in = static_cast<uInt>(data.size());
+    stream.next_out = reinterpret_cast<Bytef*>(&compressed[0]);
+    stream.avail_out = static_cast<uInt>(compressed.size());
+    deflate(&stream, Z_FINISH);
+    compressed.resize(stream.total_out);
+    deflateEnd(&stream);
+    return compressed;
+}
+
+#endif
+
+}   // namespace
+
+namespace wat {
+
+TEST(ContentDecoder, Create)
+{
+    EXPECT_EQ(nullptr, ContentDecoder::Create("identity"));
+    EXPECT_EQ(nullptr, ContentDecoder::Create("compress"));
+    EXPECT_EQ(nullptr, ContentDecoder::Create("gzip, br"));
+
+#if defined(WINANT_HTTP_USE_ZLIB)
+    EXPECT_NE(nullptr, ContentDecoder::Create("gzip"));
+    EXPECT_NE(nullptr, ContentDecoder::Create(" X-GZIP "));
+    EXPECT_NE(nullptr, ContentDecoder::Create("Deflate"));
+    EXPECT_NE(std::string::npos, std::string(ContentDecoder::AcceptEncoding()).find("gzip"));
+#endif
+
+#if defined(WINANT_HTTP_USE_BROTLI)
+    EXPECT_NE(nullptr, ContentDecoder::Create("br"));
+    EXPECT_NE(std::string::npos, std::string(ContentDecoder::AcceptEncoding()).find("br"));
+#endif
+}
+
+#if defined(WINANT_HTTP_USE_ZLIB)
+
+TEST(ContentDecoder, Zlib)
+{
+    const auto data = JsonLines(200000);
+    const std::pair<const char*, int> formats[] {
+        {"gzip", MAX_WBITS + 16},
+        {"deflate", MAX_WBITS},
+        // Some servers send deflate without the zlib wrapper.
+        {"deflate", -MAX_WBITS}
+    };
+
+    for (const auto& format : formats) {
+        auto compressed = Compress(data, format.second);
+        for (size_t step : {size_t(1), size_t(7), size_t(4096), compressed.size()}) {
+            auto decoder = ContentDecoder::Create(format.first);
+            ASSERT_NE(nullptr, decoder);
+            EXPECT_EQ(data, DecodeInSteps(*decoder, compressed, step))
+                << format.second << " " << step;
+        }
+    }
+
+    // Members of a gzip stream are decoded one after another.
+    auto member = Compress("winant", MAX_WBITS + 16);
+    EXPECT_EQ("winantwinant", DecodeInSteps(*ContentDecoder::Create("gzip"), member + member, 3));
+
+    // An empty body is fine.
+    EXPECT_EQ("", DecodeInSteps(*ContentDecoder::Create("gzip"), "", 1));
+    EXPECT_EQ("", DecodeInSteps(*ContentDecoder::Create("deflate"), "", 1));
+}
+
+TEST(ContentDecoder, ZlibMalformed)
+{
+    auto compressed = Compress(JsonLines(10000), MAX_WBITS + 16);
+
+    auto truncated = compressed.substr(0, compressed.size() / 2);
+    EXPECT_THROW(DecodeInSteps(*ContentDecoder::Create("gzip"), truncated, 100), std::exception);
+
+    auto corrupted = compressed;
+    corrupted[0] = 'x';
+    EXPECT_THROW(DecodeInSteps(*ContentDecoder::Create("gzip"), corrupted, 100), std::exception);
+
+    EXPECT_THROW(DecodeInSteps(*ContentDecoder::Create("deflate"), "x", 1), std::exception);
+}
+
+#endif  // WINANT_HTTP_USE_ZLIB
+
+#if defined(WINANT_HTTP_USE_BROTLI)
+
+TEST(ContentDecoder, Brotli)
+{
+    // "winant http, " 20 times.
+    const std::string compressed("\x1B\x03\x01\xF8\x8D\xD4\x4E\x77\xF3\x47\x2B\xB7\x3B\x70\xC8"
+                                 "\x91\x36\x4F\x25\x2B\x0B\x1E\x03\x46\x03\xC7\x4E\xA0\xC2\x2D",
+                                 30);
+    std::string expected;
+    for (int i = 0; i < 20; ++i) {
+        expected += "winant http, ";
+    }
+
+    for (size_t step : {size_t(1), size_t(5), compressed.size()}) {
+        EXPECT_EQ(expected, DecodeInSteps(*ContentDecoder::Create("br"), compressed, step));
+    }
+
+    EXPECT_THROW(DecodeInSteps(*ContentDecoder::Create("br"), compressed.substr(0, 20), 5),
+                 std::exception);
+    EXPECT_THROW(DecodeInSteps(*ContentDecoder::Create("br"), "\xFF\xFF\xFF", 1),
+                 std::exception);
+}
+
+#endif  // WINANT_HTTP_USE_BROTLI
+
+TEST(ContentDecoder, NativeTransport)
+{
+    const auto expected = JsonLines(300000);
+    // The body comes encoded only if the build can decode it.
+    bool asked_for_encoding = internal::DecodesContent(
+        internal::BuildRequest(HttpRequest::Method::Get, Url(kRequestAddr), kNative));
+    for (auto coding : {"gzip", "deflate", "deflate-raw"}) {
+        for (auto framing : {"", "/chunked"}) {
+            std::string handled;
+            auto response = Get(Url(std::string(kRequestAddr) + "/encoded/" + coding +
+                                    "/300000" + framing),
+                                kNative, ReadResponseHandler(
+                                    [&handled](const char* data, int bytes_read) {
+                                        if (bytes_read > 0) {
+                                            handled.append(data, bytes_read);
+                                        }
+                                    }));
+            ASSERT_EQ(200, response.status_code());
+            EXPECT_EQ(expected, response.text()) << coding << framing;
+            EXPECT_EQ(expected, handled) << coding << framing;
+
+            // Headers are left as they were.
+            EXPECT_EQ(asked_for_encoding,
+                      response.headers().HasHeader(Headers::Known::ContentEncoding));
+        }
+    }
+}
+
+TEST(ContentDecoder, LeftEncoded)
+{
+    const auto expected = JsonLines(1000);
+    const std::string url = std::string(kRequestAddr) + "/encoded/gzip/1000";
+
+    // Not asked for, and thus not sent.
+    auto response = Get(Url(url), LoadFlags(LoadFlags::UseNativeTransport |
+                                            LoadFlags::DoNotDecodeResponse));
+    EXPECT_FALSE(response.headers().HasHeader(Headers::Known::ContentEncoding));
+    EXPECT_EQ(expected, response.text());
+
+    // Asked for by the caller, who is then to decode it.
+    response = Get(Url(url), Headers{{"Accept-Encoding", "gzip"}}, kNative);
+    std::string content_encoding;
+    ASSERT_TRUE(response.headers().GetHeader(Headers::Known::ContentEncoding, content_encoding));
+    EXPECT_EQ("gzip", content_encoding);
+    ASSERT_GE(response.text().size(), 2U);
+    EXPECT_EQ("\x1F\x8B", response.text().substr(0, 2));
+}
+
+TEST(ContentDecoder, AsyncAndPipelined)
+{
+    const auto expected = JsonLines(50000);
+    const std::string url = std::string(kRequestAddr) + "/encoded/gzip/50000/chunked";
+
+    auto response = GetAsync(Url(url), kNative).get();
+    EXPECT_EQ(expected, response.text());
+
+    Batch::Options options;
+    options.max_in_flight = 1;
+    options.pipelining = true;
+    Batch batch(options);
+    for (int i = 0; i < 6; ++i) {
+        batch.AddGet(Url(i % 2 ? url : std::string(kRequestAddr) + "/encoded/deflate/50000"),
+                     kNative);
+    }
+
+    for (const auto& result : batch.Run()) {
+        ASSERT_TRUE(result.succeeded());
+        EXPECT_EQ(expected, result.response.text());
+    }
+}
+
+TEST(ContentDecoder, DISABLED_ThroughputBenchmark)
+{
+    constexpr int kRounds = 5;
+    const std::string body_size = "16000000";
+    for (auto coding : {"identity", "gzip", "deflate"}) {
+        for (auto framing : {"", "/chunked"}) {
+            const auto url = std::string(kRequestAddr) + "/encoded/" + coding + "/" + body_size +
+                             framing;
+            // Warms up the server, which encodes the body anew every time.
+            auto response = Get(Url(url), kNative);
+
+            size_t total = 0;
+            auto start = std::chrono::steady_clock::now();
+            for (int i = 0; i < kRounds; ++i) {
+                response = Get(Url(url), kNative);
+                total += response.text().size();
+            }
+
+            auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::steady_clock::now() - start);
+            std::cout << coding << framing << ": " << elapsed.count() / kRounds << "us per "
+                      << body_size << " bytes, "
+                      << total / std::max<int64_t>(elapsed.count(), 1) << " MB/s decoded"
+                      << std::endl;
+        }
+    }
+}
+
+}   // namespace wat
@@ -0,0 +1,169 @@
+/*
+ @ 0xCCCCCCCC
+*/
+
+#include "winant_http/winant_coroutine.h"
+
+#if defined(WINANT_HTTP_HAS_COROUTINE)
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <future>
+#include <iostream>
+#include <mutex>
+#include <thread>
+
+#include "gtest/gtest.h"
+
+#include "winant_http/winant_http.h"
+
+namespace {
+
+constexpr char kRequestAddr[] = "http://127.0.0.1:5001";
+
+const wat::LoadFlags kNative(wat::LoadFlags::UseNativeTransport);
+
+// A coroutine that starts eagerly and destroys itself when it finishes.
+struct FireAndForget {
+    struct promise_type {
+        FireAndForget get_return_object() noexcept { return {}; }
+        std::suspend_never initial_suspend() noexcept { return {}; }
+        std::suspend_never final_suspend() noexcept { return {}; }
+        void return_void() noexcept {}
+        void unhandled_exception() noexcept { std::terminate(); }
+    };
+};
+
+// Runs posted tasks on the thread calling RunOne().
+class TaskQueue {
+public:
+    wat::Executor executor()
+    {
+        return [this](std::function<void()> task) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            tasks_.push_back(std::move(task));
+            cv_.notify_one();
+        };
+    }
+
+    void RunOne()
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        cv_.wait(lock, [this] { return !tasks_.empty(); });
+        auto task = std::move(tasks_.front());
+        tasks_.pop_front();
+        lock.unlock();
+        task();
+    }
+
+private:
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::deque<std::function<void()>> tasks_;
+};
+
+FireAndForget FetchText(std::promise<std::string>& result)
+{
+    auto response = co_await wat::coro::Get(wat::Url(kRequestAddr), kNative);
+    result.set_value(response.text());
+}
+
+FireAndForget FetchOnExecutor(TaskQueue& queue, std::thread::id& resumed_on, int& status)
+{
+    auto response = co_await wat::coro::Post(wat::Url(kRequestAddr), kNative,
+                                             wat::RequestBody("echo"))
+                        .ResumeOn(queue.executor());
+    resumed_on = std::this_thread::get_id();
+    status = response.status_code();
+}
+
+FireAndForget FetchFailure(std::promise<bool>& failed)
+{
+    try {
+        co_await wat::coro::Get(wat::Url("http://127.0.0.1:1"), kNative);
+        failed.set_value(false);
+    } catch (...) {
+        failed.set_value(true);
+    }
+}
+
+FireAndForget Probe(std::shared_ptr<wat::ConnectionPool> pool, std::atomic<int>& succeeded,
+                    std::atomic<int>& remaining, std::promise<void>& all_done)
+{
+    try {
+        auto response = co_await wat::coro::Head(wat::Url(kRequestAddr), kNative, pool);
+        if (response.status_code() == 200) {
+            ++succeeded;
+        }
+    } catch (...) {}
+
+    if (--remaining == 0) {
+        all_done.set_value();
+    }
+}
+
+}   // namespace
+
+namespace wat {
+
+TEST(Coroutine, Get)
+{
+    std::promise<std::string> result;
+    FetchText(result);
+    EXPECT_EQ("Welcome to keep-alive server via GET", result.get_future().get());
+}
+
+TEST(Coroutine, ResumeOnExecutor)
+{
+    TaskQueue queue;
+    std::thread::id resumed_on;
+    int status = 0;
+    FetchOnExecutor(queue, resumed_on, status);
+    queue.RunOne();
+    EXPECT_EQ(std::this_thread::get_id(), resumed_on);
+    EXPECT_EQ(200, status);
+}
+
+TEST(Coroutine, Failure)
+{
+    std::promise<bool> failed;
+    FetchFailure(failed);
+    EXPECT_TRUE(failed.get_future().get());
+}
+
+// 10k requests in flight as suspended coroutines, while the pool bounds the number of sockets.
+// Run with --gtest_also_run_disabled_tests.
+TEST(Coroutine, DISABLED_ConcurrencyBenchmark)
+{
+    constexpr int kRequestCount = 10000;
+
+    ConnectionPool::Options options;
+    options.max_connections_per_host = 64;
+    options.max_idle_per_host = 64;
+    auto pool = std::make_shared<ConnectionPool>(options);
+
+    std::atomic<int> succeeded(0);
+    std::atomic<int> remaining(kRequestCount);
+    std::promise<void> all_done;
+
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < kRequestCount; ++i) {
+        Probe(pool, succeeded, remaining, all_done);
+    }
+
+    all_done.get_future().get();
+    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - start);
+
+    EXPECT_EQ(kRequestCount, succeeded.load());
+    auto stats = pool->stats();
+    EXPECT_LE(stats.misses, 64U + stats.discarded);
+    std::cout << kRequestCount << " requests in " << elapsed.count() << "ms, "
+              << stats.misses << " connections opened" << std::endl;
+}
+
+}   // namespace wat
+
+#endif  // WINANT_HTTP_HAS_COROUTINE
@@ -0,0 +1,191 @@
+/*
+ @ 0xCCCCCCCC
+*/
+
+#include <chrono>
+#include <memory>
+#include <string>
+#include <thread>
+
+#include "gtest/gtest.h"
+
+#include "winant_http/winant_http.h"
+
+namespace {
+
+constexpr char kRequestAddr[] = "http://127.0.0.1:5001";
+
+const wat::LoadFlags kNative(wat::LoadFlags::UseNativeTransport);
+
+using std::chrono::milliseconds;
+using Clock = std::chrono::steady_clock;
+
+// The server counts requests by name for as long as it runs.
+std::string SlowName(const std::string& name)
+{
+    static const auto run = std::to_string(Clock::now().time_since_epoch().count());
+    return name + "-" + run;
+}
+
+wat::Url SlowUrl(const std::string& name, int first_delay)
+{
+    return wat::Url(std::string(kRequestAddr) + "/slow/" + SlowName(name) + "?first=" +
+                    std::to_string(first_delay));
+}
+
+wat::HedgePolicy QuickPolicy()
+{
+    wat::HedgePolicy policy;
+    policy.initial_delay = milliseconds(50);
+    policy.tracker = std::make_shared<wat::HedgeTracker>();
+    return policy;
+}
+
+}   // namespace
+
+namespace wat {
+
+TEST(HedgePolicy, Tracker)
+{
+    HedgeTracker tracker(100);
+    milliseconds latency;
+    EXPECT_FALSE(tracker.Percentile(95, 1, latency));
+
+    for (int i = 100; i > 0; --i) {
+        tracker.Record(milliseconds(i));
+    }
+
+    EXPECT_FALSE(tracker.Percentile(95, 101, latency));
+    ASSERT_TRUE(tracker.Percentile(95, 100, latency));
+    EXPECT_EQ(95, latency.count());
+    ASSERT_TRUE(tracker.Percentile(50, 100, latency));
+    EXPECT_EQ(50, latency.count());
+    ASSERT_TRUE(tracker.Percentile(100, 100, latency));
+    EXPECT_EQ(100, latency.count());
+
+    // Only the latest samples are kept.
+    for (int i = 0; i < 100; ++i) {
+        tracker.Record(milliseconds(1000));
+    }
+
+    EXPECT_EQ(100U, tracker.sample_count());
+    ASSERT_TRUE(tracker.Percentile(1, 100, latency));
+    EXPECT_EQ(1000, latency.count());
+}
+
+TEST(HedgePolicy, HedgeWins)
+{
+    auto policy = QuickPolicy();
+
+    auto start = Clock::now();
+    auto response = Get(SlowUrl("wins", 2000), kNative, policy);
+    EXPECT_LT(Clock::now() - start, milliseconds(1000));
+    EXPECT_EQ(SlowName("wins") + ":2:127.0.0.1:5001", response.text());
+
+    start = Clock::now();
+    response = GetAsync(SlowUrl("wins-async", 2000), kNative, policy).get();
+    EXPECT_LT(Clock::now() - start, milliseconds(1000));
+    EXPECT_EQ(SlowName("wins-async") + ":2:127.0.0.1:5001", response.text());
+
+    auto stats = policy.tracker->stats();
+    EXPECT_EQ(2U, stats.requests);
+    EXPECT_EQ(2U, stats.hedges);
+    EXPECT_EQ(2U, stats.hedge_wins);
+}
+
+TEST(HedgePolicy, NoHedgeWhenFast)
+{
+    auto policy = QuickPolicy();
+    policy.initial_delay = milliseconds(500);
+
+    auto response = Get(SlowUrl("fast", 0), kNative, policy);
+    EXPECT_EQ(SlowName("fast") + ":1:127.0.0.1:5001", response.text());
+    response = GetAsync(SlowUrl("fast-async", 100), kNative, policy).get();
+    EXPECT_EQ(SlowName("fast-async") + ":1:127.0.0.1:5001", response.text());
+
+    auto stats = policy.tracker->stats();
+    EXPECT_EQ(2U, stats.requests);
+    EXPECT_EQ(0U, stats.hedges);
+    EXPECT_EQ(2U, policy.tracker->sample_count());
+}
+
+TEST(HedgePolicy, PercentileDelay)
+{
+    // The tracker says requests take 300ms to respond.
+    auto policy = QuickPolicy();
+    policy.tracker = std::make_shared<HedgeTracker>(20);
+    policy.min_samples = 20;
+    for (int i = 0; i < 20; ++i) {
+        policy.tracker->Record(milliseconds(300));
+    }
+
+    auto response = Get(SlowUrl("percentile-slow", 150), kNative, policy);
+    EXPECT_EQ(SlowName("percentile-slow") + ":1:127.0.0.1:5001", response.text());
+    EXPECT_EQ(0U, policy.tracker->stats().hedges);
+
+    // And now that they take 10ms.
+    for (int i = 0; i < 20; ++i) {
+        policy.tracker->Record(milliseconds(10));
+    }
+
+    response = Get(SlowUrl("percentile-fast", 500), kNative, policy);
+    EXPECT_EQ(SlowName("percentile-fast") + ":2:127.0.0.1:5001", response.text());
+    EXPECT_EQ(1U, policy.tracker->stats().hedges);
+}
+
+TEST(HedgePolicy, AlternateHost)
+{
+    auto policy = QuickPolicy();
+    policy.alternate_host = "localhost:5001";
+
+    auto response = Get(SlowUrl("alternate", 2000), kNative, policy);
+    EXPECT_EQ(SlowName("alternate") + ":2:localhost:5001", response.text());
+    EXPECT_EQ(1U, policy.tracker->stats().hedge_wins);
+}
+
+TEST(HedgePolicy, LoserAbandoned)
+{
+    auto policy = QuickPolicy();
+    auto pool = std::make_shared<ConnectionPool>();
+
+    auto response = GetAsync(SlowUrl("abandoned", 2000), kNative, policy, pool).get();
+    EXPECT_EQ(SlowName("abandoned") + ":2:127.0.0.1:5001", response.text());
+
+    // The connection of the hedge goes back to the pool, while that of the request is closed
+    // without waiting for its response.
+    std::this_thread::sleep_for(milliseconds(100));
+    EXPECT_EQ(1U, pool->idle_count());
+}
+
+TEST(HedgePolicy, NoHedgeWithoutConnection)
+{
+    auto policy = QuickPolicy();
+    ConnectionPool::Options options;
+    options.max_connections_per_host = 1;
+    auto pool = std::make_shared<ConnectionPool>(options);
+
+    // The request holds the only connection, which a hedge would have to wait for.
+    auto response = GetAsync(SlowUrl("capped", 200), kNative, policy, pool).get();
+    EXPECT_EQ(SlowName("capped") + ":1:127.0.0.1:5001", response.text());
+    response = Get(SlowUrl("capped-sync", 200), kNative, policy, pool);
+    EXPECT_EQ(SlowName("capped-sync") + ":1:127.0.0.1:5001", response.text());
+    EXPECT_EQ(0U, policy.tracker->stats().hedges);
+
+    // Other hosts have connections of their own.
+    policy.alternate_host = "localhost:5001";
+    response = Get(SlowUrl("capped-alternate", 2000), kNative, policy, pool);
+    EXPECT_EQ(SlowName("capped-alternate") + ":2:localhost:5001", response.text());
+    EXPECT_EQ(1U, policy.tracker->stats().hedges);
+}
+
+TEST(HedgePolicy, NotApplicable)
+{
+    auto policy = QuickPolicy();
+
+    auto response = Post(Url(std::string(kRequestAddr) + "/"), kNative, policy,
+                         RequestBody(std::string("data")));
+    EXPECT_EQ(200, response.status_code());
+    EXPECT_EQ(0U, policy.tracker->stats().requests);
+}
+
+}   // namespace wat
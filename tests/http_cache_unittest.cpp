@@ -0,0 +1,352 @@
+/*
+ @ 0xCCCCCCCC
+*/
+
+#include <chrono>
+#include <iostream>
+#include <string>
+
+#include "gtest/gtest.h"
+
+#include "winant_http/winant_http.h"
+#include "winant_http/internal/http_cache_impl.h"
+
+namespace {
+
+using wat::internal::CacheClock;
+
+constexpr char kRequestAddr[] = "http://127.0.0.1:5001";
+
+const wat::LoadFlags kNative(wat::LoadFlags::UseNativeTransport);
+
+// Resources of the test server live as long as it does, and thus are named anew for each run.
+std::string CacheUrl(const std::string& name, const std::string& query)
+{
+    static const auto run = std::to_string(
+        std::chrono::steady_clock::now().time_since_epoch().count());
+    return std::string(kRequestAddr) + "/cache/" + name + "-" + run + "?" + query;
+}
+
+std::string RequestCount(const wat::HttpResponse& response)
+{
+    std::string count;
+    response.headers().GetHeader("X-Requests", count);
+    return count;
+}
+
+}   // namespace
+
+namespace wat {
+
+TEST(HttpCache, ParseHttpDate)
+{
+    // 1994-11-06 08:49:37 UTC
+    const auto expected = CacheClock::from_time_t(0) + std::chrono::seconds(784111777);
+    for (auto date : {"Sun, 06 Nov 1994 08:49:37 GMT",
+                      "Sunday, 06-Nov-94 08:49:37 GMT",
+                      "Sun Nov  6 08:49:37 1994",
+                      "sun, 06 NOV 1994 08:49:37 gmt"}) {
+        CacheClock::time_point time;
+        ASSERT_TRUE(internal::ParseHttpDate(date, time)) << date;
+        EXPECT_TRUE(time == expected) << date;
+    }
+
+    CacheClock::time_point time;
+    EXPECT_TRUE(internal::ParseHttpDate("Thu, 01 Jan 1970 00:00:00 GMT", time));
+    EXPECT_TRUE(time == CacheClock::from_time_t(0));
+    EXPECT_TRUE(internal::ParseHttpDate("Tue, 29 Feb 2000 23:59:59 GMT", time));
+    EXPECT_TRUE(time == CacheClock::from_time_t(0) + std::chrono::seconds(951868799));
+
+    for (auto date : {"", "0", "-1", "Sun, 06 Nov 1994 08:49:37", "Sun, 06 Nov 1994 08:49 GMT",
+                      "Sun, 32 Nov 1994 08:49:37 GMT", "Sun, 06 Foo 1994 08:49:37 GMT",
+                      "Sun, 06 Nov 1994 25:49:37 GMT", "Sun, 06 Nov 994 08:49:37 GMT"}) {
+        EXPECT_FALSE(internal::ParseHttpDate(date, time)) << date;
+    }
+}
+
+TEST(HttpCache, ServeFresh)
+{
+    auto cache = std::make_shared<HttpCache>();
+    const auto url = CacheUrl("fresh", "cc=max-age=60");
+
+    auto first = Get(Url(url), cache, kNative);
+    ASSERT_EQ(200, first.status_code());
+    auto second = Get(Url(url), cache, kNative);
+    EXPECT_EQ(200, second.status_code());
+    EXPECT_EQ(first.text(), second.text());
+    EXPECT_EQ("1", RequestCount(second));
+    EXPECT_TRUE(second.headers().HasHeader("Age"));
+
+    auto stats = cache->stats();
+    EXPECT_EQ(1U, stats.misses);
+    EXPECT_EQ(1U, stats.hits);
+    EXPECT_EQ(1U, stats.stores);
+    EXPECT_EQ(1U, cache->entry_count());
+    EXPECT_GT(cache->memory_size(), first.text().size());
+
+    // Expires works the same, and the fragment doesn't count.
+    const auto expires_url = CacheUrl("expires", "expires=60");
+    EXPECT_EQ(Get(Url(expires_url), cache, kNative).text(),
+              Get(Url(expires_url + "#part"), cache, kNative).text());
+    EXPECT_EQ(2U, cache->stats().hits);
+
+    // Requests without the cache go to the server.
+    EXPECT_EQ("2", RequestCount(Get(Url(url), kNative)));
+}
+
+TEST(HttpCache, HeuristicFreshness)
+{
+    auto cache = std::make_shared<HttpCache>();
+
+    // Last-Modified a day ago.
+    const auto url = CacheUrl("heuristic", "lm=1");
+    auto first = Get(Url(url), cache, kNative);
+    EXPECT_EQ(first.text(), Get(Url(url), cache, kNative).text());
+    EXPECT_EQ(1U, cache->stats().hits);
+
+    // Neither freshness nor validators.
+    const auto plain_url = CacheUrl("plain", "");
+    Get(Url(plain_url), cache, kNative);
+    EXPECT_EQ("2", RequestCount(Get(Url(plain_url), cache, kNative)));
+    EXPECT_EQ(1U, cache->stats().stores);
+}
+
+TEST(HttpCache, Revalidate)
+{
+    auto cache = std::make_shared<HttpCache>();
+
+    const char* queries[] {"cc=no-cache&etag=1", "cc=max-age=0&lm=1", "expires=-10&etag=1&lm=1"};
+    for (size_t i = 0; i < 3; ++i) {
+        const auto query = queries[i];
+        const auto url = CacheUrl("revalidate-" + std::to_string(i), query);
+        auto first = Get(Url(url), cache, kNative);
+        ASSERT_EQ(200, first.status_code());
+
+        // Served on 304, with headers of the 304.
+        auto second = Get(Url(url), cache, kNative);
+        EXPECT_EQ(200, second.status_code()) << query;
+        EXPECT_EQ(first.text(), second.text()) << query;
+        EXPECT_EQ("2", RequestCount(second)) << query;
+    }
+
+    auto stats = cache->stats();
+    EXPECT_EQ(0U, stats.hits);
+    EXPECT_EQ(3U, stats.misses);
+    EXPECT_EQ(3U, stats.revalidations);
+    EXPECT_EQ(3U, stats.not_modified);
+}
+
+TEST(HttpCache, Modified)
+{
+    auto cache = std::make_shared<HttpCache>();
+    const auto url = CacheUrl("modified", "cc=no-cache&etag=1");
+
+    auto first = Get(Url(url), cache, kNative);
+    EXPECT_NE(std::string::npos, first.text().find(":v1:"));
+
+    // Changed behind the back of the cache, which then gets the new version on revalidation.
+    Post(Url(url), kNative);
+    auto second = Get(Url(url), cache, kNative);
+    EXPECT_NE(std::string::npos, second.text().find(":v2:"));
+    EXPECT_EQ(1U, cache->stats().revalidations);
+    EXPECT_EQ(0U, cache->stats().not_modified);
+
+    // Changed through the cache, which then drops what it had.
+    Post(Url(url), cache, kNative);
+    EXPECT_EQ(0U, cache->entry_count());
+    auto third = Get(Url(url), cache, kNative);
+    EXPECT_NE(std::string::npos, third.text().find(":v3:"));
+    EXPECT_EQ(2U, cache->stats().misses);
+}
+
+TEST(HttpCache, RequestDirectives)
+{
+    auto cache = std::make_shared<HttpCache>();
+    const auto url = CacheUrl("directives", "cc=max-age=60&etag=1");
+    auto first = Get(Url(url), cache, kNative);
+
+    // Revalidated though fresh.
+    for (auto cache_control : {"no-cache", "max-age=0"}) {
+        auto response = Get(Url(url), cache, kNative,
+                            Headers{{"Cache-Control", cache_control}});
+        EXPECT_EQ(first.text(), response.text());
+    }
+
+    auto response = Get(Url(url), cache, kNative, Headers{{"Pragma", "no-cache"}});
+    EXPECT_EQ(first.text(), response.text());
+    EXPECT_EQ("4", RequestCount(response));
+    EXPECT_EQ(3U, cache->stats().not_modified);
+
+    // Passed on to the caller, who asked for it.
+    response = Get(Url(url), cache, kNative, Headers{{"If-None-Match", "\"whatever\""}});
+    EXPECT_EQ(200, response.status_code());
+    EXPECT_EQ("5", RequestCount(response));
+
+    // Neither looked up nor stored.
+    response = Get(Url(url), cache, kNative, Headers{{"Cache-Control", "no-store"}});
+    EXPECT_EQ("6", RequestCount(response));
+    EXPECT_EQ(0U, cache->stats().hits);
+
+    Get(Url(url), cache, kNative);
+    EXPECT_EQ(1U, cache->stats().hits);
+}
+
+TEST(HttpCache, NoStore)
+{
+    auto cache = std::make_shared<HttpCache>();
+    const auto url = CacheUrl("no-store", "cc=no-store&etag=1");
+    Get(Url(url), cache, kNative);
+    EXPECT_EQ("2", RequestCount(Get(Url(url), cache, kNative)));
+    EXPECT_EQ(0U, cache->stats().stores);
+    EXPECT_EQ(0U, cache->entry_count());
+
+    const auto vary_all_url = CacheUrl("vary-all", "cc=max-age=60&vary=*");
+    Get(Url(vary_all_url), cache, kNative);
+    EXPECT_EQ("2", RequestCount(Get(Url(vary_all_url), cache, kNative)));
+    EXPECT_EQ(0U, cache->stats().stores);
+}
+
+TEST(HttpCache, Vary)
+{
+    auto cache = std::make_shared<HttpCache>();
+    const auto url = CacheUrl("vary", "cc=max-age=60&vary=X-Variant");
+
+    auto a = Get(Url(url), cache, kNative, Headers{{"X-Variant", "a"}});
+    auto b = Get(Url(url), cache, kNative, Headers{{"X-Variant", "b"}});
+    auto none = Get(Url(url), cache, kNative);
+    EXPECT_NE(a.text(), b.text());
+    EXPECT_EQ(3U, cache->stats().misses);
+    EXPECT_EQ(3U, cache->entry_count());
+
+    EXPECT_EQ(a.text(), Get(Url(url), cache, kNative, Headers{{"x-variant", "a"}}).text());
+    EXPECT_EQ(b.text(), Get(Url(url), cache, kNative, Headers{{"X-Variant", "b"}}).text());
+    EXPECT_EQ(none.text(), Get(Url(url), cache, kNative).text());
+    EXPECT_EQ(3U, cache->stats().hits);
+}
+
+TEST(HttpCache, Eviction)
+{
+    HttpCache::Options options;
+    options.max_memory_size = 7000;
+    auto cache = std::make_shared<HttpCache>(options);
+
+    std::string urls[3];
+    for (int i = 0; i < 3; ++i) {
+        urls[i] = CacheUrl("eviction-" + std::to_string(i), "cc=max-age=60&size=1500");
+        Get(Url(urls[i]), cache, kNative);
+    }
+
+    EXPECT_EQ(3U, cache->entry_count());
+
+    // The least recently used goes first.
+    Get(Url(urls[0]), cache, kNative);
+    Get(Url(CacheUrl("eviction-3", "cc=max-age=60&size=1500")), cache, kNative);
+    EXPECT_EQ(3U, cache->entry_count());
+    EXPECT_EQ(1U, cache->stats().evictions);
+    EXPECT_LE(cache->memory_size(), options.max_memory_size);
+
+    EXPECT_EQ("1", RequestCount(Get(Url(urls[0]), cache, kNative)));
+    EXPECT_EQ("2", RequestCount(Get(Url(urls[1]), cache, kNative)));
+
+    // Too big to keep at all.
+    const auto big_url = CacheUrl("eviction-big", "cc=max-age=60&size=10000");
+    Get(Url(big_url), cache, kNative);
+    EXPECT_EQ("2", RequestCount(Get(Url(big_url), cache, kNative)));
+
+    cache->Clear();
+    EXPECT_EQ(0U, cache->entry_count());
+    EXPECT_EQ(0U, cache->memory_size());
+}
+
+TEST(HttpCache, DiskTier)
+{
+    HttpCache::Options options;
+    options.max_memory_size = 3000;
+    options.disk_path = ".";
+    options.max_disk_size = 10000;
+    auto cache = std::make_shared<HttpCache>(options);
+
+    std::string urls[4];
+    std::string bodies[4];
+    for (int i = 0; i < 4; ++i) {
+        urls[i] = CacheUrl("disk-" + std::to_string(i), "cc=max-age=60&etag=1&size=2000");
+        bodies[i] = Get(Url(urls[i]), cache, kNative).text();
+    }
+
+    EXPECT_EQ(1U, cache->entry_count());
+    EXPECT_EQ(3U, cache->stats().evictions);
+
+    // Read back from disk, with headers as they were.
+    for (int i = 0; i < 4; ++i) {
+        auto response = Get(Url(urls[i]), cache, kNative);
+        EXPECT_EQ(bodies[i], response.text());
+        EXPECT_EQ("1", RequestCount(response));
+    }
+
+    EXPECT_EQ(4U, cache->stats().hits);
+    EXPECT_EQ(4U, cache->stats().disk_hits);
+
+    // Bigger than memory, and thus straight to disk.
+    const auto big_url = CacheUrl("disk-big", "cc=max-age=60&size=5000");
+    auto big = Get(Url(big_url), cache, kNative);
+    EXPECT_EQ(big.text(), Get(Url(big_url), cache, kNative).text());
+    EXPECT_EQ(5U, cache->stats().disk_hits);
+
+    // Stale ones are revalidated as well.
+    const auto stale_url = CacheUrl("disk-stale", "cc=no-cache&etag=1&size=5000");
+    auto stale = Get(Url(stale_url), cache, kNative);
+    auto revalidated = Get(Url(stale_url), cache, kNative);
+    EXPECT_EQ(stale.text(), revalidated.text());
+    EXPECT_EQ("2", RequestCount(revalidated));
+    EXPECT_EQ(6U, cache->stats().disk_hits);
+    EXPECT_EQ(1U, cache->stats().not_modified);
+}
+
+TEST(HttpCache, Async)
+{
+    auto cache = std::make_shared<HttpCache>();
+    const auto url = CacheUrl("async", "cc=max-age=60");
+    auto first = GetAsync(Url(url), cache, kNative).get();
+    ASSERT_EQ(200, first.status_code());
+
+    bool completed = false;
+    auto second = GetAsync(Url(url), cache, kNative,
+                           CompletionHandler([&completed](const HttpResponse* response,
+                                                          std::exception_ptr) {
+                               completed = response != nullptr;
+                           })).get();
+    EXPECT_TRUE(completed);
+    EXPECT_EQ(first.text(), second.text());
+    EXPECT_EQ(1U, cache->stats().hits);
+
+    const auto revalidated_url = CacheUrl("async-revalidate", "cc=no-cache&etag=1");
+    first = GetAsync(Url(revalidated_url), cache, kNative).get();
+    second = GetAsync(Url(revalidated_url), cache, kNative).get();
+    EXPECT_EQ(first.text(), second.text());
+    EXPECT_EQ("2", RequestCount(second));
+    EXPECT_EQ(1U, cache->stats().not_modified);
+}
+
+TEST(HttpCache, DISABLED_RepeatedFetchBenchmark)
+{
+    constexpr int kRounds = 500;
+    for (auto size : {"100", "100000"}) {
+        const auto url = CacheUrl(std::string("benchmark-") + size,
+                                  std::string("cc=max-age=600&etag=1&size=") + size);
+        for (int cached = 0; cached < 2; ++cached) {
+            auto cache = std::make_shared<HttpCache>();
+            auto start = std::chrono::steady_clock::now();
+            for (int i = 0; i < kRounds; ++i) {
+                auto response = cached ? Get(Url(url), cache, kNative) : Get(Url(url), kNative);
+                ASSERT_EQ(200, response.status_code());
+            }
+
+            auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::steady_clock::now() - start);
+            std::cout << size << " bytes, " << (cached ? "cached" : "uncached") << ": "
+                      << elapsed.count() / kRounds << "us per request" << std::endl;
+        }
+    }
+}
+
+}   // namespace wat
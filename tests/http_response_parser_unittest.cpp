@@ -0,0 +1,314 @@
+/*
+ @ 0xCCCCCCCC
+*/
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "winant_http/internal/http_response_parser.h"
+
+namespace {
+
+using wat::internal::HttpResponseParser;
+
+// Feeds `raw` in pieces of `step` bytes and collects the body.
+std::string FeedInSteps(HttpResponseParser& parser, const std::string& raw, size_t step)
+{
+    std::string body;
+    auto on_body = [&body](const char* data, size_t size) {
+        body.append(data, size);
+    };
+
+    for (size_t pos = 0; pos < raw.size() && !parser.message_complete(); pos += step) {
+        parser.Feed(raw.data() + pos, std::min(step, raw.size() - pos), on_body);
+    }
+
+    return body;
+}
+
+// Frames `body` in chunks of random sizes, with random extensions, hex case, line breaks and
+// trailers, as servers in the wild do.
+std::string MakeChunkedResponse(const std::string& body, std::mt19937& rng)
+{
+    auto eol = [&rng] {
+        return rng() % 8 == 0 ? "\n" : "\r\n";
+    };
+
+    std::string raw = "HTTP/1.1 200 OK\r\nTransfer-Encoding: chunked\r\n\r\n";
+    size_t pos = 0;
+    while (pos < body.size()) {
+        auto size = std::min<size_t>(body.size() - pos, 1 + rng() % 3000);
+        char hex[32];
+        std::snprintf(hex, sizeof(hex), rng() % 2 ? "%zx" : "%03zX", size);
+        raw.append(hex);
+        if (rng() % 4 == 0) {
+            raw.append(rng() % 2 ? ";name=\"quoted;value\"" : " ;ext");
+        }
+
+        raw.append(eol()).append(body, pos, size).append(eol());
+        pos += size;
+    }
+
+    raw.append("0").append(eol());
+    for (auto trailers = rng() % 3; trailers > 0; --trailers) {
+        raw.append("X-Trailer: ").append(std::to_string(rng())).append(eol());
+    }
+
+    return raw.append(eol());
+}
+
+// Feeds `raw` in pieces of random sizes; returns the bytes consumed.
+size_t FeedInRandomSteps(HttpResponseParser& parser, const std::string& raw,
+                         std::mt19937& rng, std::string& body)
+{
+    auto on_body = [&body](const char* data, size_t size) {
+        body.append(data, size);
+    };
+
+    size_t pos = 0;
+    while (pos < raw.size() && !parser.message_complete()) {
+        auto step = std::min<size_t>(raw.size() - pos, 1 + rng() % (rng() % 4 == 0 ? 4 : 5000));
+        auto consumed = parser.Feed(raw.data() + pos, step, on_body);
+        pos += consumed;
+        if (consumed < step) {
+            break;
+        }
+    }
+
+    return pos;
+}
+
+}   // namespace
+
+namespace wat {
+
+TEST(HttpResponseParser, ContentLength)
+{
+    const std::string raw = "HTTP/1.1 200 OK\r\n"
+                            "Content-Type: text/plain\r\n"
+                            "Content-Length: 5\r\n"
+                            "\r\n"
+                            "hello";
+    for (size_t step = 1; step <= raw.size(); ++step) {
+        HttpResponseParser parser(false);
+        EXPECT_EQ("hello", FeedInSteps(parser, raw, step));
+        EXPECT_TRUE(parser.message_complete());
+        EXPECT_TRUE(parser.keep_alive());
+        EXPECT_EQ(200, parser.status_code());
+        std::string value;
+        EXPECT_TRUE(parser.headers().GetHeader("Content-Type", value));
+        EXPECT_EQ("text/plain", value);
+    }
+}
+
+TEST(HttpResponseParser, Chunked)
+{
+    const std::string raw = "HTTP/1.1 200 OK\r\n"
+                            "Transfer-Encoding: chunked\r\n"
+                            "\r\n"
+                            "5;ext=1\r\nhello\r\n"
+                            "7\r\n, world\r\n"
+                            "0\r\n"
+                            "Trailer: x\r\n"
+                            "\r\n";
+    for (size_t step = 1; step <= raw.size(); ++step) {
+        HttpResponseParser parser(false);
+        EXPECT_EQ("hello, world", FeedInSteps(parser, raw, step));
+        EXPECT_TRUE(parser.message_complete());
+    }
+}
+
+TEST(HttpResponseParser, UntilClose)
+{
+    const std::string raw = "HTTP/1.0 200 OK\r\n\r\nbody";
+    HttpResponseParser parser(false);
+    EXPECT_EQ("body", FeedInSteps(parser, raw, 3));
+    EXPECT_FALSE(parser.message_complete());
+    EXPECT_TRUE(parser.FinishOnEOF());
+    EXPECT_FALSE(parser.keep_alive());
+}
+
+TEST(HttpResponseParser, NoBody)
+{
+    const std::string head_raw = "HTTP/1.1 200 OK\r\nContent-Length: 100\r\n\r\n";
+    HttpResponseParser head_parser(true);
+    EXPECT_TRUE(FeedInSteps(head_parser, head_raw, 7).empty());
+    EXPECT_TRUE(head_parser.message_complete());
+
+    const std::string interim_raw = "HTTP/1.1 100 Continue\r\n\r\n"
+                                    "HTTP/1.1 204 No Content\r\nConnection: close\r\n\r\n";
+    HttpResponseParser parser(false);
+    EXPECT_TRUE(FeedInSteps(parser, interim_raw, 5).empty());
+    EXPECT_TRUE(parser.message_complete());
+    EXPECT_EQ(204, parser.status_code());
+    EXPECT_FALSE(parser.keep_alive());
+}
+
+TEST(HttpResponseParser, Malformed)
+{
+    auto noop = [](const char*, size_t) {};
+
+    HttpResponseParser bad_status(false);
+    const std::string status = "HTTX/1.1 200 OK\r\n";
+    EXPECT_ANY_THROW(bad_status.Feed(status.data(), status.size(), noop));
+
+    const std::string chunked_head = "HTTP/1.1 200 OK\r\nTransfer-Encoding: chunked\r\n\r\n";
+    for (auto framing : {"zz\r\n", "\r\n", ";ext\r\n", "5\rx", "5x\r\n",
+                         "10000000000000000\r\n", "3\r\nabcX\r\n", "3\r\nabc\rX"}) {
+        const auto raw = chunked_head + framing;
+        for (size_t step : {size_t(1), raw.size()}) {
+            HttpResponseParser parser(false);
+            EXPECT_ANY_THROW(FeedInSteps(parser, raw, step)) << framing;
+        }
+    }
+
+    // Endless extensions or trailers.
+    HttpResponseParser long_extension(false);
+    const auto extension = chunked_head + "1;" + std::string(100 * 1024, 'x');
+    EXPECT_ANY_THROW(FeedInSteps(long_extension, extension, 4096));
+
+    HttpResponseParser long_trailers(false);
+    std::string trailers = chunked_head + "0\r\n";
+    while (trailers.size() < 300 * 1024) {
+        trailers.append("X-Trailer: value\r\n");
+    }
+
+    EXPECT_ANY_THROW(FeedInSteps(long_trailers, trailers, 4096));
+}
+
+TEST(HttpResponseParser, ChunkedFraming)
+{
+    // Bare LFs, whitespace around the size, and line breaks split across feeds.
+    const std::string raw = "HTTP/1.1 200 OK\nTransfer-Encoding: chunked\n\n"
+                            " 0005 \nhello\n"
+                            "1;a=b;c\r\n!\r\n"
+                            "0\n"
+                            "\n"
+                            "HTTP/1.1 200 OK\r\n";
+    const auto message_size = raw.find("HTTP/1.1", 1);
+    for (size_t step = 1; step <= raw.size(); ++step) {
+        HttpResponseParser parser(false);
+        std::string body;
+        size_t pos = 0;
+        while (pos < raw.size() && !parser.message_complete()) {
+            pos += parser.Feed(raw.data() + pos, std::min(step, raw.size() - pos),
+                               [&body](const char* data, size_t size) {
+                                   body.append(data, size);
+                               });
+        }
+
+        EXPECT_EQ("hello!", body) << step;
+        EXPECT_TRUE(parser.message_complete());
+        // The next message is left alone.
+        EXPECT_EQ(message_size, pos) << step;
+    }
+}
+
+// Randomly framed responses, fed in random splits, come out intact; corrupted ones are either
+// rejected or parsed without going out of bounds.
+TEST(HttpResponseParser, Fuzz)
+{
+    std::mt19937 rng(20181024);
+    for (int round = 0; round < 2000; ++round) {
+        std::string body(rng() % 20000, '\0');
+        for (auto& ch : body) {
+            ch = static_cast<char>(rng());
+        }
+
+        const auto raw = MakeChunkedResponse(body, rng);
+        const auto next = std::string("HTTP/1.1 204 No Content\r\n\r\n");
+        HttpResponseParser parser(false);
+        std::string parsed;
+        ASSERT_EQ(raw.size(), FeedInRandomSteps(parser, raw + next, rng, parsed)) << round;
+        ASSERT_TRUE(parser.message_complete()) << round;
+        ASSERT_EQ(body, parsed) << round;
+
+        auto corrupted = raw;
+        for (auto mutations = 1 + rng() % 4; mutations > 0; --mutations) {
+            auto pos = rng() % corrupted.size();
+            switch (rng() % 3) {
+                case 0:
+                    corrupted[pos] = static_cast<char>(rng());
+                    break;
+
+                case 1:
+                    corrupted.erase(pos, 1 + rng() % 8);
+                    break;
+
+                default:
+                    corrupted.insert(pos, 1 + rng() % 8, "\r\n;0aZ \t"[rng() % 9]);
+                    break;
+            }
+
+            if (corrupted.empty()) {
+                corrupted = "H";
+            }
+        }
+
+        HttpResponseParser corrupted_parser(false);
+        parsed.clear();
+        try {
+            auto consumed = FeedInRandomSteps(corrupted_parser, corrupted, rng, parsed);
+            EXPECT_LE(consumed, corrupted.size());
+            EXPECT_LE(parsed.size(), corrupted.size());
+        } catch (const std::exception&) {}
+    }
+}
+
+// Captured on loopback: a JSON body of 16 MB sent in 16 KB chunks, as chunked-encoding servers
+// typically flush, and fed in 64 KB reads.
+TEST(HttpResponseParser, DISABLED_ThroughputBenchmark)
+{
+    constexpr size_t kBodySize = 16 * 1024 * 1024;
+    constexpr size_t kReadSize = 64 * 1024;
+    constexpr int kRounds = 20;
+
+    std::string body;
+    for (int i = 0; body.size() < kBodySize; ++i) {
+        body.append("{\"id\": ").append(std::to_string(i)).append(", \"tags\": [\"winant\"]}\n");
+    }
+
+    body.resize(kBodySize);
+    for (size_t chunk_size : {size_t(1024), size_t(16 * 1024), kBodySize}) {
+        std::string raw = "HTTP/1.1 200 OK\r\nContent-Type: application/json\r\n"
+                          "Transfer-Encoding: chunked\r\n\r\n";
+        for (size_t pos = 0; pos < body.size(); pos += chunk_size) {
+            char hex[32];
+            std::snprintf(hex, sizeof(hex), "%zx\r\n", std::min(chunk_size, body.size() - pos));
+            raw.append(hex).append(body, pos, chunk_size).append("\r\n");
+        }
+
+        raw.append("0\r\n\r\n");
+
+        // Body data is copied out, as a handler usually does.
+        std::vector<char> sink(kReadSize);
+        size_t total = 0;
+        auto start = std::chrono::steady_clock::now();
+        for (int round = 0; round < kRounds; ++round) {
+            HttpResponseParser parser(false);
+            for (size_t pos = 0; pos < raw.size(); pos += kReadSize) {
+                parser.Feed(raw.data() + pos, std::min(kReadSize, raw.size() - pos),
+                            [&sink, &total](const char* data, size_t size) {
+                                std::copy_n(data, size, sink.data());
+                                total += size;
+                            });
+            }
+
+            ASSERT_TRUE(parser.message_complete());
+        }
+
+        auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - start);
+        std::cout << chunk_size << "-byte chunks: "
+                  << total / std::max<int64_t>(elapsed.count(), 1) << " MB/s" << std::endl;
+    }
+}
+
+}   // namespace wat
@@ -0,0 +1,191 @@
+/*
+ @ 0xCCCCCCCC
+*/
+
+#include <chrono>
+#include <iostream>
+#include <string>
+
+#include "gtest/gtest.h"
+
+#include "winant_http/winant_http.h"
+#include "winant_http/internal/pipeline_exchange.h"
+
+namespace {
+
+constexpr char kRequestAddr[] = "http://127.0.0.1:5001";
+
+// Adds latency in front of the keep-alive server; see latency_proxy.py.
+constexpr char kProxyAddr[] = "http://127.0.0.1:5002";
+
+const wat::LoadFlags kNative(wat::LoadFlags::UseNativeTransport);
+
+wat::Batch MakePipeliningBatch(size_t max_in_flight, size_t depth)
+{
+    wat::Batch::Options options;
+    options.max_in_flight = max_in_flight;
+    options.pipelining = true;
+    options.max_pipeline_depth = depth;
+    return wat::Batch(options);
+}
+
+}   // namespace
+
+namespace wat {
+
+TEST(Pipeline, Eligibility)
+{
+    using internal::BuildRequest;
+    using internal::CanPipelineRequest;
+
+    EXPECT_TRUE(CanPipelineRequest(BuildRequest(HttpRequest::Method::Get, Url(kRequestAddr),
+                                                kNative)));
+    EXPECT_TRUE(CanPipelineRequest(BuildRequest(HttpRequest::Method::Head, Url(kRequestAddr),
+                                                kNative)));
+    EXPECT_FALSE(CanPipelineRequest(BuildRequest(HttpRequest::Method::Post, Url(kRequestAddr),
+                                                 RequestBody("data"), kNative)));
+
+#if defined(_WIN32)
+    // WinINet has no pipelining of its own.
+    EXPECT_FALSE(CanPipelineRequest(BuildRequest(HttpRequest::Method::Get, Url(kRequestAddr))));
+#endif
+}
+
+TEST(Pipeline, ResponsesInOrder)
+{
+    auto batch = MakePipeliningBatch(1, 8);
+    for (int i = 0; i < 12; ++i) {
+        if (i % 3 == 2) {
+            batch.AddHead(Url(kRequestAddr), kNative);
+        } else {
+            batch.AddGet(Url(kRequestAddr), kNative);
+        }
+    }
+
+    // Not eligible, and thus sent on its own.
+    batch.AddPost(Url(kRequestAddr), RequestBody("tail"), kNative);
+
+    auto results = batch.Run();
+    ASSERT_EQ(13U, results.size());
+    for (int i = 0; i < 12; ++i) {
+        ASSERT_TRUE(results[i].succeeded());
+        EXPECT_EQ(200, results[i].response.status_code());
+        EXPECT_EQ(i % 3 == 2 ? "" : "Welcome to keep-alive server via GET",
+                  results[i].response.text());
+    }
+
+    ASSERT_TRUE(results[12].succeeded());
+    EXPECT_EQ("tail", results[12].response.text());
+
+    const auto& stats = batch.stats();
+    EXPECT_EQ(13U, stats.succeeded);
+    EXPECT_EQ(12U, stats.requests_pipelined);
+    EXPECT_EQ(0U, stats.requests_resent);
+    EXPECT_EQ(1U, stats.connections_opened);
+}
+
+TEST(Pipeline, ResendAfterConnectionClose)
+{
+    auto batch = MakePipeliningBatch(1, 8);
+    for (int i = 0; i < 8; ++i) {
+        batch.AddGet(Url(std::string(kRequestAddr) + (i == 2 || i == 5 ? "/close" : "/")),
+                     kNative);
+    }
+
+    auto results = batch.Run();
+    ASSERT_EQ(8U, results.size());
+    for (int i = 0; i < 8; ++i) {
+        ASSERT_TRUE(results[i].succeeded());
+        EXPECT_EQ(200, results[i].response.status_code());
+    }
+
+    EXPECT_EQ("Closing via GET", results[2].response.text());
+    EXPECT_EQ("Welcome to keep-alive server via GET", results[3].response.text());
+
+    // 5 requests after the first close, and 2 after the second one.
+    const auto& stats = batch.stats();
+    EXPECT_EQ(8U, stats.succeeded);
+    EXPECT_EQ(7U, stats.requests_resent);
+    EXPECT_EQ(3U, stats.connections_opened);
+}
+
+TEST(Pipeline, ResendAfterResponseCutOff)
+{
+    std::string received;
+    int errors = 0;
+    auto on_read = [&](const char* data, int bytes_read) {
+        if (bytes_read < 0) {
+            ++errors;
+            received.clear();
+        } else {
+            received.append(data, static_cast<size_t>(bytes_read));
+        }
+    };
+
+    auto name = std::to_string(std::chrono::steady_clock::now().time_since_epoch().count());
+    auto batch = MakePipeliningBatch(1, 8);
+    batch.AddGet(Url(std::string(kRequestAddr) + "/cut/" + name), kNative,
+                 ReadResponseHandler(on_read))
+         .AddGet(Url(kRequestAddr), kNative);
+
+    auto results = batch.Run();
+    ASSERT_EQ(2U, results.size());
+    ASSERT_TRUE(results[0].succeeded());
+    EXPECT_EQ(1024U, results[0].response.text().size());
+    ASSERT_TRUE(results[1].succeeded());
+
+    // The half read before the cut was dropped.
+    EXPECT_EQ(1, errors);
+    EXPECT_EQ(1024U, received.size());
+    EXPECT_EQ(2U, batch.stats().requests_resent);
+}
+
+TEST(Pipeline, FailsUnreachableHost)
+{
+    auto batch = MakePipeliningBatch(4, 8);
+    batch.AddGet(Url("http://127.0.0.1:1"), kNative)
+         .AddGet(Url("http://127.0.0.1:1"), kNative);
+
+    auto results = batch.Run();
+    ASSERT_EQ(2U, results.size());
+    EXPECT_FALSE(results[0].succeeded());
+    EXPECT_FALSE(results[1].succeeded());
+    EXPECT_THROW(std::rethrow_exception(results[0].error), ConnectError);
+    EXPECT_EQ(2U, batch.stats().failed);
+}
+
+TEST(Pipeline, DISABLED_LatencyBenchmark)
+{
+    constexpr int kRequestCount = 64;
+
+    auto run = [](bool pipelining) {
+        Batch::Options options;
+        options.max_in_flight = 2;
+        options.pipelining = pipelining;
+        options.max_pipeline_depth = 16;
+        Batch batch(options);
+        for (int i = 0; i < kRequestCount; ++i) {
+            batch.AddGet(Url(kProxyAddr), kNative);
+        }
+
+        auto results = batch.Run();
+        for (const auto& result : results) {
+            EXPECT_TRUE(result.succeeded());
+        }
+
+        return batch.stats();
+    };
+
+    auto sequential = run(false);
+    auto pipelined = run(true);
+    EXPECT_LT(pipelined.elapsed, sequential.elapsed);
+
+    using std::chrono::milliseconds;
+    std::cout << kRequestCount << " requests over 2 connections: "
+              << std::chrono::duration_cast<milliseconds>(sequential.elapsed).count()
+              << "ms one by one, "
+              << std::chrono::duration_cast<milliseconds>(pipelined.elapsed).count()
+              << "ms pipelined" << std::endl;
+}
+
+}   // namespace wat
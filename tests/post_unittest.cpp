@@ -2,6 +2,8 @@
  @ 0xCCCCCCCC
 */
 
+#include <chrono>
+#include <functional>
 #include <iostream>
 
 #include "gtest/gtest.h"
@@ -68,4 +70,38 @@ TEST(Posts, PostAsMultipart)
     EXPECT_EQ(200, response.status_code());
 }
 
+TEST(Posts, DISABLED_RequestSetupBenchmark)
+{
+    constexpr int kRounds = 200000;
+    const Url url("http://127.0.0.1:5000/json-test?category=test");
+    const Headers headers {{"category", "test"}, {"X-Request-Id", "3e1c2d4f"}};
+    const Payload payload {{"type", "urlencoded"}, {"category", "test"}};
+    Multipart multipart;
+    multipart.AddPart(Multipart::Value{"name", "value"});
+
+    auto measure = [&](const char* name, const std::function<HttpRequest()>& build) {
+        size_t total = 0;
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < kRounds; ++i) {
+            total += build().headers().size();
+        }
+
+        auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - start);
+        std::cout << name << ": " << elapsed.count() / kRounds << "ns per request (" << total
+                  << ")" << std::endl;
+    };
+
+    measure("json", [&] {
+        return internal::BuildRequest(HttpRequest::Method::Post, url, headers,
+                                      JSONContent("{}"));
+    });
+    measure("payload", [&] {
+        return internal::BuildRequest(HttpRequest::Method::Post, url, headers, payload);
+    });
+    measure("multipart", [&] {
+        return internal::BuildRequest(HttpRequest::Method::Post, url, headers, multipart);
+    });
+}
+
 }   // namespace wat
@@ -0,0 +1,117 @@
+/*
+ @ 0xCCCCCCCC
+*/
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <string>
+
+#include "gtest/gtest.h"
+
+#include "winant_http/winant_http.h"
+#include "winant_http/internal/read_buffer.h"
+
+namespace {
+
+constexpr char kRequestAddr[] = "http://127.0.0.1:5001";
+
+const wat::LoadFlags kNative(wat::LoadFlags::UseNativeTransport);
+
+struct ReadStats {
+    size_t calls {0};
+    size_t largest {0};
+    size_t total {0};
+};
+
+wat::ReadResponseHandler CountReads(ReadStats& stats)
+{
+    return [&stats](const char* /*data*/, int bytes_read) {
+        if (bytes_read > 0) {
+            ++stats.calls;
+            stats.largest = std::max(stats.largest, static_cast<size_t>(bytes_read));
+            stats.total += static_cast<size_t>(bytes_read);
+        }
+    };
+}
+
+}   // namespace
+
+namespace wat {
+
+TEST(ReadBuffer, Growth)
+{
+    internal::ReadBuffer fixed(ReadBufferSize(1024));
+    fixed.OnRead(1024);
+    EXPECT_EQ(1024U, fixed.size());
+
+    internal::ReadBuffer adaptive(ReadBufferSize::Adaptive(1024, 3000));
+    EXPECT_TRUE(ReadBufferSize::Adaptive().adaptive());
+
+    // Partial reads keep the size.
+    adaptive.OnRead(100);
+    EXPECT_EQ(1024U, adaptive.size());
+
+    adaptive.OnRead(1024);
+    EXPECT_EQ(2048U, adaptive.size());
+    adaptive.OnRead(2048);
+    EXPECT_EQ(3000U, adaptive.size());
+    adaptive.OnRead(3000);
+    EXPECT_EQ(3000U, adaptive.size());
+}
+
+TEST(ReadBuffer, FixedSize)
+{
+    ReadStats stats;
+    auto response = Get(Url(std::string(kRequestAddr) + "/bytes/200000"), kNative,
+                        ReadBufferSize(4096), CountReads(stats));
+    EXPECT_EQ(200000U, response.text().size());
+    EXPECT_EQ(200000U, stats.total);
+    EXPECT_LE(stats.largest, 4096U);
+    EXPECT_GE(stats.calls, 200000U / 4096);
+}
+
+TEST(ReadBuffer, Adaptive)
+{
+    ReadStats stats;
+    auto response = Get(Url(std::string(kRequestAddr) + "/bytes/8000000"), kNative,
+                        ReadBufferSize::Adaptive(4096, 256 * 1024), CountReads(stats));
+    EXPECT_EQ(8000000U, response.text().size());
+    EXPECT_EQ(8000000U, stats.total);
+    EXPECT_LE(stats.largest, 256U * 1024);
+    EXPECT_GT(stats.largest, 4096U);
+}
+
+TEST(ReadBuffer, DISABLED_ThroughputBenchmark)
+{
+    const size_t body_sizes[] {10 * 1000, 1000 * 1000, 16 * 1000 * 1000, 64 * 1000 * 1000};
+    const ReadBufferSize buf_sizes[] {
+        ReadBufferSize(4 * 1024),
+        ReadBufferSize(),
+        ReadBufferSize(256 * 1024),
+        ReadBufferSize::Adaptive()
+    };
+
+    for (auto body_size : body_sizes) {
+        for (const auto& buf_size : buf_sizes) {
+            ReadStats stats;
+            auto start = std::chrono::steady_clock::now();
+            auto response = Get(Url(std::string(kRequestAddr) + "/bytes/" +
+                                    std::to_string(body_size)),
+                                LoadFlags(LoadFlags::UseNativeTransport |
+                                          LoadFlags::DoNotSaveResponseBody),
+                                buf_size, CountReads(stats));
+            auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::steady_clock::now() - start);
+            EXPECT_EQ(body_size, stats.total);
+
+            std::cout << body_size << " bytes, buffer " << buf_size.size << "-"
+                      << buf_size.max_size << ": " << elapsed.count() << "us, "
+                      << stats.calls << " reads, "
+                      << body_size / std::max<int64_t>(elapsed.count(), 1) << " MB/s"
+                      << std::endl;
+        }
+    }
+}
+
+}   // namespace wat
@@ -0,0 +1,198 @@
+/*
+ @ 0xCCCCCCCC
+*/
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <string>
+
+#include "gtest/gtest.h"
+
+#include "winant_http/winant_http.h"
+#include "winant_http/internal/request_body_reader.h"
+
+namespace {
+
+constexpr char kRequestAddr[] = "http://127.0.0.1:5001";
+
+const wat::LoadFlags kNative(wat::LoadFlags::UseNativeTransport);
+
+class ScopedTempFile {
+public:
+    explicit ScopedTempFile(const std::string& content)
+        : path_("winant_request_body_test.txt")
+    {
+        std::ofstream file(path_, std::ios::binary);
+        file << content;
+    }
+
+    ~ScopedTempFile()
+    {
+        std::remove(path_.c_str());
+    }
+
+    const std::string& path() const
+    {
+        return path_;
+    }
+
+private:
+    std::string path_;
+};
+
+wat::RequestBody::Source MakeSource(std::string data)
+{
+    auto pos = std::make_shared<size_t>(0);
+    return [data, pos](char* buf, size_t size) {
+        auto count = std::min(size, data.size() - *pos);
+        std::copy_n(data.data() + *pos, count, buf);
+        *pos += count;
+        return count;
+    };
+}
+
+std::string ReadAll(const wat::RequestBody& body, size_t buf_size)
+{
+    std::string buf(buf_size, '\0');
+    std::string result;
+    wat::internal::RequestBodyReader reader(body);
+    while (true) {
+        auto chunk = reader.Next(&buf[0], buf.size());
+        if (chunk.empty()) {
+            break;
+        }
+
+        result.append(chunk.data(), chunk.size());
+    }
+
+    return result;
+}
+
+}   // namespace
+
+namespace wat {
+
+TEST(RequestBody, LengthAndReplayable)
+{
+    ScopedTempFile file("0123456789");
+
+    RequestBody body("hello");
+    EXPECT_EQ(5, body.length());
+    EXPECT_TRUE(body.replayable());
+
+    kbase::StringView data;
+    EXPECT_TRUE(body.AsContiguous(data));
+    EXPECT_EQ("hello", data.ToString());
+
+    body.AppendFile(file.path(), 2, 5);
+    EXPECT_EQ(10, body.length());
+    EXPECT_TRUE(body.replayable());
+    EXPECT_FALSE(body.AsContiguous(data));
+
+    body.AppendFile(file.path(), 8);
+    EXPECT_EQ(12, body.length());
+
+    body.AppendSource(MakeSource("abc"), 3);
+    EXPECT_EQ(15, body.length());
+    EXPECT_FALSE(body.replayable());
+
+    body.AppendSource(MakeSource("xyz"));
+    EXPECT_EQ(RequestBody::kUnknownLength, body.length());
+
+    body.clear();
+    EXPECT_TRUE(body.empty());
+    EXPECT_EQ(0, body.length());
+}
+
+TEST(RequestBody, Reader)
+{
+    ScopedTempFile file("0123456789");
+
+    auto make_body = [&file] {
+        RequestBody body;
+        body.Append("head-").AppendFile(file.path(), 3, 4).AppendSource(MakeSource("-tail"));
+        return body;
+    };
+
+    EXPECT_EQ("head-3456-tail", ReadAll(make_body(), 3));
+    EXPECT_EQ("head-3456-tail", ReadAll(make_body(), 4096));
+
+    RequestBody short_body;
+    short_body.AppendSource(MakeSource("abc"), 5);
+    EXPECT_ANY_THROW(ReadAll(short_body, 16));
+}
+
+TEST(RequestBody, MappedFile)
+{
+    std::string content(300 * 1024, '\0');
+    for (size_t i = 0; i < content.size(); ++i) {
+        content[i] = static_cast<char>('a' + i % 26);
+    }
+
+    ScopedTempFile file(content);
+
+    // File data is handed out in place, in one piece, rather than through the buffer.
+    RequestBody body;
+    body.AppendFile(file.path(), 5000, 200 * 1024);
+    char buf[16];
+    internal::RequestBodyReader reader(body);
+    auto chunk = reader.Next(buf, sizeof(buf));
+    EXPECT_NE(buf, chunk.data());
+    EXPECT_EQ(content.substr(5000, 200 * 1024), chunk.ToString());
+    EXPECT_TRUE(reader.Next(buf, sizeof(buf)).empty());
+
+    internal::MappedFile mapped_file;
+    EXPECT_TRUE(mapped_file.Map(file.path(), 1, 10));
+    EXPECT_EQ("bcdefghijk", std::string(mapped_file.data(), mapped_file.size()));
+    EXPECT_FALSE(mapped_file.Map(file.path(), content.size() - 5, 10));
+    EXPECT_FALSE(mapped_file.mapped());
+}
+
+TEST(RequestBody, NativePost)
+{
+    std::string content(100 * 1024, 'x');
+    for (size_t i = 0; i < content.size(); i += 7) {
+        content[i] = static_cast<char>('a' + i % 26);
+    }
+
+    ScopedTempFile file(content);
+
+    // Known length.
+    {
+        RequestBody body;
+        body.Append("<").AppendFile(file.path()).Append(">");
+        auto response = Post(Url(kRequestAddr), body, kNative);
+        EXPECT_EQ(200, response.status_code());
+        EXPECT_EQ("<" + content + ">", response.text());
+    }
+
+    // Unknown length goes chunked.
+    {
+        RequestBody body;
+        body.AppendSource(MakeSource(content));
+        auto response = Post(Url(kRequestAddr), body, kNative);
+        EXPECT_EQ(200, response.status_code());
+        EXPECT_EQ(content, response.text());
+    }
+}
+
+TEST(RequestBody, UnreadableOnReusedConnection)
+{
+    auto pool = std::make_shared<ConnectionPool>();
+    EXPECT_EQ(200, Get(Url(kRequestAddr), kNative, pool).status_code());
+
+    RequestBody body;
+    {
+        ScopedTempFile file("0123456789");
+        body.Append("<").AppendFile(file.path()).Append(">");
+    }
+
+    // The file is gone by the time the request goes out on the kept-alive connection, which
+    // isn't the connection's fault, and thus the request isn't sent again on a new one.
+    EXPECT_ANY_THROW(Post(Url(kRequestAddr), body, kNative, pool));
+    EXPECT_EQ(1U, pool->stats().misses);
+}
+
+}   // namespace wat
@@ -0,0 +1,199 @@
+/*
+ @ 0xCCCCCCCC
+*/
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <string>
+
+#include "gtest/gtest.h"
+
+#include "winant_http/winant_http.h"
+
+namespace {
+
+constexpr char kRequestAddr[] = "http://127.0.0.1:5001";
+
+const wat::LoadFlags kNative(wat::LoadFlags::UseNativeTransport);
+
+#if defined(WINANT_HTTP_USE_ZLIB)
+constexpr bool kCompressionAvailable = true;
+#else
+constexpr bool kCompressionAvailable = false;
+#endif
+
+// Telemetry-like records, which compress well.
+std::string MakeTelemetry(size_t records)
+{
+    std::string json = "[";
+    for (size_t i = 0; i < records; ++i) {
+        auto id = std::to_string(i);
+        json.append(i == 0 ? "" : ",")
+            .append("{\"event\": \"page_view\", \"session\": \"s-")
+            .append(std::to_string(i % 7))
+            .append("\", \"seq\": ")
+            .append(id)
+            .append(", \"duration_ms\": ")
+            .append(std::to_string(i * 37 % 1000))
+            .append("}");
+    }
+
+    return json.append("]");
+}
+
+std::string ReceivedEncoding(const wat::HttpResponse& response)
+{
+    std::string encoding;
+    response.headers().GetHeader("X-Received-Encoding", encoding);
+    return encoding;
+}
+
+size_t ReceivedLength(const wat::HttpResponse& response)
+{
+    std::string length;
+    response.headers().GetHeader("X-Received-Length", length);
+    return length.empty() ? 0 : std::stoul(length);
+}
+
+}   // namespace
+
+namespace wat {
+
+TEST(RequestCompression, InOneGo)
+{
+    auto json = MakeTelemetry(5000);
+    auto response = Post(Url(kRequestAddr), JSONContent(json), RequestCompression(), kNative);
+    ASSERT_EQ(200, response.status_code());
+    EXPECT_EQ(json, response.text());
+
+    if (kCompressionAvailable) {
+        EXPECT_EQ("gzip", ReceivedEncoding(response));
+        EXPECT_LT(ReceivedLength(response), json.size() / 5);
+    } else {
+        EXPECT_EQ(json.size(), ReceivedLength(response));
+    }
+
+    // The form is compressed as well.
+    Payload payload {{"records", json}, {"source", "test"}};
+    response = Post(Url(kRequestAddr), payload, RequestCompression(), kNative);
+    EXPECT_EQ(payload.ToString().second, response.text());
+    EXPECT_EQ(kCompressionAvailable ? "gzip" : "", ReceivedEncoding(response));
+}
+
+TEST(RequestCompression, Threshold)
+{
+    auto json = MakeTelemetry(10);
+    ASSERT_LT(json.size(), RequestCompression::kDefaultMinSize);
+
+    auto response = Post(Url(kRequestAddr), JSONContent(json), RequestCompression(), kNative);
+    EXPECT_EQ(json, response.text());
+    EXPECT_EQ("", ReceivedEncoding(response));
+    EXPECT_EQ(json.size(), ReceivedLength(response));
+
+    response = Post(Url(kRequestAddr), JSONContent(json), RequestCompression(0), kNative);
+    EXPECT_EQ(json, response.text());
+    EXPECT_EQ(kCompressionAvailable ? "gzip" : "", ReceivedEncoding(response));
+
+    // Data that doesn't shrink is sent as it is.
+    std::string incompressible;
+    for (int i = 0; i < 64; ++i) {
+        incompressible.push_back(static_cast<char>('!' + (i * 7919) % 90));
+    }
+
+    response = Post(Url(kRequestAddr), RequestBody(incompressible), RequestCompression(0),
+                    kNative);
+    EXPECT_EQ(incompressible, response.text());
+    EXPECT_EQ("", ReceivedEncoding(response));
+}
+
+TEST(RequestCompression, Streaming)
+{
+    const char kLocalFile[] = "request_compression_streaming.json";
+    auto file_data = MakeTelemetry(20000);
+    {
+        std::ofstream file(kLocalFile, std::ios::binary);
+        file << file_data;
+    }
+
+    auto source_data = std::make_shared<std::string>(MakeTelemetry(3000));
+    auto offset = std::make_shared<size_t>(0);
+    RequestBody body;
+    body.Append("{\"file\": ")
+        .AppendFile(kLocalFile)
+        .Append(", \"source\": ")
+        .AppendSource([source_data, offset](char* buf, size_t size) {
+            auto count = std::min(size, source_data->size() - *offset);
+            std::copy_n(source_data->data() + *offset, count, buf);
+            *offset += count;
+            return count;
+        })
+        .Append("}");
+
+    auto expected = "{\"file\": " + file_data + ", \"source\": " + *source_data + "}";
+    auto response = Post(Url(kRequestAddr), std::move(body), RequestCompression(), kNative);
+    EXPECT_EQ(expected, response.text());
+    if (kCompressionAvailable) {
+        EXPECT_EQ("gzip", ReceivedEncoding(response));
+        EXPECT_LT(ReceivedLength(response), expected.size() / 5);
+    }
+
+    std::remove(kLocalFile);
+}
+
+TEST(RequestCompression, PooledBuffer)
+{
+    auto pool = std::make_shared<BufferPool>();
+    auto json = MakeTelemetry(1000);
+    {
+        auto request = internal::BuildRequest(HttpRequest::Method::Post, Url(kRequestAddr),
+                                              JSONContent(json), RequestCompression(), pool,
+                                              kNative);
+        if (!kCompressionAvailable) {
+            EXPECT_FALSE(request.headers().HasHeader(Headers::Known::ContentEncoding));
+            return;
+        }
+
+        std::string encoding;
+        ASSERT_TRUE(request.headers().GetHeader(Headers::Known::ContentEncoding, encoding));
+        EXPECT_EQ("gzip", encoding);
+        ASSERT_EQ(1U, request.body().segments().size());
+        EXPECT_LT(request.body().length(), static_cast<int64_t>(json.size()));
+        EXPECT_TRUE(request.body().replayable());
+        EXPECT_EQ(1U, pool->stats().acquired);
+        EXPECT_EQ(0U, pool->idle_count());
+
+        EXPECT_EQ(json, request.Start().text());
+    }
+
+    // Back to the pool along with the response body.
+    EXPECT_EQ(2U, pool->idle_count());
+}
+
+TEST(RequestCompression, DISABLED_UploadBenchmark)
+{
+    constexpr int kRounds = 20;
+    auto json = MakeTelemetry(100000);
+    for (int level : {0, 1, 6}) {
+        size_t sent = 0;
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < kRounds; ++i) {
+            auto response = level == 0 ?
+                Post(Url(kRequestAddr), JSONContent(json), kNative) :
+                Post(Url(kRequestAddr), JSONContent(json), RequestCompression(1024, level),
+                     kNative);
+            sent += ReceivedLength(response);
+        }
+
+        auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - start);
+        std::cout << "level " << level << ": " << json.size() << " bytes as "
+                  << sent / kRounds << " bytes, " << elapsed.count() / kRounds
+                  << "us per request" << std::endl;
+    }
+}
+
+}   // namespace wat
@@ -0,0 +1,263 @@
+/*
+ @ 0xCCCCCCCC
+*/
+
+#include <chrono>
+#include <future>
+#include <memory>
+#include <string>
+#include <thread>
+
+#include "gtest/gtest.h"
+
+#include "winant_http/winant_http.h"
+
+namespace {
+
+constexpr char kRequestAddr[] = "http://127.0.0.1:5001";
+
+const wat::LoadFlags kNative(wat::LoadFlags::UseNativeTransport);
+
+using std::chrono::milliseconds;
+using Clock = std::chrono::steady_clock;
+
+// The server counts requests by name for as long as it runs.
+std::string FlakyUrl(const std::string& name, const std::string& query)
+{
+    static const auto run = std::to_string(Clock::now().time_since_epoch().count());
+    return std::string(kRequestAddr) + "/flaky/" + name + "-" + run + "?" + query;
+}
+
+std::string FlakyName(const std::string& name)
+{
+    auto url = FlakyUrl(name, "");
+    auto begin = url.find("/flaky/") + 7;
+    return url.substr(begin, url.size() - begin - 1);
+}
+
+wat::RetryPolicy QuickPolicy()
+{
+    wat::RetryPolicy policy;
+    policy.initial_backoff = milliseconds(10);
+    policy.budget = std::make_shared<wat::RetryBudget>();
+    return policy;
+}
+
+}   // namespace
+
+namespace wat {
+
+TEST(RetryPolicy, Budget)
+{
+    RetryBudget::Options options;
+    options.retry_ratio = 0.5;
+    options.min_retries_per_second = 0;
+    options.max_tokens = 2;
+    RetryBudget budget(options);
+
+    EXPECT_TRUE(budget.TryWithdraw());
+    EXPECT_TRUE(budget.TryWithdraw());
+    EXPECT_FALSE(budget.TryWithdraw());
+
+    // Every two requests earn a retry.
+    budget.Deposit();
+    EXPECT_FALSE(budget.TryWithdraw());
+    budget.Deposit();
+    EXPECT_TRUE(budget.TryWithdraw());
+
+    auto stats = budget.stats();
+    EXPECT_EQ(3U, stats.retries);
+    EXPECT_EQ(2U, stats.rejected);
+
+    // Tokens trickle in over time, up to the maximum.
+    options.min_retries_per_second = 1000;
+    RetryBudget trickling(options);
+    EXPECT_TRUE(trickling.TryWithdraw());
+    EXPECT_TRUE(trickling.TryWithdraw());
+    std::this_thread::sleep_for(milliseconds(20));
+    EXPECT_TRUE(trickling.TryWithdraw());
+    EXPECT_LE(trickling.tokens(), options.max_tokens);
+}
+
+TEST(RetryPolicy, StatusCodes)
+{
+    auto policy = QuickPolicy();
+
+    auto response = Get(Url(FlakyUrl("status", "fail=2")), kNative, policy);
+    EXPECT_EQ(200, response.status_code());
+    EXPECT_EQ(FlakyName("status") + ":3", response.text());
+
+    response = GetAsync(Url(FlakyUrl("status-async", "fail=2&status=502")), kNative,
+                        policy).get();
+    EXPECT_EQ(200, response.status_code());
+    EXPECT_EQ(FlakyName("status-async") + ":3", response.text());
+
+    // Other failures are returned as they are.
+    response = Get(Url(FlakyUrl("status-500", "fail=1&status=500")), kNative, policy);
+    EXPECT_EQ(500, response.status_code());
+
+    EXPECT_EQ(4U, policy.budget->stats().retries);
+}
+
+TEST(RetryPolicy, MaxAttempts)
+{
+    auto policy = QuickPolicy();
+    policy.max_attempts = 3;
+
+    auto response = Get(Url(FlakyUrl("attempts", "fail=6")), kNative, policy);
+    EXPECT_EQ(503, response.status_code());
+
+    response = GetAsync(Url(FlakyUrl("attempts", "fail=6")), kNative, policy).get();
+    EXPECT_EQ(503, response.status_code());
+
+    // Three attempts each.
+    response = Get(Url(FlakyUrl("attempts", "")), kNative);
+    EXPECT_EQ(FlakyName("attempts") + ":7", response.text());
+}
+
+TEST(RetryPolicy, RetryAfter)
+{
+    auto policy = QuickPolicy();
+
+    auto start = Clock::now();
+    auto response = Get(Url(FlakyUrl("retry-after", "fail=1&retry_after=1")), kNative, policy);
+    EXPECT_EQ(200, response.status_code());
+    EXPECT_GE(Clock::now() - start, milliseconds(1000));
+
+    start = Clock::now();
+    response = GetAsync(Url(FlakyUrl("retry-after-async", "fail=1&retry_after=1")), kNative,
+                        policy).get();
+    EXPECT_EQ(200, response.status_code());
+    EXPECT_GE(Clock::now() - start, milliseconds(1000));
+
+    // Asked to wait for too long.
+    policy.max_retry_after = milliseconds(5000);
+    start = Clock::now();
+    response = Get(Url(FlakyUrl("retry-after-long", "fail=1&retry_after=60")), kNative, policy);
+    EXPECT_EQ(503, response.status_code());
+    EXPECT_LT(Clock::now() - start, milliseconds(1000));
+}
+
+TEST(RetryPolicy, NonIdempotent)
+{
+    auto policy = QuickPolicy();
+    auto make_body = [] {
+        return RequestBody(std::string(1000, 'x'));
+    };
+
+    auto response = Post(Url(FlakyUrl("post", "fail=1")), kNative, policy, make_body());
+    EXPECT_EQ(503, response.status_code());
+
+    // The body is sent again as it is.
+    policy.retry_non_idempotent = true;
+    response = Post(Url(FlakyUrl("post-retried", "fail=1")), kNative, policy, make_body());
+    EXPECT_EQ(200, response.status_code());
+    EXPECT_EQ(FlakyName("post-retried") + ":2:1000", response.text());
+
+    response = PostAsync(Url(FlakyUrl("post-retried-async", "fail=2")), kNative, policy,
+                         make_body()).get();
+    EXPECT_EQ(200, response.status_code());
+    EXPECT_EQ(FlakyName("post-retried-async") + ":3:1000", response.text());
+}
+
+TEST(RetryPolicy, ConnectFailures)
+{
+    // Nothing listens on the port; the attempts are retried even for a POST.
+    auto policy = QuickPolicy();
+    Url url("http://127.0.0.1:1/");
+
+    EXPECT_THROW(Get(url, kNative, policy), ConnectError);
+    EXPECT_EQ(2U, policy.budget->stats().retries);
+
+    EXPECT_THROW(PostAsync(url, kNative, policy, RequestBody(std::string("data"))).get(),
+                 ConnectError);
+    EXPECT_EQ(4U, policy.budget->stats().retries);
+
+    policy.retry_connect_failures = false;
+    EXPECT_THROW(GetAsync(url, kNative, policy).get(), ConnectError);
+    EXPECT_EQ(4U, policy.budget->stats().retries);
+}
+
+TEST(RetryPolicy, ServerGoneBetweenRequests)
+{
+    // The server goes down as the second request comes in on the kept-alive connection, which
+    // is then sent again on a new connection; failing to connect, that is retried as well.
+    auto run = [](bool async) {
+        auto port = Get(Url(std::string(kRequestAddr) + "/spawn"), kNative).text();
+        Url url("http://127.0.0.1:" + port + "/");
+        auto pool = std::make_shared<ConnectionPool>();
+        auto policy = QuickPolicy();
+        EXPECT_EQ(200, Get(url, kNative, pool).status_code());
+        if (async) {
+            EXPECT_THROW(GetAsync(url, kNative, policy, pool).get(), ConnectError);
+        } else {
+            EXPECT_THROW(Get(url, kNative, policy, pool), ConnectError);
+        }
+
+        EXPECT_EQ(2U, policy.budget->stats().retries);
+    };
+
+    run(false);
+    run(true);
+}
+
+TEST(RetryPolicy, Timeouts)
+{
+    auto policy = QuickPolicy();
+    Timeouts timeouts;
+    timeouts.first_byte = milliseconds(100);
+    Url url(std::string(kRequestAddr) + "/delay/300");
+
+    EXPECT_THROW(Get(url, kNative, timeouts, policy), TimeoutError);
+    EXPECT_EQ(2U, policy.budget->stats().retries);
+
+    EXPECT_THROW(GetAsync(url, kNative, timeouts, policy).get(), TimeoutError);
+    EXPECT_EQ(4U, policy.budget->stats().retries);
+
+    policy.retry_timeouts = false;
+    EXPECT_THROW(Get(url, kNative, timeouts, policy), TimeoutError);
+    EXPECT_EQ(4U, policy.budget->stats().retries);
+}
+
+TEST(RetryPolicy, BudgetExhausted)
+{
+    RetryBudget::Options options;
+    options.retry_ratio = 0;
+    options.min_retries_per_second = 0;
+    options.max_tokens = 1;
+    auto policy = QuickPolicy();
+    policy.max_attempts = 5;
+    policy.budget = std::make_shared<RetryBudget>(options);
+
+    // One retry is all the budget allows for.
+    auto response = Get(Url(FlakyUrl("budget", "fail=5")), kNative, policy);
+    EXPECT_EQ(503, response.status_code());
+    response = GetAsync(Url(FlakyUrl("budget", "fail=5")), kNative, policy).get();
+    EXPECT_EQ(503, response.status_code());
+
+    auto stats = policy.budget->stats();
+    EXPECT_EQ(1U, stats.retries);
+    EXPECT_EQ(2U, stats.rejected);
+
+    response = Get(Url(FlakyUrl("budget", "")), kNative);
+    EXPECT_EQ(FlakyName("budget") + ":4", response.text());
+}
+
+TEST(RetryPolicy, WaitForConnection)
+{
+    ConnectionPool::Options options;
+    options.max_connections_per_host = 1;
+    auto pool = std::make_shared<ConnectionPool>(options);
+    auto policy = QuickPolicy();
+
+    // The retry, started from the I/O loop, waits in line for the connection the other request
+    // holds, which the loop has to finish meanwhile.
+    auto retried = GetAsync(Url(FlakyUrl("pool", "fail=1")), kNative, policy, pool);
+    auto other = GetAsync(Url(std::string(kRequestAddr) + "/delay/300"), kNative, pool);
+    ASSERT_EQ(std::future_status::ready, retried.wait_for(std::chrono::seconds(5)));
+    ASSERT_EQ(std::future_status::ready, other.wait_for(std::chrono::seconds(5)));
+    EXPECT_EQ(FlakyName("pool") + ":2", retried.get().text());
+    EXPECT_EQ(200, other.get().status_code());
+}
+
+}   // namespace wat
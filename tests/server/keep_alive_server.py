@@ -0,0 +1,348 @@
+#! python3
+# -*- coding: utf-8 -*-
+# 0xCCCCCCCC
+
+# A bare HTTP/1.1 server that keeps connections alive, which the flask dev server never does.
+# Tests of the native transport rely on it for connection reuse and framing details.
+
+import email.utils
+import functools
+import gzip
+import threading
+import time
+import urllib.parse
+import zlib
+from http.server import BaseHTTPRequestHandler, ThreadingHTTPServer
+
+PORT = 5001
+
+START_TIME = time.time()
+
+# Keyed by names of /cache/ resources.
+cache_lock = threading.Lock()
+cache_requests = {}
+cache_versions = {}
+
+# Keyed by names of /flaky/ resources.
+flaky_lock = threading.Lock()
+flaky_requests = {}
+
+# Keyed by names of /slow/ resources.
+slow_lock = threading.Lock()
+slow_requests = {}
+
+# Keyed by names of /cut/ resources.
+cut_lock = threading.Lock()
+cut_requests = {}
+
+
+class Handler(BaseHTTPRequestHandler):
+    protocol_version = 'HTTP/1.1'
+
+    def send_body(self, body, status=200, content_type='text/plain', extra_headers=None):
+        data = body.encode('utf-8')
+        self.send_response(status)
+        self.send_header('Content-Type', content_type)
+        self.send_header('Content-Length', str(len(data)))
+        for name, value in (extra_headers or {}).items():
+            self.send_header(name, value)
+        self.end_headers()
+        if self.command != 'HEAD':
+            self.wfile.write(data)
+
+    def send_bytes(self, spec):
+        parts = spec.split('/')
+        data = b'x' * int(parts[0])
+        chunked = len(parts) > 1 and parts[1] == 'chunked'
+        self.send_response(200)
+        self.send_header('Content-Type', 'application/octet-stream')
+        if chunked:
+            self.send_header('Transfer-Encoding', 'chunked')
+        else:
+            self.send_header('Content-Length', str(len(data)))
+        self.end_headers()
+        if self.command == 'HEAD':
+            return
+        if not chunked:
+            self.wfile.write(data)
+            return
+        for i in range(0, len(data), 64 * 1024):
+            piece = data[i:i + 64 * 1024]
+            self.wfile.write('{0:x}\r\n'.format(len(piece)).encode('ascii') + piece + b'\r\n')
+        self.wfile.write(b'0\r\n\r\n')
+
+    def send_encoded(self, spec):
+        parts = spec.split('/')
+        coding, size = parts[0], int(parts[1])
+        chunked = len(parts) > 2 and parts[2] == 'chunked'
+        # The body is encoded only if the client asked for the coding.
+        name = 'deflate' if coding == 'deflate-raw' else coding
+        accepted = [c.split(';')[0].strip() for c in self.headers.get('Accept-Encoding', '').split(',')]
+        if name in accepted:
+            data = encoded_json_lines(coding, size)
+        else:
+            name = None
+            data = json_lines(size)
+        self.send_response(200)
+        self.send_header('Content-Type', 'application/json')
+        if name:
+            self.send_header('Content-Encoding', name)
+        if chunked:
+            self.send_header('Transfer-Encoding', 'chunked')
+        else:
+            self.send_header('Content-Length', str(len(data)))
+        self.end_headers()
+        if not chunked:
+            self.wfile.write(data)
+            return
+        # Small chunks split the encoded data at arbitrary points.
+        for i in range(0, len(data), 1000):
+            piece = data[i:i + 1000]
+            self.wfile.write('{0:x}\r\n'.format(len(piece)).encode('ascii') + piece + b'\r\n')
+        self.wfile.write(b'0\r\n\r\n')
+
+    def send_cacheable(self, spec):
+        name, _, query = spec.partition('?')
+        params = {k: v[0] for k, v in urllib.parse.parse_qs(query).items()}
+        with cache_lock:
+            cache_requests[name] = cache_requests.get(name, 0) + 1
+            count = cache_requests[name]
+            version = cache_versions.get(name, 1)
+        headers = {'X-Requests': str(count)}
+        if 'cc' in params:
+            headers['Cache-Control'] = params['cc']
+        if 'expires' in params:
+            headers['Expires'] = email.utils.formatdate(time.time() + int(params['expires']),
+                                                        usegmt=True)
+        if 'etag' in params:
+            headers['ETag'] = '"{0}-v{1}"'.format(name, version)
+        if 'lm' in params:
+            # A day ago, which also makes for a heuristic freshness lifetime of 2.4 hours.
+            headers['Last-Modified'] = email.utils.formatdate(START_TIME - 86400 + version,
+                                                              usegmt=True)
+        if 'vary' in params:
+            headers['Vary'] = params['vary']
+        if ('ETag' in headers and self.headers.get('If-None-Match') == headers['ETag']) or \
+                ('ETag' not in headers and 'Last-Modified' in headers and
+                 self.headers.get('If-Modified-Since') == headers['Last-Modified']):
+            self.send_response(304)
+            for header, value in headers.items():
+                self.send_header(header, value)
+            self.end_headers()
+            return
+        body = '{0}:v{1}:{2}'.format(name, version, count)
+        if 'vary' in params:
+            body += ':' + self.headers.get(params['vary'], '')
+        body += '.' * int(params.get('size', 0))
+        self.send_body(body, extra_headers=headers)
+
+    def send_flaky(self, spec, body=None):
+        name, _, query = spec.partition('?')
+        params = {k: v[0] for k, v in urllib.parse.parse_qs(query).items()}
+        with flaky_lock:
+            flaky_requests[name] = flaky_requests.get(name, 0) + 1
+            count = flaky_requests[name]
+        if count <= int(params.get('fail', 0)):
+            headers = {}
+            if 'retry_after' in params:
+                headers['Retry-After'] = params['retry_after']
+            self.send_body('Failed', status=int(params.get('status', 503)),
+                           extra_headers=headers)
+            return
+        text = '{0}:{1}'.format(name, count)
+        if body is not None:
+            text += ':{0}'.format(len(body))
+        self.send_body(text)
+
+    def read_body(self):
+        if 'chunked' in self.headers.get('Transfer-Encoding', '').lower():
+            return self.read_chunked_body()
+        length = int(self.headers.get('Content-Length', 0))
+        return self.rfile.read(length) if length > 0 else b''
+
+    def read_chunked_body(self):
+        body = b''
+        while True:
+            size = int(self.rfile.readline().split(b';')[0].strip(), 16)
+            if size == 0:
+                break
+            body += self.rfile.read(size)
+            self.rfile.readline()
+        # Skip trailers up to the terminating empty line.
+        while self.rfile.readline() not in (b'\r\n', b'\n', b''):
+            pass
+        return body
+
+    def do_GET(self):
+        # /delay/<ms> holds the response back for a while.
+        if self.path.startswith('/delay/'):
+            time.sleep(int(self.path[len('/delay/'):]) / 1000.0)
+        # /bytes/<n> answers with a body of n bytes; /bytes/<n>/chunked sends it in chunks.
+        if self.path.startswith('/bytes/'):
+            self.send_bytes(self.path[len('/bytes/'):])
+            return
+        # /encoded/<coding>/<n>[/chunked] answers with n bytes of JSON lines in the content coding,
+        # one of gzip, deflate, deflate-raw (deflate without the zlib wrapper) and br.
+        if self.path.startswith('/encoded/'):
+            self.send_encoded(self.path[len('/encoded/'):])
+            return
+        # /cache/<name>?cc=<cache-control>&etag=1&lm=1&expires=<secs>&vary=<header>&size=<n>
+        # answers with `name:v<version>:<request count>[:<vary header value>]`, padded by n dots,
+        # and with the cache headers asked for; a request with matching validators gets a 304.
+        # X-Requests tells the number of requests for the name, 304 ones included.
+        if self.path.startswith('/cache/'):
+            self.send_cacheable(self.path[len('/cache/'):])
+            return
+        # /stall/<ms> sends the headers and half of the body, and the rest after a while.
+        if self.path.startswith('/stall/'):
+            data = b'x' * 1024
+            self.send_response(200)
+            self.send_header('Content-Type', 'application/octet-stream')
+            self.send_header('Content-Length', str(len(data)))
+            self.end_headers()
+            self.wfile.write(data[:512])
+            self.wfile.flush()
+            time.sleep(int(self.path[len('/stall/'):]) / 1000.0)
+            self.wfile.write(data[512:])
+            return
+        # /flaky/<name>?fail=<n>&status=<code>&retry_after=<value> answers the first n requests
+        # for the name with the status, 503 by default, and then with `name:<request count>`.
+        if self.path.startswith('/flaky/'):
+            self.send_flaky(self.path[len('/flaky/'):])
+            return
+        # /slow/<name>?first=<ms> holds the response to the first request for the name back for a
+        # while, and answers with `name:<request count>:<Host header>`.
+        if self.path.startswith('/slow/'):
+            name, _, query = self.path[len('/slow/'):].partition('?')
+            params = {k: v[0] for k, v in urllib.parse.parse_qs(query).items()}
+            with slow_lock:
+                slow_requests[name] = slow_requests.get(name, 0) + 1
+                count = slow_requests[name]
+            if count == 1:
+                time.sleep(int(params.get('first', 0)) / 1000.0)
+            self.send_body('{0}:{1}:{2}'.format(name, count, self.headers.get('Host', '')))
+            return
+        # /cut/<name> sends the headers and half of the body of the first response for the name,
+        # and then closes the connection; later requests are answered in full.
+        if self.path.startswith('/cut/'):
+            name = self.path[len('/cut/'):]
+            with cut_lock:
+                cut_requests[name] = cut_requests.get(name, 0) + 1
+                count = cut_requests[name]
+            if count > 1:
+                self.send_bytes('1024')
+                return
+            self.close_connection = True
+            self.send_response(200)
+            self.send_header('Content-Type', 'application/octet-stream')
+            self.send_header('Content-Length', '1024')
+            self.end_headers()
+            self.wfile.write(b'x' * 512)
+            self.wfile.flush()
+            # Lets the client read the part before the connection goes.
+            time.sleep(0.1)
+            return
+        # /spawn starts a server of its own on a free port, and answers with the port. That server
+        # answers the first request on a connection, and goes down as the second one comes in.
+        if self.path == '/spawn':
+            server = Server(('127.0.0.1', 0), DoomedHandler)
+            threading.Thread(target=server.serve_forever, daemon=True).start()
+            self.send_body(str(server.server_address[1]))
+            return
+        # /close answers and then closes the connection, leaving pipelined requests unanswered.
+        if self.path.startswith('/close'):
+            self.close_connection = True
+            data = 'Closing via {0}'.format(self.command).encode('utf-8')
+            self.send_response(200)
+            self.send_header('Connection', 'close')
+            self.send_header('Content-Length', str(len(data)))
+            self.end_headers()
+            if self.command != 'HEAD':
+                self.wfile.write(data)
+            return
+        self.send_body('Welcome to keep-alive server via {0}'.format(self.command))
+
+    def do_HEAD(self):
+        self.do_GET()
+
+    def do_POST(self):
+        # Posting to /stall/<ms> leaves the body unread for a while.
+        if self.path.startswith('/stall/'):
+            time.sleep(int(self.path[len('/stall/'):]) / 1000.0)
+        body = self.read_body()
+        # Posting to /flaky/ works as getting it does, with the body length appended.
+        if self.path.startswith('/flaky/'):
+            self.send_flaky(self.path[len('/flaky/'):], body)
+            return
+        # Posting to /cache/<name> makes a new version of it.
+        if self.path.startswith('/cache/'):
+            name = self.path[len('/cache/'):].partition('?')[0]
+            with cache_lock:
+                cache_versions[name] = cache_versions.get(name, 1) + 1
+        # A gzip body is echoed decompressed; headers tell how it came in.
+        extra_headers = {'X-Received-Length': str(len(body))}
+        if self.headers.get('Content-Encoding', '') == 'gzip':
+            body = gzip.decompress(body)
+            extra_headers['X-Received-Encoding'] = 'gzip'
+        self.send_body(body.decode('utf-8'), extra_headers=extra_headers)
+
+    def log_message(self, fmt, *args):
+        pass
+
+
+class DoomedHandler(Handler):
+    def setup(self):
+        super().setup()
+        self.requests_seen = 0
+
+    def do_GET(self):
+        self.requests_seen += 1
+        if self.requests_seen == 1:
+            super().do_GET()
+            return
+        # New connections are refused by the time this one is closed, unanswered.
+        self.server.shutdown()
+        self.server.server_close()
+        self.close_connection = True
+
+
+@functools.lru_cache(maxsize=16)
+def json_lines(size):
+    lines = []
+    total = 0
+    i = 0
+    while total < size:
+        line = '{{"id": {0}, "name": "item-{0}", "tags": ["winant", "http"]}}\n'.format(i)
+        lines.append(line)
+        total += len(line)
+        i += 1
+    return ''.join(lines).encode('ascii')[:size]
+
+
+# Bodies are cached, so that benchmarks measure the client rather than the server.
+@functools.lru_cache(maxsize=16)
+def encoded_json_lines(coding, size):
+    data = json_lines(size)
+    if coding == 'gzip':
+        return gzip.compress(data)
+    if coding == 'deflate':
+        return zlib.compress(data)
+    if coding == 'deflate-raw':
+        compressor = zlib.compressobj(wbits=-zlib.MAX_WBITS)
+        return compressor.compress(data) + compressor.flush()
+    import brotli
+    return brotli.compress(data)
+
+
+class Server(ThreadingHTTPServer):
+    # Lots of connections are opened at once by concurrency tests.
+    request_queue_size = 256
+    daemon_threads = True
+
+
+def main():
+    Server(('127.0.0.1', PORT), Handler).serve_forever()
+
+
+if __name__ == '__main__':
+    main()
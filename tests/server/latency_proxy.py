@@ -0,0 +1,47 @@
+#! python3
+# -*- coding: utf-8 -*-
+# 0xCCCCCCCC
+
+# Forwards connections to the keep-alive server and delays every chunk of data in each direction,
+# which makes round trips as expensive as on a real network.
+# Benchmarks of pipelining rely on it.
+
+import asyncio
+
+PORT = 5002
+UPSTREAM_PORT = 5001
+DELAY_SECONDS = 0.025
+
+
+async def pipe(reader, writer):
+    try:
+        while True:
+            data = await reader.read(64 * 1024)
+            if not data:
+                break
+            await asyncio.sleep(DELAY_SECONDS)
+            writer.write(data)
+            await writer.drain()
+    except ConnectionError:
+        pass
+    finally:
+        writer.close()
+
+
+async def handle(client_reader, client_writer):
+    try:
+        upstream_reader, upstream_writer = await asyncio.open_connection('127.0.0.1', UPSTREAM_PORT)
+    except OSError:
+        client_writer.close()
+        return
+    await asyncio.gather(pipe(client_reader, upstream_writer), pipe(upstream_reader, client_writer))
+
+
+async def main():
+    server = await asyncio.start_server(handle, '127.0.0.1', PORT, backlog=256)
+    async with server:
+        await server.serve_forever()
+
+
+if __name__ == '__main__':
+    asyncio.run(main())
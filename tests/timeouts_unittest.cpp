@@ -0,0 +1,263 @@
+/*
+ @ 0xCCCCCCCC
+*/
+
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "winant_http/internal/host_resolver.h"
+#include "winant_http/internal/request_timer.h"
+#include "winant_http/winant_http.h"
+
+namespace {
+
+constexpr char kRequestAddr[] = "http://127.0.0.1:5001";
+
+const wat::LoadFlags kNative(wat::LoadFlags::UseNativeTransport);
+
+using std::chrono::milliseconds;
+using Clock = std::chrono::steady_clock;
+
+// Returns the limit the request ran out of.
+template<typename F>
+wat::TimeoutError::Limit ExpectTimeout(F&& send, milliseconds max_elapsed)
+{
+    auto start = Clock::now();
+    try {
+        send();
+    } catch (const wat::TimeoutError& ex) {
+        EXPECT_LT(Clock::now() - start, max_elapsed);
+        return ex.limit();
+    } catch (const std::exception& ex) {
+        ADD_FAILURE() << "Unexpected error: " << ex.what();
+        return wat::TimeoutError::Limit::Total;
+    }
+
+    ADD_FAILURE() << "The request didn't time out";
+    return wat::TimeoutError::Limit::Total;
+}
+
+}   // namespace
+
+namespace wat {
+
+TEST(Timeouts, RequestTimer)
+{
+    using internal::RequestTimer;
+
+    RequestTimer unbounded {Timeouts()};
+    EXPECT_EQ(RequestTimer::Clock::time_point::max(), unbounded.deadline());
+    unbounded.Enter(RequestTimer::Phase::Read);
+    EXPECT_EQ(RequestTimer::Clock::time_point::max(), unbounded.deadline());
+
+    Timeouts timeouts;
+    timeouts.connect = milliseconds(100);
+    timeouts.idle_read = milliseconds(50);
+    timeouts.total = milliseconds(1000);
+    RequestTimer timer(timeouts);
+    auto start = RequestTimer::Clock::now();
+    EXPECT_LE(timer.deadline(), start + milliseconds(100));
+    EXPECT_EQ(TimeoutError::Limit::Connect, timer.Expired().limit());
+
+    // Writing isn't bounded but for the total.
+    timer.Enter(RequestTimer::Phase::Write);
+    EXPECT_EQ(TimeoutError::Limit::Total, timer.Expired().limit());
+    EXPECT_LE(timer.deadline(), start + milliseconds(1000));
+
+    // The idle limit runs from the last activity.
+    timer.Enter(RequestTimer::Phase::Read);
+    auto deadline = timer.deadline();
+    EXPECT_EQ(TimeoutError::Limit::IdleRead, timer.Expired().limit());
+    std::this_thread::sleep_for(milliseconds(10));
+    timer.OnActivity();
+    EXPECT_GE(timer.deadline() - deadline, milliseconds(10));
+}
+
+TEST(Timeouts, FirstByte)
+{
+    Timeouts timeouts;
+    timeouts.first_byte = milliseconds(100);
+    Url url(std::string(kRequestAddr) + "/delay/1000");
+    auto pool = std::make_shared<ConnectionPool>();
+
+    auto limit = ExpectTimeout([&] {
+        Get(url, kNative, timeouts, pool);
+    }, milliseconds(600));
+    EXPECT_EQ(TimeoutError::Limit::FirstByte, limit);
+
+    std::atomic<bool> failed(false);
+    auto on_complete = [&failed](const HttpResponse* response, std::exception_ptr error) {
+        failed = response == nullptr && error != nullptr;
+    };
+
+    limit = ExpectTimeout([&] {
+        GetAsync(url, kNative, timeouts, pool, CompletionHandler(on_complete)).get();
+    }, milliseconds(600));
+    EXPECT_EQ(TimeoutError::Limit::FirstByte, limit);
+    EXPECT_TRUE(failed);
+
+    // Timed-out connections are closed rather than reused.
+    EXPECT_EQ(0U, pool->idle_count());
+
+    auto response = Get(Url(std::string(kRequestAddr) + "/delay/50"), kNative, timeouts, pool);
+    EXPECT_EQ(200, response.status_code());
+    EXPECT_EQ(1U, pool->idle_count());
+}
+
+TEST(Timeouts, IdleRead)
+{
+    Timeouts timeouts;
+    timeouts.idle_read = milliseconds(100);
+    Url url(std::string(kRequestAddr) + "/stall/1000");
+
+    auto limit = ExpectTimeout([&] {
+        Get(url, kNative, timeouts);
+    }, milliseconds(600));
+    EXPECT_EQ(TimeoutError::Limit::IdleRead, limit);
+
+    limit = ExpectTimeout([&] {
+        GetAsync(url, kNative, timeouts).get();
+    }, milliseconds(600));
+    EXPECT_EQ(TimeoutError::Limit::IdleRead, limit);
+
+    // Gaps shorter than the limit don't count however long the response takes.
+    timeouts.idle_read = milliseconds(500);
+    auto response = Get(Url(std::string(kRequestAddr) + "/stall/200"), kNative, timeouts);
+    EXPECT_EQ(1024U, response.text().size());
+    response = GetAsync(Url(std::string(kRequestAddr) + "/stall/200"), kNative, timeouts).get();
+    EXPECT_EQ(1024U, response.text().size());
+}
+
+TEST(Timeouts, Write)
+{
+    Timeouts timeouts;
+    timeouts.write = milliseconds(100);
+    Url url(std::string(kRequestAddr) + "/stall/1500");
+
+    // The server leaves the body unread, and thus the socket buffers fill up.
+    auto make_body = [] {
+        return RequestBody(std::string(64 * 1024 * 1024, 'x'));
+    };
+
+    auto limit = ExpectTimeout([&] {
+        Post(url, kNative, timeouts, make_body());
+    }, milliseconds(1200));
+    EXPECT_EQ(TimeoutError::Limit::Write, limit);
+
+    limit = ExpectTimeout([&] {
+        PostAsync(url, kNative, timeouts, make_body()).get();
+    }, milliseconds(1200));
+    EXPECT_EQ(TimeoutError::Limit::Write, limit);
+}
+
+TEST(Timeouts, Total)
+{
+    Timeouts timeouts(milliseconds(200));
+    timeouts.idle_read = milliseconds(1000);
+
+    // The gap isn't long enough on its own.
+    Url url(std::string(kRequestAddr) + "/stall/300");
+    auto limit = ExpectTimeout([&] {
+        Get(url, kNative, timeouts);
+    }, milliseconds(400));
+    EXPECT_EQ(TimeoutError::Limit::Total, limit);
+
+    limit = ExpectTimeout([&] {
+        GetAsync(url, kNative, timeouts).get();
+    }, milliseconds(400));
+    EXPECT_EQ(TimeoutError::Limit::Total, limit);
+
+    auto response = Get(Url(std::string(kRequestAddr) + "/stall/50"), kNative, timeouts);
+    EXPECT_EQ(200, response.status_code());
+    response = GetAsync(Url(std::string(kRequestAddr) + "/stall/50"), kNative, timeouts).get();
+    EXPECT_EQ(200, response.status_code());
+}
+
+TEST(Timeouts, WaitForConnection)
+{
+    ConnectionPool::Options options;
+    options.max_connections_per_host = 1;
+    auto pool = std::make_shared<ConnectionPool>(options);
+    auto busy = GetAsync(Url(std::string(kRequestAddr) + "/delay/1000"), kNative, pool);
+    std::this_thread::sleep_for(milliseconds(50));
+
+    // The limits hold while a request waits in line for a connection.
+    Timeouts timeouts(milliseconds(200));
+    auto limit = ExpectTimeout([&] {
+        Get(Url(kRequestAddr), kNative, timeouts, pool);
+    }, milliseconds(400));
+    EXPECT_EQ(TimeoutError::Limit::Total, limit);
+
+    limit = ExpectTimeout([&] {
+        GetAsync(Url(kRequestAddr), kNative, timeouts, pool).get();
+    }, milliseconds(400));
+    EXPECT_EQ(TimeoutError::Limit::Total, limit);
+
+    // Requests that gave up have left the line.
+    EXPECT_EQ(200, busy.get().status_code());
+    EXPECT_EQ(200, Get(Url(kRequestAddr), kNative, pool).status_code());
+    EXPECT_EQ(1U, pool->stats().misses);
+}
+
+TEST(Timeouts, StalledHostLookup)
+{
+    using internal::RequestTimer;
+
+    // Lookups of the first host hang until the end of the test.
+    auto release = std::make_shared<std::promise<void>>();
+    auto released = release->get_future().share();
+    auto look_up = [released](const std::string& host, const std::string& port) {
+        if (host == "stalled.test") {
+            released.wait();
+        }
+
+        return internal::ResolveHost("127.0.0.1", port);
+    };
+
+    Timeouts timeouts(milliseconds(50));
+    for (int i = 0; i < 8; ++i) {
+        RequestTimer timer(timeouts);
+        auto limit = ExpectTimeout([&] {
+            internal::ResolveHostWithin("stalled.test", "80", &timer, look_up);
+        }, milliseconds(200));
+        EXPECT_EQ(TimeoutError::Limit::Total, limit);
+    }
+
+    // The abandoned lookups hold up no other.
+    RequestTimer timer(timeouts);
+    auto start = Clock::now();
+    EXPECT_TRUE(!!internal::ResolveHostWithin("healthy.test", "80", &timer, look_up));
+    EXPECT_LT(Clock::now() - start, milliseconds(50));
+
+    release->set_value();
+}
+
+TEST(Timeouts, ManyInFlight)
+{
+    // Each request is timed out on its own, while the others go on.
+    constexpr int kRequestCount = 20;
+    std::vector<std::future<HttpResponse>> futures;
+    for (int i = 0; i < kRequestCount; ++i) {
+        Timeouts timeouts;
+        timeouts.first_byte = milliseconds(i % 2 == 0 ? 100 : 2000);
+        futures.push_back(GetAsync(Url(std::string(kRequestAddr) + "/delay/400"), kNative,
+                                   timeouts));
+    }
+
+    for (int i = 0; i < kRequestCount; ++i) {
+        if (i % 2 == 0) {
+            EXPECT_THROW(futures[i].get(), TimeoutError);
+        } else {
+            EXPECT_EQ(200, futures[i].get().status_code());
+        }
+    }
+}
+
+}   // namespace wat
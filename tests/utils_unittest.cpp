@@ -2,6 +2,12 @@
  @ 0xCCCCCCCC
 */
 
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <string>
+
 #include "gtest/gtest.h"
 
 #include "winant_http/winant_utils.h"
@@ -15,6 +21,42 @@ struct EscapeCase {
     const char* output;
 };
 
+// The escaping used before, as a baseline.
+std::string EscapeUrlByScanning(kbase::StringView str)
+{
+    constexpr kbase::StringView kUnreserved("ABCDEFGHIJKLMNOPQRSTUVWXYZ"
+                                            "abcdefghijklmnopqrstuvwxyz"
+                                            "0123456789"
+                                            "-_.~");
+
+    std::string escaped;
+    for (auto ch : str) {
+        if (kUnreserved.find_first_of(ch) != kbase::StringView::npos) {
+            escaped.push_back(ch);
+        } else {
+            escaped.append(1, '%')
+                   .append(kbase::StringPrintf("%.2X", static_cast<unsigned char>(ch)));
+        }
+    }
+
+    return escaped;
+}
+
+std::string RandomText(std::mt19937& engine, size_t size, int escaped_percent)
+{
+    constexpr char kPlain[] = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789-_.~";
+    std::string text(size, '\0');
+    for (auto& ch : text) {
+        if (static_cast<int>(engine() % 100) < escaped_percent) {
+            ch = static_cast<char>(engine() % 256);
+        } else {
+            ch = kPlain[engine() % (sizeof(kPlain) - 1)];
+        }
+    }
+
+    return text;
+}
+
 }   // namespace
 
 namespace wat {
@@ -35,9 +77,9 @@ TEST(WinAntUtils, EscapeUrl)
                                           "abcdefghijklmnopqrstuvwxyz"
                                           "0123456789"
                                           "-_.~");
-    for (char i = 0; i < 256; ++i) {
+    for (int i = 0; i < 256; ++i) {
         std::string in;
-        in.push_back(i);
+        in.push_back(static_cast<char>(i));
         std::string out = EscapeUrl(in);
         if (0 == i) {
             EXPECT_EQ(out, std::string("%00"));
@@ -52,4 +94,79 @@ TEST(WinAntUtils, EscapeUrl)
     }
 }
 
+TEST(WinAntUtils, EscapeUrlMatchesBaseline)
+{
+    std::mt19937 engine(20201013);
+    for (size_t size = 0; size < 200; ++size) {
+        for (int escaped_percent : {0, 5, 50, 100}) {
+            auto text = RandomText(engine, size, escaped_percent);
+            auto escaped = EscapeUrl(text);
+            ASSERT_EQ(EscapeUrlByScanning(text), escaped);
+            ASSERT_EQ(text, UnescapeUrl(escaped));
+        }
+    }
+}
+
+TEST(WinAntUtils, UnescapeUrl)
+{
+    const EscapeCase unescape_cases[] = {
+        { "foo", "foo" },
+        { "foo%20bar", "foo bar" },
+        { "%2b%2B+", "+++" },
+        { "%e4%BD%A0", "\xE4\xBD\xA0" },
+        { "100%", "100%" },
+        { "%4", "%4" },
+        { "%%41", "%A" },
+        { "%zz%4g", "%zz%4g" }
+    };
+
+    for (const auto& item : unescape_cases) {
+        EXPECT_EQ(item.output, UnescapeUrl(item.input));
+    }
+
+    EXPECT_EQ(std::string(1, '\0'), UnescapeUrl("%00"));
+}
+
+TEST(WinAntUtils, DISABLED_EscapeUrlBenchmark)
+{
+    std::mt19937 engine(20201013);
+    using Clock = std::chrono::steady_clock;
+    using std::chrono::nanoseconds;
+
+    for (size_t size : {1000, 100 * 1000, 10 * 1000 * 1000}) {
+        for (int escaped_percent : {2, 30}) {
+            auto text = RandomText(engine, size, escaped_percent);
+            int rounds = static_cast<int>(std::max<size_t>(1, 100 * 1000 * 1000 / size / 10));
+
+            size_t total = 0;
+            auto start = Clock::now();
+            for (int i = 0; i < rounds; ++i) {
+                total += EscapeUrlByScanning(text).size();
+            }
+
+            auto scanning = std::chrono::duration_cast<nanoseconds>(Clock::now() - start);
+
+            start = Clock::now();
+            for (int i = 0; i < rounds; ++i) {
+                total += EscapeUrl(text).size();
+            }
+
+            auto table = std::chrono::duration_cast<nanoseconds>(Clock::now() - start);
+
+            start = Clock::now();
+            auto escaped = EscapeUrl(text);
+            for (int i = 0; i < rounds; ++i) {
+                total += UnescapeUrl(escaped).size();
+            }
+
+            auto unescape = std::chrono::duration_cast<nanoseconds>(Clock::now() - start);
+
+            std::cout << size << " bytes, " << escaped_percent << "% escaped: scanning "
+                      << scanning.count() / rounds << "ns, table "
+                      << table.count() / rounds << "ns, unescape "
+                      << unescape.count() / rounds << "ns (" << total << ")" << std::endl;
+        }
+    }
+}
+
 }   // namespace wat
@@ -0,0 +1,525 @@
+/*
+ @ 0xCCCCCCCC
+*/
+
+#include "winant_http/internal/async_exchange.h"
+
+#include <atomic>
+#include <cstdio>
+#include <utility>
+
+#include "kbase/error_exception_util.h"
+
+#include "winant_http/internal/hedged_request.h"
+
+namespace {
+
+constexpr size_t kSendChunkSize = 64 * 1024;
+
+}   // namespace
+
+namespace wat {
+namespace internal {
+
+// -*- AsyncCompletion -*-
+
+AsyncCompletion::AsyncCompletion(CompletionHandler handler, AsyncResultHandler on_result)
+    : handler_(std::move(handler)), on_result_(std::move(on_result)), watcher_id_(0),
+      abandoned_(false)
+{}
+
+void AsyncCompletion::Abandon() noexcept
+{
+    abandoned_ = true;
+    if (watcher_id_ != 0) {
+        try {
+            IoLoop::Default().Refresh(watcher_id_);
+        } catch (...) {}
+    }
+}
+
+void AsyncCompletion::SetCacheTransaction(std::unique_ptr<HttpCacheTransaction> transaction)
+{
+    cache_transaction_ = std::move(transaction);
+}
+
+void AsyncCompletion::SetRetryController(std::unique_ptr<RetryController> retry)
+{
+    retry_ = std::move(retry);
+}
+
+void AsyncCompletion::SetHeadersHandler(std::function<void()> on_headers)
+{
+    on_headers_ = std::move(on_headers);
+}
+
+void AsyncCompletion::OnHeaders() noexcept
+{
+    if (on_headers_) {
+        try {
+            on_headers_();
+        } catch (...) {}
+    }
+}
+
+bool AsyncCompletion::RetryLater(HttpRequest& request, const HttpResponse* response,
+                                 std::exception_ptr error) noexcept
+{
+    if (!retry_ || abandoned_) {
+        return false;
+    }
+
+    try {
+        std::chrono::milliseconds delay;
+        if (!retry_->ShouldRetry(response, error, delay)) {
+            return false;
+        }
+
+        // The retry is due either once the backoff is over or as soon as the request is cancelled,
+        // whichever comes first, and only the first of the two starts it.
+        struct PendingRetry {
+            explicit PendingRetry(HttpRequest&& request)
+                : request(std::move(request)), cancel_callback(0), started(false)
+            {}
+
+            HttpRequest request;
+            std::atomic<uint64_t> cancel_callback;
+            bool started;
+        };
+
+        auto next = std::make_shared<PendingRetry>(std::move(request));
+        auto self = shared_from_this();
+        auto start = [next, self] {
+            if (next->started) {
+                return;
+            }
+
+            next->started = true;
+            auto token = next->request.cancellation_token();
+            if (token) {
+                token->RemoveCallback(next->cancel_callback);
+            }
+
+            try {
+                if (CanHedgeRequest(next->request)) {
+                    std::make_shared<HedgedRequest>(std::move(next->request), self)->Start();
+                } else {
+                    StartAsyncExchange(std::move(next->request), self);
+                }
+            } catch (...) {
+                self->Fail(std::current_exception());
+            }
+        };
+
+        auto token = next->request.cancellation_token();
+        if (token) {
+            next->cancel_callback = token->AddCallback([start] {
+                try {
+                    IoLoop::Default().AddTimer(IoLoop::Clock::now(), start);
+                } catch (...) {}
+            });
+        }
+
+        IoLoop::Default().AddTimer(IoLoop::Clock::now() + delay, start);
+
+        return true;
+    } catch (...) {
+        return false;
+    }
+}
+
+void AsyncCompletion::Succeed(HttpResponse&& response) noexcept
+{
+    if (cache_transaction_) {
+        cache_transaction_->OnResponse(response);
+    }
+
+    if (handler_) {
+        try {
+            handler_(&response, nullptr);
+        } catch (...) {}
+    }
+
+    on_result_(&response, nullptr);
+}
+
+void AsyncCompletion::Fail(std::exception_ptr error) noexcept
+{
+    if (handler_) {
+        try {
+            handler_(nullptr, error);
+        } catch (...) {}
+    }
+
+    on_result_(nullptr, error);
+}
+
+// -*- AsyncExchange -*-
+
+AsyncExchange::AsyncExchange(HttpRequest request, std::shared_ptr<AsyncCompletion> completion)
+    : request_(std::move(request)),
+      completion_(std::move(completion)),
+      state_(State::Acquiring),
+      retried_(false),
+      timer_(request_.timeouts(), request_.cancellation_token()),
+      head_sent_(false),
+      body_sent_(false),
+      read_buf_(request_.read_buffer_size()),
+      parser_(request_.method() == HttpRequest::Method::Head),
+      decoder_(request_),
+      response_body_(request_),
+      response_started_(false),
+      headers_received_(false),
+      unexpected_data_(false)
+{}
+
+AsyncExchange::~AsyncExchange()
+{
+    if (checkout_) {
+        checkout_->Cancel();
+    }
+}
+
+bool AsyncExchange::OnStart() noexcept
+{
+    try {
+        // The loop looks at the deadline again, and thus aborts the exchange.
+        auto id = this->id();
+        timer_.OnCancel([id] {
+            try {
+                IoLoop::Default().Refresh(id);
+            } catch (...) {}
+        });
+        completion_->set_watcher_id(id);
+        timer_.CheckCancelled();
+        endpoint_ = GetEndpoint(request_.url());
+        EnsureNativeScheme(endpoint_);
+
+        head_.reserve(512);
+        AppendRequestHead(request_, endpoint_, head_);
+
+        pool_ = request_.connection_pool() ? request_.connection_pool() :
+                                             ConnectionPool::Default();
+        Connect(true);
+        return true;
+    } catch (...) {
+        Abort(std::current_exception());
+        return false;
+    }
+}
+
+void AsyncExchange::Connect(bool reuse_idle)
+{
+    connection_.reset();
+    if (checkout_) {
+        checkout_->Cancel();
+    }
+
+    state_ = State::Acquiring;
+    timer_.Enter(RequestTimer::Phase::Connect);
+
+    out_ = kbase::StringView();
+    head_sent_ = false;
+    body_sent_ = false;
+    body_reader_.reset();
+
+    checkout_ = std::make_shared<AsyncCheckout>(pool_, endpoint_, reuse_idle);
+    bool connecting = false;
+    auto connection = checkout_->Start(
+        [this](std::unique_ptr<PooledConnection> connection, bool connecting,
+               std::exception_ptr error) {
+            OnCheckedOut(std::move(connection), connecting, error);
+        },
+        connecting);
+    if (connection) {
+        UseConnection(std::move(connection), connecting);
+    }
+}
+
+void AsyncExchange::UseConnection(std::unique_ptr<PooledConnection> connection, bool connecting)
+{
+    checkout_.reset();
+    connection_ = std::move(connection);
+    state_ = connecting ? State::Connecting : State::Sending;
+    timer_.Enter(connecting ? RequestTimer::Phase::Connect : RequestTimer::Phase::Write);
+}
+
+void AsyncExchange::OnCheckedOut(std::unique_ptr<PooledConnection> connection, bool connecting,
+                                 std::exception_ptr error) noexcept
+{
+    if (error) {
+        checkout_.reset();
+        pending_error_ = error;
+    } else {
+        UseConnection(std::move(connection), connecting);
+    }
+
+    // The loop starts watching the connection, or aborts the exchange.
+    try {
+        IoLoop::Default().Refresh(id());
+    } catch (...) {}
+}
+
+SocketHandle AsyncExchange::socket() const noexcept
+{
+    return connection_ ? connection_->get() : kInvalidSocket;
+}
+
+unsigned int AsyncExchange::interest() const noexcept
+{
+    return state_ == State::Receiving ? SocketReadable : SocketWritable;
+}
+
+bool AsyncExchange::OnReady(unsigned int /*events*/) noexcept
+{
+    try {
+        if (state_ == State::Connecting) {
+            int error = GetPendingSocketError(connection_->get());
+            if (error != 0) {
+                ThrowConnectError(endpoint_.host, endpoint_.port, error);
+            }
+
+            state_ = State::Sending;
+            timer_.Enter(RequestTimer::Phase::Write);
+        }
+
+        if (state_ == State::Sending) {
+            if (!SendRequest()) {
+                return true;
+            }
+
+            state_ = State::Receiving;
+            timer_.Enter(RequestTimer::Phase::FirstByte);
+        }
+
+        if (!ReceiveResponse()) {
+            return true;
+        }
+
+        Finish();
+        return false;
+    } catch (const ConnectionClosedError&) {
+        auto error = std::current_exception();
+        if (CanRetry()) {
+            retried_ = true;
+            try {
+                Connect(false);
+                return true;
+            } catch (...) {
+                // As on a synchronous request, the new connection tells why the server is gone.
+                error = std::current_exception();
+            }
+        }
+
+        Abort(error);
+        return false;
+    } catch (...) {
+        Abort(std::current_exception());
+        return false;
+    }
+}
+
+AsyncExchange::Clock::time_point AsyncExchange::deadline() const noexcept
+{
+    return Cancelled() || pending_error_ ? Clock::time_point::min() : timer_.deadline();
+}
+
+bool AsyncExchange::OnTimeout() noexcept
+{
+    if (pending_error_) {
+        Abort(pending_error_);
+        return false;
+    }
+
+    if (Cancelled()) {
+        Abort(std::make_exception_ptr(CancelledError()));
+        return false;
+    }
+
+    // A timed-out request isn't retried, as it's not the connection that went stale.
+    Abort(std::make_exception_ptr(timer_.Expired()));
+    return false;
+}
+
+bool AsyncExchange::SendRequest()
+{
+    while (true) {
+        if (out_.empty() && !NextOutput()) {
+            return true;
+        }
+
+        if (Cancelled()) {
+            throw CancelledError();
+        }
+
+        auto sent = SendSome(connection_->get(), out_.data(), out_.size());
+        if (sent == 0) {
+            return false;
+        }
+
+        timer_.OnActivity();
+        out_ = kbase::StringView(out_.data() + sent, out_.size() - sent);
+    }
+}
+
+bool AsyncExchange::NextOutput()
+{
+    if (!head_sent_) {
+        head_sent_ = true;
+        out_ = head_;
+        return true;
+    }
+
+    const auto& body = request_.body();
+    if (body_sent_ || body.empty()) {
+        return false;
+    }
+
+    if (!body_reader_) {
+        body_reader_ = std::make_unique<RequestBodyReader>(body);
+        if (!body_buf_) {
+            body_buf_.reset(new char[kSendChunkSize]);
+        }
+    }
+
+    bool chunked = body.length() == RequestBody::kUnknownLength;
+    auto chunk = body_reader_->Next(body_buf_.get(), kSendChunkSize);
+    if (chunk.empty()) {
+        body_sent_ = true;
+        if (chunked) {
+            out_ = kbase::StringView("0\r\n\r\n", 5);
+            return true;
+        }
+
+        return false;
+    }
+
+    if (chunked) {
+        char size_line[24];
+        int len = snprintf(size_line, sizeof(size_line), "%llx\r\n",
+                           static_cast<unsigned long long>(chunk.size()));
+        chunk_frame_.assign(size_line, static_cast<size_t>(len));
+        chunk_frame_.append(chunk.data(), chunk.size()).append("\r\n", 2);
+        out_ = chunk_frame_;
+    } else {
+        out_ = chunk;
+    }
+
+    return true;
+}
+
+bool AsyncExchange::ReceiveResponse()
+{
+    const auto& read_handler = request_.read_response_handler();
+    bool save_body = !(request_.load_flags().flags & LoadFlags::DoNotSaveResponseBody);
+    auto on_decoded = [&](const char* data, size_t size) {
+        if (save_body) {
+            response_body_.Reserve(parser_.content_length());
+            response_body_.Append(data, size);
+        }
+
+        if (read_handler && size > 0) {
+            read_handler(data, static_cast<int>(size));
+        }
+    };
+
+    auto on_body = [&](const char* data, size_t size) {
+        decoder_.Feed(parser_.headers(), data, size, on_decoded);
+    };
+
+    while (true) {
+        // Data may keep coming without the loop going round.
+        if (Cancelled()) {
+            throw CancelledError();
+        }
+
+        size_t received = 0;
+        if (!TryReceive(connection_->get(), read_buf_.data(), read_buf_.size(), received)) {
+            return false;
+        }
+
+        if (received == 0) {
+            if (!response_started_) {
+                throw ConnectionClosedError("Connection closed before any response");
+            }
+
+            ENSURE(THROW, parser_.FinishOnEOF())(parser_.headers_complete()).Require();
+            decoder_.Finish();
+            return true;
+        }
+
+        if (response_started_) {
+            timer_.OnActivity();
+        } else {
+            response_started_ = true;
+            timer_.Enter(RequestTimer::Phase::Read);
+        }
+
+        auto consumed = parser_.Feed(read_buf_.data(), received, on_body);
+        if (!headers_received_ && parser_.headers_complete()) {
+            headers_received_ = true;
+            completion_->OnHeaders();
+        }
+
+        if (parser_.message_complete()) {
+            unexpected_data_ = consumed != received;
+            decoder_.Finish();
+            return true;
+        }
+
+        read_buf_.OnRead(received);
+    }
+}
+
+bool AsyncExchange::CanRetry() const noexcept
+{
+    return !retried_ && !response_started_ && connection_ && connection_->reused() &&
+           request_.body().replayable() && !Cancelled();
+}
+
+void AsyncExchange::Finish()
+{
+    const auto& read_handler = request_.read_response_handler();
+    if (read_handler) {
+        read_handler("", 0);
+    }
+
+    connection_->set_reusable(parser_.keep_alive() && !unexpected_data_ &&
+                              !RequestsConnectionClose(request_.headers()));
+    // Return the connection before completing, so that follow-up requests can reuse it.
+    connection_.reset();
+
+    auto response = response_body_.ToResponse(parser_.status_code(), std::move(parser_.headers()));
+    if (!completion_->RetryLater(request_, &response, nullptr)) {
+        completion_->Succeed(std::move(response));
+    }
+}
+
+void AsyncExchange::Abort(std::exception_ptr error) noexcept
+{
+    const auto& read_handler = request_.read_response_handler();
+    if (read_handler) {
+        try {
+            read_handler(nullptr, -1);
+        } catch (...) {}
+    }
+
+    if (checkout_) {
+        checkout_->Cancel();
+        checkout_.reset();
+    }
+
+    connection_.reset();
+    if (!completion_->RetryLater(request_, nullptr, error)) {
+        completion_->Fail(error);
+    }
+}
+
+void StartAsyncExchange(HttpRequest request, std::shared_ptr<AsyncCompletion> completion)
+{
+    IoLoop::Default().Add(std::make_unique<AsyncExchange>(std::move(request),
+                                                          std::move(completion)));
+}
+
+}   // namespace internal
+}   // namespace wat
@@ -0,0 +1,197 @@
+/*
+ @ 0xCCCCCCCC
+*/
+
+#if defined(_MSC_VER)
+#pragma once
+#endif
+
+#ifndef WINANT_HTTP_INTERNAL_ASYNC_EXCHANGE_H_
+#define WINANT_HTTP_INTERNAL_ASYNC_EXCHANGE_H_
+
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <string>
+
+#include "kbase/basic_macros.h"
+#include "kbase/string_view.h"
+
+#include "winant_http/internal/connection_pool_impl.h"
+#include "winant_http/internal/content_decoder.h"
+#include "winant_http/internal/http_cache_impl.h"
+#include "winant_http/internal/http_response_parser.h"
+#include "winant_http/internal/http_transport.h"
+#include "winant_http/internal/io_loop.h"
+#include "winant_http/internal/read_buffer.h"
+#include "winant_http/internal/request_body_reader.h"
+#include "winant_http/internal/request_timer.h"
+#include "winant_http/internal/response_body_buffer.h"
+#include "winant_http/internal/retry_controller.h"
+#include "winant_http/internal/socket_transport.h"
+#include "winant_http/winant_request.h"
+#include "winant_http/winant_response.h"
+
+namespace wat {
+namespace internal {
+
+// Delivers the outcome of an asynchronous request to the completion handler the request was
+// configured with, if any, and then to the result handler, which may take the response over.
+// Attempts that are to be retried are started over instead, after the delay, from the I/O loop.
+class AsyncCompletion : public std::enable_shared_from_this<AsyncCompletion> {
+public:
+    AsyncCompletion(CompletionHandler handler, AsyncResultHandler on_result);
+
+    ~AsyncCompletion() = default;
+
+    DISALLOW_COPY(AsyncCompletion);
+
+    // The response goes through `transaction` before it is delivered.
+    void SetCacheTransaction(std::unique_ptr<HttpCacheTransaction> transaction);
+
+    void SetRetryController(std::unique_ptr<RetryController> retry);
+
+    // `on_headers` is called on the loop thread once the response headers have been received.
+    void SetHeadersHandler(std::function<void()> on_headers);
+
+    void OnHeaders() noexcept;
+
+    // The exchange of the attempt underway, which is refreshed once the attempt is abandoned.
+    void set_watcher_id(uint64_t id) noexcept
+    {
+        watcher_id_ = id;
+    }
+
+    // The exchange is aborted at the next turn of the loop as if it were cancelled, and fails
+    // without being retried.
+    // Called on the loop thread.
+    void Abandon() noexcept;
+
+    bool abandoned() const noexcept
+    {
+        return abandoned_;
+    }
+
+    // Returns true, having taken `request` over, if the attempt that ended with either `response`
+    // or `error` is retried; the outcome is not delivered then.
+    bool RetryLater(HttpRequest& request, const HttpResponse* response,
+                    std::exception_ptr error) noexcept;
+
+    void Succeed(HttpResponse&& response) noexcept;
+
+    void Fail(std::exception_ptr error) noexcept;
+
+private:
+    CompletionHandler handler_;
+    AsyncResultHandler on_result_;
+    std::unique_ptr<HttpCacheTransaction> cache_transaction_;
+    std::unique_ptr<RetryController> retry_;
+    std::function<void()> on_headers_;
+    uint64_t watcher_id_;
+    bool abandoned_;
+};
+
+// Carries out a request of the native transport on the I/O loop: checks out a connection, sends
+// the request and parses the response, each step proceeding only as far as the socket allows
+// without blocking.
+// The loop times the exchange out as the timeouts of the request direct, and aborts it once the
+// request is cancelled.
+class AsyncExchange : public IoWatcher {
+public:
+    AsyncExchange(HttpRequest request, std::shared_ptr<AsyncCompletion> completion);
+
+    ~AsyncExchange();
+
+    DISALLOW_COPY(AsyncExchange);
+
+    // Prepares the request head and starts checking out a connection.
+    bool OnStart() noexcept override;
+
+    SocketHandle socket() const noexcept override;
+
+    unsigned int interest() const noexcept override;
+
+    bool OnReady(unsigned int events) noexcept override;
+
+    Clock::time_point deadline() const noexcept override;
+
+    bool OnTimeout() noexcept override;
+
+private:
+    enum class State {
+        // Waiting for the pool to hand over a connection.
+        Acquiring,
+        Connecting,
+        Sending,
+        Receiving
+    };
+
+    void Connect(bool reuse_idle);
+
+    void UseConnection(std::unique_ptr<PooledConnection> connection, bool connecting);
+
+    void OnCheckedOut(std::unique_ptr<PooledConnection> connection, bool connecting,
+                      std::exception_ptr error) noexcept;
+
+    // Returns true once the whole request has been sent.
+    bool SendRequest();
+
+    // Sets `out_` to the next piece of the request; returns false at the end of the request.
+    bool NextOutput();
+
+    // Returns true once the response is complete.
+    bool ReceiveResponse();
+
+    // A reused connection may have been closed by the server while it was idle; the request is
+    // then sent again on a new connection, as long as no response byte has been seen and the
+    // body can be replayed.
+    bool CanRetry() const noexcept;
+
+    bool Cancelled() const noexcept
+    {
+        return timer_.cancelled() || completion_->abandoned();
+    }
+
+    void Finish();
+
+    void Abort(std::exception_ptr error) noexcept;
+
+private:
+    HttpRequest request_;
+    std::shared_ptr<AsyncCompletion> completion_;
+    std::shared_ptr<ConnectionPool> pool_;
+    Endpoint endpoint_;
+    std::string head_;
+    std::shared_ptr<AsyncCheckout> checkout_;
+    std::unique_ptr<PooledConnection> connection_;
+    State state_;
+    bool retried_;
+    // A checkout that failed, which the exchange is aborted with at the next turn of the loop.
+    std::exception_ptr pending_error_;
+    RequestTimer timer_;
+
+    kbase::StringView out_;
+    bool head_sent_;
+    bool body_sent_;
+    std::unique_ptr<RequestBodyReader> body_reader_;
+    std::unique_ptr<char[]> body_buf_;
+    std::string chunk_frame_;
+
+    ReadBuffer read_buf_;
+    HttpResponseParser parser_;
+    ResponseBodyDecoder decoder_;
+    ResponseBodyBuffer response_body_;
+    bool response_started_;
+    bool headers_received_;
+    bool unexpected_data_;
+};
+
+// Starts an attempt of the request on the I/O loop; a failure to start ends the attempt as any
+// other failure does. Never blocks.
+void StartAsyncExchange(HttpRequest request, std::shared_ptr<AsyncCompletion> completion);
+
+}   // namespace internal
+}   // namespace wat
+
+#endif  // WINANT_HTTP_INTERNAL_ASYNC_EXCHANGE_H_
@@ -0,0 +1,497 @@
+/*
+ @ 0xCCCCCCCC
+*/
+
+#include "winant_http/internal/connection_pool_impl.h"
+
+#include <algorithm>
+#include <utility>
+
+#include "winant_http/internal/host_resolver.h"
+#include "winant_http/internal/io_loop.h"
+#include "winant_http/internal/request_timer.h"
+#include "winant_http/internal/socket_transport.h"
+
+namespace {
+
+std::string MakePoolKey(const wat::internal::Endpoint& endpoint)
+{
+    std::string key;
+    key.reserve(endpoint.scheme.size() + endpoint.host.size() + endpoint.port.size() + 4);
+    key.append(endpoint.scheme).append("://").append(endpoint.host)
+       .append(1, ':').append(endpoint.port);
+    return key;
+}
+
+// An idle connection should have nothing to read; being readable means the peer has closed it
+// or has sent something we can't make sense of.
+bool IsIdleConnectionAlive(wat::internal::SocketHandle socket)
+{
+    return wat::internal::WaitSocket(socket, wat::internal::SocketReadable, 0) == 0;
+}
+
+}   // namespace
+
+namespace wat {
+namespace internal {
+
+// -*- PooledConnection -*-
+
+PooledConnection::PooledConnection(ConnectionPoolImpl* pool, std::string key, ScopedSocket socket,
+                                   bool reused)
+    : pool_(pool), key_(std::move(key)), socket_(std::move(socket)), reused_(reused),
+      reusable_(false)
+{}
+
+PooledConnection::~PooledConnection()
+{
+    ReturnToPool();
+}
+
+PooledConnection::PooledConnection(PooledConnection&& other) noexcept
+    : pool_(other.pool_), key_(std::move(other.key_)), socket_(std::move(other.socket_)),
+      reused_(other.reused_), reusable_(other.reusable_)
+{
+    other.pool_ = nullptr;
+}
+
+PooledConnection& PooledConnection::operator=(PooledConnection&& other) noexcept
+{
+    if (this != &other) {
+        ReturnToPool();
+        pool_ = other.pool_;
+        key_ = std::move(other.key_);
+        socket_ = std::move(other.socket_);
+        reused_ = other.reused_;
+        reusable_ = other.reusable_;
+        other.pool_ = nullptr;
+    }
+
+    return *this;
+}
+
+void PooledConnection::ReturnToPool() noexcept
+{
+    if (pool_) {
+        pool_->Release(key_, std::move(socket_), reusable_);
+        pool_ = nullptr;
+    }
+}
+
+// -*- ConnectionPoolImpl -*-
+
+ConnectionPoolImpl::ConnectionPoolImpl(const ConnectionPool::Options& options)
+    : options_(options), next_ticket_(1)
+{}
+
+PooledConnection ConnectionPoolImpl::Acquire(const Endpoint& endpoint, bool reuse_idle,
+                                             RequestTimer* timer)
+{
+    auto key = MakePoolKey(endpoint);
+    ScopedSocket socket;
+    if (Reserve(key, reuse_idle, socket, timer)) {
+        return PooledConnection(this, std::move(key), std::move(socket), true);
+    }
+
+    try {
+        socket = ConnectSocket(ResolveHostWithin(endpoint.host, endpoint.port, timer),
+                               endpoint.host, endpoint.port, timer);
+        return PooledConnection(this, std::move(key), std::move(socket), false);
+    } catch (...) {
+        Release(key, ScopedSocket(), false);
+        throw;
+    }
+}
+
+void ConnectionPoolImpl::Release(const std::string& key, ScopedSocket socket, bool reusable)
+{
+    std::shared_ptr<SlotWaiter> next;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto& entry = hosts_[key];
+        bool keep = reusable && socket;
+        if (entry.waiters.empty()) {
+            --entry.active;
+            if (keep && entry.idle.size() < options_.max_idle_per_host) {
+                entry.idle.push_back(IdleConnection {std::move(socket), Clock::now()});
+            }
+        } else {
+            // The slot goes straight to the checkout that has waited longest, so that it can't be
+            // taken by one that comes later.
+            next = std::move(entry.waiters.front());
+            entry.waiters.pop_front();
+            next->granted = true;
+            if (keep && next->reuse_idle) {
+                next->socket = std::move(socket);
+                ++stats_.hits;
+            } else {
+                ++stats_.misses;
+            }
+        }
+    }
+
+    if (!next) {
+        return;
+    }
+
+    if (next->on_slot) {
+        next->on_slot(std::move(next->socket));
+    } else {
+        slot_available_.notify_all();
+    }
+}
+
+bool ConnectionPoolImpl::HasFreeSlot(const Endpoint& endpoint) const
+{
+    if (options_.max_connections_per_host == 0) {
+        return true;
+    }
+
+    // Idle connections are reused, or dropped to make room.
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = hosts_.find(MakePoolKey(endpoint));
+    return it == hosts_.end() || it->second.active < options_.max_connections_per_host;
+}
+
+ConnectionPool::Stats ConnectionPoolImpl::stats() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return stats_;
+}
+
+size_t ConnectionPoolImpl::idle_count() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    size_t count = 0;
+    for (const auto& host : hosts_) {
+        count += host.second.idle.size();
+    }
+
+    return count;
+}
+
+void ConnectionPoolImpl::CloseIdleConnections()
+{
+    // No checkout can be waiting while there are idle connections to make room with.
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto& host : hosts_) {
+        host.second.idle.clear();
+    }
+}
+
+bool ConnectionPoolImpl::Reserve(const std::string& key, bool reuse_idle, ScopedSocket& idle_socket,
+                                 const RequestTimer* timer)
+{
+    auto token = timer ? timer->token() : nullptr;
+    if (!token) {
+        return WaitForSlot(key, reuse_idle, idle_socket, timer);
+    }
+
+    // The token runs the callback under its own lock, so the pool isn't locked while the callback
+    // is added or removed.
+    auto cancel_callback = token->AddCallback([this] {
+        std::lock_guard<std::mutex> lock(mutex_);
+        slot_available_.notify_all();
+    });
+
+    try {
+        bool reused = WaitForSlot(key, reuse_idle, idle_socket, timer);
+        token->RemoveCallback(cancel_callback);
+        return reused;
+    } catch (...) {
+        token->RemoveCallback(cancel_callback);
+        throw;
+    }
+}
+
+bool ConnectionPoolImpl::WaitForSlot(const std::string& key, bool reuse_idle,
+                                     ScopedSocket& idle_socket, const RequestTimer* timer)
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    auto& entry = hosts_[key];
+    if (TakeSlot(entry, reuse_idle, idle_socket)) {
+        return !!idle_socket;
+    }
+
+    auto waiter = Enqueue(entry, reuse_idle, nullptr);
+    auto granted_or_cancelled = [&waiter, timer] {
+        return waiter->granted || (timer && timer->cancelled());
+    };
+
+    auto deadline = timer ? timer->deadline() : RequestTimer::Clock::time_point::max();
+    if (deadline == RequestTimer::Clock::time_point::max()) {
+        slot_available_.wait(lock, granted_or_cancelled);
+    } else {
+        slot_available_.wait_until(lock, deadline, granted_or_cancelled);
+    }
+
+    // A slot handed over just as the request was cancelled is kept, and given back by the caller.
+    if (!waiter->granted) {
+        Dequeue(entry, waiter->ticket);
+        timer->CheckCancelled();
+        throw timer->Expired();
+    }
+
+    idle_socket = std::move(waiter->socket);
+    return !!idle_socket;
+}
+
+bool ConnectionPoolImpl::TryReserve(const std::string& key, bool reuse_idle,
+                                    ScopedSocket& idle_socket, SlotHandler on_slot,
+                                    uint64_t& ticket)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto& entry = hosts_[key];
+    if (TakeSlot(entry, reuse_idle, idle_socket)) {
+        return true;
+    }
+
+    ticket = Enqueue(entry, reuse_idle, std::move(on_slot))->ticket;
+    return false;
+}
+
+bool ConnectionPoolImpl::Withdraw(const std::string& key, uint64_t ticket)
+{
+    // Destroyed with the pool unlocked, as the handler may own whoever queued it.
+    std::shared_ptr<SlotWaiter> waiter;
+    std::lock_guard<std::mutex> lock(mutex_);
+    waiter = Dequeue(hosts_[key], ticket);
+    return !!waiter;
+}
+
+bool ConnectionPoolImpl::TakeSlot(HostEntry& entry, bool reuse_idle, ScopedSocket& idle_socket)
+{
+    auto now = Clock::now();
+    while (reuse_idle && !entry.idle.empty()) {
+        auto conn = std::move(entry.idle.back());
+        entry.idle.pop_back();
+        if (now - conn.idle_since < options_.idle_timeout &&
+            IsIdleConnectionAlive(conn.socket.get())) {
+            ++entry.active;
+            ++stats_.hits;
+            idle_socket = std::move(conn.socket);
+            return true;
+        }
+
+        ++stats_.discarded;
+    }
+
+    // Make room by dropping idle connections we were told not to reuse.
+    while (ReachedLimit(entry) && !entry.idle.empty()) {
+        entry.idle.pop_front();
+        ++stats_.discarded;
+    }
+
+    if (ReachedLimit(entry)) {
+        return false;
+    }
+
+    ++entry.active;
+    ++stats_.misses;
+    return true;
+}
+
+std::shared_ptr<ConnectionPoolImpl::SlotWaiter> ConnectionPoolImpl::Enqueue(
+    HostEntry& entry, bool reuse_idle, SlotHandler on_slot)
+{
+    auto waiter = std::make_shared<SlotWaiter>();
+    waiter->ticket = next_ticket_++;
+    waiter->reuse_idle = reuse_idle;
+    waiter->on_slot = std::move(on_slot);
+    waiter->granted = false;
+    entry.waiters.push_back(waiter);
+    return waiter;
+}
+
+std::shared_ptr<ConnectionPoolImpl::SlotWaiter> ConnectionPoolImpl::Dequeue(HostEntry& entry,
+                                                                           uint64_t ticket)
+{
+    auto& waiters = entry.waiters;
+    auto it = std::find_if(waiters.begin(), waiters.end(),
+                           [ticket](const std::shared_ptr<SlotWaiter>& queued) {
+                               return queued->ticket == ticket;
+                           });
+    if (it == waiters.end()) {
+        return nullptr;
+    }
+
+    auto waiter = std::move(*it);
+    waiters.erase(it);
+    return waiter;
+}
+
+bool ConnectionPoolImpl::ReachedLimit(const HostEntry& entry) const noexcept
+{
+    return options_.max_connections_per_host != 0 &&
+           entry.active + entry.idle.size() >= options_.max_connections_per_host;
+}
+
+// -*- AsyncCheckout -*-
+
+AsyncCheckout::AsyncCheckout(std::shared_ptr<ConnectionPool> pool, const Endpoint& endpoint,
+                             bool reuse_idle)
+    : pool_(std::move(pool)),
+      key_(MakePoolKey(endpoint)),
+      host_(endpoint.host),
+      port_(endpoint.port),
+      reuse_idle_(reuse_idle),
+      queued_(false),
+      ticket_(0),
+      holds_slot_(false),
+      cancelled_(false)
+{}
+
+AsyncCheckout::~AsyncCheckout()
+{
+    if (holds_slot_) {
+        ReleaseSlot(ScopedSocket());
+    }
+}
+
+std::unique_ptr<PooledConnection> AsyncCheckout::Start(Callback callback, bool& connecting)
+{
+    callback_ = std::move(callback);
+
+    // Queued checkouts keep themselves alive until they are handed a slot or withdrawn.
+    auto self = shared_from_this();
+    auto on_slot = [self](ScopedSocket idle_socket) {
+        auto socket = std::make_shared<ScopedSocket>(std::move(idle_socket));
+        try {
+            IoLoop::Default().AddTimer(IoLoop::Clock::now(), [self, socket] {
+                self->OnSlot(std::move(*socket));
+            });
+        } catch (...) {
+            self->pool_->impl().Release(self->key_, std::move(*socket), true);
+        }
+    };
+
+    ScopedSocket idle_socket;
+    if (!pool_->impl().TryReserve(key_, reuse_idle_, idle_socket, on_slot, ticket_)) {
+        queued_ = true;
+        return nullptr;
+    }
+
+    holds_slot_ = true;
+    if (idle_socket) {
+        connecting = false;
+        return MakeConnection(std::move(idle_socket), true);
+    }
+
+    try {
+        return Connect(connecting);
+    } catch (...) {
+        ReleaseSlot(ScopedSocket());
+        throw;
+    }
+}
+
+void AsyncCheckout::Cancel() noexcept
+{
+    cancelled_ = true;
+    callback_ = nullptr;
+    if (queued_) {
+        try {
+            // Otherwise the slot is on its way, and is given back once it arrives.
+            queued_ = !pool_->impl().Withdraw(key_, ticket_);
+        } catch (...) {}
+    }
+}
+
+void AsyncCheckout::OnSlot(ScopedSocket idle_socket) noexcept
+{
+    queued_ = false;
+    holds_slot_ = true;
+    if (cancelled_) {
+        ReleaseSlot(std::move(idle_socket));
+        return;
+    }
+
+    try {
+        bool connecting = false;
+        auto connection = idle_socket ? MakeConnection(std::move(idle_socket), true) :
+                                        Connect(connecting);
+        if (connection) {
+            Deliver(std::move(connection), connecting, nullptr);
+        }
+    } catch (...) {
+        ReleaseSlot(ScopedSocket());
+        Deliver(nullptr, false, std::current_exception());
+    }
+}
+
+std::unique_ptr<PooledConnection> AsyncCheckout::Connect(bool& connecting)
+{
+    auto addresses = ResolveNumericHost(host_, port_);
+    if (addresses) {
+        return StartConnect(addresses, connecting);
+    }
+
+    auto self = shared_from_this();
+    ResolveHostDetached(host_, port_, [self](AddressList addresses, std::exception_ptr error) {
+        auto resolved = std::make_shared<AddressList>(std::move(addresses));
+        try {
+            IoLoop::Default().AddTimer(IoLoop::Clock::now(), [self, resolved, error] {
+                self->OnResolved(std::move(*resolved), error);
+            });
+        } catch (...) {}
+    });
+
+    return nullptr;
+}
+
+void AsyncCheckout::OnResolved(AddressList addresses, std::exception_ptr error) noexcept
+{
+    if (cancelled_) {
+        ReleaseSlot(ScopedSocket());
+        return;
+    }
+
+    try {
+        if (error) {
+            std::rethrow_exception(error);
+        }
+
+        bool connecting = false;
+        auto connection = StartConnect(addresses, connecting);
+        Deliver(std::move(connection), connecting, nullptr);
+    } catch (...) {
+        ReleaseSlot(ScopedSocket());
+        Deliver(nullptr, false, std::current_exception());
+    }
+}
+
+std::unique_ptr<PooledConnection> AsyncCheckout::StartConnect(const AddressList& addresses,
+                                                              bool& connecting)
+{
+    return MakeConnection(StartConnectSocket(addresses, host_, port_, connecting), false);
+}
+
+std::unique_ptr<PooledConnection> AsyncCheckout::MakeConnection(ScopedSocket socket, bool reused)
+{
+    auto connection = std::make_unique<PooledConnection>(&pool_->impl(), key_, std::move(socket),
+                                                         reused);
+    holds_slot_ = false;
+    return connection;
+}
+
+void AsyncCheckout::Deliver(std::unique_ptr<PooledConnection> connection, bool connecting,
+                            std::exception_ptr error) noexcept
+{
+    auto callback = std::move(callback_);
+    callback_ = nullptr;
+    if (callback) {
+        callback(std::move(connection), connecting, error);
+    }
+}
+
+void AsyncCheckout::ReleaseSlot(ScopedSocket idle_socket) noexcept
+{
+    if (holds_slot_) {
+        holds_slot_ = false;
+        bool reusable = !!idle_socket;
+        pool_->impl().Release(key_, std::move(idle_socket), reusable);
+    }
+}
+
+}   // namespace internal
+}   // namespace wat
@@ -0,0 +1,241 @@
+/*
+ @ 0xCCCCCCCC
+*/
+
+#if defined(_MSC_VER)
+#pragma once
+#endif
+
+#ifndef WINANT_HTTP_INTERNAL_CONNECTION_POOL_IMPL_H_
+#define WINANT_HTTP_INTERNAL_CONNECTION_POOL_IMPL_H_
+
+#include "winant_http/internal/socket.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#include "kbase/basic_macros.h"
+
+#include "winant_http/winant_connection_pool.h"
+
+namespace wat {
+namespace internal {
+
+class RequestTimer;
+struct Endpoint;
+
+// A connection checked out of a pool.
+// The connection goes back to the pool on destruction if it was marked reusable, and is closed
+// otherwise.
+class PooledConnection {
+public:
+    PooledConnection(ConnectionPoolImpl* pool, std::string key, ScopedSocket socket, bool reused);
+
+    ~PooledConnection();
+
+    DISALLOW_COPY(PooledConnection);
+
+    PooledConnection(PooledConnection&& other) noexcept;
+
+    PooledConnection& operator=(PooledConnection&& other) noexcept;
+
+    SocketHandle get() const noexcept
+    {
+        return socket_.get();
+    }
+
+    // True if the connection had carried requests before this checkout.
+    bool reused() const noexcept
+    {
+        return reused_;
+    }
+
+    void set_reusable(bool reusable) noexcept
+    {
+        reusable_ = reusable;
+    }
+
+private:
+    void ReturnToPool() noexcept;
+
+private:
+    ConnectionPoolImpl* pool_;
+    std::string key_;
+    ScopedSocket socket_;
+    bool reused_;
+    bool reusable_;
+};
+
+class ConnectionPoolImpl {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    // Takes over the slot handed to a queued checkout; `idle_socket` is a connection just
+    // returned to the pool, if it can be reused, and empty otherwise.
+    // Called on the thread that freed the slot, with the pool unlocked; must not throw.
+    using SlotHandler = std::function<void(ScopedSocket idle_socket)>;
+
+    explicit ConnectionPoolImpl(const ConnectionPool::Options& options);
+
+    ~ConnectionPoolImpl() = default;
+
+    DISALLOW_COPY(ConnectionPoolImpl);
+
+    // Checks out a healthy idle connection to the endpoint, or connects a new one.
+    // Pass false for `reuse_idle` to always connect, e.g. to retry after a reused connection
+    // turned out stale.
+    // Blocks if the endpoint has reached its connection limit, until a connection is returned;
+    // waiting checkouts are served in order.
+    // The wait for a connection, the host lookup and connecting are all bounded by `timer`, if
+    // any, which throws a TimeoutError once it runs out.
+    PooledConnection Acquire(const Endpoint& endpoint, bool reuse_idle = true,
+                             RequestTimer* timer = nullptr);
+
+    void Release(const std::string& key, ScopedSocket socket, bool reusable);
+
+    // True if a checkout for the endpoint wouldn't have to wait for a connection to be returned.
+    bool HasFreeSlot(const Endpoint& endpoint) const;
+
+    ConnectionPool::Stats stats() const;
+
+    size_t idle_count() const;
+
+    void CloseIdleConnections();
+
+private:
+    struct IdleConnection {
+        ScopedSocket socket;
+        Clock::time_point idle_since;
+    };
+
+    // A checkout waiting for a connection to be returned.
+    struct SlotWaiter {
+        uint64_t ticket;
+        bool reuse_idle;
+        // Null for a blocked Acquire(), which is woken up instead.
+        SlotHandler on_slot;
+        bool granted;
+        ScopedSocket socket;
+    };
+
+    struct HostEntry {
+        std::deque<IdleConnection> idle;
+        size_t active = 0;
+        // Only non-empty while the limit is reached, with no idle connection left.
+        std::deque<std::shared_ptr<SlotWaiter>> waiters;
+    };
+
+    friend class AsyncCheckout;
+
+    // Takes a slot for a connection to `key`, waiting if the limit was reached, as long as
+    // `timer` allows and the request isn't cancelled.
+    // Returns true with `idle_socket` set if an idle connection was reused; otherwise the caller
+    // is expected to connect.
+    bool Reserve(const std::string& key, bool reuse_idle, ScopedSocket& idle_socket,
+                 const RequestTimer* timer);
+
+    // Does the work of Reserve(), which wakes the wait up when the request is cancelled.
+    bool WaitForSlot(const std::string& key, bool reuse_idle, ScopedSocket& idle_socket,
+                     const RequestTimer* timer);
+
+    // Takes a slot for a connection to `key` as Reserve() does if there is one, and returns true;
+    // otherwise queues `on_slot` under `ticket` for the next connection returned, and returns
+    // false.
+    bool TryReserve(const std::string& key, bool reuse_idle, ScopedSocket& idle_socket,
+                    SlotHandler on_slot, uint64_t& ticket);
+
+    // Takes the queued checkout out of line.
+    // Returns false if it has been handed a slot already, which it is to give back then.
+    bool Withdraw(const std::string& key, uint64_t ticket);
+
+    // Called with the pool locked.
+    bool TakeSlot(HostEntry& entry, bool reuse_idle, ScopedSocket& idle_socket);
+
+    // Called with the pool locked.
+    std::shared_ptr<SlotWaiter> Enqueue(HostEntry& entry, bool reuse_idle, SlotHandler on_slot);
+
+    // Returns null if the waiter isn't in line anymore.
+    // Called with the pool locked.
+    std::shared_ptr<SlotWaiter> Dequeue(HostEntry& entry, uint64_t ticket);
+
+    bool ReachedLimit(const HostEntry& entry) const noexcept;
+
+private:
+    ConnectionPool::Options options_;
+    mutable std::mutex mutex_;
+    std::condition_variable slot_available_;
+    std::unordered_map<std::string, HostEntry> hosts_;
+    uint64_t next_ticket_;
+    ConnectionPool::Stats stats_;
+};
+
+// Checks a connection out of a pool on the I/O loop without ever blocking the loop: a checkout
+// beyond the connection limit waits in line for a connection to be returned, and host names are
+// looked up on threads of their own. A new connection is handed over while it may still be
+// connecting.
+// Used on the loop thread only.
+class AsyncCheckout : public std::enable_shared_from_this<AsyncCheckout> {
+public:
+    // Takes either the connection or the error the checkout failed with; must not throw.
+    using Callback = std::function<void(std::unique_ptr<PooledConnection> connection,
+                                        bool connecting, std::exception_ptr error)>;
+
+    AsyncCheckout(std::shared_ptr<ConnectionPool> pool, const Endpoint& endpoint,
+                  bool reuse_idle);
+
+    // Gives back the slot, if the checkout holds one.
+    ~AsyncCheckout();
+
+    DISALLOW_COPY(AsyncCheckout);
+
+    // Returns the connection if it could be checked out right away; otherwise returns null, and
+    // `callback` is called with the outcome later, from a task of the loop.
+    // Throws if the checkout fails right away.
+    std::unique_ptr<PooledConnection> Start(Callback callback, bool& connecting);
+
+    // The callback isn't called afterwards.
+    void Cancel() noexcept;
+
+private:
+    void OnSlot(ScopedSocket idle_socket) noexcept;
+
+    // Connects right away if the host is an IP address, and looks it up first otherwise.
+    std::unique_ptr<PooledConnection> Connect(bool& connecting);
+
+    void OnResolved(AddressList addresses, std::exception_ptr error) noexcept;
+
+    std::unique_ptr<PooledConnection> StartConnect(const AddressList& addresses,
+                                                   bool& connecting);
+
+    std::unique_ptr<PooledConnection> MakeConnection(ScopedSocket socket, bool reused);
+
+    void Deliver(std::unique_ptr<PooledConnection> connection, bool connecting,
+                 std::exception_ptr error) noexcept;
+
+    void ReleaseSlot(ScopedSocket idle_socket) noexcept;
+
+private:
+    std::shared_ptr<ConnectionPool> pool_;
+    std::string key_;
+    std::string host_;
+    std::string port_;
+    bool reuse_idle_;
+    Callback callback_;
+    bool queued_;
+    uint64_t ticket_;
+    bool holds_slot_;
+    bool cancelled_;
+};
+
+}   // namespace internal
+}   // namespace wat
+
+#endif  // WINANT_HTTP_INTERNAL_CONNECTION_POOL_IMPL_H_
@@ -0,0 +1,326 @@
+/*
+ @ 0xCCCCCCCC
+*/
+
+#include "winant_http/internal/content_decoder.h"
+
+#include <algorithm>
+#include <cctype>
+#include <string>
+
+#include "kbase/error_exception_util.h"
+
+#if defined(WINANT_HTTP_USE_ZLIB)
+#include "zlib.h"
+#endif
+
+#if defined(WINANT_HTTP_USE_BROTLI)
+#include "brotli/decode.h"
+#endif
+
+#include "winant_http/winant_request.h"
+
+namespace {
+
+using wat::internal::ContentDecoder;
+
+#if defined(WINANT_HTTP_USE_ZLIB) || defined(WINANT_HTTP_USE_BROTLI)
+
+constexpr size_t kOutputChunkSize = 16 * 1024;
+
+bool EqualsIgnoreCase(kbase::StringView str, kbase::StringView lower) noexcept
+{
+    if (str.size() != lower.size()) {
+        return false;
+    }
+
+    for (size_t i = 0; i < str.size(); ++i) {
+        if (std::tolower(static_cast<unsigned char>(str[i])) != lower[i]) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+kbase::StringView TrimWhitespace(kbase::StringView str) noexcept
+{
+    while (!str.empty() && (str.front() == ' ' || str.front() == '\t')) {
+        str.remove_prefix(1);
+    }
+
+    while (!str.empty() && (str.back() == ' ' || str.back() == '\t')) {
+        str.remove_suffix(1);
+    }
+
+    return str;
+}
+
+#endif
+
+#if defined(WINANT_HTTP_USE_ZLIB)
+
+class ZlibDecoder : public ContentDecoder {
+public:
+    enum class Format {
+        Gzip,
+        // RFC 1950 zlib data as the spec says, or raw RFC 1951 deflate data as some servers send;
+        // told apart by the first two bytes.
+        Deflate
+    };
+
+    explicit ZlibDecoder(Format format)
+        : format_(format), initialized_(false), stream_end_(false), consumed_any_(false),
+          stream_()
+    {
+        if (format_ == Format::Gzip) {
+            Init(MAX_WBITS + 16);
+        }
+    }
+
+    ~ZlibDecoder()
+    {
+        if (initialized_) {
+            inflateEnd(&stream_);
+        }
+    }
+
+    DISALLOW_COPY(ZlibDecoder);
+
+    DISALLOW_MOVE(ZlibDecoder);
+
+    void Decode(const char* data, size_t size, const OutputHandler& on_output) override
+    {
+        if (!initialized_) {
+            // Wait for the header of deflate data.
+            header_.append(data, size);
+            if (header_.size() < 2) {
+                return;
+            }
+
+            auto cmf = static_cast<unsigned char>(header_[0]);
+            auto flg = static_cast<unsigned char>(header_[1]);
+            bool zlib_wrapped = (cmf & 0x0F) == Z_DEFLATED && (cmf * 256 + flg) % 31 == 0;
+            Init(zlib_wrapped ? MAX_WBITS : -MAX_WBITS);
+
+            std::string header;
+            header.swap(header_);
+            Inflate(header.data(), header.size(), on_output);
+            return;
+        }
+
+        Inflate(data, size, on_output);
+    }
+
+    void Finish() override
+    {
+        ENSURE(THROW, stream_end_ || (!consumed_any_ && header_.empty()))
+            (stream_.total_in)(header_.size()).Require();
+    }
+
+private:
+    void Init(int window_bits)
+    {
+        auto rv = inflateInit2(&stream_, window_bits);
+        ENSURE(THROW, rv == Z_OK)(rv).Require();
+        initialized_ = true;
+    }
+
+    void Inflate(const char* data, size_t size, const OutputHandler& on_output)
+    {
+        char out[kOutputChunkSize];
+        while (size > 0) {
+            // Anything after the end of the data is ignored, except for further gzip members.
+            if (stream_end_) {
+                if (format_ != Format::Gzip) {
+                    return;
+                }
+
+                inflateReset(&stream_);
+                stream_end_ = false;
+            }
+
+            consumed_any_ = true;
+            auto chunk = static_cast<uInt>(std::min<size_t>(size, 1U << 30));
+            stream_.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data));
+            stream_.avail_in = chunk;
+
+            do {
+                stream_.next_out = reinterpret_cast<Bytef*>(out);
+                stream_.avail_out = sizeof(out);
+                auto rv = inflate(&stream_, Z_NO_FLUSH);
+                ENSURE(THROW, rv == Z_OK || rv == Z_STREAM_END || rv == Z_BUF_ERROR)
+                    (rv)(stream_.msg ? stream_.msg : "").Require();
+
+                auto produced = sizeof(out) - stream_.avail_out;
+                if (produced > 0) {
+                    on_output(out, produced);
+                }
+
+                if (rv == Z_STREAM_END) {
+                    stream_end_ = true;
+                    break;
+                }
+            } while (stream_.avail_out == 0 || stream_.avail_in > 0);
+
+            auto consumed = chunk - stream_.avail_in;
+            data += consumed;
+            size -= consumed;
+        }
+    }
+
+private:
+    Format format_;
+    bool initialized_;
+    bool stream_end_;
+    bool consumed_any_;
+    std::string header_;
+    z_stream stream_;
+};
+
+#endif  // WINANT_HTTP_USE_ZLIB
+
+#if defined(WINANT_HTTP_USE_BROTLI)
+
+class BrotliDecoder : public ContentDecoder {
+public:
+    BrotliDecoder()
+        : state_(BrotliDecoderCreateInstance(nullptr, nullptr, nullptr)),
+          result_(BROTLI_DECODER_RESULT_NEEDS_MORE_INPUT),
+          consumed_any_(false)
+    {
+        ENSURE(THROW, state_ != nullptr).Require();
+    }
+
+    ~BrotliDecoder()
+    {
+        BrotliDecoderDestroyInstance(state_);
+    }
+
+    DISALLOW_COPY(BrotliDecoder);
+
+    DISALLOW_MOVE(BrotliDecoder);
+
+    void Decode(const char* data, size_t size, const OutputHandler& on_output) override
+    {
+        if (result_ == BROTLI_DECODER_RESULT_SUCCESS || size == 0) {
+            return;
+        }
+
+        consumed_any_ = true;
+        auto next_in = reinterpret_cast<const uint8_t*>(data);
+        size_t avail_in = size;
+        char out[kOutputChunkSize];
+        do {
+            auto next_out = reinterpret_cast<uint8_t*>(out);
+            size_t avail_out = sizeof(out);
+            result_ = BrotliDecoderDecompressStream(state_, &avail_in, &next_in, &avail_out,
+                                                    &next_out, nullptr);
+            ENSURE(THROW, result_ != BROTLI_DECODER_RESULT_ERROR)
+                (BrotliDecoderErrorString(BrotliDecoderGetErrorCode(state_))).Require();
+
+            auto produced = sizeof(out) - avail_out;
+            if (produced > 0) {
+                on_output(out, produced);
+            }
+        } while (result_ == BROTLI_DECODER_RESULT_NEEDS_MORE_OUTPUT);
+    }
+
+    void Finish() override
+    {
+        ENSURE(THROW, result_ == BROTLI_DECODER_RESULT_SUCCESS || !consumed_any_)
+            (result_).Require();
+    }
+
+private:
+    BrotliDecoderState* state_;
+    BrotliDecoderResult result_;
+    bool consumed_any_;
+};
+
+#endif  // WINANT_HTTP_USE_BROTLI
+
+}   // namespace
+
+namespace wat {
+namespace internal {
+
+// static
+const char* ContentDecoder::AcceptEncoding() noexcept
+{
+#if defined(WINANT_HTTP_USE_ZLIB) && defined(WINANT_HTTP_USE_BROTLI)
+    return "gzip, deflate, br";
+#elif defined(WINANT_HTTP_USE_ZLIB)
+    return "gzip, deflate";
+#elif defined(WINANT_HTTP_USE_BROTLI)
+    return "br";
+#else
+    return "";
+#endif
+}
+
+// static
+std::unique_ptr<ContentDecoder> ContentDecoder::Create(kbase::StringView content_encoding)
+{
+#if defined(WINANT_HTTP_USE_ZLIB) || defined(WINANT_HTTP_USE_BROTLI)
+    auto coding = TrimWhitespace(content_encoding);
+#endif
+
+#if defined(WINANT_HTTP_USE_ZLIB)
+    if (EqualsIgnoreCase(coding, "gzip") || EqualsIgnoreCase(coding, "x-gzip")) {
+        return std::make_unique<ZlibDecoder>(ZlibDecoder::Format::Gzip);
+    }
+
+    if (EqualsIgnoreCase(coding, "deflate")) {
+        return std::make_unique<ZlibDecoder>(ZlibDecoder::Format::Deflate);
+    }
+#endif
+
+#if defined(WINANT_HTTP_USE_BROTLI)
+    if (EqualsIgnoreCase(coding, "br")) {
+        return std::make_unique<BrotliDecoder>();
+    }
+#endif
+
+    UNREFED_VAR(content_encoding);
+    return nullptr;
+}
+
+bool DecodesContent(const HttpRequest& request)
+{
+    return *ContentDecoder::AcceptEncoding() != '\0' &&
+           !(request.load_flags().flags & LoadFlags::DoNotDecodeResponse) &&
+           !request.headers().HasHeader(Headers::Known::AcceptEncoding);
+}
+
+ResponseBodyDecoder::ResponseBodyDecoder(const HttpRequest& request)
+    : enabled_(DecodesContent(request)), started_(false)
+{}
+
+void ResponseBodyDecoder::Feed(const Headers& headers, const char* data, size_t size,
+                               const ContentDecoder::OutputHandler& on_output)
+{
+    if (!started_) {
+        started_ = true;
+        kbase::StringView content_encoding;
+        if (enabled_ && headers.GetHeader(Headers::Known::ContentEncoding, content_encoding)) {
+            decoder_ = ContentDecoder::Create(content_encoding);
+        }
+    }
+
+    if (decoder_) {
+        decoder_->Decode(data, size, on_output);
+    } else {
+        on_output(data, size);
+    }
+}
+
+void ResponseBodyDecoder::Finish()
+{
+    if (decoder_) {
+        decoder_->Finish();
+    }
+}
+
+}   // namespace internal
+}   // namespace wat
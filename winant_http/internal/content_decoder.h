@@ -0,0 +1,84 @@
+/*
+ @ 0xCCCCCCCC
+*/
+
+#if defined(_MSC_VER)
+#pragma once
+#endif
+
+#ifndef WINANT_HTTP_INTERNAL_CONTENT_DECODER_H_
+#define WINANT_HTTP_INTERNAL_CONTENT_DECODER_H_
+
+#include <cstddef>
+#include <functional>
+#include <memory>
+
+#include "kbase/basic_macros.h"
+#include "kbase/string_view.h"
+
+#include "winant_http/winant_common_types.h"
+
+namespace wat {
+
+class HttpRequest;
+
+namespace internal {
+
+// Incrementally decodes a response body in a content coding.
+// gzip and deflate are available when built with WINANT_HTTP_USE_ZLIB, and br when built with
+// WINANT_HTTP_USE_BROTLI.
+class ContentDecoder {
+public:
+    using OutputHandler = std::function<void(const char* data, size_t size)>;
+
+    virtual ~ContentDecoder() = default;
+
+    // The codings available, as the value of an Accept-Encoding header; empty if none is.
+    static const char* AcceptEncoding() noexcept;
+
+    // Returns nullptr if `content_encoding` is not a single coding that is available.
+    static std::unique_ptr<ContentDecoder> Create(kbase::StringView content_encoding);
+
+    // Decoded data may be handed to `on_output` in several pieces, or not at all if more input
+    // is needed.
+    // Throws if the data is corrupted.
+    virtual void Decode(const char* data, size_t size, const OutputHandler& on_output) = 0;
+
+    // Throws if the encoded data ended prematurely.
+    virtual void Finish() = 0;
+};
+
+// True if the transport asks for encoded content on behalf of the request, and decodes the
+// response body itself.
+// The caller might have asked for some codings itself, in which case the body is left as it is.
+bool DecodesContent(const HttpRequest& request);
+
+// Passes body data of a response through a ContentDecoder, if the body is to be decoded and its
+// coding is available, or else hands it over as it is.
+class ResponseBodyDecoder {
+public:
+    explicit ResponseBodyDecoder(const HttpRequest& request);
+
+    ~ResponseBodyDecoder() = default;
+
+    DISALLOW_COPY(ResponseBodyDecoder);
+
+    DEFAULT_MOVE(ResponseBodyDecoder);
+
+    // `headers` are those of the response, and are looked at only on the first call.
+    void Feed(const Headers& headers, const char* data, size_t size,
+              const ContentDecoder::OutputHandler& on_output);
+
+    // Throws if the encoded body ended prematurely.
+    void Finish();
+
+private:
+    bool enabled_;
+    bool started_;
+    std::unique_ptr<ContentDecoder> decoder_;
+};
+
+}   // namespace internal
+}   // namespace wat
+
+#endif  // WINANT_HTTP_INTERNAL_CONTENT_DECODER_H_
@@ -0,0 +1,221 @@
+/*
+ @ 0xCCCCCCCC
+*/
+
+#include "winant_http/internal/file_util.h"
+
+#include <limits>
+#include <utility>
+
+#if defined(_WIN32)
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "kbase/error_exception_util.h"
+
+#if defined(_WIN32)
+#include "kbase/scoped_handle.h"
+#include "kbase/string_encoding_conversions.h"
+#endif
+
+namespace {
+
+// Offsets of a mapping must be aligned to this.
+uint64_t MappingGranularity()
+{
+#if defined(_WIN32)
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return info.dwAllocationGranularity;
+#else
+    return static_cast<uint64_t>(sysconf(_SC_PAGESIZE));
+#endif
+}
+
+}   // namespace
+
+namespace wat {
+namespace internal {
+
+std::ifstream OpenFileForRead(const std::string& path)
+{
+#if defined(_WIN32)
+    std::ifstream file(kbase::UTF8ToWide(path), std::ios::binary);
+#else
+    std::ifstream file(path, std::ios::binary);
+#endif
+    ENSURE(THROW, file.is_open())(path).Require();
+    return file;
+}
+
+std::ofstream OpenFileForWrite(const std::string& path)
+{
+#if defined(_WIN32)
+    std::ofstream file(kbase::UTF8ToWide(path), std::ios::binary | std::ios::trunc);
+#else
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+#endif
+    ENSURE(THROW, file.is_open())(path).Require();
+    return file;
+}
+
+bool RemoveFile(const std::string& path) noexcept
+{
+#if defined(_WIN32)
+    try {
+        return DeleteFileW(kbase::UTF8ToWide(path).c_str()) != FALSE;
+    } catch (...) {
+        return false;
+    }
+#else
+    return unlink(path.c_str()) == 0;
+#endif
+}
+
+uint64_t GetFileSize(const std::string& path)
+{
+    auto file = OpenFileForRead(path);
+    file.seekg(0, std::ios::end);
+    auto size = static_cast<int64_t>(file.tellg());
+    ENSURE(THROW, size >= 0)(path).Require();
+    return static_cast<uint64_t>(size);
+}
+
+// -*- MappedFile -*-
+
+MappedFile::MappedFile() noexcept
+    : view_(nullptr), view_size_(0), data_(nullptr), size_(0)
+{}
+
+MappedFile::~MappedFile()
+{
+    Unmap();
+}
+
+MappedFile::MappedFile(MappedFile&& other) noexcept
+    : view_(other.view_), view_size_(other.view_size_), data_(other.data_), size_(other.size_)
+{
+    other.view_ = nullptr;
+    other.view_size_ = 0;
+    other.data_ = nullptr;
+    other.size_ = 0;
+}
+
+MappedFile& MappedFile::operator=(MappedFile&& other) noexcept
+{
+    if (this != &other) {
+        Unmap();
+        std::swap(view_, other.view_);
+        std::swap(view_size_, other.view_size_);
+        std::swap(data_, other.data_);
+        std::swap(size_, other.size_);
+    }
+
+    return *this;
+}
+
+bool MappedFile::Map(const std::string& path, uint64_t offset, uint64_t length)
+{
+    Unmap();
+
+    if (length == 0) {
+        return false;
+    }
+
+    static const uint64_t granularity = MappingGranularity();
+    auto view_offset = offset - offset % granularity;
+    auto delta = offset - view_offset;
+    if (length > std::numeric_limits<size_t>::max() - delta) {
+        return false;
+    }
+
+    auto view_size = static_cast<size_t>(delta + length);
+
+#if defined(_WIN32)
+    kbase::ScopedWinHandle file(CreateFileW(kbase::UTF8ToWide(path).c_str(),
+                                            GENERIC_READ,
+                                            FILE_SHARE_READ,
+                                            nullptr,
+                                            OPEN_EXISTING,
+                                            FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN,
+                                            nullptr));
+    if (!file) {
+        return false;
+    }
+
+    // Mapping beyond the end of the file would grow it.
+    LARGE_INTEGER file_size;
+    if (!GetFileSizeEx(file.get(), &file_size) ||
+        static_cast<uint64_t>(file_size.QuadPart) < offset + length) {
+        return false;
+    }
+
+    kbase::ScopedWinHandle mapping(CreateFileMappingW(file.get(), nullptr, PAGE_READONLY,
+                                                      0, 0, nullptr));
+    if (!mapping) {
+        return false;
+    }
+
+    auto view = MapViewOfFile(mapping.get(), FILE_MAP_READ,
+                              static_cast<DWORD>(view_offset >> 32),
+                              static_cast<DWORD>(view_offset & 0xFFFFFFFF),
+                              view_size);
+    if (!view) {
+        return false;
+    }
+#else
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return false;
+    }
+
+    // Touching pages beyond the end of the file raises SIGBUS.
+    struct stat file_stat;
+    if (fstat(fd, &file_stat) != 0 || static_cast<uint64_t>(file_stat.st_size) < offset + length) {
+        close(fd);
+        return false;
+    }
+
+    auto view = mmap(nullptr, view_size, PROT_READ, MAP_PRIVATE, fd,
+                     static_cast<off_t>(view_offset));
+    close(fd);
+    if (view == MAP_FAILED) {
+        return false;
+    }
+
+    madvise(view, view_size, MADV_SEQUENTIAL);
+#endif
+
+    view_ = view;
+    view_size_ = view_size;
+    data_ = static_cast<const char*>(view) + delta;
+    size_ = static_cast<size_t>(length);
+
+    return true;
+}
+
+void MappedFile::Unmap() noexcept
+{
+    if (!view_) {
+        return;
+    }
+
+#if defined(_WIN32)
+    UnmapViewOfFile(view_);
+#else
+    munmap(view_, view_size_);
+#endif
+
+    view_ = nullptr;
+    view_size_ = 0;
+    data_ = nullptr;
+    size_ = 0;
+}
+
+}   // namespace internal
+}   // namespace wat
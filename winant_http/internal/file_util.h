@@ -0,0 +1,78 @@
+/*
+ @ 0xCCCCCCCC
+*/
+
+#if defined(_MSC_VER)
+#pragma once
+#endif
+
+#ifndef WINANT_HTTP_INTERNAL_FILE_UTIL_H_
+#define WINANT_HTTP_INTERNAL_FILE_UTIL_H_
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+
+#include "kbase/basic_macros.h"
+
+namespace wat {
+namespace internal {
+
+// `path` is in UTF-8. Throws if the file can't be opened.
+std::ifstream OpenFileForRead(const std::string& path);
+
+// `path` is in UTF-8. Truncates an existing file. Throws if the file can't be opened.
+std::ofstream OpenFileForWrite(const std::string& path);
+
+// Returns false if the file doesn't exist or can't be removed.
+bool RemoveFile(const std::string& path) noexcept;
+
+// Throws if the file can't be opened.
+uint64_t GetFileSize(const std::string& path);
+
+// A read-only view of a file range mapped into memory.
+class MappedFile {
+public:
+    MappedFile() noexcept;
+
+    ~MappedFile();
+
+    DISALLOW_COPY(MappedFile);
+
+    MappedFile(MappedFile&& other) noexcept;
+
+    MappedFile& operator=(MappedFile&& other) noexcept;
+
+    // Maps [offset, offset + length) of the file at `path`.
+    // Returns false if the file can't be opened or the range can't be mapped, e.g. it is beyond
+    // the end of the file or doesn't fit in the address space; callers then fall back to reading.
+    bool Map(const std::string& path, uint64_t offset, uint64_t length);
+
+    void Unmap() noexcept;
+
+    bool mapped() const noexcept
+    {
+        return data_ != nullptr;
+    }
+
+    const char* data() const noexcept
+    {
+        return data_;
+    }
+
+    size_t size() const noexcept
+    {
+        return size_;
+    }
+
+private:
+    void* view_;
+    size_t view_size_;
+    const char* data_;
+    size_t size_;
+};
+
+}   // namespace internal
+}   // namespace wat
+
+#endif  // WINANT_HTTP_INTERNAL_FILE_UTIL_H_
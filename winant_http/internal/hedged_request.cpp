@@ -0,0 +1,231 @@
+/*
+ @ 0xCCCCCCCC
+*/
+
+#include "winant_http/internal/hedged_request.h"
+
+#include <algorithm>
+#include <chrono>
+#include <future>
+#include <utility>
+
+#include "winant_http/internal/connection_pool_impl.h"
+#include "winant_http/internal/socket_transport.h"
+#include "winant_http/winant_response.h"
+
+namespace {
+
+using wat::HttpRequest;
+
+// Attempts are neither cached, retried nor handled on their own; the request as a whole is.
+HttpRequest MakeAttempt(const HttpRequest& request, const wat::Url& url)
+{
+    HttpRequest attempt(request.method(), url);
+    attempt.SetLoadFlags(request.load_flags());
+    attempt.SetHeaders(request.headers());
+    attempt.SetConnectionPool(request.connection_pool());
+    attempt.SetBufferPool(request.buffer_pool());
+    attempt.SetReadBufferSize(request.read_buffer_size());
+    attempt.SetTimeouts(request.timeouts());
+    attempt.SetHedgePolicy(request.hedge_policy());
+    if (request.cancellation_token()) {
+        attempt.SetCancellationToken(*request.cancellation_token());
+    }
+
+    return attempt;
+}
+
+wat::Url HedgeUrl(const HttpRequest& request)
+{
+    const auto& url = request.url();
+    const auto& host = request.hedge_policy()->alternate_host;
+    if (host.empty()) {
+        return url;
+    }
+
+    return wat::Url(url.scheme().ToString() + "://" + host + url.path_and_query().ToString());
+}
+
+}   // namespace
+
+namespace wat {
+namespace internal {
+
+bool CanHedgeRequest(const HttpRequest& request)
+{
+    return request.hedge_policy() &&
+           request.method() == HttpRequest::Method::Get &&
+           request.body().empty() &&
+           !request.read_response_handler() &&
+           UsesNativeTransport(request);
+}
+
+// -*- HedgedRequest -*-
+
+constexpr size_t HedgedRequest::kAttemptCount;
+
+HedgedRequest::HedgedRequest(HttpRequest request, std::shared_ptr<AsyncCompletion> completion)
+    : request_(std::move(request)),
+      completion_(std::move(completion)),
+      tracker_(request_.hedge_policy()->tracker ? request_.hedge_policy()->tracker :
+                                                  HedgeTracker::Default()),
+      running_ {false, false},
+      pending_(0),
+      headers_received_(false),
+      done_(false)
+{}
+
+void HedgedRequest::Start()
+{
+    tracker_->OnRequest();
+
+    auto self = shared_from_this();
+    IoLoop::Default().AddTimer(IoLoop::Clock::now(), [self] {
+        self->StartAttempt(0);
+
+        const auto& policy = *self->request_.hedge_policy();
+        std::chrono::milliseconds delay;
+        if (!self->tracker_->Percentile(policy.percentile, policy.min_samples, delay)) {
+            delay = policy.initial_delay;
+        }
+
+        delay = std::max(delay, policy.min_delay);
+        try {
+            IoLoop::Default().AddTimer(self->start_times_[0] + delay, [self] {
+                self->SendHedge();
+            });
+        } catch (...) {}
+    });
+}
+
+void HedgedRequest::StartAttempt(size_t index)
+{
+    ++pending_;
+    running_[index] = true;
+    start_times_[index] = IoLoop::Clock::now();
+
+    try {
+        // The cycle is broken once the attempt ends.
+        auto self = shared_from_this();
+        auto attempt = std::make_shared<AsyncCompletion>(
+            CompletionHandler(),
+            [self, index](HttpResponse* response, std::exception_ptr error) {
+                self->OnResult(index, response, error);
+            });
+        attempt->SetHeadersHandler([self, index] {
+            self->OnHeaders(index);
+        });
+
+        attempts_[index] = attempt;
+        auto url = index == 0 ? request_.url() : HedgeUrl(request_);
+        StartAsyncExchange(MakeAttempt(request_, url), std::move(attempt));
+    } catch (...) {
+        OnResult(index, nullptr, std::current_exception());
+    }
+}
+
+void HedgedRequest::SendHedge()
+{
+    const auto* token = request_.cancellation_token();
+    if (done_ || headers_received_ || (token && token->cancelled())) {
+        return;
+    }
+
+    // A hedge that had to wait for a connection wouldn't get ahead of the request, and would
+    // hold up other requests to the host.
+    try {
+        const auto& pool = request_.connection_pool() ? request_.connection_pool() :
+                                                        ConnectionPool::Default();
+        if (!pool->impl().HasFreeSlot(GetEndpoint(HedgeUrl(request_)))) {
+            return;
+        }
+    } catch (...) {
+        return;
+    }
+
+    tracker_->OnHedge();
+    StartAttempt(1);
+}
+
+void HedgedRequest::OnHeaders(size_t index)
+{
+    if (done_) {
+        return;
+    }
+
+    headers_received_ = true;
+    tracker_->Record(std::chrono::duration_cast<std::chrono::milliseconds>(
+        IoLoop::Clock::now() - start_times_[index]));
+}
+
+void HedgedRequest::OnResult(size_t index, HttpResponse* response, std::exception_ptr error)
+{
+    // An attempt whose exchange failed to start may end twice.
+    if (!running_[index]) {
+        return;
+    }
+
+    running_[index] = false;
+    attempts_[index].reset();
+    --pending_;
+    if (done_) {
+        return;
+    }
+
+    if (response) {
+        done_ = true;
+        for (auto& attempt : attempts_) {
+            if (attempt) {
+                attempt->Abandon();
+            }
+        }
+
+        if (index != 0) {
+            tracker_->OnHedgeWon();
+        }
+
+        if (!completion_->RetryLater(request_, response, nullptr)) {
+            completion_->Succeed(std::move(*response));
+        }
+
+        return;
+    }
+
+    if (!first_error_) {
+        first_error_ = error;
+    }
+
+    // Waits for the other attempt, if it was sent.
+    if (pending_ > 0) {
+        return;
+    }
+
+    done_ = true;
+    if (!completion_->RetryLater(request_, nullptr, first_error_)) {
+        completion_->Fail(first_error_);
+    }
+}
+
+// -*- HedgingTransport -*-
+
+HttpResponse HedgingTransport::Send(const HttpRequest& request)
+{
+    auto promise = std::make_shared<std::promise<HttpResponse>>();
+    auto future = promise->get_future();
+    auto completion = std::make_shared<AsyncCompletion>(
+        CompletionHandler(),
+        [promise](HttpResponse* response, std::exception_ptr error) {
+            if (response) {
+                promise->set_value(std::move(*response));
+            } else {
+                promise->set_exception(error);
+            }
+        });
+
+    std::make_shared<HedgedRequest>(MakeAttempt(request, request.url()),
+                                    std::move(completion))->Start();
+    return future.get();
+}
+
+}   // namespace internal
+}   // namespace wat
@@ -0,0 +1,84 @@
+/*
+ @ 0xCCCCCCCC
+*/
+
+#if defined(_MSC_VER)
+#pragma once
+#endif
+
+#ifndef WINANT_HTTP_INTERNAL_HEDGED_REQUEST_H_
+#define WINANT_HTTP_INTERNAL_HEDGED_REQUEST_H_
+
+#include <exception>
+#include <memory>
+
+#include "kbase/basic_macros.h"
+
+#include "winant_http/internal/async_exchange.h"
+#include "winant_http/internal/http_transport.h"
+#include "winant_http/internal/io_loop.h"
+#include "winant_http/winant_hedge_policy.h"
+#include "winant_http/winant_request.h"
+
+namespace wat {
+namespace internal {
+
+// True if the request has a hedge policy that applies to it.
+bool CanHedgeRequest(const HttpRequest& request);
+
+// Races the attempts of a hedged request on the I/O loop: the request goes out first, and the
+// hedge once the request has gone without response headers for the hedging delay. The first
+// attempt to complete with a response is delivered, and the other one is abandoned; the request
+// fails once every attempt sent has failed.
+class HedgedRequest : public std::enable_shared_from_this<HedgedRequest> {
+public:
+    HedgedRequest(HttpRequest request, std::shared_ptr<AsyncCompletion> completion);
+
+    ~HedgedRequest() = default;
+
+    DISALLOW_COPY(HedgedRequest);
+
+    // Thread-safe; the attempts are carried out on the loop thread.
+    void Start();
+
+private:
+    void StartAttempt(size_t index);
+
+    void SendHedge();
+
+    void OnHeaders(size_t index);
+
+    void OnResult(size_t index, HttpResponse* response, std::exception_ptr error);
+
+private:
+    static constexpr size_t kAttemptCount = 2;
+
+    HttpRequest request_;
+    std::shared_ptr<AsyncCompletion> completion_;
+    std::shared_ptr<HedgeTracker> tracker_;
+    std::shared_ptr<AsyncCompletion> attempts_[kAttemptCount];
+    bool running_[kAttemptCount];
+    IoLoop::Clock::time_point start_times_[kAttemptCount];
+    size_t pending_;
+    bool headers_received_;
+    bool done_;
+    std::exception_ptr first_error_;
+};
+
+// Carries hedged requests out on the I/O loop, waiting on the calling thread for the outcome;
+// thus it must not be used on the loop thread.
+class HedgingTransport : public HttpTransport {
+public:
+    HedgingTransport() = default;
+
+    ~HedgingTransport() = default;
+
+    DISALLOW_COPY(HedgingTransport);
+
+    HttpResponse Send(const HttpRequest& request) override;
+};
+
+}   // namespace internal
+}   // namespace wat
+
+#endif  // WINANT_HTTP_INTERNAL_HEDGED_REQUEST_H_
@@ -0,0 +1,104 @@
+/*
+ @ 0xCCCCCCCC
+*/
+
+#include "winant_http/internal/host_resolver.h"
+
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+
+#include "winant_http/internal/request_timer.h"
+
+namespace wat {
+namespace internal {
+
+void ResolveHostDetached(const std::string& host, const std::string& port,
+                         ResolveHandler on_resolved, HostLookup look_up)
+{
+    std::thread([host, port, on_resolved, look_up] {
+        AddressList addresses;
+        std::exception_ptr error;
+        try {
+            addresses = look_up(host, port);
+        } catch (...) {
+            error = std::current_exception();
+        }
+
+        on_resolved(std::move(addresses), error);
+    }).detach();
+}
+
+AddressList ResolveHostWithin(const std::string& host, const std::string& port,
+                              const RequestTimer* timer, HostLookup look_up)
+{
+    auto addresses = ResolveNumericHost(host, port);
+    if (addresses) {
+        return addresses;
+    }
+
+    auto deadline = timer ? timer->deadline() : RequestTimer::Clock::time_point::max();
+    if (deadline == RequestTimer::Clock::time_point::max()) {
+        return look_up(host, port);
+    }
+
+    struct Lookup {
+        std::mutex mutex;
+        std::condition_variable done_cv;
+        bool done = false;
+        AddressList addresses;
+        std::exception_ptr error;
+    };
+
+    auto lookup = std::make_shared<Lookup>();
+    ResolveHostDetached(host, port, [lookup](AddressList addresses, std::exception_ptr error) {
+        {
+            std::lock_guard<std::mutex> lock(lookup->mutex);
+            lookup->addresses = std::move(addresses);
+            lookup->error = error;
+            lookup->done = true;
+        }
+
+        lookup->done_cv.notify_all();
+    }, std::move(look_up));
+
+    // The token runs the callback under its own lock, so the lookup isn't locked while the
+    // callback is added or removed.
+    auto token = timer->token();
+    uint64_t cancel_callback = 0;
+    if (token) {
+        cancel_callback = token->AddCallback([lookup] {
+            std::lock_guard<std::mutex> lock(lookup->mutex);
+            lookup->done_cv.notify_all();
+        });
+    }
+
+    bool done = false;
+    {
+        std::unique_lock<std::mutex> lock(lookup->mutex);
+        lookup->done_cv.wait_until(lock, deadline, [&lookup, token] {
+            return lookup->done || (token && token->cancelled());
+        });
+        done = lookup->done;
+    }
+
+    if (token) {
+        token->RemoveCallback(cancel_callback);
+    }
+
+    if (!done) {
+        timer->CheckCancelled();
+        throw timer->Expired();
+    }
+
+    if (lookup->error) {
+        std::rethrow_exception(lookup->error);
+    }
+
+    return std::move(lookup->addresses);
+}
+
+}   // namespace internal
+}   // namespace wat
@@ -0,0 +1,44 @@
+/*
+ @ 0xCCCCCCCC
+*/
+
+#if defined(_MSC_VER)
+#pragma once
+#endif
+
+#ifndef WINANT_HTTP_INTERNAL_HOST_RESOLVER_H_
+#define WINANT_HTTP_INTERNAL_HOST_RESOLVER_H_
+
+#include <exception>
+#include <functional>
+#include <string>
+
+#include "winant_http/internal/socket.h"
+
+namespace wat {
+namespace internal {
+
+class RequestTimer;
+
+// Resolves a host as ResolveHost() does, which is what it is unless tests stand in for it.
+using HostLookup = std::function<AddressList(const std::string& host, const std::string& port)>;
+
+// Takes either the addresses or the error the lookup failed with; must not throw.
+using ResolveHandler = std::function<void(AddressList addresses, std::exception_ptr error)>;
+
+// Looks `host` up on a thread of its own, and calls `on_resolved` from that thread.
+// Every lookup gets its own thread, as one that hangs would otherwise hold up the lookups queued
+// behind it, for hosts whose names resolve just fine.
+void ResolveHostDetached(const std::string& host, const std::string& port,
+                         ResolveHandler on_resolved, HostLookup look_up = ResolveHost);
+
+// Resolves `host` in place, unless `timer` bounds the request: then the name is looked up as
+// above, and given up on once the timer runs out or the request is cancelled, while the lookup
+// itself goes on regardless.
+AddressList ResolveHostWithin(const std::string& host, const std::string& port,
+                              const RequestTimer* timer, HostLookup look_up = ResolveHost);
+
+}   // namespace internal
+}   // namespace wat
+
+#endif  // WINANT_HTTP_INTERNAL_HOST_RESOLVER_H_
@@ -0,0 +1,911 @@
+/*
+ @ 0xCCCCCCCC
+*/
+
+#include "winant_http/internal/http_cache_impl.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdint>
+#include <iterator>
+
+#include "kbase/error_exception_util.h"
+
+#include "winant_http/internal/content_decoder.h"
+#include "winant_http/internal/file_util.h"
+#include "winant_http/winant_request.h"
+
+namespace {
+
+using wat::Headers;
+using wat::HttpCache;
+using wat::HttpRequest;
+using wat::HttpResponse;
+using wat::Url;
+using wat::internal::CacheClock;
+using wat::internal::CacheEntry;
+using wat::internal::VaryHeaders;
+
+constexpr char kDiskFileMagic[] = "WATCACHE 1";
+
+// The upper bound of a freshness lifetime guessed from Last-Modified.
+constexpr auto kMaxHeuristicLifetime = std::chrono::hours(24);
+
+// Responses of these statuses are stored, and may be given a heuristic freshness lifetime as
+// RFC 7231, section 6.1 allows.
+constexpr int kCacheableStatuses[] {200, 203, 204, 300, 301, 308, 404, 405, 410, 414, 501};
+
+// Headers of a 304 response that don't replace those stored, as they describe the message
+// rather than the stored response.
+constexpr const char* kNotUpdatedHeaders[] {
+    "Connection", "Content-Encoding", "Content-Length", "Keep-Alive", "Transfer-Encoding"
+};
+
+constexpr const char* kMonthNames[] {
+    "jan", "feb", "mar", "apr", "may", "jun", "jul", "aug", "sep", "oct", "nov", "dec"
+};
+
+char ToLowerASCII(char ch) noexcept
+{
+    return static_cast<char>(std::tolower(static_cast<unsigned char>(ch)));
+}
+
+std::string ToLower(kbase::StringView str)
+{
+    std::string lower;
+    lower.reserve(str.size());
+    std::transform(str.begin(), str.end(), std::back_inserter(lower), ToLowerASCII);
+    return lower;
+}
+
+bool EqualsIgnoreCase(kbase::StringView lhs, kbase::StringView rhs) noexcept
+{
+    return lhs.size() == rhs.size() &&
+           std::equal(lhs.begin(), lhs.end(), rhs.begin(), [](char l, char r) {
+               return ToLowerASCII(l) == ToLowerASCII(r);
+           });
+}
+
+kbase::StringView TrimWhitespace(kbase::StringView str) noexcept
+{
+    while (!str.empty() && (str.front() == ' ' || str.front() == '\t')) {
+        str.remove_prefix(1);
+    }
+
+    while (!str.empty() && (str.back() == ' ' || str.back() == '\t')) {
+        str.remove_suffix(1);
+    }
+
+    return str;
+}
+
+// Digits only; values too large to matter are clamped.
+bool ParseDeltaSeconds(kbase::StringView str, int64_t& value) noexcept
+{
+    if (str.empty()) {
+        return false;
+    }
+
+    constexpr int64_t kMaxValue = int64_t(1) << 40;
+    value = 0;
+    for (auto ch : str) {
+        if (ch < '0' || ch > '9') {
+            return false;
+        }
+
+        value = std::min(value * 10 + (ch - '0'), kMaxValue);
+    }
+
+    return true;
+}
+
+// Splits `str` at `delimiter`s outside of quoted strings, and hands over each trimmed part that
+// isn't empty.
+template<typename F>
+void ForEachListItem(kbase::StringView str, char delimiter, F&& on_item)
+{
+    bool quoted = false;
+    size_t begin = 0;
+    for (size_t i = 0; i <= str.size(); ++i) {
+        if (i < str.size()) {
+            if (quoted && str[i] == '\\' && i + 1 < str.size()) {
+                ++i;
+                continue;
+            }
+
+            if (str[i] == '"') {
+                quoted = !quoted;
+            }
+
+            if (quoted || str[i] != delimiter) {
+                continue;
+            }
+        }
+
+        auto item = TrimWhitespace(str.substr(begin, std::min(i, str.size()) - begin));
+        if (!item.empty()) {
+            on_item(item);
+        }
+
+        begin = i + 1;
+    }
+}
+
+struct CacheDirectives {
+    bool no_store = false;
+    bool no_cache = false;
+    bool has_max_age = false;
+    int64_t max_age = 0;
+};
+
+// `Pragma: no-cache` counts for requests without Cache-Control, as RFC 7234, section 5.4 says.
+CacheDirectives ParseCacheDirectives(const Headers& headers, bool is_request)
+{
+    CacheDirectives directives;
+    auto values = headers.GetHeaderValues("Cache-Control");
+    if (values.empty() && is_request) {
+        for (const auto& pragma : headers.GetHeaderValues("Pragma")) {
+            ForEachListItem(pragma, ',', [&directives](kbase::StringView item) {
+                directives.no_cache |= EqualsIgnoreCase(item, "no-cache");
+            });
+        }
+    }
+
+    for (const auto& value : values) {
+        ForEachListItem(value, ',', [&directives](kbase::StringView item) {
+            auto eq = item.find('=');
+            auto name = TrimWhitespace(item.substr(0, eq));
+            auto argument = eq == kbase::StringView::npos ?
+                kbase::StringView() : TrimWhitespace(item.substr(eq + 1));
+            if (argument.size() >= 2 && argument.front() == '"' && argument.back() == '"') {
+                argument = argument.substr(1, argument.size() - 2);
+            }
+
+            if (EqualsIgnoreCase(name, "no-store")) {
+                directives.no_store = true;
+            } else if (EqualsIgnoreCase(name, "no-cache")) {
+                // no-cache with field names limits the headers that can be served, which is
+                // simplified to revalidating the whole response.
+                directives.no_cache = true;
+            } else if (EqualsIgnoreCase(name, "max-age")) {
+                // An invalid max-age makes the response stale, as RFC 7234, section 4.2.1 says.
+                int64_t max_age = 0;
+                directives.has_max_age = true;
+                directives.max_age = ParseDeltaSeconds(argument, max_age) ? max_age : 0;
+            }
+        });
+    }
+
+    return directives;
+}
+
+bool ParseNumber(kbase::StringView str, int& value) noexcept
+{
+    int64_t number = 0;
+    if (str.size() > 4 || !ParseDeltaSeconds(str, number)) {
+        return false;
+    }
+
+    value = static_cast<int>(number);
+    return true;
+}
+
+bool ParseMonth(kbase::StringView str, int& month) noexcept
+{
+    for (int i = 0; i < 12; ++i) {
+        if (EqualsIgnoreCase(str, kMonthNames[i])) {
+            month = i + 1;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+// hh:mm:ss
+bool ParseTimeOfDay(kbase::StringView str, int& hour, int& minute, int& second) noexcept
+{
+    return str.size() == 8 && str[2] == ':' && str[5] == ':' &&
+           ParseNumber(str.substr(0, 2), hour) && hour < 24 &&
+           ParseNumber(str.substr(3, 2), minute) && minute < 60 &&
+           ParseNumber(str.substr(6, 2), second) && second <= 60;
+}
+
+// Days since 1970-01-01 of a date of the proleptic Gregorian calendar.
+int64_t DaysFromCivil(int64_t year, int month, int day) noexcept
+{
+    year -= month <= 2 ? 1 : 0;
+    auto era = (year >= 0 ? year : year - 399) / 400;
+    auto year_of_era = year - era * 400;
+    auto day_of_year = (153 * (month > 2 ? month - 3 : month + 9) + 2) / 5 + day - 1;
+    auto day_of_era = year_of_era * 365 + year_of_era / 4 - year_of_era / 100 + day_of_year;
+    return era * 146097 + day_of_era - 719468;
+}
+
+bool GetDateHeader(const Headers& headers, Headers::Known name, CacheClock::time_point& time)
+{
+    kbase::StringView value;
+    return headers.GetHeader(name, value) && wat::internal::ParseHttpDate(value, time);
+}
+
+bool IsCacheableStatus(int status_code) noexcept
+{
+    return std::find(std::begin(kCacheableStatuses), std::end(kCacheableStatuses),
+                     status_code) != std::end(kCacheableStatuses);
+}
+
+// Values of headers of the same name are combined as a list.
+std::string GetRequestHeaderValue(const Headers& request_headers, kbase::StringView name)
+{
+    std::string combined;
+    for (const auto& value : request_headers.GetHeaderValues(name)) {
+        combined.append(combined.empty() ? "" : ", ").append(value);
+    }
+
+    return combined;
+}
+
+// Returns false if the response varies on something other than request headers, i.e. it
+// can't be served again.
+bool GetVaryHeaders(const Headers& response_headers, const Headers& request_headers,
+                    VaryHeaders& vary)
+{
+    bool any = false;
+    for (const auto& value : response_headers.GetHeaderValues("Vary")) {
+        ForEachListItem(value, ',', [&](kbase::StringView name) {
+            any |= name == "*";
+            vary.emplace_back(ToLower(name), GetRequestHeaderValue(request_headers, name));
+        });
+    }
+
+    return !any;
+}
+
+bool VaryMatches(const VaryHeaders& vary, const Headers& request_headers)
+{
+    return std::all_of(vary.begin(), vary.end(), [&request_headers](const auto& header) {
+        return GetRequestHeaderValue(request_headers, header.first) == header.second;
+    });
+}
+
+size_t GetEntrySize(const CacheEntry& entry) noexcept
+{
+    size_t size = sizeof(CacheEntry) + entry.key.size();
+    for (const auto& header : entry.headers.views()) {
+        size += header.first.size() + header.second.size() + 4;
+    }
+
+    for (const auto& header : entry.vary) {
+        size += header.first.size() + header.second.size();
+    }
+
+    return size + (entry.body ? entry.body->size() : 0);
+}
+
+// Computes the freshness lifetime and the age of the response as of its arrival, as described
+// in RFC 7234, section 4.2.
+std::shared_ptr<CacheEntry> MakeCacheEntry(std::string key, VaryHeaders vary, int status_code,
+                                           Headers headers,
+                                           std::shared_ptr<const std::string> body,
+                                           CacheClock::time_point request_time,
+                                           CacheClock::time_point response_time)
+{
+    auto entry = std::make_shared<CacheEntry>();
+    entry->key = std::move(key);
+    entry->vary = std::move(vary);
+    entry->status_code = status_code;
+    entry->headers = std::move(headers);
+    entry->body = std::move(body);
+    entry->request_time = request_time;
+    entry->response_time = response_time;
+
+    const auto& response_headers = entry->headers;
+    auto directives = ParseCacheDirectives(response_headers, false);
+    entry->no_cache = directives.no_cache;
+
+    CacheClock::time_point date = response_time;
+    GetDateHeader(response_headers, Headers::Known::Date, date);
+
+    auto apparent_age = std::max(CacheClock::duration::zero(), response_time - date);
+    int64_t age_value = 0;
+    kbase::StringView age;
+    if (response_headers.GetHeader("Age", age)) {
+        ParseDeltaSeconds(age, age_value);
+    }
+
+    auto corrected_age_value = std::chrono::seconds(age_value) + (response_time - request_time);
+    entry->corrected_initial_age = std::max<CacheClock::duration>(apparent_age,
+                                                                  corrected_age_value);
+
+    CacheClock::time_point expires, last_modified;
+    if (directives.has_max_age) {
+        entry->freshness_lifetime = std::chrono::seconds(directives.max_age);
+    } else if (response_headers.HasHeader(Headers::Known::Expires)) {
+        // An invalid date, e.g. "0", means already expired.
+        entry->freshness_lifetime =
+            GetDateHeader(response_headers, Headers::Known::Expires, expires) ?
+                std::max(CacheClock::duration::zero(), expires - date) :
+                CacheClock::duration::zero();
+    } else if (GetDateHeader(response_headers, Headers::Known::LastModified, last_modified) &&
+               last_modified < date) {
+        // 10% of the time since the last modification, as commonly used.
+        entry->freshness_lifetime =
+            std::min<CacheClock::duration>((date - last_modified) / 10, kMaxHeuristicLifetime);
+    } else {
+        entry->freshness_lifetime = CacheClock::duration::zero();
+    }
+
+    entry->size = GetEntrySize(*entry);
+
+    return entry;
+}
+
+// scheme://host:port/path?query, the fragment aside.
+std::string GetCacheKey(const Url& url)
+{
+    auto path_and_query = url.path_and_query();
+    auto port = std::to_string(url.EffectivePort());
+
+    std::string key;
+    key.reserve(url.spec().size() + port.size() + 4);
+    key.append(ToLower(url.scheme())).append("://").append(url.ascii_host()).append(1, ':')
+       .append(port);
+    if (path_and_query.empty() || path_and_query.front() != '/') {
+        key.append(1, '/');
+    }
+
+    return key.append(path_and_query.data(), path_and_query.size());
+}
+
+std::string JoinPath(const std::string& dir, const std::string& name)
+{
+    if (dir.empty() || dir.back() == '/' || dir.back() == '\\') {
+        return dir + name;
+    }
+
+    return dir + '/' + name;
+}
+
+int64_t ToMilliseconds(CacheClock::time_point time)
+{
+    return std::chrono::duration_cast<std::chrono::milliseconds>(time.time_since_epoch()).count();
+}
+
+CacheClock::time_point FromMilliseconds(int64_t ms)
+{
+    return CacheClock::time_point(std::chrono::duration_cast<CacheClock::duration>(
+        std::chrono::milliseconds(ms)));
+}
+
+}   // namespace
+
+namespace wat {
+namespace internal {
+
+bool ParseHttpDate(kbase::StringView date, CacheClock::time_point& time)
+{
+    // Sun, 06 Nov 1994 08:49:37 GMT    (IMF-fixdate)
+    // Sunday, 06-Nov-94 08:49:37 GMT   (RFC 850)
+    // Sun Nov  6 08:49:37 1994         (asctime)
+    constexpr size_t kMaxTokens = 7;
+    kbase::StringView tokens[kMaxTokens];
+    size_t count = 0;
+    size_t begin = 0;
+    for (size_t i = 0; i <= date.size(); ++i) {
+        if (i < date.size() && date[i] != ' ' && date[i] != ',' && date[i] != '-') {
+            continue;
+        }
+
+        if (i > begin) {
+            if (count == kMaxTokens) {
+                return false;
+            }
+
+            tokens[count++] = date.substr(begin, i - begin);
+        }
+
+        begin = i + 1;
+    }
+
+    kbase::StringView day_token, month_token, year_token, time_token;
+    if (count == 6 && EqualsIgnoreCase(tokens[5], "GMT")) {
+        day_token = tokens[1];
+        month_token = tokens[2];
+        year_token = tokens[3];
+        time_token = tokens[4];
+    } else if (count == 5) {
+        month_token = tokens[1];
+        day_token = tokens[2];
+        time_token = tokens[3];
+        year_token = tokens[4];
+    } else {
+        return false;
+    }
+
+    int day = 0, month = 0, year = 0, hour = 0, minute = 0, second = 0;
+    if (!ParseNumber(day_token, day) || day < 1 || day > 31 ||
+        !ParseMonth(month_token, month) ||
+        !(year_token.size() == 2 || year_token.size() == 4) ||
+        !ParseNumber(year_token, year) ||
+        !ParseTimeOfDay(time_token, hour, minute, second)) {
+        return false;
+    }
+
+    if (year_token.size() == 2) {
+        year += year < 70 ? 2000 : 1900;
+    }
+
+    auto seconds = DaysFromCivil(year, month, day) * 86400 + hour * 3600 + minute * 60 + second;
+    time = CacheClock::from_time_t(0) + std::chrono::seconds(seconds);
+
+    return true;
+}
+
+// -*- CacheEntry -*-
+
+CacheClock::duration CacheEntry::CurrentAge(CacheClock::time_point now) const noexcept
+{
+    return corrected_initial_age + std::max(CacheClock::duration::zero(), now - response_time);
+}
+
+bool CacheEntry::IsFresh(CacheClock::time_point now) const noexcept
+{
+    return !no_cache && freshness_lifetime > CurrentAge(now);
+}
+
+bool CacheEntry::HasValidator() const noexcept
+{
+    return headers.HasHeader(Headers::Known::ETag) ||
+           headers.HasHeader(Headers::Known::LastModified);
+}
+
+// -*- HttpCacheImpl -*-
+
+HttpCacheImpl::HttpCacheImpl(const HttpCache::Options& options)
+    : options_(options),
+      next_file_id_(0),
+      memory_size_(0),
+      disk_size_(0)
+{
+    auto tag = reinterpret_cast<uintptr_t>(this) ^
+               static_cast<uintptr_t>(CacheClock::now().time_since_epoch().count());
+    file_prefix_ = "watcache-" + std::to_string(tag);
+}
+
+HttpCacheImpl::~HttpCacheImpl()
+{
+    for (const auto& disk_entry : disk_lru_) {
+        RemoveFile(disk_entry.path);
+    }
+}
+
+std::shared_ptr<const CacheEntry> HttpCacheImpl::Find(const std::string& key,
+                                                      const Headers& request_headers)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    auto range = memory_index_.equal_range(key);
+    for (auto it = range.first; it != range.second; ++it) {
+        auto entry = *it->second;
+        if (VaryMatches(entry->vary, request_headers)) {
+            memory_lru_.splice(memory_lru_.begin(), memory_lru_, it->second);
+            return entry;
+        }
+    }
+
+    auto disk_range = disk_index_.equal_range(key);
+    for (auto it = disk_range.first; it != disk_range.second; ++it) {
+        if (!VaryMatches(it->second->vary, request_headers)) {
+            continue;
+        }
+
+        // Moved back into memory.
+        auto disk_it = it->second;
+        auto entry = ReadFromDisk(*disk_it);
+        RemoveFromDisk(disk_it);
+        if (!entry) {
+            return nullptr;
+        }
+
+        ++stats_.disk_hits;
+        memory_lru_.push_front(entry);
+        memory_index_.emplace(key, memory_lru_.begin());
+        memory_size_ += entry->size;
+        EvictIfNeeded();
+
+        return entry;
+    }
+
+    return nullptr;
+}
+
+void HttpCacheImpl::Store(std::shared_ptr<const CacheEntry> entry)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    auto range = memory_index_.equal_range(entry->key);
+    for (auto it = range.first; it != range.second; ++it) {
+        if ((*it->second)->vary == entry->vary) {
+            RemoveFromMemory(it->second);
+            break;
+        }
+    }
+
+    auto disk_range = disk_index_.equal_range(entry->key);
+    for (auto it = disk_range.first; it != disk_range.second; ++it) {
+        if (it->second->vary == entry->vary) {
+            RemoveFromDisk(it->second);
+            break;
+        }
+    }
+
+    ++stats_.stores;
+
+    if (entry->size > options_.max_memory_size) {
+        if (!options_.disk_path.empty()) {
+            WriteToDisk(*entry);
+        }
+
+        return;
+    }
+
+    memory_lru_.push_front(entry);
+    memory_index_.emplace(entry->key, memory_lru_.begin());
+    memory_size_ += entry->size;
+    EvictIfNeeded();
+}
+
+void HttpCacheImpl::Remove(const std::string& key)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    auto range = memory_index_.equal_range(key);
+    while (range.first != range.second) {
+        RemoveFromMemory((range.first++)->second);
+    }
+
+    auto disk_range = disk_index_.equal_range(key);
+    while (disk_range.first != disk_range.second) {
+        RemoveFromDisk((disk_range.first++)->second);
+    }
+}
+
+void HttpCacheImpl::Count(uint64_t HttpCache::Stats::* counter)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    ++(stats_.*counter);
+}
+
+HttpCache::Stats HttpCacheImpl::stats() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return stats_;
+}
+
+size_t HttpCacheImpl::entry_count() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return memory_lru_.size();
+}
+
+size_t HttpCacheImpl::memory_size() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return memory_size_;
+}
+
+void HttpCacheImpl::Clear()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    memory_lru_.clear();
+    memory_index_.clear();
+    memory_size_ = 0;
+
+    for (const auto& disk_entry : disk_lru_) {
+        RemoveFile(disk_entry.path);
+    }
+
+    disk_lru_.clear();
+    disk_index_.clear();
+    disk_size_ = 0;
+}
+
+void HttpCacheImpl::RemoveFromMemory(MemoryList::iterator it)
+{
+    auto range = memory_index_.equal_range((*it)->key);
+    for (auto index_it = range.first; index_it != range.second; ++index_it) {
+        if (index_it->second == it) {
+            memory_index_.erase(index_it);
+            break;
+        }
+    }
+
+    memory_size_ -= (*it)->size;
+    memory_lru_.erase(it);
+}
+
+void HttpCacheImpl::RemoveFromDisk(DiskList::iterator it)
+{
+    auto range = disk_index_.equal_range(it->key);
+    for (auto index_it = range.first; index_it != range.second; ++index_it) {
+        if (index_it->second == it) {
+            disk_index_.erase(index_it);
+            break;
+        }
+    }
+
+    RemoveFile(it->path);
+    disk_size_ -= it->size;
+    disk_lru_.erase(it);
+}
+
+void HttpCacheImpl::EvictIfNeeded()
+{
+    while (memory_size_ > options_.max_memory_size) {
+        auto victim = std::prev(memory_lru_.end());
+        ++stats_.evictions;
+        if (!options_.disk_path.empty()) {
+            WriteToDisk(**victim);
+        }
+
+        RemoveFromMemory(victim);
+    }
+}
+
+// WATCACHE 1
+// status request-time response-time vary-count headers-size body-size
+// name
+// value (for each of the Vary headers)
+// headers body
+void HttpCacheImpl::WriteToDisk(const CacheEntry& entry)
+{
+    if (entry.size > options_.max_disk_size) {
+        return;
+    }
+
+    auto path = JoinPath(options_.disk_path,
+                         file_prefix_ + "-" + std::to_string(next_file_id_++) + ".cache");
+    try {
+        auto raw_headers = entry.headers.ToString();
+        auto file = OpenFileForWrite(path);
+        file << kDiskFileMagic << '\n'
+             << entry.status_code << ' ' << ToMilliseconds(entry.request_time) << ' '
+             << ToMilliseconds(entry.response_time) << ' ' << entry.vary.size() << ' '
+             << raw_headers.size() << ' ' << entry.body->size() << '\n';
+        for (const auto& header : entry.vary) {
+            file << header.first << '\n' << header.second << '\n';
+        }
+
+        file.write(raw_headers.data(), static_cast<std::streamsize>(raw_headers.size()));
+        file.write(entry.body->data(), static_cast<std::streamsize>(entry.body->size()));
+        file.close();
+        ENSURE(THROW, !file.fail())(path).Require();
+    } catch (...) {
+        RemoveFile(path);
+        return;
+    }
+
+    disk_lru_.push_front(DiskEntry{entry.key, entry.vary, path, entry.size});
+    disk_index_.emplace(entry.key, disk_lru_.begin());
+    disk_size_ += entry.size;
+
+    while (disk_size_ > options_.max_disk_size) {
+        RemoveFromDisk(std::prev(disk_lru_.end()));
+    }
+}
+
+std::shared_ptr<const CacheEntry> HttpCacheImpl::ReadFromDisk(const DiskEntry& disk_entry)
+{
+    try {
+        auto file = OpenFileForRead(disk_entry.path);
+        std::string magic;
+        if (!std::getline(file, magic) || magic != kDiskFileMagic) {
+            return nullptr;
+        }
+
+        int status_code = 0;
+        int64_t request_time = 0, response_time = 0;
+        size_t vary_count = 0, headers_size = 0, body_size = 0;
+        file >> status_code >> request_time >> response_time >> vary_count >> headers_size
+             >> body_size;
+        file.ignore(1);
+
+        VaryHeaders vary(vary_count);
+        for (auto& header : vary) {
+            std::getline(file, header.first);
+            std::getline(file, header.second);
+        }
+
+        std::string raw_headers(headers_size, '\0');
+        auto body = std::make_shared<std::string>(body_size, '\0');
+        file.read(&raw_headers[0], static_cast<std::streamsize>(headers_size));
+        file.read(&(*body)[0], static_cast<std::streamsize>(body_size));
+        if (!file || vary != disk_entry.vary) {
+            return nullptr;
+        }
+
+        return MakeCacheEntry(disk_entry.key, std::move(vary), status_code,
+                              Headers::Parse(std::move(raw_headers)), std::move(body),
+                              FromMilliseconds(request_time), FromMilliseconds(response_time));
+    } catch (...) {
+        return nullptr;
+    }
+}
+
+// -*- HttpCacheTransaction -*-
+
+HttpCacheTransaction::HttpCacheTransaction(const HttpRequest& request)
+    : cache_(request.http_cache()),
+      key_(GetCacheKey(request.url())),
+      cacheable_(false),
+      invalidates_(false),
+      fresh_(false),
+      request_time_(CacheClock::now())
+{
+    ENSURE(CHECK, cache_ != nullptr).Require();
+
+    if (request.method() != HttpRequest::Method::Get) {
+        // A successful POST may have changed the resource, as RFC 7234, section 4.4 says.
+        invalidates_ = request.method() == HttpRequest::Method::Post;
+        return;
+    }
+
+    // The caller either handles the body, or has validators of its own.
+    const auto& headers = request.headers();
+    if (request.read_response_handler() ||
+        (request.load_flags().flags & LoadFlags::DoNotSaveResponseBody) ||
+        headers.HasHeader(Headers::Known::IfNoneMatch) ||
+        headers.HasHeader(Headers::Known::IfModifiedSince) ||
+        headers.HasHeader("If-Match") || headers.HasHeader("If-Range") ||
+        headers.HasHeader("Range")) {
+        return;
+    }
+
+    auto directives = ParseCacheDirectives(headers, true);
+    if (directives.no_store) {
+        return;
+    }
+
+    cacheable_ = true;
+    request_headers_ = headers;
+    if (DecodesContent(request)) {
+        request_headers_.SetHeader("Accept-Encoding", ContentDecoder::AcceptEncoding());
+    }
+
+    auto& impl = cache_->impl();
+    entry_ = impl.Find(key_, request_headers_);
+    if (entry_ && !directives.no_cache && entry_->IsFresh(request_time_) &&
+        (!directives.has_max_age ||
+         entry_->CurrentAge(request_time_) <= std::chrono::seconds(directives.max_age))) {
+        fresh_ = true;
+        impl.Count(&HttpCache::Stats::hits);
+        return;
+    }
+
+    if (entry_ && !entry_->HasValidator()) {
+        entry_ = nullptr;
+    }
+
+    impl.Count(entry_ ? &HttpCache::Stats::revalidations : &HttpCache::Stats::misses);
+}
+
+HttpResponse HttpCacheTransaction::CachedResponse() const
+{
+    ENSURE(CHECK, fresh_).Require();
+
+    auto headers = entry_->headers;
+    auto age = std::chrono::duration_cast<std::chrono::seconds>(
+        entry_->CurrentAge(CacheClock::now()));
+    headers.SetHeader("Age", std::to_string(age.count()));
+
+    return HttpResponse(entry_->status_code, std::move(headers), entry_->body);
+}
+
+void HttpCacheTransaction::AddValidators(HttpRequest& request) const
+{
+    if (!entry_ || fresh_) {
+        return;
+    }
+
+    Headers validators;
+    kbase::StringView value;
+    if (entry_->headers.GetHeader(Headers::Known::ETag, value)) {
+        validators.AddHeader("If-None-Match", value);
+    }
+
+    if (entry_->headers.GetHeader(Headers::Known::LastModified, value)) {
+        validators.AddHeader("If-Modified-Since", value);
+    }
+
+    request.SetHeaders(validators);
+}
+
+void HttpCacheTransaction::RemoveValidators(HttpRequest& request) const
+{
+    if (!entry_ || fresh_) {
+        return;
+    }
+
+    request.RemoveHeader("If-None-Match");
+    request.RemoveHeader("If-Modified-Since");
+}
+
+void HttpCacheTransaction::OnResponse(HttpResponse& response) noexcept
+{
+    try {
+        auto& impl = cache_->impl();
+        auto status_code = response.status_code();
+        if (invalidates_) {
+            if (status_code >= 200 && status_code < 400) {
+                impl.Remove(key_);
+            }
+
+            return;
+        }
+
+        if (!cacheable_) {
+            return;
+        }
+
+        auto response_time = CacheClock::now();
+
+        if (status_code == 304 && entry_) {
+            // Headers of the 304 replace those stored, and the stored body is served.
+            Headers updates;
+            for (const auto& header : response.headers().views()) {
+                auto not_updated = std::any_of(std::begin(kNotUpdatedHeaders),
+                                               std::end(kNotUpdatedHeaders),
+                                               [&header](const char* name) {
+                                                   return EqualsIgnoreCase(header.first, name);
+                                               });
+                if (!not_updated) {
+                    updates.AddHeader(header.first, header.second);
+                }
+            }
+
+            auto headers = entry_->headers;
+            for (const auto& header : updates) {
+                headers.RemoveHeader(header.first);
+            }
+
+            for (const auto& header : updates) {
+                headers.AddHeader(header.first, header.second);
+            }
+
+            auto entry = MakeCacheEntry(key_, entry_->vary, entry_->status_code,
+                                        std::move(headers), entry_->body, request_time_,
+                                        response_time);
+            impl.Count(&HttpCache::Stats::not_modified);
+            impl.Store(entry);
+            response = HttpResponse(entry->status_code, entry->headers, entry->body);
+            return;
+        }
+
+        if (!IsCacheableStatus(status_code) ||
+            ParseCacheDirectives(response.headers(), false).no_store) {
+            return;
+        }
+
+        VaryHeaders vary;
+        if (!GetVaryHeaders(response.headers(), request_headers_, vary)) {
+            return;
+        }
+
+        auto entry = MakeCacheEntry(key_, std::move(vary), status_code, response.headers(),
+                                    nullptr, request_time_, response_time);
+        // Neither servable nor revalidatable.
+        if (!entry->IsFresh(response_time) && !entry->HasValidator()) {
+            return;
+        }
+
+        entry->body = response.ShareBody();
+        entry->size = GetEntrySize(*entry);
+        impl.Store(std::move(entry));
+    } catch (...) {
+        // The response is served as it is.
+    }
+}
+
+}   // namespace internal
+}   // namespace wat
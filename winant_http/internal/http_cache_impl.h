@@ -0,0 +1,181 @@
+/*
+ @ 0xCCCCCCCC
+*/
+
+#if defined(_MSC_VER)
+#pragma once
+#endif
+
+#ifndef WINANT_HTTP_INTERNAL_HTTP_CACHE_IMPL_H_
+#define WINANT_HTTP_INTERNAL_HTTP_CACHE_IMPL_H_
+
+#include <chrono>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "kbase/basic_macros.h"
+#include "kbase/string_view.h"
+
+#include "winant_http/winant_common_types.h"
+#include "winant_http/winant_http_cache.h"
+#include "winant_http/winant_response.h"
+
+namespace wat {
+
+class HttpRequest;
+
+namespace internal {
+
+using CacheClock = std::chrono::system_clock;
+
+// Parses an HTTP-date in any of the three formats of RFC 7231, section 7.1.1.1.
+bool ParseHttpDate(kbase::StringView date, CacheClock::time_point& time);
+
+// (name in lowercase, value in the request)
+using VaryHeaders = std::vector<std::pair<std::string, std::string>>;
+
+// A stored response. Entries are immutable; updating one replaces it.
+struct CacheEntry {
+    // The canonicalized url.
+    std::string key;
+    // Headers the response varies on, as listed by its Vary header.
+    VaryHeaders vary;
+    int status_code;
+    Headers headers;
+    std::shared_ptr<const std::string> body;
+    CacheClock::time_point request_time;
+    CacheClock::time_point response_time;
+
+    // The rest is derived from the above.
+    CacheClock::duration freshness_lifetime;
+    CacheClock::duration corrected_initial_age;
+    // The response said no-cache, i.e. it must be revalidated each time.
+    bool no_cache;
+    size_t size;
+
+    CacheClock::duration CurrentAge(CacheClock::time_point now) const noexcept;
+
+    bool IsFresh(CacheClock::time_point now) const noexcept;
+
+    bool HasValidator() const noexcept;
+};
+
+class HttpCacheImpl {
+public:
+    explicit HttpCacheImpl(const HttpCache::Options& options);
+
+    // Removes files of the disk tier.
+    ~HttpCacheImpl();
+
+    DISALLOW_COPY(HttpCacheImpl);
+
+    // Returns the response to `key` that was for the same values of its Vary headers as
+    // `request_headers` have, or nullptr.
+    // A response on disk is read back into memory.
+    std::shared_ptr<const CacheEntry> Find(const std::string& key,
+                                           const Headers& request_headers);
+
+    // Replaces the response to the same key and Vary headers, if any.
+    void Store(std::shared_ptr<const CacheEntry> entry);
+
+    // Removes all responses to `key`.
+    void Remove(const std::string& key);
+
+    void Count(uint64_t HttpCache::Stats::* counter);
+
+    HttpCache::Stats stats() const;
+
+    size_t entry_count() const;
+
+    size_t memory_size() const;
+
+    void Clear();
+
+private:
+    using MemoryList = std::list<std::shared_ptr<const CacheEntry>>;
+
+    struct DiskEntry {
+        std::string key;
+        VaryHeaders vary;
+        std::string path;
+        uint64_t size;
+    };
+
+    using DiskList = std::list<DiskEntry>;
+
+    void RemoveFromMemory(MemoryList::iterator it);
+
+    void RemoveFromDisk(DiskList::iterator it);
+
+    void EvictIfNeeded();
+
+    // Files are written and read with the lock held, which is fine as long as the disk tier is
+    // there for responses too many to keep in memory rather than big ones.
+    void WriteToDisk(const CacheEntry& entry);
+
+    std::shared_ptr<const CacheEntry> ReadFromDisk(const DiskEntry& disk_entry);
+
+private:
+    HttpCache::Options options_;
+    // Tells apart files of caches sharing the directory.
+    std::string file_prefix_;
+    uint64_t next_file_id_;
+    mutable std::mutex mutex_;
+    // Most recently used first.
+    MemoryList memory_lru_;
+    std::unordered_multimap<std::string, MemoryList::iterator> memory_index_;
+    size_t memory_size_;
+    DiskList disk_lru_;
+    std::unordered_multimap<std::string, DiskList::iterator> disk_index_;
+    uint64_t disk_size_;
+    HttpCache::Stats stats_;
+};
+
+// Carries a request through its cache: looks up the response to serve or revalidate, and
+// stores the response the server sent, or the one revalidated by a 304.
+class HttpCacheTransaction {
+public:
+    explicit HttpCacheTransaction(const HttpRequest& request);
+
+    ~HttpCacheTransaction() = default;
+
+    DISALLOW_COPY(HttpCacheTransaction);
+
+    // True if the response found is served as it is, and thus the request is not to be sent.
+    bool fresh() const noexcept
+    {
+        return fresh_;
+    }
+
+    HttpResponse CachedResponse() const;
+
+    // Makes the request conditional if a stale response is to be revalidated.
+    void AddValidators(HttpRequest& request) const;
+
+    void RemoveValidators(HttpRequest& request) const;
+
+    // Either stores `response`, or replaces a 304 with the response it revalidated.
+    void OnResponse(HttpResponse& response) noexcept;
+
+private:
+    std::shared_ptr<HttpCache> cache_;
+    std::string key_;
+    bool cacheable_;
+    bool invalidates_;
+    bool storable_;
+    // Headers of the request as sent, to tell the values of Vary headers.
+    Headers request_headers_;
+    std::shared_ptr<const CacheEntry> entry_;
+    bool fresh_;
+    CacheClock::time_point request_time_;
+};
+
+}   // namespace internal
+}   // namespace wat
+
+#endif  // WINANT_HTTP_INTERNAL_HTTP_CACHE_IMPL_H_
@@ -0,0 +1,403 @@
+/*
+ @ 0xCCCCCCCC
+*/
+
+#include "winant_http/internal/http_response_parser.h"
+
+#include <algorithm>
+#include <cctype>
+
+#include "kbase/error_exception_util.h"
+#include "kbase/string_view.h"
+
+namespace {
+
+constexpr size_t kMaxLineLength = 64 * 1024;
+
+constexpr size_t kMaxHeaderBlockSize = 256 * 1024;
+
+// A chunk size takes at most 64 bits.
+constexpr size_t kMaxChunkSizeDigits = 16;
+
+// Enough for the header section of most responses.
+constexpr size_t kInitialHeaderBlockSize = 1024;
+
+bool EqualsIgnoreCase(kbase::StringView lhs, kbase::StringView rhs) noexcept
+{
+    return lhs.size() == rhs.size() &&
+           std::equal(lhs.begin(), lhs.end(), rhs.begin(), [](char l, char r) {
+               return std::tolower(static_cast<unsigned char>(l)) ==
+                      std::tolower(static_cast<unsigned char>(r));
+           });
+}
+
+kbase::StringView TrimWhitespace(kbase::StringView str) noexcept
+{
+    while (!str.empty() && (str.front() == ' ' || str.front() == '\t')) {
+        str.remove_prefix(1);
+    }
+
+    while (!str.empty() && (str.back() == ' ' || str.back() == '\t')) {
+        str.remove_suffix(1);
+    }
+
+    return str;
+}
+
+bool ContainsTokenIgnoreCase(kbase::StringView list, kbase::StringView token) noexcept
+{
+    size_t pos = 0;
+    while (pos <= list.size()) {
+        auto comma = list.find(',', pos);
+        if (comma == kbase::StringView::npos) {
+            comma = list.size();
+        }
+
+        if (EqualsIgnoreCase(TrimWhitespace(list.substr(pos, comma - pos)), token)) {
+            return true;
+        }
+
+        pos = comma + 1;
+    }
+
+    return false;
+}
+
+int HexDigitValue(char ch) noexcept
+{
+    if (ch >= '0' && ch <= '9') {
+        return ch - '0';
+    }
+
+    if (ch >= 'a' && ch <= 'f') {
+        return ch - 'a' + 10;
+    }
+
+    if (ch >= 'A' && ch <= 'F') {
+        return ch - 'A' + 10;
+    }
+
+    return -1;
+}
+
+}   // namespace
+
+namespace wat {
+namespace internal {
+
+HttpResponseParser::HttpResponseParser(bool head_request)
+    : head_request_(head_request),
+      state_(State::StatusLine),
+      status_code_(0),
+      http_minor_(1),
+      keep_alive_(true),
+      chunked_(false),
+      content_length_(-1),
+      remaining_(0),
+      chunk_size_digits_(0),
+      line_length_(0),
+      trailers_size_(0)
+{}
+
+size_t HttpResponseParser::Feed(const char* data, size_t size, const BodyHandler& on_body)
+{
+    const char* const begin = data;
+    const char* const end = data + size;
+    kbase::StringView line;
+
+    while (data < end && state_ != State::Complete) {
+        switch (state_) {
+            case State::StatusLine:
+                if (NextLine(data, end, line)) {
+                    // Tolerate stray CRLFs between messages.
+                    if (!line.empty()) {
+                        ParseStatusLine(line);
+                        state_ = State::Headers;
+                    }
+
+                    pending_.clear();
+                }
+                break;
+
+            case State::Headers:
+                if (NextLine(data, end, line)) {
+                    if (line.empty()) {
+                        ParseHeaderBlock();
+                        OnHeadersComplete();
+                    } else {
+                        ENSURE(THROW, header_block_.size() + line.size() <= kMaxHeaderBlockSize)
+                            (header_block_.size()).Require();
+                        if (header_block_.empty()) {
+                            header_block_.reserve(kInitialHeaderBlockSize);
+                        }
+
+                        header_block_.append(line.data(), line.size()).append("\r\n", 2);
+                    }
+
+                    pending_.clear();
+                }
+                break;
+
+            case State::Body:
+            case State::ChunkData: {
+                auto available = static_cast<size_t>(end - data);
+                auto count = static_cast<size_t>(std::min<uint64_t>(remaining_, available));
+                on_body(data, count);
+                data += count;
+                remaining_ -= count;
+                if (remaining_ == 0) {
+                    state_ = state_ == State::Body ? State::Complete : State::ChunkDataCR;
+                }
+                break;
+            }
+
+            case State::ChunkSize:
+                if (ParseChunkSize(data, end)) {
+                    ENSURE(THROW, chunk_size_digits_ > 0)(*data).Require();
+                    auto ch = *data++;
+                    if (ch == '\n') {
+                        OnChunkSizeLineEnd();
+                    } else if (ch == '\r') {
+                        state_ = State::ChunkSizeLF;
+                    } else {
+                        ENSURE(THROW, ch == ';' || ch == ' ' || ch == '\t')(ch).Require();
+                        state_ = State::ChunkExtension;
+                    }
+                }
+                break;
+
+            case State::ChunkExtension: {
+                // Extensions are ignored.
+                auto eol = std::find(data, end, '\n');
+                line_length_ += static_cast<size_t>(eol - data);
+                ENSURE(THROW, line_length_ <= kMaxLineLength)(line_length_).Require();
+                data = eol;
+                if (eol != end) {
+                    ++data;
+                    OnChunkSizeLineEnd();
+                }
+                break;
+            }
+
+            case State::ChunkSizeLF:
+                ENSURE(THROW, *data == '\n')(*data).Require();
+                ++data;
+                OnChunkSizeLineEnd();
+                break;
+
+            case State::ChunkDataCR:
+                // A bare LF is tolerated.
+                if (*data == '\r') {
+                    ++data;
+                    state_ = State::ChunkDataLF;
+                    break;
+                }
+
+                ENSURE(THROW, *data == '\n')(*data).Require();
+                ++data;
+                ExpectChunkSize();
+                break;
+
+            case State::ChunkDataLF:
+                ENSURE(THROW, *data == '\n')(*data).Require();
+                ++data;
+                ExpectChunkSize();
+                break;
+
+            case State::Trailers:
+                SkipTrailers(data, end);
+                break;
+
+            case State::BodyUntilClose:
+                on_body(data, static_cast<size_t>(end - data));
+                data = end;
+                break;
+
+            default:
+                ENSURE(CHECK, kbase::NotReached())(static_cast<int>(state_)).Require();
+                break;
+        }
+    }
+
+    return static_cast<size_t>(data - begin);
+}
+
+bool HttpResponseParser::FinishOnEOF()
+{
+    if (state_ == State::BodyUntilClose) {
+        state_ = State::Complete;
+    }
+
+    keep_alive_ = false;
+
+    return state_ == State::Complete;
+}
+
+void HttpResponseParser::ParseStatusLine(kbase::StringView line)
+{
+    ENSURE(THROW, line.size() >= 12 && line.substr(0, 7) == "HTTP/1.")(line).Require();
+    http_minor_ = line[7] - '0';
+    auto code = line.substr(9, 3);
+    ENSURE(THROW, line[8] == ' ' && std::all_of(code.begin(), code.end(), [](char ch) {
+                                        return ch >= '0' && ch <= '9';
+                                    }))(line).Require();
+    status_code_ = (code[0] - '0') * 100 + (code[1] - '0') * 10 + (code[2] - '0');
+    keep_alive_ = http_minor_ >= 1;
+}
+
+bool HttpResponseParser::NextLine(const char*& data, const char* end, kbase::StringView& line)
+{
+    auto eol = std::find(data, end, '\n');
+    if (eol == end || !pending_.empty()) {
+        pending_.append(data, eol);
+        ENSURE(THROW, pending_.size() <= kMaxLineLength)(pending_.size()).Require();
+        if (eol == end) {
+            data = end;
+            return false;
+        }
+
+        line = pending_;
+    } else {
+        line = kbase::StringView(data, static_cast<size_t>(eol - data));
+        ENSURE(THROW, line.size() <= kMaxLineLength)(line.size()).Require();
+    }
+
+    data = eol + 1;
+    if (!line.empty() && line.back() == '\r') {
+        line.remove_suffix(1);
+    }
+
+    return true;
+}
+
+bool HttpResponseParser::ParseChunkSize(const char*& data, const char* end)
+{
+    for (; data < end; ++data) {
+        auto digit = HexDigitValue(*data);
+        if (digit < 0) {
+            // Whitespace before the size is tolerated.
+            if (chunk_size_digits_ == 0 && (*data == ' ' || *data == '\t') &&
+                ++line_length_ <= kMaxLineLength) {
+                continue;
+            }
+
+            return true;
+        }
+
+        ENSURE(THROW, chunk_size_digits_ < kMaxChunkSizeDigits)(chunk_size_digits_).Require();
+        remaining_ = (remaining_ << 4) | static_cast<uint64_t>(digit);
+        ++chunk_size_digits_;
+        ++line_length_;
+    }
+
+    return false;
+}
+
+void HttpResponseParser::ExpectChunkSize() noexcept
+{
+    remaining_ = 0;
+    chunk_size_digits_ = 0;
+    line_length_ = 0;
+    state_ = State::ChunkSize;
+}
+
+void HttpResponseParser::OnChunkSizeLineEnd()
+{
+    if (remaining_ > 0) {
+        state_ = State::ChunkData;
+        return;
+    }
+
+    line_length_ = 0;
+    trailers_size_ = 0;
+    state_ = State::Trailers;
+}
+
+void HttpResponseParser::SkipTrailers(const char*& data, const char* end)
+{
+    while (data < end) {
+        auto eol = std::find(data, end, '\n');
+        auto size = static_cast<size_t>(eol - data);
+        line_length_ += size - static_cast<size_t>(std::count(data, eol, '\r'));
+        trailers_size_ += size;
+        ENSURE(THROW, trailers_size_ <= kMaxHeaderBlockSize)(trailers_size_).Require();
+        if (eol == end) {
+            data = end;
+            return;
+        }
+
+        data = eol + 1;
+        if (line_length_ == 0) {
+            state_ = State::Complete;
+            return;
+        }
+
+        line_length_ = 0;
+    }
+}
+
+void HttpResponseParser::ParseHeaderBlock()
+{
+    headers_ = Headers::Parse(std::move(header_block_));
+    header_block_.clear();
+
+    for (const auto& header : headers_.views()) {
+        const auto& value = header.second;
+        switch (Headers::LookupKnown(header.first)) {
+            case Headers::Known::ContentLength: {
+                ENSURE(THROW, !value.empty() && value.size() <= 18 &&
+                              std::all_of(value.begin(), value.end(), [](char ch) {
+                                  return ch >= '0' && ch <= '9';
+                              }))(value.ToString()).Require();
+                auto length = std::stoll(value.ToString());
+                // Conflicting lengths leave the message boundary in doubt.
+                ENSURE(THROW, content_length_ < 0 || content_length_ == length)
+                    (content_length_)(length).Require();
+                content_length_ = length;
+                break;
+            }
+
+            case Headers::Known::TransferEncoding:
+                chunked_ = ContainsTokenIgnoreCase(value, "chunked");
+                break;
+
+            case Headers::Known::Connection:
+                if (ContainsTokenIgnoreCase(value, "close")) {
+                    keep_alive_ = false;
+                } else if (ContainsTokenIgnoreCase(value, "keep-alive")) {
+                    keep_alive_ = true;
+                }
+                break;
+
+            default:
+                break;
+        }
+    }
+}
+
+void HttpResponseParser::OnHeadersComplete()
+{
+    // Interim responses carry no body, and the final response follows.
+    if (status_code_ >= 100 && status_code_ < 200 && status_code_ != 101) {
+        headers_.clear();
+        chunked_ = false;
+        content_length_ = -1;
+        state_ = State::StatusLine;
+        return;
+    }
+
+    if (head_request_ || status_code_ == 204 || status_code_ == 304 || status_code_ == 101) {
+        state_ = State::Complete;
+    } else if (chunked_) {
+        ExpectChunkSize();
+    } else if (content_length_ >= 0) {
+        remaining_ = static_cast<uint64_t>(content_length_);
+        state_ = remaining_ == 0 ? State::Complete : State::Body;
+    } else {
+        keep_alive_ = false;
+        state_ = State::BodyUntilClose;
+    }
+}
+
+}   // namespace internal
+}   // namespace wat
@@ -0,0 +1,148 @@
+/*
+ @ 0xCCCCCCCC
+*/
+
+#if defined(_MSC_VER)
+#pragma once
+#endif
+
+#ifndef WINANT_HTTP_INTERNAL_HTTP_RESPONSE_PARSER_H_
+#define WINANT_HTTP_INTERNAL_HTTP_RESPONSE_PARSER_H_
+
+#include <cstdint>
+#include <functional>
+#include <string>
+
+#include "kbase/basic_macros.h"
+#include "kbase/string_view.h"
+
+#include "winant_http/winant_common_types.h"
+
+namespace wat {
+namespace internal {
+
+// Incrementally parses a HTTP/1.x response from bytes read off a connection.
+// Data can be fed in arbitrary splits; body data is delivered through `BodyHandler` as soon
+// as it is de-framed, pointing right into the data fed.
+// Chunk framing and trailers are parsed byte by byte without being copied aside, so that only
+// the status line and headers ever take memory of the parser.
+class HttpResponseParser {
+public:
+    using BodyHandler = std::function<void(const char* data, size_t size)>;
+
+    // The response to a HEAD request never has a body, regardless of its headers.
+    explicit HttpResponseParser(bool head_request);
+
+    ~HttpResponseParser() = default;
+
+    DISALLOW_COPY(HttpResponseParser);
+
+    DEFAULT_MOVE(HttpResponseParser);
+
+    // Returns the number of bytes consumed, which is less than `size` only if the message
+    // completed before the end of the input.
+    // Throws if the response is malformed.
+    size_t Feed(const char* data, size_t size, const BodyHandler& on_body);
+
+    // Notifies the parser that the peer has closed the connection.
+    // Returns true if the message is complete.
+    bool FinishOnEOF();
+
+    bool headers_complete() const noexcept
+    {
+        return state_ > State::Headers;
+    }
+
+    bool message_complete() const noexcept
+    {
+        return state_ == State::Complete;
+    }
+
+    int status_code() const noexcept
+    {
+        return status_code_;
+    }
+
+    Headers& headers() noexcept
+    {
+        return headers_;
+    }
+
+    // The body length announced by Content-Length, or -1 if the body is delimited otherwise.
+    // Meaningful once the headers are complete.
+    int64_t content_length() const noexcept
+    {
+        return head_request_ || chunked_ ? -1 : content_length_;
+    }
+
+    // True if the connection can carry another request after this response.
+    bool keep_alive() const noexcept
+    {
+        return keep_alive_;
+    }
+
+private:
+    enum class State {
+        StatusLine,
+        Headers,
+        Body,
+        // Hex digits of the size.
+        ChunkSize,
+        // Whitespace or extensions after the size, up to the end of the line.
+        ChunkExtension,
+        // CR seen at the end of the size line.
+        ChunkSizeLF,
+        ChunkData,
+        // CRLF that follows the data.
+        ChunkDataCR,
+        ChunkDataLF,
+        Trailers,
+        BodyUntilClose,
+        Complete
+    };
+
+    void ParseStatusLine(kbase::StringView line);
+
+    void ParseHeaderBlock();
+
+    void OnHeadersComplete();
+
+    // Sets `line` to the next line, without its line break, if the line is complete.
+    // The line points into the input unless it spans feeds, in which case it is gathered in
+    // `pending_`, which is to be cleared once the line is handled.
+    bool NextLine(const char*& data, const char* end, kbase::StringView& line);
+
+    // Reads the chunk size up to the end of the digits; returns false if more input is needed.
+    bool ParseChunkSize(const char*& data, const char* end);
+
+    void ExpectChunkSize() noexcept;
+
+    void OnChunkSizeLineEnd();
+
+    // Skips trailer fields, which are not surfaced.
+    void SkipTrailers(const char*& data, const char* end);
+
+private:
+    bool head_request_;
+    State state_;
+    int status_code_;
+    int http_minor_;
+    Headers headers_;
+    bool keep_alive_;
+    bool chunked_;
+    int64_t content_length_;
+    uint64_t remaining_;
+    // Hex digits of the chunk size so far.
+    size_t chunk_size_digits_;
+    // Length of the current chunk size line or trailer line, line break aside.
+    size_t line_length_;
+    size_t trailers_size_;
+    std::string pending_;
+    // Header lines of the response, parsed as a whole once complete.
+    std::string header_block_;
+};
+
+}   // namespace internal
+}   // namespace wat
+
+#endif  // WINANT_HTTP_INTERNAL_HTTP_RESPONSE_PARSER_H_
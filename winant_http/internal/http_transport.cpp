@@ -0,0 +1,124 @@
+/*
+ @ 0xCCCCCCCC
+*/
+
+#include "winant_http/internal/http_transport.h"
+
+#include <utility>
+
+#include "winant_http/internal/async_exchange.h"
+#include "winant_http/internal/hedged_request.h"
+#include "winant_http/internal/io_loop.h"
+#include "winant_http/internal/socket_transport.h"
+#include "winant_http/internal/worker_pool.h"
+
+#if defined(_WIN32)
+#include "winant_http/internal/wininet_transport.h"
+#endif
+
+#include "winant_http/winant_request.h"
+
+namespace {
+
+constexpr size_t kMaxWinINetThreads = 16;
+
+wat::internal::WorkerPool& WinINetPool()
+{
+    // Intentionally leaked, so that no thread has to be joined during static destruction.
+    static auto pool = new wat::internal::WorkerPool(kMaxWinINetThreads);
+    return *pool;
+}
+
+}   // namespace
+
+namespace wat {
+namespace internal {
+
+bool UsesNativeTransport(const HttpRequest& request)
+{
+#if defined(_WIN32)
+    return (request.load_flags().flags & LoadFlags::UseNativeTransport) &&
+           request.url().SchemeIs("http");
+#else
+    static_cast<void>(request);
+    return true;
+#endif
+}
+
+std::unique_ptr<HttpTransport> MakeHttpTransport(const HttpRequest& request)
+{
+    if (CanHedgeRequest(request)) {
+        return std::make_unique<HedgingTransport>();
+    }
+
+#if defined(_WIN32)
+    if (!UsesNativeTransport(request)) {
+        return std::make_unique<WinINetTransport>();
+    }
+#endif
+
+    return std::make_unique<SocketTransport>();
+}
+
+void SendHttpRequestAsync(HttpRequest request, AsyncResultHandler on_result)
+{
+    auto completion = std::make_shared<AsyncCompletion>(request.completion_handler(),
+                                                        std::move(on_result));
+    try {
+        if (request.http_cache()) {
+            auto transaction = std::make_unique<HttpCacheTransaction>(request);
+            if (transaction->fresh()) {
+                completion->Succeed(transaction->CachedResponse());
+                return;
+            }
+
+            // The transaction takes the cache over, lest the worker thread look it up again.
+            transaction->AddValidators(request);
+            request.SetHttpCache(nullptr);
+            completion->SetCacheTransaction(std::move(transaction));
+        }
+
+        if (UsesNativeTransport(request)) {
+            if (request.retry_policy()) {
+                completion->SetRetryController(
+                    std::make_unique<RetryController>(request.retry_policy(), request));
+            }
+
+            if (CanHedgeRequest(request)) {
+                std::make_shared<HedgedRequest>(std::move(request), completion)->Start();
+            } else {
+                StartAsyncExchange(std::move(request), completion);
+            }
+        } else {
+            auto task = std::make_shared<HttpRequest>(std::move(request));
+            WinINetPool().Post([task, completion] {
+                try {
+                    completion->Succeed(task->Start());
+                } catch (...) {
+                    completion->Fail(std::current_exception());
+                }
+            });
+        }
+    } catch (...) {
+        completion->Fail(std::current_exception());
+    }
+}
+
+std::future<HttpResponse> SendHttpRequestAsync(HttpRequest request)
+{
+    auto promise = std::make_shared<std::promise<HttpResponse>>();
+    auto future = promise->get_future();
+    SendHttpRequestAsync(std::move(request), [promise](HttpResponse* response,
+                                                       std::exception_ptr error) {
+        if (response) {
+            promise->set_value(std::move(*response));
+        } else {
+            promise->set_exception(error);
+        }
+    });
+
+    return future;
+}
+
+}   // namespace internal
+}   // namespace wat
@@ -0,0 +1,54 @@
+/*
+ @ 0xCCCCCCCC
+*/
+
+#if defined(_MSC_VER)
+#pragma once
+#endif
+
+#ifndef WINANT_HTTP_INTERNAL_HTTP_TRANSPORT_H_
+#define WINANT_HTTP_INTERNAL_HTTP_TRANSPORT_H_
+
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+
+namespace wat {
+
+class HttpRequest;
+class HttpResponse;
+
+namespace internal {
+
+// A transport carries out a fully configured request and collects its response.
+class HttpTransport {
+public:
+    virtual ~HttpTransport() = default;
+
+    // Throws if the request failed before a complete response was received.
+    virtual HttpResponse Send(const HttpRequest& request) = 0;
+};
+
+// True if the request goes through the native socket transport.
+bool UsesNativeTransport(const HttpRequest& request);
+
+// Picks the transport suitable for the request on the current platform.
+std::unique_ptr<HttpTransport> MakeHttpTransport(const HttpRequest& request);
+
+// Receives the outcome of an asynchronous request: either `response`, which the handler may move
+// from, or `error`. Must not throw.
+using AsyncResultHandler = std::function<void(HttpResponse* response, std::exception_ptr error)>;
+
+// Requests through the native transport are carried out on the I/O loop, and `on_result` is
+// called on the loop thread; WinINet requests are carried out synchronously on a bounded pool of
+// worker threads, where they wait in line once all are busy. A request served from its cache
+// completes on the calling thread.
+void SendHttpRequestAsync(HttpRequest request, AsyncResultHandler on_result);
+
+std::future<HttpResponse> SendHttpRequestAsync(HttpRequest request);
+
+}   // namespace internal
+}   // namespace wat
+
+#endif  // WINANT_HTTP_INTERNAL_HTTP_TRANSPORT_H_
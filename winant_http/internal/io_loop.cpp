@@ -0,0 +1,234 @@
+/*
+ @ 0xCCCCCCCC
+*/
+
+#include "winant_http/internal/io_loop.h"
+
+#include <algorithm>
+#include <atomic>
+#include <map>
+
+namespace {
+
+// Watcher ids start from 1.
+constexpr uint64_t kWakeKey = 0;
+
+uint64_t NextWatcherId() noexcept
+{
+    static std::atomic<uint64_t> next_id {1};
+    return next_id.fetch_add(1, std::memory_order_relaxed);
+}
+
+}   // namespace
+
+namespace wat {
+namespace internal {
+
+IoWatcher::IoWatcher()
+    : id_(NextWatcherId())
+{}
+
+IoLoop::IoLoop()
+    : wake_socket_(CreateWakeSocket()), quit_(false)
+{
+    poller_.Watch(wake_socket_.get(), SocketReadable, kWakeKey);
+    thread_ = std::thread(&IoLoop::Run, this);
+}
+
+IoLoop::~IoLoop()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        quit_ = true;
+    }
+
+    SignalWakeSocket(wake_socket_.get());
+    thread_.join();
+}
+
+// static
+IoLoop& IoLoop::Default()
+{
+    // Intentionally leaked, so that the loop never has to be joined during static destruction.
+    static IoLoop* loop = new IoLoop();
+    return *loop;
+}
+
+void IoLoop::Add(std::unique_ptr<IoWatcher> watcher)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        incoming_.push_back(std::move(watcher));
+    }
+
+    SignalWakeSocket(wake_socket_.get());
+}
+
+void IoLoop::AddTimer(Clock::time_point when, std::function<void()> task)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        incoming_timers_.emplace_back(when, std::move(task));
+    }
+
+    SignalWakeSocket(wake_socket_.get());
+}
+
+void IoLoop::Refresh(uint64_t watcher_id)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        incoming_refreshes_.push_back(watcher_id);
+    }
+
+    SignalWakeSocket(wake_socket_.get());
+}
+
+void IoLoop::Run()
+{
+    std::unordered_map<uint64_t, WatcherEntry> watchers;
+    DeadlineSet deadlines;
+    std::multimap<Clock::time_point, std::function<void()>> timers;
+    std::vector<std::unique_ptr<IoWatcher>> added;
+    std::vector<uint64_t> refreshes;
+    std::vector<SocketPoller::Event> events;
+    std::vector<uint64_t> due;
+
+    while (true) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (quit_) {
+                break;
+            }
+
+            added.swap(incoming_);
+            refreshes.swap(incoming_refreshes_);
+            for (auto& timer : incoming_timers_) {
+                timers.emplace(timer.first, std::move(timer.second));
+            }
+
+            incoming_timers_.clear();
+        }
+
+        // A refresh may come along with the watcher it is for.
+        for (auto& watcher : added) {
+            if (!watcher->OnStart()) {
+                continue;
+            }
+
+            auto id = watcher->id();
+            auto& entry = watchers[id];
+            entry.watcher = std::move(watcher);
+            Sync(id, entry, deadlines);
+        }
+
+        added.clear();
+
+        for (auto id : refreshes) {
+            auto it = watchers.find(id);
+            if (it != watchers.end()) {
+                Sync(id, it->second, deadlines);
+            }
+        }
+
+        refreshes.clear();
+
+        auto earliest_deadline = timers.empty() ? Clock::time_point::max() : timers.begin()->first;
+        if (!deadlines.empty()) {
+            earliest_deadline = std::min(earliest_deadline, deadlines.begin()->first);
+        }
+
+        poller_.Wait(ToPollTimeout(earliest_deadline, Clock::now()), events);
+
+        // A watcher whose socket is ready makes progress first, which may push its deadline back.
+        for (const auto& event : events) {
+            if (event.key == kWakeKey) {
+                DrainWakeSocket(wake_socket_.get());
+                continue;
+            }
+
+            auto it = watchers.find(event.key);
+            if (it == watchers.end()) {
+                continue;
+            }
+
+            auto ready = event.ready & it->second.events;
+            if (ready == 0) {
+                continue;
+            }
+
+            if (it->second.watcher->OnReady(ready)) {
+                Sync(event.key, it->second, deadlines);
+            } else {
+                Remove(event.key, watchers, deadlines);
+            }
+        }
+
+        auto now = Clock::now();
+        due.clear();
+        for (auto it = deadlines.begin(); it != deadlines.end() && it->first <= now; ++it) {
+            due.push_back(it->second);
+        }
+
+        for (auto id : due) {
+            auto it = watchers.find(id);
+            if (it->second.watcher->OnTimeout()) {
+                Sync(id, it->second, deadlines);
+            } else {
+                Remove(id, watchers, deadlines);
+            }
+        }
+
+        // Tasks may add watchers and timers, which are picked up in the next round.
+        while (!timers.empty() && timers.begin()->first <= now) {
+            auto task = std::move(timers.begin()->second);
+            timers.erase(timers.begin());
+            task();
+        }
+    }
+}
+
+void IoLoop::Sync(uint64_t id, WatcherEntry& entry, DeadlineSet& deadlines)
+{
+    const auto& watcher = *entry.watcher;
+    auto socket = watcher.socket();
+    auto events = socket != kInvalidSocket ? watcher.interest() : 0;
+    if (entry.socket != kInvalidSocket && (entry.socket != socket || events == 0)) {
+        poller_.Unwatch(entry.socket, id);
+    }
+
+    // Registered every time, as the socket may have been replaced by one with the same handle.
+    if (events != 0) {
+        poller_.Watch(socket, events, id);
+    }
+
+    entry.socket = events != 0 ? socket : kInvalidSocket;
+    entry.events = events;
+
+    auto deadline = watcher.deadline();
+    if (deadline != entry.deadline) {
+        deadlines.erase(std::make_pair(entry.deadline, id));
+        if (deadline != Clock::time_point::max()) {
+            deadlines.emplace(deadline, id);
+        }
+
+        entry.deadline = deadline;
+    }
+}
+
+void IoLoop::Remove(uint64_t id, std::unordered_map<uint64_t, WatcherEntry>& watchers,
+                    DeadlineSet& deadlines) noexcept
+{
+    auto it = watchers.find(id);
+    auto& entry = it->second;
+    // Its connection may be back in the pool already, where it must not stay registered.
+    if (entry.socket != kInvalidSocket) {
+        poller_.Unwatch(entry.socket, id);
+    }
+
+    deadlines.erase(std::make_pair(entry.deadline, id));
+    watchers.erase(it);
+}
+
+}   // namespace internal
+}   // namespace wat
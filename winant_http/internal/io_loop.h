@@ -0,0 +1,143 @@
+/*
+ @ 0xCCCCCCCC
+*/
+
+#if defined(_MSC_VER)
+#pragma once
+#endif
+
+#ifndef WINANT_HTTP_INTERNAL_IO_LOOP_H_
+#define WINANT_HTTP_INTERNAL_IO_LOOP_H_
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "kbase/basic_macros.h"
+
+#include "winant_http/internal/socket.h"
+#include "winant_http/internal/socket_poller.h"
+
+namespace wat {
+namespace internal {
+
+// Drives a socket operation on the I/O loop.
+// All methods are called on the loop thread, and must not throw.
+// The loop looks at the socket, interest and deadline of a watcher again after each call of
+// OnReady() or OnTimeout(), and whenever it is asked to refresh the watcher.
+class IoWatcher {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    IoWatcher();
+
+    virtual ~IoWatcher() = default;
+
+    // Unique in the process, by which the loop can be asked to refresh the watcher.
+    uint64_t id() const noexcept
+    {
+        return id_;
+    }
+
+    // Called once the watcher has been added to the loop, before anything else.
+    // Returns false if the watcher has finished already, after which it is destroyed.
+    virtual bool OnStart() noexcept
+    {
+        return true;
+    }
+
+    // The socket may change between calls, e.g. when a request is retried on a new connection.
+    virtual SocketHandle socket() const noexcept = 0;
+
+    // Returns the events the watcher is currently waiting for.
+    virtual unsigned int interest() const noexcept = 0;
+
+    // Returns false once the watcher has finished, after which it is destroyed.
+    virtual bool OnReady(unsigned int events) noexcept = 0;
+
+    // The loop wakes up at the deadline, if the socket hasn't become ready by then, and calls
+    // OnTimeout(). The deadline may change between calls as well.
+    virtual Clock::time_point deadline() const noexcept
+    {
+        return Clock::time_point::max();
+    }
+
+    // Returns false once the watcher has finished, after which it is destroyed.
+    virtual bool OnTimeout() noexcept
+    {
+        return true;
+    }
+
+private:
+    const uint64_t id_;
+};
+
+// Multiplexes watchers on a single thread by waiting on their sockets through a SocketPoller,
+// and times them out when their deadlines pass.
+class IoLoop {
+public:
+    using Clock = IoWatcher::Clock;
+
+    IoLoop();
+
+    // Stops the loop; pending watchers are destroyed without being finished.
+    ~IoLoop();
+
+    DISALLOW_COPY(IoLoop);
+
+    // The process-wide loop, which is started on first use and never stops.
+    static IoLoop& Default();
+
+    // Thread-safe.
+    void Add(std::unique_ptr<IoWatcher> watcher);
+
+    // Runs `task` on the loop thread once `when` has come; the task must not throw.
+    // Thread-safe.
+    void AddTimer(Clock::time_point when, std::function<void()> task);
+
+    // Makes the loop look at the watcher again, e.g. once its deadline has been changed from
+    // another thread or by a task. Nothing happens if the watcher has finished already.
+    // Thread-safe.
+    void Refresh(uint64_t watcher_id);
+
+private:
+    struct WatcherEntry {
+        std::unique_ptr<IoWatcher> watcher;
+        // As registered with the poller.
+        SocketHandle socket {kInvalidSocket};
+        unsigned int events {0};
+        Clock::time_point deadline {Clock::time_point::max()};
+    };
+
+    using DeadlineSet = std::set<std::pair<Clock::time_point, uint64_t>>;
+
+    void Run();
+
+    // Brings the registration of the watcher with the poller and its deadline up to date.
+    void Sync(uint64_t id, WatcherEntry& entry, DeadlineSet& deadlines);
+
+    void Remove(uint64_t id, std::unordered_map<uint64_t, WatcherEntry>& watchers,
+                DeadlineSet& deadlines) noexcept;
+
+private:
+    ScopedSocket wake_socket_;
+    SocketPoller poller_;
+    std::mutex mutex_;
+    std::vector<std::unique_ptr<IoWatcher>> incoming_;
+    std::vector<std::pair<Clock::time_point, std::function<void()>>> incoming_timers_;
+    std::vector<uint64_t> incoming_refreshes_;
+    bool quit_;
+    std::thread thread_;
+};
+
+}   // namespace internal
+}   // namespace wat
+
+#endif  // WINANT_HTTP_INTERNAL_IO_LOOP_H_
@@ -0,0 +1,411 @@
+/*
+ @ 0xCCCCCCCC
+*/
+
+#include "winant_http/internal/pipeline_exchange.h"
+
+#include <utility>
+
+#include "kbase/error_exception_util.h"
+
+#include "winant_http/internal/http_transport.h"
+
+namespace {
+
+// A request is failed once it was the first unanswered one on this many connections that
+// answered nothing.
+constexpr int kMaxFailures = 2;
+
+}   // namespace
+
+namespace wat {
+namespace internal {
+
+bool CanPipelineRequest(const HttpRequest& request)
+{
+    return (request.method() == HttpRequest::Method::Get ||
+            request.method() == HttpRequest::Method::Head) &&
+           request.body().empty() &&
+           !request.http_cache() &&
+           request.timeouts().empty() &&
+           !request.retry_policy() &&
+           !request.hedge_policy() &&
+           !request.cancellation_token() &&
+           UsesNativeTransport(request);
+}
+
+PipelineExchange::PipelineExchange(std::vector<HttpRequest> requests, ResultHandler on_result,
+                                   DoneHandler on_done)
+    : requests_(std::move(requests)),
+      on_result_(std::move(on_result)),
+      on_done_(std::move(on_done)),
+      failures_(requests_.size(), 0),
+      resent_(0),
+      connecting_(false),
+      out_offset_(0),
+      answered_on_connection_(0)
+{
+    ENSURE(CHECK, !requests_.empty()).Require();
+}
+
+PipelineExchange::~PipelineExchange()
+{
+    if (checkout_) {
+        checkout_->Cancel();
+    }
+}
+
+bool PipelineExchange::OnStart() noexcept
+{
+    try {
+        endpoint_ = GetEndpoint(requests_.front().url());
+        EnsureNativeScheme(endpoint_);
+
+        for (size_t i = 0; i < requests_.size(); ++i) {
+            ENSURE(CHECK, CanPipelineRequest(requests_[i]))(requests_[i].url().spec()).Require();
+            std::string head;
+            head.reserve(256);
+            AppendRequestHead(requests_[i], GetEndpoint(requests_[i].url()), head);
+            heads_.push_back(std::move(head));
+        }
+
+        read_buf_ = std::make_unique<ReadBuffer>(requests_.front().read_buffer_size());
+
+        const auto& pool = requests_.front().connection_pool();
+        pool_ = pool ? pool : ConnectionPool::Default();
+        for (size_t i = 0; i < requests_.size(); ++i) {
+            unanswered_.push_back(i);
+        }
+
+        Connect(true);
+        return true;
+    } catch (...) {
+        auto error = std::current_exception();
+        unanswered_.clear();
+        for (size_t i = 0; i < requests_.size(); ++i) {
+            on_result_(i, nullptr, error);
+        }
+
+        on_done_(0);
+        return false;
+    }
+}
+
+void PipelineExchange::Connect(bool reuse_idle)
+{
+    connection_.reset();
+    parser_.reset();
+    decoder_.reset();
+    response_body_.reset();
+    answered_on_connection_ = 0;
+
+    out_.clear();
+    out_offset_ = 0;
+    for (auto index : unanswered_) {
+        out_.append(heads_[index]);
+    }
+
+    if (checkout_) {
+        checkout_->Cancel();
+    }
+
+    checkout_ = std::make_shared<AsyncCheckout>(pool_, endpoint_, reuse_idle);
+    bool connecting = false;
+    auto connection = checkout_->Start(
+        [this](std::unique_ptr<PooledConnection> connection, bool connecting,
+               std::exception_ptr error) {
+            OnCheckedOut(std::move(connection), connecting, error);
+        },
+        connecting);
+    if (connection) {
+        UseConnection(std::move(connection), connecting);
+    }
+}
+
+void PipelineExchange::UseConnection(std::unique_ptr<PooledConnection> connection,
+                                     bool connecting)
+{
+    checkout_.reset();
+    connection_ = std::move(connection);
+    connecting_ = connecting;
+}
+
+void PipelineExchange::OnCheckedOut(std::unique_ptr<PooledConnection> connection,
+                                    bool connecting, std::exception_ptr error) noexcept
+{
+    if (error) {
+        checkout_.reset();
+        checkout_error_ = error;
+    } else {
+        UseConnection(std::move(connection), connecting);
+    }
+
+    // The loop starts watching the connection, or fails the requests.
+    try {
+        IoLoop::Default().Refresh(id());
+    } catch (...) {}
+}
+
+SocketHandle PipelineExchange::socket() const noexcept
+{
+    return connection_ ? connection_->get() : kInvalidSocket;
+}
+
+unsigned int PipelineExchange::interest() const noexcept
+{
+    if (connecting_) {
+        return SocketWritable;
+    }
+
+    // Responses are read while requests are still being written, so that neither side stalls
+    // on a full socket buffer.
+    unsigned int events = SocketReadable;
+    if (out_offset_ < out_.size()) {
+        events |= SocketWritable;
+    }
+
+    return events;
+}
+
+bool PipelineExchange::OnReady(unsigned int /*events*/) noexcept
+{
+    try {
+        if (connecting_) {
+            int error = GetPendingSocketError(connection_->get());
+            if (error != 0) {
+                ThrowConnectError(endpoint_.host, endpoint_.port, error);
+            }
+
+            connecting_ = false;
+        }
+
+        SendRequests();
+        if (!ReceiveResponses()) {
+            return true;
+        }
+
+        on_done_(resent_);
+        return false;
+    } catch (...) {
+        if (HandleConnectionLost(std::current_exception())) {
+            return true;
+        }
+
+        on_done_(resent_);
+        return false;
+    }
+}
+
+PipelineExchange::Clock::time_point PipelineExchange::deadline() const noexcept
+{
+    return checkout_error_ ? Clock::time_point::min() : Clock::time_point::max();
+}
+
+bool PipelineExchange::OnTimeout() noexcept
+{
+    if (checkout_error_) {
+        FailAll(checkout_error_);
+        on_done_(resent_);
+        return false;
+    }
+
+    return true;
+}
+
+void PipelineExchange::SendRequests()
+{
+    while (out_offset_ < out_.size()) {
+        auto sent = SendSome(connection_->get(), out_.data() + out_offset_,
+                             out_.size() - out_offset_);
+        if (sent == 0) {
+            return;
+        }
+
+        out_offset_ += sent;
+    }
+}
+
+bool PipelineExchange::ReceiveResponses()
+{
+    auto on_decoded = [this](const char* data, size_t size) {
+        const auto& request = requests_[unanswered_.front()];
+        if (!(request.load_flags().flags & LoadFlags::DoNotSaveResponseBody)) {
+            response_body_->Reserve(parser_->content_length());
+            response_body_->Append(data, size);
+        }
+
+        const auto& read_handler = request.read_response_handler();
+        if (read_handler && size > 0) {
+            read_handler(data, static_cast<int>(size));
+        }
+    };
+
+    auto on_body = [this, &on_decoded](const char* data, size_t size) {
+        decoder_->Feed(parser_->headers(), data, size, on_decoded);
+    };
+
+    while (true) {
+        auto buf = read_buf_->data();
+        size_t received = 0;
+        if (!TryReceive(connection_->get(), buf, read_buf_->size(), received)) {
+            return false;
+        }
+
+        if (received == 0) {
+            // A response delimited by the end of the connection is complete now.
+            if (parser_ && parser_->FinishOnEOF()) {
+                CompleteFront();
+                if (unanswered_.empty()) {
+                    return true;
+                }
+            }
+
+            ENSURE(THROW, kbase::NotReached())(unanswered_.size()).Require();
+        }
+
+        size_t offset = 0;
+        while (offset < received) {
+            if (!parser_) {
+                const auto& request = requests_[unanswered_.front()];
+                parser_ = std::make_unique<HttpResponseParser>(
+                    request.method() == HttpRequest::Method::Head);
+                decoder_ = std::make_unique<ResponseBodyDecoder>(request);
+                response_body_ = std::make_unique<ResponseBodyBuffer>(request);
+            }
+
+            offset += parser_->Feed(buf + offset, received - offset, on_body);
+            if (!parser_->message_complete()) {
+                continue;
+            }
+
+            bool keep_alive = CompleteFront();
+            if (unanswered_.empty()) {
+                connection_->set_reusable(keep_alive && offset == received);
+                connection_.reset();
+                return true;
+            }
+
+            // The server won't answer the rest on this connection.
+            if (!keep_alive) {
+                resent_ += unanswered_.size();
+                Connect(false);
+                return false;
+            }
+        }
+
+        read_buf_->OnRead(received);
+    }
+}
+
+bool PipelineExchange::CompleteFront()
+{
+    decoder_->Finish();
+
+    auto index = unanswered_.front();
+    unanswered_.pop_front();
+    ++answered_on_connection_;
+
+    const auto& request = requests_[index];
+    const auto& read_handler = request.read_response_handler();
+    if (read_handler) {
+        read_handler("", 0);
+    }
+
+    bool keep_alive = parser_->keep_alive() && !RequestsConnectionClose(request.headers());
+
+    auto response = response_body_->ToResponse(parser_->status_code(),
+                                               std::move(parser_->headers()));
+    parser_.reset();
+    decoder_.reset();
+    response_body_.reset();
+
+    on_result_(index, &response, nullptr);
+
+    return keep_alive;
+}
+
+bool PipelineExchange::HandleConnectionLost(std::exception_ptr error) noexcept
+{
+    // The response of the first request may have been cut off after part of it was read.
+    bool interrupted = !!parser_;
+
+    // Nothing was answered, and thus the first request may be the one killing the connection.
+    if (answered_on_connection_ == 0 && !unanswered_.empty()) {
+        auto index = unanswered_.front();
+        if (++failures_[index] >= kMaxFailures) {
+            unanswered_.pop_front();
+            Fail(index, error);
+            interrupted = false;
+        }
+    }
+
+    if (unanswered_.empty()) {
+        connection_.reset();
+        return false;
+    }
+
+    // Its read handler has to drop what it was given, as the response comes again from the start.
+    const auto& read_handler = requests_[unanswered_.front()].read_response_handler();
+    if (interrupted && read_handler) {
+        try {
+            read_handler(nullptr, -1);
+        } catch (...) {}
+    }
+
+    resent_ += unanswered_.size();
+    try {
+        Connect(false);
+        return true;
+    } catch (...) {
+        FailAll(std::current_exception());
+        return false;
+    }
+}
+
+void PipelineExchange::FailAll(std::exception_ptr error) noexcept
+{
+    if (checkout_) {
+        checkout_->Cancel();
+        checkout_.reset();
+    }
+
+    connection_.reset();
+    while (!unanswered_.empty()) {
+        auto index = unanswered_.front();
+        unanswered_.pop_front();
+        Fail(index, error);
+    }
+}
+
+void PipelineExchange::Fail(size_t index, std::exception_ptr error) noexcept
+{
+    const auto& read_handler = requests_[index].read_response_handler();
+    if (read_handler) {
+        try {
+            read_handler(nullptr, -1);
+        } catch (...) {}
+    }
+
+    on_result_(index, nullptr, error);
+}
+
+void SendPipelinedAsync(std::vector<HttpRequest> requests,
+                        PipelineExchange::ResultHandler on_result,
+                        PipelineExchange::DoneHandler on_done)
+{
+    auto count = requests.size();
+    try {
+        IoLoop::Default().Add(std::make_unique<PipelineExchange>(std::move(requests), on_result,
+                                                                 on_done));
+    } catch (...) {
+        auto error = std::current_exception();
+        for (size_t i = 0; i < count; ++i) {
+            on_result(i, nullptr, error);
+        }
+
+        on_done(0);
+    }
+}
+
+}   // namespace internal
+}   // namespace wat
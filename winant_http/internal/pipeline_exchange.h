@@ -0,0 +1,135 @@
+/*
+ @ 0xCCCCCCCC
+*/
+
+#if defined(_MSC_VER)
+#pragma once
+#endif
+
+#ifndef WINANT_HTTP_INTERNAL_PIPELINE_EXCHANGE_H_
+#define WINANT_HTTP_INTERNAL_PIPELINE_EXCHANGE_H_
+
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "kbase/basic_macros.h"
+
+#include "winant_http/internal/connection_pool_impl.h"
+#include "winant_http/internal/content_decoder.h"
+#include "winant_http/internal/http_response_parser.h"
+#include "winant_http/internal/io_loop.h"
+#include "winant_http/internal/read_buffer.h"
+#include "winant_http/internal/response_body_buffer.h"
+#include "winant_http/internal/socket_transport.h"
+#include "winant_http/winant_request.h"
+#include "winant_http/winant_response.h"
+
+namespace wat {
+namespace internal {
+
+// True if the request can be pipelined, i.e. it is an idempotent GET or HEAD without a body
+// that goes through the native transport; cached requests and those with timeouts, a retry
+// or hedge policy, or a cancellation token go on their own.
+bool CanPipelineRequest(const HttpRequest& request);
+
+// Sends requests to the same origin back-to-back on one connection, and parses the responses
+// in order, as HTTP/1.1 pipelining does.
+// If the connection is closed before every request has been answered, the unanswered requests
+// are sent again on a new connection. A request is given up on only if it is the first
+// unanswered one twice on connections that didn't answer anything.
+class PipelineExchange : public IoWatcher {
+public:
+    // Called on the I/O thread for each request, in order; `response` may be moved from.
+    using ResultHandler = std::function<void(size_t index, HttpResponse* response,
+                                             std::exception_ptr error)>;
+
+    // Called once all requests have finished, with the number of times requests were resent.
+    using DoneHandler = std::function<void(size_t resent)>;
+
+    // All requests must satisfy CanPipelineRequest() and target the same origin.
+    PipelineExchange(std::vector<HttpRequest> requests, ResultHandler on_result,
+                     DoneHandler on_done);
+
+    ~PipelineExchange();
+
+    DISALLOW_COPY(PipelineExchange);
+
+    // Prepares the request heads and starts checking out a connection; a failure to start is
+    // reported for every request.
+    bool OnStart() noexcept override;
+
+    SocketHandle socket() const noexcept override;
+
+    unsigned int interest() const noexcept override;
+
+    bool OnReady(unsigned int events) noexcept override;
+
+    Clock::time_point deadline() const noexcept override;
+
+    bool OnTimeout() noexcept override;
+
+private:
+    // Sends the heads of all unanswered requests on a new or idle connection, once it is checked
+    // out.
+    void Connect(bool reuse_idle);
+
+    void UseConnection(std::unique_ptr<PooledConnection> connection, bool connecting);
+
+    void OnCheckedOut(std::unique_ptr<PooledConnection> connection, bool connecting,
+                      std::exception_ptr error) noexcept;
+
+    void SendRequests();
+
+    // Returns true once every request has been answered.
+    bool ReceiveResponses();
+
+    // Completes the request at the front; returns true if the connection can carry on.
+    bool CompleteFront();
+
+    // Returns false if there is nothing left to do.
+    bool HandleConnectionLost(std::exception_ptr error) noexcept;
+
+    void FailAll(std::exception_ptr error) noexcept;
+
+    void Fail(size_t index, std::exception_ptr error) noexcept;
+
+private:
+    std::vector<HttpRequest> requests_;
+    ResultHandler on_result_;
+    DoneHandler on_done_;
+    std::shared_ptr<ConnectionPool> pool_;
+    Endpoint endpoint_;
+    std::vector<std::string> heads_;
+    std::vector<int> failures_;
+    std::deque<size_t> unanswered_;
+    size_t resent_;
+
+    std::shared_ptr<AsyncCheckout> checkout_;
+    // A checkout that failed, which fails the unanswered requests at the next turn of the loop.
+    std::exception_ptr checkout_error_;
+    std::unique_ptr<PooledConnection> connection_;
+    bool connecting_;
+    std::string out_;
+    size_t out_offset_;
+    size_t answered_on_connection_;
+    // Sized as the first request asks for.
+    std::unique_ptr<ReadBuffer> read_buf_;
+    std::unique_ptr<HttpResponseParser> parser_;
+    std::unique_ptr<ResponseBodyDecoder> decoder_;
+    std::unique_ptr<ResponseBodyBuffer> response_body_;
+};
+
+// Takes care of the exchange on the I/O loop. Failures to start are reported through
+// `on_result` for every request. Never blocks.
+void SendPipelinedAsync(std::vector<HttpRequest> requests,
+                        PipelineExchange::ResultHandler on_result,
+                        PipelineExchange::DoneHandler on_done);
+
+}   // namespace internal
+}   // namespace wat
+
+#endif  // WINANT_HTTP_INTERNAL_PIPELINE_EXCHANGE_H_
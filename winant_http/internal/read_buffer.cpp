@@ -0,0 +1,28 @@
+/*
+ @ 0xCCCCCCCC
+*/
+
+#include "winant_http/internal/read_buffer.h"
+
+#include <algorithm>
+
+namespace wat {
+namespace internal {
+
+ReadBuffer::ReadBuffer(ReadBufferSize size)
+    : buf_(new char[size.size]), size_(size.size), max_size_(size.max_size)
+{}
+
+void ReadBuffer::OnRead(size_t bytes_read)
+{
+    if (bytes_read < size_ || size_ >= max_size_) {
+        return;
+    }
+
+    auto size = std::min(size_ * 2, max_size_);
+    buf_.reset(new char[size]);
+    size_ = size;
+}
+
+}   // namespace internal
+}   // namespace wat
@@ -0,0 +1,56 @@
+/*
+ @ 0xCCCCCCCC
+*/
+
+#if defined(_MSC_VER)
+#pragma once
+#endif
+
+#ifndef WINANT_HTTP_INTERNAL_READ_BUFFER_H_
+#define WINANT_HTTP_INTERNAL_READ_BUFFER_H_
+
+#include <memory>
+
+#include "kbase/basic_macros.h"
+
+#include "winant_http/winant_common_types.h"
+
+namespace wat {
+namespace internal {
+
+// The buffer a response is read into, sized as the request asks for.
+class ReadBuffer {
+public:
+    explicit ReadBuffer(ReadBufferSize size);
+
+    ~ReadBuffer() = default;
+
+    DISALLOW_COPY(ReadBuffer);
+
+    DEFAULT_MOVE(ReadBuffer);
+
+    char* data() const noexcept
+    {
+        return buf_.get();
+    }
+
+    size_t size() const noexcept
+    {
+        return size_;
+    }
+
+    // Reports how many bytes the last read into the buffer returned.
+    // In adaptive mode, a full read grows the buffer for the next one; the content of the buffer
+    // is not preserved then.
+    void OnRead(size_t bytes_read);
+
+private:
+    std::unique_ptr<char[]> buf_;
+    size_t size_;
+    size_t max_size_;
+};
+
+}   // namespace internal
+}   // namespace wat
+
+#endif  // WINANT_HTTP_INTERNAL_READ_BUFFER_H_
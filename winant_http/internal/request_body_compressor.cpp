@@ -0,0 +1,224 @@
+/*
+ @ 0xCCCCCCCC
+*/
+
+#include "winant_http/internal/request_body_compressor.h"
+
+#include <algorithm>
+#include <string>
+#include <utility>
+
+#include "kbase/error_exception_util.h"
+
+#if defined(WINANT_HTTP_USE_ZLIB)
+#include "zlib.h"
+
+#include "winant_http/internal/request_body_reader.h"
+#endif
+
+namespace {
+
+#if defined(WINANT_HTTP_USE_ZLIB)
+
+using wat::BufferPool;
+using wat::RequestBody;
+using wat::internal::RequestBodyReader;
+
+// Window bits of deflateInit2() for the gzip wrapper.
+constexpr int kGzipWindowBits = MAX_WBITS + 16;
+
+// zlib takes at most this many bytes at a time.
+constexpr size_t kMaxDeflateInput = 1U << 30;
+
+// The buffer data of segments other than memory ones is read into when streaming.
+constexpr size_t kStreamReadSize = 64 * 1024;
+
+class GzipStream {
+public:
+    explicit GzipStream(int level)
+        : stream_()
+    {
+        auto rv = deflateInit2(&stream_, level, Z_DEFLATED, kGzipWindowBits, 8,
+                               Z_DEFAULT_STRATEGY);
+        ENSURE(THROW, rv == Z_OK)(rv)(level).Require();
+    }
+
+    ~GzipStream()
+    {
+        deflateEnd(&stream_);
+    }
+
+    DISALLOW_COPY(GzipStream);
+
+    DISALLOW_MOVE(GzipStream);
+
+    z_stream* get() noexcept
+    {
+        return &stream_;
+    }
+
+    // Returns the result of deflate(), which is checked for errors.
+    int Deflate(int flush)
+    {
+        auto rv = deflate(&stream_, flush);
+        ENSURE(THROW, rv == Z_OK || rv == Z_STREAM_END || rv == Z_BUF_ERROR)(rv).Require();
+        return rv;
+    }
+
+private:
+    z_stream stream_;
+};
+
+bool IsInMemory(const RequestBody& body) noexcept
+{
+    return std::all_of(body.segments().begin(), body.segments().end(), [](const auto& segment) {
+        return segment.type == RequestBody::Segment::Type::Memory;
+    });
+}
+
+// The buffer goes back to `pool` once the last body sharing it is gone.
+std::shared_ptr<const std::string> ToPooledBuffer(std::string buf,
+                                                  std::shared_ptr<BufferPool> pool)
+{
+    return std::shared_ptr<std::string>(new std::string(std::move(buf)),
+                                        [pool](std::string* ptr) {
+                                            pool->Recycle(std::move(*ptr));
+                                            delete ptr;
+                                        });
+}
+
+// The output is sized for the worst case upfront, and thus is written in a single pass.
+bool CompressInOneGo(RequestBody& body, int level, const std::shared_ptr<BufferPool>& pool)
+{
+    auto length = static_cast<size_t>(body.length());
+
+    GzipStream stream(level);
+    auto z = stream.get();
+    auto bound = static_cast<size_t>(deflateBound(z, static_cast<uLong>(length)));
+    auto buf = pool->Acquire(bound);
+    buf.resize(bound);
+    z->next_out = reinterpret_cast<Bytef*>(&buf[0]);
+    z->avail_out = static_cast<uInt>(bound);
+
+    for (const auto& segment : body.segments()) {
+        auto data = segment.data;
+        while (!data.empty()) {
+            auto chunk = std::min(data.size(), kMaxDeflateInput);
+            z->next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data.data()));
+            z->avail_in = static_cast<uInt>(chunk);
+            stream.Deflate(Z_NO_FLUSH);
+            data.remove_prefix(chunk - z->avail_in);
+        }
+    }
+
+    auto rv = stream.Deflate(Z_FINISH);
+    ENSURE(CHECK, rv == Z_STREAM_END)(rv)(bound).Require();
+
+    buf.resize(static_cast<size_t>(z->total_out));
+    if (buf.size() >= length) {
+        pool->Recycle(std::move(buf));
+        return false;
+    }
+
+    auto compressed = ToPooledBuffer(std::move(buf), pool);
+    RequestBody compressed_body;
+    compressed_body.AppendShared(compressed, *compressed);
+    body = std::move(compressed_body);
+
+    return true;
+}
+
+// Pulls the original body through a RequestBodyReader and compresses it as it goes.
+class GzipSource {
+public:
+    GzipSource(RequestBody body, int level)
+        : state_(std::make_shared<State>(std::move(body), level))
+    {}
+
+    size_t operator()(char* buf, size_t size)
+    {
+        auto& state = *state_;
+        auto z = state.stream.get();
+        z->next_out = reinterpret_cast<Bytef*>(buf);
+        z->avail_out = static_cast<uInt>(std::min(size, kMaxDeflateInput));
+        auto capacity = z->avail_out;
+
+        while (z->avail_out > 0 && !state.finished) {
+            if (z->avail_in == 0 && !state.input_done) {
+                if (state.pending.empty()) {
+                    state.pending = state.reader.Next(state.read_buf.get(), kStreamReadSize);
+                    state.input_done = state.pending.empty();
+                }
+
+                auto chunk = std::min(state.pending.size(), kMaxDeflateInput);
+                z->next_in = reinterpret_cast<Bytef*>(const_cast<char*>(state.pending.data()));
+                z->avail_in = static_cast<uInt>(chunk);
+                state.pending.remove_prefix(chunk);
+            }
+
+            bool last_input = state.input_done && state.pending.empty();
+            auto rv = state.stream.Deflate(last_input ? Z_FINISH : Z_NO_FLUSH);
+            state.finished = rv == Z_STREAM_END;
+        }
+
+        return capacity - z->avail_out;
+    }
+
+private:
+    struct State {
+        State(RequestBody body, int level)
+            : body(std::move(body)), reader(this->body), stream(level),
+              read_buf(new char[kStreamReadSize]), input_done(false), finished(false)
+        {}
+
+        RequestBody body;
+        RequestBodyReader reader;
+        GzipStream stream;
+        std::unique_ptr<char[]> read_buf;
+        // Data of the current chunk not yet handed to zlib.
+        kbase::StringView pending;
+        bool input_done;
+        bool finished;
+    };
+
+    // Sources are copied around.
+    std::shared_ptr<State> state_;
+};
+
+#endif  // WINANT_HTTP_USE_ZLIB
+
+}   // namespace
+
+namespace wat {
+namespace internal {
+
+bool CompressRequestBody(RequestBody& body, const RequestCompression& compression,
+                         const std::shared_ptr<BufferPool>& pool)
+{
+#if defined(WINANT_HTTP_USE_ZLIB)
+    auto length = body.length();
+    if (body.empty() ||
+        (length != RequestBody::kUnknownLength &&
+         static_cast<uint64_t>(length) < compression.min_size)) {
+        return false;
+    }
+
+    if (length != RequestBody::kUnknownLength && IsInMemory(body)) {
+        return CompressInOneGo(body, compression.level, pool);
+    }
+
+    RequestBody compressed_body;
+    compressed_body.AppendSource(GzipSource(std::move(body), compression.level));
+    body = std::move(compressed_body);
+
+    return true;
+#else
+    UNREFED_VAR(body);
+    UNREFED_VAR(compression);
+    UNREFED_VAR(pool);
+    return false;
+#endif
+}
+
+}   // namespace internal
+}   // namespace wat
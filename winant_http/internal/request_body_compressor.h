@@ -0,0 +1,34 @@
+/*
+ @ 0xCCCCCCCC
+*/
+
+#if defined(_MSC_VER)
+#pragma once
+#endif
+
+#ifndef WINANT_HTTP_INTERNAL_REQUEST_BODY_COMPRESSOR_H_
+#define WINANT_HTTP_INTERNAL_REQUEST_BODY_COMPRESSOR_H_
+
+#include <memory>
+
+#include "winant_http/winant_buffer_pool.h"
+#include "winant_http/winant_common_types.h"
+#include "winant_http/winant_request_body.h"
+
+namespace wat {
+namespace internal {
+
+// The content coding of compressed request bodies.
+constexpr char kRequestBodyCoding[] = "gzip";
+
+// Compresses `body` as described by RequestCompression, with the buffer of a body compressed in
+// one go drawn from `pool`.
+// Returns false, with `body` left as it is, if the body is too small, doesn't shrink, or
+// compression is not available.
+bool CompressRequestBody(RequestBody& body, const RequestCompression& compression,
+                         const std::shared_ptr<BufferPool>& pool);
+
+}   // namespace internal
+}   // namespace wat
+
+#endif  // WINANT_HTTP_INTERNAL_REQUEST_BODY_COMPRESSOR_H_
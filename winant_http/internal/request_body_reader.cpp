@@ -0,0 +1,97 @@
+/*
+ @ 0xCCCCCCCC
+*/
+
+#include "winant_http/internal/request_body_reader.h"
+
+#include <algorithm>
+#include <utility>
+
+#include "kbase/error_exception_util.h"
+
+namespace wat {
+namespace internal {
+
+RequestBodyReader::RequestBodyReader(const RequestBody& body)
+    : body_(body), index_(0), segment_consumed_(0)
+{}
+
+kbase::StringView RequestBodyReader::Next(char* buf, size_t buf_size)
+{
+    using Type = RequestBody::Segment::Type;
+
+    const auto& segments = body_.segments();
+    while (index_ < segments.size()) {
+        const auto& segment = segments[index_];
+        bool known_length = segment.length != RequestBody::kUnknownLength;
+        auto remaining = known_length ?
+            static_cast<uint64_t>(segment.length) - segment_consumed_ : UINT64_MAX;
+        if (remaining == 0) {
+            NextSegment();
+            continue;
+        }
+
+        auto want = static_cast<size_t>(std::min<uint64_t>(remaining, buf_size));
+        switch (segment.type) {
+            case Type::Memory:
+                segment_consumed_ = segment.data.size();
+                return segment.data;
+
+            case Type::File: {
+                if (segment_consumed_ == 0) {
+                    MappedFile mapped_file;
+                    if (mapped_file.Map(segment.path, segment.offset,
+                                        static_cast<uint64_t>(segment.length))) {
+                        kbase::StringView data(mapped_file.data(), mapped_file.size());
+                        mapped_files_.push_back(std::move(mapped_file));
+                        segment_consumed_ = data.size();
+                        return data;
+                    }
+                }
+
+                if (!file_.is_open()) {
+                    file_ = OpenFileForRead(segment.path);
+                    file_.seekg(static_cast<std::streamoff>(segment.offset));
+                }
+
+                file_.read(buf, static_cast<std::streamsize>(want));
+                auto count = static_cast<size_t>(file_.gcount());
+                ENSURE(THROW, count > 0)(segment.path)(segment_consumed_).Require();
+                segment_consumed_ += count;
+                return kbase::StringView(buf, count);
+            }
+
+            case Type::Source: {
+                auto count = (*segment.source)(buf, want);
+                ENSURE(CHECK, count <= want)(count)(want).Require();
+                if (count == 0) {
+                    ENSURE(THROW, !known_length)(segment.length)(segment_consumed_).Require();
+                    NextSegment();
+                    continue;
+                }
+
+                segment_consumed_ += count;
+                return kbase::StringView(buf, count);
+            }
+
+            default:
+                ENSURE(CHECK, kbase::NotReached())(static_cast<int>(segment.type)).Require();
+                break;
+        }
+    }
+
+    return kbase::StringView();
+}
+
+void RequestBodyReader::NextSegment()
+{
+    ++index_;
+    segment_consumed_ = 0;
+    if (file_.is_open()) {
+        file_.close();
+        file_.clear();
+    }
+}
+
+}   // namespace internal
+}   // namespace wat
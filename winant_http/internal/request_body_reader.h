@@ -0,0 +1,55 @@
+/*
+ @ 0xCCCCCCCC
+*/
+
+#if defined(_MSC_VER)
+#pragma once
+#endif
+
+#ifndef WINANT_HTTP_INTERNAL_REQUEST_BODY_READER_H_
+#define WINANT_HTTP_INTERNAL_REQUEST_BODY_READER_H_
+
+#include <cstdint>
+#include <fstream>
+#include <vector>
+
+#include "kbase/basic_macros.h"
+#include "kbase/string_view.h"
+
+#include "winant_http/internal/file_util.h"
+#include "winant_http/winant_request_body.h"
+
+namespace wat {
+namespace internal {
+
+// Walks through the segments of a request body chunk by chunk.
+class RequestBodyReader {
+public:
+    explicit RequestBodyReader(const RequestBody& body);
+
+    ~RequestBodyReader() = default;
+
+    DISALLOW_COPY(RequestBodyReader);
+
+    // Returns the next chunk of the body, and an empty chunk indicates the end of the body.
+    // Data of memory segments and of file segments that can be memory-mapped is returned in place,
+    // and stays valid as long as the reader lives; data of other segments is read into `buf`,
+    // and is valid only until the next call.
+    // Throws if a segment ends before its declared length.
+    kbase::StringView Next(char* buf, size_t buf_size);
+
+private:
+    void NextSegment();
+
+private:
+    const RequestBody& body_;
+    size_t index_;
+    uint64_t segment_consumed_;
+    std::ifstream file_;
+    std::vector<MappedFile> mapped_files_;
+};
+
+}   // namespace internal
+}   // namespace wat
+
+#endif  // WINANT_HTTP_INTERNAL_REQUEST_BODY_READER_H_
@@ -0,0 +1,150 @@
+/*
+ @ 0xCCCCCCCC
+*/
+
+#include "winant_http/internal/request_timer.h"
+
+#include <utility>
+
+namespace {
+
+// A thread waits for one request at a time, and so has one wake socket for all of them.
+wat::internal::SocketHandle ThreadWakeSocket()
+{
+    thread_local wat::internal::ScopedSocket wake_socket(wat::internal::CreateWakeSocket());
+    return wake_socket.get();
+}
+
+}   // namespace
+
+namespace wat {
+namespace internal {
+
+RequestTimer::RequestTimer(const Timeouts& timeouts, const CancellationToken* token)
+    : timeouts_(timeouts),
+      start_(Clock::now()),
+      phase_(Phase::Connect),
+      phase_start_(start_),
+      last_activity_(start_),
+      token_(token ? std::make_unique<CancellationToken>(*token) : nullptr),
+      wake_socket_(kInvalidSocket),
+      callback_id_(0)
+{}
+
+RequestTimer::~RequestTimer()
+{
+    // The wake socket stays with the thread.
+    if (token_) {
+        token_->RemoveCallback(callback_id_);
+    }
+}
+
+void RequestTimer::Enter(Phase phase) noexcept
+{
+    phase_ = phase;
+    phase_start_ = Clock::now();
+    last_activity_ = phase_start_;
+}
+
+RequestTimer::Clock::time_point RequestTimer::deadline() const noexcept
+{
+    Clock::time_point deadline;
+    EarliestLimit(deadline);
+    return deadline;
+}
+
+TimeoutError RequestTimer::Expired() const
+{
+    Clock::time_point deadline;
+    return TimeoutError(EarliestLimit(deadline));
+}
+
+void RequestTimer::CheckCancelled() const
+{
+    if (cancelled()) {
+        throw CancelledError();
+    }
+}
+
+void RequestTimer::OnCancel(CancellationToken::Callback callback)
+{
+    if (token_) {
+        callback_id_ = token_->AddCallback(std::move(callback));
+    }
+}
+
+void RequestTimer::Wait(SocketHandle socket, unsigned int events)
+{
+    OnActivity();
+    if (token_ && wake_socket_ == kInvalidSocket) {
+        wake_socket_ = ThreadWakeSocket();
+        auto wake_socket = wake_socket_;
+        OnCancel([wake_socket] {
+            SignalWakeSocket(wake_socket);
+        });
+    }
+
+    while (true) {
+        CheckCancelled();
+
+        Clock::time_point deadline;
+        auto limit = EarliestLimit(deadline);
+        auto now = Clock::now();
+        if (deadline <= now) {
+            throw TimeoutError(limit);
+        }
+
+        // Polling may wake up a little early on coarse timers, in which case we wait again.
+        // A signal may also be left over from a request the thread waited for before.
+        SocketPollItem items[] {
+            {socket, events, 0},
+            {wake_socket_, SocketReadable, 0}
+        };
+        PollSockets(items, wake_socket_ != kInvalidSocket ? 2 : 1, ToPollTimeout(deadline, now));
+        if (items[0].ready != 0) {
+            return;
+        }
+
+        if (items[1].ready != 0) {
+            DrainWakeSocket(wake_socket_);
+        }
+    }
+}
+
+TimeoutError::Limit RequestTimer::EarliestLimit(Clock::time_point& deadline) const noexcept
+{
+    deadline = Clock::time_point::max();
+    auto limit = TimeoutError::Limit::Total;
+    auto consider = [&](Timeouts::Duration timeout, Clock::time_point since,
+                        TimeoutError::Limit which) {
+        if (timeout.count() > 0 && since + timeout < deadline) {
+            deadline = since + timeout;
+            limit = which;
+        }
+    };
+
+    switch (phase_) {
+        case Phase::Connect:
+            consider(timeouts_.connect, phase_start_, TimeoutError::Limit::Connect);
+            break;
+
+        case Phase::Write:
+            consider(timeouts_.write, last_activity_, TimeoutError::Limit::Write);
+            break;
+
+        case Phase::FirstByte:
+            consider(timeouts_.first_byte, phase_start_, TimeoutError::Limit::FirstByte);
+            break;
+
+        case Phase::Read:
+            consider(timeouts_.idle_read, last_activity_, TimeoutError::Limit::IdleRead);
+            break;
+    }
+
+    consider(timeouts_.total, start_, TimeoutError::Limit::Total);
+
+    return limit;
+}
+
+}   // namespace internal
+}   // namespace wat
@@ -0,0 +1,104 @@
+/*
+ @ 0xCCCCCCCC
+*/
+
+#if defined(_MSC_VER)
+#pragma once
+#endif
+
+#ifndef WINANT_HTTP_INTERNAL_REQUEST_TIMER_H_
+#define WINANT_HTTP_INTERNAL_REQUEST_TIMER_H_
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+
+#include "kbase/basic_macros.h"
+
+#include "winant_http/internal/socket.h"
+#include "winant_http/winant_cancellation_token.h"
+#include "winant_http/winant_common_types.h"
+
+namespace wat {
+namespace internal {
+
+// Keeps track of the Timeouts of a request as the exchange goes through its phases, and tells
+// when the earliest limit in effect runs out.
+// The limits on connecting and on the first byte run from entering their phases, those on
+// writing and reading from the last activity of the connection, and the total from construction.
+// Waits are cut short as well once the cancellation token of the request, if any, is cancelled.
+class RequestTimer : public SocketWaiter {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    enum class Phase {
+        Connect,
+        Write,
+        FirstByte,
+        Read
+    };
+
+    explicit RequestTimer(const Timeouts& timeouts, const CancellationToken* token = nullptr);
+
+    ~RequestTimer();
+
+    DISALLOW_COPY(RequestTimer);
+
+    void Enter(Phase phase) noexcept;
+
+    // Data went through the connection.
+    void OnActivity() noexcept
+    {
+        last_activity_ = Clock::now();
+    }
+
+    // Returns Clock::time_point::max() if no limit is in effect.
+    Clock::time_point deadline() const noexcept;
+
+    // The error for the limit that runs out at deadline().
+    TimeoutError Expired() const;
+
+    bool cancelled() const noexcept
+    {
+        return token_ && token_->cancelled();
+    }
+
+    // The cancellation token of the request, if any.
+    const CancellationToken* token() const noexcept
+    {
+        return token_.get();
+    }
+
+    // Throws a CancelledError if the request has been cancelled.
+    void CheckCancelled() const;
+
+    // Runs `callback` once the request is cancelled, as long as the timer lives; at most one
+    // callback can be set, including the one the waits set for themselves.
+    void OnCancel(CancellationToken::Callback callback);
+
+    // Waits with the limits in effect, counting the wait as the connection having gone idle.
+    // Throws a TimeoutError if a limit runs out first, or a CancelledError if the request is
+    // cancelled.
+    void Wait(SocketHandle socket, unsigned int events) override;
+
+private:
+    // Returns the limit that runs out first and when.
+    TimeoutError::Limit EarliestLimit(Clock::time_point& deadline) const noexcept;
+
+private:
+    Timeouts timeouts_;
+    Clock::time_point start_;
+    Phase phase_;
+    Clock::time_point phase_start_;
+    Clock::time_point last_activity_;
+    std::unique_ptr<CancellationToken> token_;
+    // That of the thread waiting, which the token signals so that waits wake up; set by the first
+    // wait.
+    SocketHandle wake_socket_;
+    uint64_t callback_id_;
+};
+
+}   // namespace internal
+}   // namespace wat
+
+#endif  // WINANT_HTTP_INTERNAL_REQUEST_TIMER_H_
@@ -0,0 +1,55 @@
+/*
+ @ 0xCCCCCCCC
+*/
+
+#include "winant_http/internal/response_body_buffer.h"
+
+#include <utility>
+
+namespace wat {
+namespace internal {
+
+ResponseBodyBuffer::ResponseBodyBuffer(const HttpRequest& request)
+    : pool_(request.buffer_pool() ? request.buffer_pool() : BufferPool::Default()),
+      acquired_(false)
+{}
+
+ResponseBodyBuffer::~ResponseBodyBuffer()
+{
+    // The response was abandoned.
+    if (acquired_) {
+        pool_->Recycle(std::move(buf_));
+    }
+}
+
+void ResponseBodyBuffer::Reserve(int64_t content_length)
+{
+    if (acquired_) {
+        return;
+    }
+
+    buf_ = pool_->Acquire(content_length > 0 ? static_cast<size_t>(content_length) : 0);
+    acquired_ = true;
+}
+
+void ResponseBodyBuffer::Append(const char* data, size_t size)
+{
+    if (!acquired_) {
+        Reserve(-1);
+    }
+
+    if (buf_.size() + size > buf_.capacity()) {
+        pool_->Grow(buf_, buf_.size() + size);
+    }
+
+    buf_.append(data, size);
+}
+
+HttpResponse ResponseBodyBuffer::ToResponse(int status_code, Headers headers)
+{
+    acquired_ = false;
+    return HttpResponse(status_code, std::move(headers), std::move(buf_), pool_);
+}
+
+}   // namespace internal
+}   // namespace wat
@@ -0,0 +1,53 @@
+/*
+ @ 0xCCCCCCCC
+*/
+
+#if defined(_MSC_VER)
+#pragma once
+#endif
+
+#ifndef WINANT_HTTP_INTERNAL_RESPONSE_BODY_BUFFER_H_
+#define WINANT_HTTP_INTERNAL_RESPONSE_BODY_BUFFER_H_
+
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include "kbase/basic_macros.h"
+
+#include "winant_http/winant_buffer_pool.h"
+#include "winant_http/winant_common_types.h"
+#include "winant_http/winant_request.h"
+#include "winant_http/winant_response.h"
+
+namespace wat {
+namespace internal {
+
+// Collects a response body in storage drawn from the buffer pool of the request.
+class ResponseBodyBuffer {
+public:
+    explicit ResponseBodyBuffer(const HttpRequest& request);
+
+    ~ResponseBodyBuffer();
+
+    DISALLOW_COPY(ResponseBodyBuffer);
+
+    // Sizes the buffer for a body of `content_length` bytes, or -1 if the length is unknown.
+    // Takes effect only before any data was appended.
+    void Reserve(int64_t content_length);
+
+    void Append(const char* data, size_t size);
+
+    // The response owns the buffer afterwards, and gives it back to the pool when destroyed.
+    HttpResponse ToResponse(int status_code, Headers headers);
+
+private:
+    std::shared_ptr<BufferPool> pool_;
+    std::string buf_;
+    bool acquired_;
+};
+
+}   // namespace internal
+}   // namespace wat
+
+#endif  // WINANT_HTTP_INTERNAL_RESPONSE_BODY_BUFFER_H_
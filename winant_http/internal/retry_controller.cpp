@@ -0,0 +1,193 @@
+/*
+ @ 0xCCCCCCCC
+*/
+
+#include "winant_http/internal/retry_controller.h"
+
+#include <algorithm>
+#include <cmath>
+#include <condition_variable>
+#include <cstdlib>
+#include <mutex>
+#include <random>
+#include <thread>
+
+#include "kbase/string_view.h"
+
+#include "winant_http/internal/http_cache_impl.h"
+#include "winant_http/internal/http_transport.h"
+#include "winant_http/winant_request.h"
+#include "winant_http/winant_response.h"
+
+namespace {
+
+using std::chrono::milliseconds;
+
+// Either delta-seconds or an HTTP-date.
+bool ParseRetryAfter(kbase::StringView value, milliseconds& delay)
+{
+    std::string str(value.data(), value.size());
+    char* end = nullptr;
+    auto seconds = std::strtol(str.c_str(), &end, 10);
+    if (end != str.c_str() && *end == '\0') {
+        if (seconds < 0) {
+            return false;
+        }
+
+        delay = std::chrono::seconds(seconds);
+        return true;
+    }
+
+    wat::internal::CacheClock::time_point time;
+    if (!wat::internal::ParseHttpDate(value, time)) {
+        return false;
+    }
+
+    auto now = wat::internal::CacheClock::now();
+    delay = time > now ? std::chrono::duration_cast<milliseconds>(time - now) : milliseconds(0);
+    return true;
+}
+
+// Throws a CancelledError if the request is cancelled in the meantime.
+void WaitBeforeRetry(const wat::HttpRequest& request, milliseconds delay)
+{
+    const auto* token = request.cancellation_token();
+    if (!token) {
+        std::this_thread::sleep_for(delay);
+        return;
+    }
+
+    std::mutex mutex;
+    std::condition_variable cancelled;
+    auto callback_id = token->AddCallback([&] {
+        std::lock_guard<std::mutex> lock(mutex);
+        cancelled.notify_all();
+    });
+
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        cancelled.wait_for(lock, delay, [token] {
+            return token->cancelled();
+        });
+    }
+
+    token->RemoveCallback(callback_id);
+    if (token->cancelled()) {
+        throw wat::CancelledError();
+    }
+}
+
+double RandomFraction()
+{
+    thread_local std::mt19937 engine(std::random_device{}());
+    return std::uniform_real_distribution<double>(0.0, 1.0)(engine);
+}
+
+}   // namespace
+
+namespace wat {
+namespace internal {
+
+RetryController::RetryController(std::shared_ptr<const RetryPolicy> policy,
+                                 const HttpRequest& request)
+    : policy_(std::move(policy)),
+      budget_(policy_->budget ? policy_->budget : RetryBudget::Default()),
+      resendable_(request.body().replayable() &&
+                  (policy_->retry_non_idempotent ||
+                   request.method() == HttpRequest::Method::Get ||
+                   request.method() == HttpRequest::Method::Head)),
+      attempts_(1)
+{
+    budget_->Deposit();
+}
+
+bool RetryController::ShouldRetry(const HttpResponse* response, std::exception_ptr error,
+                                  milliseconds& delay)
+{
+    if (attempts_ >= policy_->max_attempts) {
+        return false;
+    }
+
+    milliseconds retry_after(0);
+    if (response ? !IsRetryableResponse(*response, retry_after) : !IsRetryableError(error)) {
+        return false;
+    }
+
+    if (retry_after > policy_->max_retry_after || !budget_->TryWithdraw()) {
+        return false;
+    }
+
+    delay = std::max(NextBackoff(), retry_after);
+    ++attempts_;
+    return true;
+}
+
+bool RetryController::IsRetryableError(std::exception_ptr error) const
+{
+    try {
+        std::rethrow_exception(error);
+    } catch (const ConnectError&) {
+        return policy_->retry_connect_failures;
+    } catch (const TimeoutError& ex) {
+        if (ex.limit() == TimeoutError::Limit::Connect) {
+            return policy_->retry_connect_failures;
+        }
+
+        return policy_->retry_timeouts && resendable_;
+    } catch (...) {
+        return false;
+    }
+}
+
+bool RetryController::IsRetryableResponse(const HttpResponse& response,
+                                          milliseconds& retry_after) const
+{
+    const auto& codes = policy_->retry_status_codes;
+    if (!resendable_ ||
+        std::find(codes.begin(), codes.end(), response.status_code()) == codes.end()) {
+        return false;
+    }
+
+    kbase::StringView value;
+    if (response.headers().GetHeader("Retry-After", value)) {
+        ParseRetryAfter(value, retry_after);
+    }
+
+    return true;
+}
+
+milliseconds RetryController::NextBackoff() const
+{
+    auto backoff = static_cast<double>(policy_->initial_backoff.count()) *
+                   std::pow(policy_->backoff_multiplier, attempts_ - 1);
+    backoff = std::min(backoff, static_cast<double>(policy_->max_backoff.count()));
+    backoff -= backoff * policy_->jitter * RandomFraction();
+    return milliseconds(static_cast<milliseconds::rep>(backoff));
+}
+
+HttpResponse SendWithRetries(HttpTransport& transport, const HttpRequest& request)
+{
+    if (!request.retry_policy()) {
+        return transport.Send(request);
+    }
+
+    RetryController retry(request.retry_policy(), request);
+    while (true) {
+        milliseconds delay;
+        try {
+            auto response = transport.Send(request);
+            if (!retry.ShouldRetry(&response, nullptr, delay)) {
+                return response;
+            }
+        } catch (...) {
+            if (!retry.ShouldRetry(nullptr, std::current_exception(), delay)) {
+                throw;
+            }
+        }
+
+        WaitBeforeRetry(request, delay);
+    }
+}
+
+}   // namespace internal
+}   // namespace wat
@@ -0,0 +1,73 @@
+/*
+ @ 0xCCCCCCCC
+*/
+
+#if defined(_MSC_VER)
+#pragma once
+#endif
+
+#ifndef WINANT_HTTP_INTERNAL_RETRY_CONTROLLER_H_
+#define WINANT_HTTP_INTERNAL_RETRY_CONTROLLER_H_
+
+#include <chrono>
+#include <exception>
+#include <memory>
+
+#include "kbase/basic_macros.h"
+
+#include "winant_http/winant_retry_policy.h"
+
+namespace wat {
+
+class HttpRequest;
+class HttpResponse;
+
+namespace internal {
+
+class HttpTransport;
+
+// Goes through the attempts of a request as its RetryPolicy directs.
+class RetryController {
+public:
+    // Counts as the first attempt going out.
+    RetryController(std::shared_ptr<const RetryPolicy> policy, const HttpRequest& request);
+
+    ~RetryController() = default;
+
+    DISALLOW_COPY(RetryController);
+
+    // Returns true, with the delay before the next attempt, if the attempt that ended with
+    // either `response` or `error` is to be retried; a token of the budget is taken then.
+    bool ShouldRetry(const HttpResponse* response, std::exception_ptr error,
+                     std::chrono::milliseconds& delay);
+
+    int attempts() const noexcept
+    {
+        return attempts_;
+    }
+
+private:
+    bool IsRetryableError(std::exception_ptr error) const;
+
+    // `retry_after` is left as it is if the response doesn't have a valid Retry-After.
+    bool IsRetryableResponse(const HttpResponse& response,
+                             std::chrono::milliseconds& retry_after) const;
+
+    std::chrono::milliseconds NextBackoff() const;
+
+private:
+    std::shared_ptr<const RetryPolicy> policy_;
+    std::shared_ptr<RetryBudget> budget_;
+    // Whether attempts that did send something may be retried.
+    bool resendable_;
+    int attempts_;
+};
+
+// Sends the request through `transport`, and retries as the retry policy of the request, if any,
+// directs, waiting on the calling thread in between.
+HttpResponse SendWithRetries(HttpTransport& transport, const HttpRequest& request);
+
+}   // namespace internal
+}   // namespace wat
+
+#endif  // WINANT_HTTP_INTERNAL_RETRY_CONTROLLER_H_
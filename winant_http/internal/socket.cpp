@@ -0,0 +1,553 @@
+/*
+ @ 0xCCCCCCCC
+*/
+
+#include "winant_http/internal/socket.h"
+
+#include <algorithm>
+#include <limits>
+#include <memory>
+#include <string>
+#include <vector>
+
+#if defined(_WIN32)
+#include <mutex>
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#endif
+
+#include "kbase/error_exception_util.h"
+
+#include "winant_http/winant_common_types.h"
+
+namespace {
+
+using wat::internal::SocketHandle;
+
+#if defined(_WIN32)
+
+void EnsureWinsockInitialized()
+{
+    static std::once_flag init_flag;
+    std::call_once(init_flag, [] {
+        WSADATA wsa_data;
+        int rv = WSAStartup(MAKEWORD(2, 2), &wsa_data);
+        ENSURE(THROW, rv == 0)(rv).Require();
+    });
+}
+
+#endif
+
+bool IsInterrupted(int error) noexcept
+{
+#if defined(_WIN32)
+    return error == WSAEINTR;
+#else
+    return error == EINTR;
+#endif
+}
+
+// Throws a ConnectionClosedError if the peer has closed the connection, and fails as any other
+// call otherwise.
+[[noreturn]] void ThrowSocketError(int error)
+{
+    ENSURE(THROW, wat::internal::IsConnectionClosed(error))(error).Require();
+    throw wat::internal::ConnectionClosedError("Connection closed by peer, error " +
+                                               std::to_string(error));
+}
+
+void SetNonBlocking(SocketHandle socket)
+{
+#if defined(_WIN32)
+    u_long non_blocking = 1;
+    int rv = ioctlsocket(socket, FIONBIO, &non_blocking);
+    ENSURE(THROW, rv == 0)(wat::internal::LastSocketError()).Require();
+#else
+    int flags = fcntl(socket, F_GETFL, 0);
+    int rv = fcntl(socket, F_SETFL, flags | O_NONBLOCK);
+    ENSURE(THROW, flags != -1 && rv != -1)(wat::internal::LastSocketError()).Require();
+#endif
+}
+
+void DisableNagle(SocketHandle socket)
+{
+    int no_delay = 1;
+    setsockopt(socket, IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<const char*>(&no_delay),
+               sizeof(no_delay));
+}
+
+void WaitFor(SocketHandle socket, unsigned int events, wat::internal::SocketWaiter* waiter)
+{
+    if (waiter) {
+        waiter->Wait(socket, events);
+    } else {
+        wat::internal::WaitSocket(socket, events, -1);
+    }
+}
+
+// Tries the addresses in order until one connects. If `in_progress` is given, a connection
+// still underway is returned as it is, and flagged, instead of being waited for.
+wat::internal::ScopedSocket ConnectFirst(const addrinfo* addresses, const std::string& host,
+                                         const std::string& port,
+                                         wat::internal::SocketWaiter* waiter, bool* in_progress)
+{
+    using wat::internal::LastSocketError;
+    using wat::internal::ScopedSocket;
+
+    int last_error = 0;
+    for (auto addr = addresses; addr; addr = addr->ai_next) {
+        ScopedSocket socket(::socket(addr->ai_family, addr->ai_socktype, addr->ai_protocol));
+        if (!socket) {
+            last_error = LastSocketError();
+            continue;
+        }
+
+        SetNonBlocking(socket.get());
+        DisableNagle(socket.get());
+
+        if (connect(socket.get(), addr->ai_addr, static_cast<socklen_t>(addr->ai_addrlen)) == 0) {
+            if (in_progress) {
+                *in_progress = false;
+            }
+
+            return socket;
+        }
+
+        last_error = LastSocketError();
+        if (!wat::internal::IsSocketWouldBlock(last_error)) {
+            continue;
+        }
+
+        if (in_progress) {
+            *in_progress = true;
+            return socket;
+        }
+
+        WaitFor(socket.get(), wat::internal::SocketWritable, waiter);
+        last_error = wat::internal::GetPendingSocketError(socket.get());
+        if (last_error == 0) {
+            return socket;
+        }
+    }
+
+    wat::internal::ThrowConnectError(host, port, last_error);
+}
+
+// Returns null with `error` set if `host` doesn't resolve.
+wat::internal::AddressList LookUpHost(const std::string& host, const std::string& port, int flags,
+                                      int& error)
+{
+#if defined(_WIN32)
+    EnsureWinsockInitialized();
+#endif
+
+    addrinfo hints {};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_protocol = IPPROTO_TCP;
+    hints.ai_flags = flags;
+
+    addrinfo* result = nullptr;
+    error = getaddrinfo(host.c_str(), port.c_str(), &hints, &result);
+    wat::internal::AddressList addresses(result);
+    if (error != 0) {
+        addresses.reset();
+    }
+
+    return addresses;
+}
+
+}   // namespace
+
+namespace wat {
+namespace internal {
+
+int LastSocketError() noexcept
+{
+#if defined(_WIN32)
+    return WSAGetLastError();
+#else
+    return errno;
+#endif
+}
+
+bool IsSocketWouldBlock(int error) noexcept
+{
+#if defined(_WIN32)
+    return error == WSAEWOULDBLOCK || error == WSAEINPROGRESS;
+#else
+    return error == EAGAIN || error == EWOULDBLOCK || error == EINPROGRESS;
+#endif
+}
+
+bool IsConnectionClosed(int error) noexcept
+{
+#if defined(_WIN32)
+    return error == WSAECONNRESET || error == WSAECONNABORTED || error == WSAESHUTDOWN ||
+           error == WSAENOTCONN;
+#else
+    return error == ECONNRESET || error == ECONNABORTED || error == EPIPE || error == ENOTCONN;
+#endif
+}
+
+void ThrowConnectError(const std::string& host, const std::string& port, int error)
+{
+    throw ConnectError("Failed to connect to " + host + ":" + port + ", error " +
+                       std::to_string(error));
+}
+
+void AddrInfoDeleter::operator()(addrinfo* info) const noexcept
+{
+    freeaddrinfo(info);
+}
+
+AddressList ResolveHost(const std::string& host, const std::string& port)
+{
+    int error = 0;
+    auto addresses = LookUpHost(host, port, 0, error);
+    if (!addresses) {
+        throw ConnectError("Failed to resolve " + host + ":" + port + ", error " +
+                           std::to_string(error));
+    }
+
+    return addresses;
+}
+
+AddressList ResolveNumericHost(const std::string& host, const std::string& port)
+{
+    int error = 0;
+    return LookUpHost(host, port, AI_NUMERICHOST, error);
+}
+
+ScopedSocket ConnectSocket(const AddressList& addresses, const std::string& host,
+                           const std::string& port, SocketWaiter* waiter)
+{
+    return ConnectFirst(addresses.get(), host, port, waiter, nullptr);
+}
+
+ScopedSocket ConnectSocket(const std::string& host, const std::string& port,
+                           SocketWaiter* waiter)
+{
+    return ConnectSocket(ResolveHost(host, port), host, port, waiter);
+}
+
+ScopedSocket StartConnectSocket(const AddressList& addresses, const std::string& host,
+                                const std::string& port, bool& in_progress)
+{
+    return ConnectFirst(addresses.get(), host, port, nullptr, &in_progress);
+}
+
+ScopedSocket StartConnectSocket(const std::string& host, const std::string& port,
+                                bool& in_progress)
+{
+    return StartConnectSocket(ResolveHost(host, port), host, port, in_progress);
+}
+
+int GetPendingSocketError(SocketHandle socket) noexcept
+{
+    int error = 0;
+    socklen_t len = sizeof(error);
+    if (getsockopt(socket, SOL_SOCKET, SO_ERROR, reinterpret_cast<char*>(&error), &len) != 0) {
+        return LastSocketError();
+    }
+
+    return error;
+}
+
+ScopedSocket CreateWakeSocket()
+{
+#if defined(_WIN32)
+    EnsureWinsockInitialized();
+#endif
+
+    ScopedSocket socket(::socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP));
+    ENSURE(THROW, !!socket)(LastSocketError()).Require();
+
+    sockaddr_in addr {};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = 0;
+    socklen_t addr_len = sizeof(addr);
+    int rv = bind(socket.get(), reinterpret_cast<sockaddr*>(&addr), addr_len);
+    ENSURE(THROW, rv == 0)(LastSocketError()).Require();
+
+    rv = getsockname(socket.get(), reinterpret_cast<sockaddr*>(&addr), &addr_len);
+    ENSURE(THROW, rv == 0)(LastSocketError()).Require();
+
+    rv = connect(socket.get(), reinterpret_cast<sockaddr*>(&addr), addr_len);
+    ENSURE(THROW, rv == 0)(LastSocketError()).Require();
+
+    SetNonBlocking(socket.get());
+
+    return socket;
+}
+
+void SignalWakeSocket(SocketHandle socket) noexcept
+{
+    // A full socket buffer means a wakeup is pending anyway.
+    char byte = 0;
+    send(socket, &byte, 1, 0);
+}
+
+void DrainWakeSocket(SocketHandle socket) noexcept
+{
+    char buf[64];
+    while (recv(socket, buf, sizeof(buf), 0) > 0) {}
+}
+
+size_t PollSockets(SocketPollItem* items, size_t count, int timeout_ms)
+{
+#if defined(_WIN32)
+    using PollFd = WSAPOLLFD;
+#else
+    using PollFd = pollfd;
+#endif
+
+    std::vector<PollFd> fds(count);
+    for (size_t i = 0; i < count; ++i) {
+        fds[i].fd = items[i].socket;
+        fds[i].events = static_cast<short>(((items[i].events & SocketReadable) ? POLLIN : 0) |
+                                           ((items[i].events & SocketWritable) ? POLLOUT : 0));
+        items[i].ready = 0;
+    }
+
+    int rv = 0;
+    do {
+#if defined(_WIN32)
+        rv = WSAPoll(fds.data(), static_cast<ULONG>(count), timeout_ms);
+#else
+        rv = poll(fds.data(), static_cast<nfds_t>(count), timeout_ms);
+#endif
+    } while (rv < 0 && IsInterrupted(LastSocketError()));
+
+    ENSURE(THROW, rv >= 0)(LastSocketError()).Require();
+
+    if (rv == 0) {
+        return 0;
+    }
+
+    // Errors and hang-ups are reported as readiness so that the subsequent call surfaces them.
+    for (size_t i = 0; i < count; ++i) {
+        unsigned int ready = 0;
+        if (fds[i].revents & (POLLIN | POLLERR | POLLHUP)) {
+            ready |= SocketReadable;
+        }
+
+        if (fds[i].revents & (POLLOUT | POLLERR | POLLHUP)) {
+            ready |= SocketWritable;
+        }
+
+        items[i].ready = ready & items[i].events;
+    }
+
+    return static_cast<size_t>(rv);
+}
+
+unsigned int WaitSocket(SocketHandle socket, unsigned int events, int timeout_ms)
+{
+    SocketPollItem item {socket, events, 0};
+    PollSockets(&item, 1, timeout_ms);
+    return item.ready;
+}
+
+int ToPollTimeout(std::chrono::steady_clock::time_point deadline,
+                  std::chrono::steady_clock::time_point now) noexcept
+{
+    if (deadline == std::chrono::steady_clock::time_point::max()) {
+        return -1;
+    }
+
+    if (deadline <= now) {
+        return 0;
+    }
+
+    auto remaining = deadline - now;
+    auto timeout = std::chrono::duration_cast<std::chrono::milliseconds>(remaining);
+    if (timeout < remaining) {
+        timeout += std::chrono::milliseconds(1);
+    }
+
+    return static_cast<int>(std::min<std::chrono::milliseconds::rep>(
+        timeout.count(), std::numeric_limits<int>::max()));
+}
+
+void SendAll(SocketHandle socket, const char* data, size_t size, SocketWaiter* waiter)
+{
+#if defined(_WIN32)
+    constexpr int kSendFlags = 0;
+#else
+    constexpr int kSendFlags = MSG_NOSIGNAL;
+#endif
+
+    while (size > 0) {
+#if defined(_WIN32)
+        int chunk = static_cast<int>(std::min<size_t>(size, std::numeric_limits<int>::max()));
+        auto sent = send(socket, data, chunk, kSendFlags);
+#else
+        auto sent = send(socket, data, size, kSendFlags);
+#endif
+        if (sent < 0) {
+            int error = LastSocketError();
+            if (!IsSocketWouldBlock(error) && !IsInterrupted(error)) {
+                ThrowSocketError(error);
+            }
+
+            WaitFor(socket, SocketWritable, waiter);
+            continue;
+        }
+
+        data += sent;
+        size -= static_cast<size_t>(sent);
+    }
+}
+
+void SendVectored(SocketHandle socket, kbase::StringView* bufs, size_t count,
+                  SocketWaiter* waiter)
+{
+    constexpr size_t kMaxBuffers = 64;
+
+    while (count > 0) {
+        if (bufs->empty()) {
+            ++bufs;
+            --count;
+            continue;
+        }
+
+        size_t batch = std::min(count, kMaxBuffers);
+#if defined(_WIN32)
+        WSABUF wsa_bufs[kMaxBuffers];
+        for (size_t i = 0; i < batch; ++i) {
+            wsa_bufs[i].buf = const_cast<char*>(bufs[i].data());
+            wsa_bufs[i].len = static_cast<ULONG>(
+                std::min<size_t>(bufs[i].size(), std::numeric_limits<ULONG>::max()));
+            // Data following a truncated buffer must wait for the next round.
+            if (wsa_bufs[i].len != bufs[i].size()) {
+                batch = i + 1;
+                break;
+            }
+        }
+
+        DWORD sent = 0;
+        int rv = WSASend(socket, wsa_bufs, static_cast<DWORD>(batch), &sent, 0, nullptr, nullptr);
+        if (rv != 0) {
+#else
+        iovec iov[kMaxBuffers];
+        for (size_t i = 0; i < batch; ++i) {
+            iov[i].iov_base = const_cast<char*>(bufs[i].data());
+            iov[i].iov_len = bufs[i].size();
+        }
+
+        msghdr msg {};
+        msg.msg_iov = iov;
+        msg.msg_iovlen = batch;
+        auto sent = sendmsg(socket, &msg, MSG_NOSIGNAL);
+        if (sent < 0) {
+#endif
+            int error = LastSocketError();
+            if (!IsSocketWouldBlock(error) && !IsInterrupted(error)) {
+                ThrowSocketError(error);
+            }
+
+            WaitFor(socket, SocketWritable, waiter);
+            continue;
+        }
+
+        auto remaining = static_cast<size_t>(sent);
+        while (remaining > 0) {
+            auto consumed = std::min(remaining, bufs->size());
+            *bufs = kbase::StringView(bufs->data() + consumed, bufs->size() - consumed);
+            remaining -= consumed;
+            if (bufs->empty()) {
+                ++bufs;
+                --count;
+            }
+        }
+    }
+}
+
+size_t SendSome(SocketHandle socket, const char* data, size_t size)
+{
+#if defined(_WIN32)
+    constexpr int kSendFlags = 0;
+#else
+    constexpr int kSendFlags = MSG_NOSIGNAL;
+#endif
+
+    while (true) {
+#if defined(_WIN32)
+        int chunk = static_cast<int>(std::min<size_t>(size, std::numeric_limits<int>::max()));
+        auto sent = send(socket, data, chunk, kSendFlags);
+#else
+        auto sent = send(socket, data, size, kSendFlags);
+#endif
+        if (sent >= 0) {
+            return static_cast<size_t>(sent);
+        }
+
+        int error = LastSocketError();
+        if (IsSocketWouldBlock(error)) {
+            return 0;
+        }
+
+        if (!IsInterrupted(error)) {
+            ThrowSocketError(error);
+        }
+    }
+}
+
+bool TryReceive(SocketHandle socket, char* buf, size_t size, size_t& received)
+{
+    while (true) {
+#if defined(_WIN32)
+        int chunk = static_cast<int>(std::min<size_t>(size, std::numeric_limits<int>::max()));
+        auto rv = recv(socket, buf, chunk, 0);
+#else
+        auto rv = recv(socket, buf, size, 0);
+#endif
+        if (rv >= 0) {
+            received = static_cast<size_t>(rv);
+            return true;
+        }
+
+        int error = LastSocketError();
+        if (IsSocketWouldBlock(error)) {
+            return false;
+        }
+
+        if (!IsInterrupted(error)) {
+            ThrowSocketError(error);
+        }
+    }
+}
+
+size_t ReceiveSome(SocketHandle socket, char* buf, size_t size, SocketWaiter* waiter)
+{
+    while (true) {
+#if defined(_WIN32)
+        int chunk = static_cast<int>(std::min<size_t>(size, std::numeric_limits<int>::max()));
+        auto received = recv(socket, buf, chunk, 0);
+#else
+        auto received = recv(socket, buf, size, 0);
+#endif
+        if (received >= 0) {
+            return static_cast<size_t>(received);
+        }
+
+        int error = LastSocketError();
+        if (!IsSocketWouldBlock(error) && !IsInterrupted(error)) {
+            ThrowSocketError(error);
+        }
+
+        WaitFor(socket, SocketReadable, waiter);
+    }
+}
+
+}   // namespace internal
+}   // namespace wat
@@ -0,0 +1,199 @@
+/*
+ @ 0xCCCCCCCC
+*/
+
+#if defined(_MSC_VER)
+#pragma once
+#endif
+
+#ifndef WINANT_HTTP_INTERNAL_SOCKET_H_
+#define WINANT_HTTP_INTERNAL_SOCKET_H_
+
+#if defined(_WIN32)
+#include <WinSock2.h>
+#include <WS2tcpip.h>
+#else
+#include <netdb.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+#include <chrono>
+#include <memory>
+#include <stdexcept>
+#include <string>
+
+#include "kbase/scoped_handle.h"
+#include "kbase/string_view.h"
+
+namespace wat {
+namespace internal {
+
+#if defined(_WIN32)
+using SocketHandle = SOCKET;
+constexpr SocketHandle kInvalidSocket = INVALID_SOCKET;
+#else
+using SocketHandle = int;
+constexpr SocketHandle kInvalidSocket = -1;
+#endif
+
+struct SocketHandleTraits {
+    using Handle = SocketHandle;
+
+    SocketHandleTraits() = delete;
+
+    ~SocketHandleTraits() = delete;
+
+    static Handle NullHandle() noexcept
+    {
+        return kInvalidSocket;
+    }
+
+    static bool IsValid(Handle handle) noexcept
+    {
+        return handle != kInvalidSocket;
+    }
+
+    static void Close(Handle handle) noexcept
+    {
+#if defined(_WIN32)
+        closesocket(handle);
+#else
+        close(handle);
+#endif
+    }
+};
+
+using ScopedSocket = kbase::GenericScopedHandle<SocketHandleTraits>;
+
+enum SocketEvent : unsigned int {
+    SocketReadable = 1 << 0,
+    SocketWritable = 1 << 1
+};
+
+// Waits on behalf of the blocking calls below whenever their socket isn't ready, e.g. to keep
+// the waits within a deadline. Throws if the socket doesn't become ready in time.
+// Blocking calls given no waiter wait indefinitely.
+class SocketWaiter {
+public:
+    virtual ~SocketWaiter() = default;
+
+    virtual void Wait(SocketHandle socket, unsigned int events) = 0;
+};
+
+// Returns the error code of the last failed socket call on this thread.
+int LastSocketError() noexcept;
+
+// Returns true if `error` indicates the operation would block or is in progress.
+bool IsSocketWouldBlock(int error) noexcept;
+
+// Returns true if `error` indicates the peer has closed or reset the connection.
+bool IsConnectionClosed(int error) noexcept;
+
+// Thrown by the send and receive calls below once the peer has closed or reset the connection;
+// other socket failures throw as usual.
+class ConnectionClosedError : public std::runtime_error {
+public:
+    explicit ConnectionClosedError(const std::string& what)
+        : std::runtime_error(what)
+    {}
+};
+
+// Throws a ConnectError for a failed attempt to connect to `host`:`port`.
+[[noreturn]] void ThrowConnectError(const std::string& host, const std::string& port, int error);
+
+struct AddrInfoDeleter {
+    void operator()(addrinfo* info) const noexcept;
+};
+
+// The addresses a host resolves to, in the order they are to be tried.
+using AddressList = std::unique_ptr<addrinfo, AddrInfoDeleter>;
+
+// Resolves `host`:`port` to TCP addresses; may block for as long as the name lookup takes.
+// Throws a ConnectError if the host doesn't resolve.
+AddressList ResolveHost(const std::string& host, const std::string& port);
+
+// Same as ResolveHost() but only takes IP address literals, and thus never blocks.
+// Returns null if `host` is a name that has to be looked up.
+AddressList ResolveNumericHost(const std::string& host, const std::string& port);
+
+// Creates a non-blocking TCP socket connected to the first connectable one of `addresses`.
+// Throws a ConnectError, which names `host`:`port`, if none of them is connectable.
+ScopedSocket ConnectSocket(const AddressList& addresses, const std::string& host,
+                           const std::string& port, SocketWaiter* waiter = nullptr);
+
+// Resolves `host` and then connects as above.
+ScopedSocket ConnectSocket(const std::string& host, const std::string& port,
+                           SocketWaiter* waiter = nullptr);
+
+// Same as ConnectSocket() but doesn't wait for the connection to establish; `in_progress` is set
+// if it is still underway, in which case the socket becomes writable once it is done, and
+// GetPendingSocketError() tells the outcome.
+// Only the first address that accepts the attempt is tried.
+ScopedSocket StartConnectSocket(const AddressList& addresses, const std::string& host,
+                                const std::string& port, bool& in_progress);
+
+ScopedSocket StartConnectSocket(const std::string& host, const std::string& port,
+                                bool& in_progress);
+
+// Returns and clears the pending error, e.g. of a non-blocking connect.
+int GetPendingSocketError(SocketHandle socket) noexcept;
+
+// A loopback UDP socket connected to itself, for waking up a thread blocked in polling.
+ScopedSocket CreateWakeSocket();
+
+void SignalWakeSocket(SocketHandle socket) noexcept;
+
+void DrainWakeSocket(SocketHandle socket) noexcept;
+
+struct SocketPollItem {
+    SocketHandle socket;
+    unsigned int events;
+    // Set by PollSockets().
+    unsigned int ready;
+};
+
+// Waits until any of the sockets becomes ready for its events.
+// Returns the number of ready sockets, or 0 if timed out.
+// A negative `timeout_ms` waits indefinitely.
+size_t PollSockets(SocketPollItem* items, size_t count, int timeout_ms);
+
+// Converts a deadline into a timeout of the waits above, rounded up so that a wait never ends
+// before the deadline; returns -1 for time_point::max(), i.e. no deadline.
+int ToPollTimeout(std::chrono::steady_clock::time_point deadline,
+                  std::chrono::steady_clock::time_point now) noexcept;
+
+// Waits until the socket becomes ready for any of `events`.
+// Returns the ready events, or 0 if timed out.
+// A negative `timeout_ms` waits indefinitely.
+unsigned int WaitSocket(SocketHandle socket, unsigned int events, int timeout_ms);
+
+// Writes the whole buffer, waiting for writability whenever the socket buffer is full.
+// Throws on failure.
+void SendAll(SocketHandle socket, const char* data, size_t size, SocketWaiter* waiter = nullptr);
+
+// Writes the buffers in order, in as few system calls as possible.
+// The views are consumed as data goes out. Throws on failure.
+void SendVectored(SocketHandle socket, kbase::StringView* bufs, size_t count,
+                  SocketWaiter* waiter = nullptr);
+
+// Writes as much data as the socket buffer takes without waiting.
+// Returns the number of bytes written, which is 0 if the socket buffer is full.
+// Throws on failure.
+size_t SendSome(SocketHandle socket, const char* data, size_t size);
+
+// Receives available data into `buf` without waiting.
+// Returns false if no data is available yet; otherwise `received` is set, and 0 indicates the
+// peer has closed the connection.
+// Throws on failure.
+bool TryReceive(SocketHandle socket, char* buf, size_t size, size_t& received);
+
+// Receives available data into `buf`, waiting for readability if necessary.
+// Returns the number of bytes received, and 0 indicates the peer has closed the connection.
+// Throws on failure.
+size_t ReceiveSome(SocketHandle socket, char* buf, size_t size, SocketWaiter* waiter = nullptr);
+
+}   // namespace internal
+}   // namespace wat
+
+#endif  // WINANT_HTTP_INTERNAL_SOCKET_H_
@@ -0,0 +1,198 @@
+/*
+ @ 0xCCCCCCCC
+*/
+
+#include "winant_http/internal/socket_poller.h"
+
+#include <algorithm>
+
+#if !defined(_WIN32)
+#include <cerrno>
+#include <unistd.h>
+#endif
+
+#include "kbase/error_exception_util.h"
+
+namespace {
+
+using wat::internal::SocketReadable;
+using wat::internal::SocketWritable;
+
+constexpr size_t kMaxEventsPerWait = 256;
+
+bool IsInterrupted(int error) noexcept
+{
+#if defined(_WIN32)
+    return error == WSAEINTR;
+#else
+    return error == EINTR;
+#endif
+}
+
+}   // namespace
+
+namespace wat {
+namespace internal {
+
+#if defined(__linux__)
+
+SocketPoller::SocketPoller()
+    : epoll_fd_(epoll_create1(EPOLL_CLOEXEC)), ready_(kMaxEventsPerWait)
+{
+    ENSURE(THROW, epoll_fd_ != -1)(LastSocketError()).Require();
+}
+
+SocketPoller::~SocketPoller()
+{
+    close(epoll_fd_);
+}
+
+void SocketPoller::Watch(SocketHandle socket, unsigned int events, uint64_t key)
+{
+    epoll_event event {};
+    event.events = ((events & SocketReadable) ? EPOLLIN : 0u) |
+                   ((events & SocketWritable) ? EPOLLOUT : 0u);
+    event.data.u64 = key;
+
+    // The registration is gone if the socket was closed since, or the descriptor was reused.
+    auto it = keys_.find(socket);
+    int rv = -1;
+    if (it != keys_.end()) {
+        rv = epoll_ctl(epoll_fd_, EPOLL_CTL_MOD, socket, &event);
+    }
+
+    if (rv != 0) {
+        rv = epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, socket, &event);
+        if (rv != 0 && errno == EEXIST) {
+            rv = epoll_ctl(epoll_fd_, EPOLL_CTL_MOD, socket, &event);
+        }
+    }
+
+    ENSURE(THROW, rv == 0)(LastSocketError())(socket).Require();
+    keys_[socket] = key;
+}
+
+void SocketPoller::Unwatch(SocketHandle socket, uint64_t key) noexcept
+{
+    auto it = keys_.find(socket);
+    if (it == keys_.end() || it->second != key) {
+        return;
+    }
+
+    keys_.erase(it);
+    // Fails harmlessly if the socket has been closed already.
+    epoll_event event {};
+    epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, socket, &event);
+}
+
+size_t SocketPoller::Wait(int timeout_ms, std::vector<Event>& events)
+{
+    events.clear();
+
+    int rv = 0;
+    do {
+        rv = epoll_wait(epoll_fd_, ready_.data(), static_cast<int>(ready_.size()), timeout_ms);
+    } while (rv < 0 && IsInterrupted(LastSocketError()));
+
+    ENSURE(THROW, rv >= 0)(LastSocketError()).Require();
+
+    for (int i = 0; i < rv; ++i) {
+        auto revents = ready_[i].events;
+        unsigned int ready = 0;
+        if (revents & (EPOLLIN | EPOLLERR | EPOLLHUP)) {
+            ready |= SocketReadable;
+        }
+
+        if (revents & (EPOLLOUT | EPOLLERR | EPOLLHUP)) {
+            ready |= SocketWritable;
+        }
+
+        events.push_back(Event {ready_[i].data.u64, ready});
+    }
+
+    return events.size();
+}
+
+#else
+
+SocketPoller::SocketPoller() = default;
+
+SocketPoller::~SocketPoller() = default;
+
+void SocketPoller::Watch(SocketHandle socket, unsigned int events, uint64_t key)
+{
+    auto it = positions_.find(socket);
+    if (it == positions_.end()) {
+        it = positions_.emplace(socket, fds_.size()).first;
+        fds_.push_back(PollFd {});
+        keys_.push_back(0);
+    }
+
+    auto& fd = fds_[it->second];
+    fd.fd = socket;
+    fd.events = static_cast<short>(((events & SocketReadable) ? POLLIN : 0) |
+                                   ((events & SocketWritable) ? POLLOUT : 0));
+    fd.revents = 0;
+    keys_[it->second] = key;
+}
+
+void SocketPoller::Unwatch(SocketHandle socket, uint64_t key) noexcept
+{
+    auto it = positions_.find(socket);
+    if (it == positions_.end() || keys_[it->second] != key) {
+        return;
+    }
+
+    // The last socket takes the place of the removed one.
+    auto pos = it->second;
+    positions_.erase(it);
+    if (pos + 1 != fds_.size()) {
+        fds_[pos] = fds_.back();
+        keys_[pos] = keys_.back();
+        positions_[fds_[pos].fd] = pos;
+    }
+
+    fds_.pop_back();
+    keys_.pop_back();
+}
+
+size_t SocketPoller::Wait(int timeout_ms, std::vector<Event>& events)
+{
+    events.clear();
+
+    int rv = 0;
+    do {
+#if defined(_WIN32)
+        rv = WSAPoll(fds_.data(), static_cast<ULONG>(fds_.size()), timeout_ms);
+#else
+        rv = poll(fds_.data(), static_cast<nfds_t>(fds_.size()), timeout_ms);
+#endif
+    } while (rv < 0 && IsInterrupted(LastSocketError()));
+
+    ENSURE(THROW, rv >= 0)(LastSocketError()).Require();
+
+    for (size_t i = 0; i < fds_.size() && events.size() < static_cast<size_t>(rv); ++i) {
+        auto revents = fds_[i].revents;
+        if (revents == 0) {
+            continue;
+        }
+
+        unsigned int ready = 0;
+        if (revents & (POLLIN | POLLERR | POLLHUP | POLLNVAL)) {
+            ready |= SocketReadable;
+        }
+
+        if (revents & (POLLOUT | POLLERR | POLLHUP | POLLNVAL)) {
+            ready |= SocketWritable;
+        }
+
+        events.push_back(Event {keys_[i], ready});
+    }
+
+    return events.size();
+}
+
+#endif
+
+}   // namespace internal
+}   // namespace wat
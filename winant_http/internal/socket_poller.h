@@ -0,0 +1,85 @@
+/*
+ @ 0xCCCCCCCC
+*/
+
+#if defined(_MSC_VER)
+#pragma once
+#endif
+
+#ifndef WINANT_HTTP_INTERNAL_SOCKET_POLLER_H_
+#define WINANT_HTTP_INTERNAL_SOCKET_POLLER_H_
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include "kbase/basic_macros.h"
+
+#include "winant_http/internal/socket.h"
+
+#if defined(__linux__)
+#include <sys/epoll.h>
+#elif !defined(_WIN32)
+#include <poll.h>
+#endif
+
+namespace wat {
+namespace internal {
+
+// Waits on a set of sockets that is kept across waits, so that the sockets aren't handed to the
+// system all over again for every wait. Sockets are registered under a key, which is what a wait
+// reports them by.
+// On Linux the set lives in an epoll instance and a wait only looks at the ready sockets; on
+// other platforms the poll array is kept up to date in place.
+// Not thread-safe.
+class SocketPoller {
+public:
+    struct Event {
+        uint64_t key;
+        unsigned int ready;
+    };
+
+    SocketPoller();
+
+    ~SocketPoller();
+
+    DISALLOW_COPY(SocketPoller);
+
+    // Starts watching `socket` for `events` under `key`, or updates the registration.
+    // The system forgets a socket once it is closed, so a new socket that happens to get the
+    // descriptor of a closed one is registered afresh.
+    void Watch(SocketHandle socket, unsigned int events, uint64_t key);
+
+    // Stops watching `socket`, unless it has been registered under another key since.
+    void Unwatch(SocketHandle socket, uint64_t key) noexcept;
+
+    // Waits until any of the sockets becomes ready, and fills `events` with the ready ones;
+    // errors and hang-ups are reported as readiness.
+    // Returns the number of events, or 0 if timed out.
+    // A negative `timeout_ms` waits indefinitely.
+    size_t Wait(int timeout_ms, std::vector<Event>& events);
+
+private:
+#if defined(__linux__)
+    int epoll_fd_;
+    // The key each socket was last registered under.
+    std::unordered_map<SocketHandle, uint64_t> keys_;
+    std::vector<epoll_event> ready_;
+#else
+#if defined(_WIN32)
+    using PollFd = WSAPOLLFD;
+#else
+    using PollFd = pollfd;
+#endif
+
+    // Index of each socket into `fds_` and `keys_`.
+    std::unordered_map<SocketHandle, size_t> positions_;
+    std::vector<PollFd> fds_;
+    std::vector<uint64_t> keys_;
+#endif
+};
+
+}   // namespace internal
+}   // namespace wat
+
+#endif  // WINANT_HTTP_INTERNAL_SOCKET_POLLER_H_
@@ -0,0 +1,334 @@
+/*
+ @ 0xCCCCCCCC
+*/
+
+#include "winant_http/internal/socket_transport.h"
+
+#include "winant_http/internal/socket.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "kbase/error_exception_util.h"
+
+#include "winant_http/internal/connection_pool_impl.h"
+#include "winant_http/internal/content_decoder.h"
+#include "winant_http/internal/http_response_parser.h"
+#include "winant_http/internal/read_buffer.h"
+#include "winant_http/internal/request_body_reader.h"
+#include "winant_http/internal/request_timer.h"
+#include "winant_http/internal/response_body_buffer.h"
+#include "winant_http/winant_constants.h"
+#include "winant_http/winant_request.h"
+
+namespace {
+
+using wat::HttpRequest;
+using wat::RequestBody;
+
+constexpr size_t kSendChunkSize = 64 * 1024;
+
+// The number of buffers handed to one vectored write.
+constexpr size_t kMaxSendBuffers = 64;
+
+void AppendHeaderLine(std::string& buf, kbase::StringView name, kbase::StringView value)
+{
+    buf.append(name.data(), name.size());
+    buf.append(value.empty() ? ":" : ": ", value.empty() ? 1 : 2);
+    buf.append(value.data(), value.size());
+    buf.append("\r\n", 2);
+}
+
+void SendChunkedBody(wat::internal::SocketHandle socket, const RequestBody& body,
+                     wat::internal::SocketWaiter* waiter)
+{
+    using wat::internal::SendAll;
+
+    std::unique_ptr<char[]> buf(new char[kSendChunkSize]);
+    wat::internal::RequestBodyReader reader(body);
+    while (true) {
+        auto chunk = reader.Next(buf.get(), kSendChunkSize);
+        if (chunk.empty()) {
+            break;
+        }
+
+        char size_line[24];
+        int len = snprintf(size_line, sizeof(size_line), "%llx\r\n",
+                           static_cast<unsigned long long>(chunk.size()));
+        SendAll(socket, size_line, static_cast<size_t>(len), waiter);
+        SendAll(socket, chunk.data(), chunk.size(), waiter);
+        SendAll(socket, "\r\n", 2, waiter);
+    }
+
+    SendAll(socket, "0\r\n\r\n", 5, waiter);
+}
+
+// The head and the in-place data of the body, i.e. memory segments and mapped file segments,
+// are gathered into vectored writes, so that the payload is never copied in userspace.
+void SendRequest(wat::internal::SocketHandle socket, const std::string& head,
+                 const RequestBody& body, wat::internal::SocketWaiter* waiter)
+{
+    using wat::internal::SendVectored;
+
+    if (body.length() == RequestBody::kUnknownLength) {
+        wat::internal::SendAll(socket, head.data(), head.size(), waiter);
+        SendChunkedBody(socket, body, waiter);
+        return;
+    }
+
+    std::vector<kbase::StringView> pending;
+    pending.reserve(kMaxSendBuffers);
+    pending.emplace_back(head);
+
+    std::unique_ptr<char[]> buf(new char[kSendChunkSize]);
+    wat::internal::RequestBodyReader reader(body);
+    while (true) {
+        auto chunk = reader.Next(buf.get(), kSendChunkSize);
+        if (chunk.empty()) {
+            break;
+        }
+
+        // Data read into `buf` is overwritten by the next read, and thus must go out right away.
+        if (chunk.data() == buf.get()) {
+            pending.push_back(chunk);
+            SendVectored(socket, pending.data(), pending.size(), waiter);
+            pending.clear();
+            continue;
+        }
+
+        pending.push_back(chunk);
+        if (pending.size() == kMaxSendBuffers) {
+            SendVectored(socket, pending.data(), pending.size(), waiter);
+            pending.clear();
+        }
+    }
+
+    SendVectored(socket, pending.data(), pending.size(), waiter);
+}
+
+// Sends the request and waits for the first piece of the response.
+// Returns 0 if the peer closed the connection without responding.
+size_t SendAndReceiveFirst(wat::internal::SocketHandle socket, const std::string& head,
+                           const RequestBody& body, char* buf, size_t buf_size,
+                           wat::internal::RequestTimer& timer)
+{
+    using Phase = wat::internal::RequestTimer::Phase;
+
+    timer.Enter(Phase::Write);
+    SendRequest(socket, head, body, &timer);
+    timer.Enter(Phase::FirstByte);
+    return wat::internal::ReceiveSome(socket, buf, buf_size, &timer);
+}
+
+}   // namespace
+
+namespace wat {
+namespace internal {
+
+Endpoint GetEndpoint(const Url& url)
+{
+    ENSURE(THROW, url.is_valid())(url.spec()).Require();
+
+    Endpoint endpoint;
+
+    auto scheme = url.scheme();
+    endpoint.scheme.resize(scheme.size());
+    std::transform(scheme.begin(), scheme.end(), endpoint.scheme.begin(), [](char ch) {
+        return static_cast<char>(std::tolower(static_cast<unsigned char>(ch)));
+    });
+
+    endpoint.host = url.ascii_host();
+    auto port = url.EffectivePort();
+    ENSURE(THROW, port > 0)(url.spec()).Require();
+    endpoint.port = std::to_string(port);
+
+    if (url.HostIsIPv6Literal()) {
+        endpoint.authority.append(1, '[').append(endpoint.host).append(1, ']');
+    } else {
+        endpoint.authority = endpoint.host;
+    }
+
+    if (!url.port().empty()) {
+        endpoint.authority.append(1, ':').append(url.port().data(), url.port().size());
+    }
+
+    auto target = url.path_and_query();
+    if (target.empty() || target.front() != '/') {
+        endpoint.target.reserve(target.size() + 1);
+        endpoint.target.append(1, '/');
+    }
+
+    endpoint.target.append(target.data(), target.size());
+
+    return endpoint;
+}
+
+void EnsureNativeScheme(const Endpoint& endpoint)
+{
+    if (endpoint.scheme != "http") {
+        throw UnsupportedSchemeError(endpoint.scheme + " is not supported by the native transport");
+    }
+}
+
+void AppendRequestHead(const HttpRequest& request, const Endpoint& endpoint, std::string& buf)
+{
+    const auto& headers = request.headers();
+
+    buf.append(MethodToVerb(request.method()))
+       .append(1, ' ')
+       .append(endpoint.target)
+       .append(" HTTP/1.1\r\n");
+
+    if (!headers.HasHeader(Headers::Known::Host)) {
+        AppendHeaderLine(buf, "Host", endpoint.authority);
+    }
+
+    if (!headers.HasHeader(Headers::Known::UserAgent)) {
+        AppendHeaderLine(buf, "User-Agent", kWinAntUserAgentA);
+    }
+
+    if (DecodesContent(request)) {
+        AppendHeaderLine(buf, "Accept-Encoding", ContentDecoder::AcceptEncoding());
+    }
+
+    for (const auto& header : headers.views()) {
+        AppendHeaderLine(buf, header.first, header.second);
+    }
+
+    auto body_length = request.body().length();
+    if (body_length == RequestBody::kUnknownLength) {
+        AppendHeaderLine(buf, "Transfer-Encoding", "chunked");
+    } else if (body_length > 0 || request.method() == HttpRequest::Method::Post) {
+        AppendHeaderLine(buf, "Content-Length", std::to_string(body_length));
+    }
+
+    buf.append("\r\n", 2);
+}
+
+bool RequestsConnectionClose(const Headers& headers)
+{
+    std::string connection;
+    if (!headers.GetHeader(Headers::Known::Connection, connection)) {
+        return false;
+    }
+
+    for (auto& ch : connection) {
+        ch = static_cast<char>(std::tolower(static_cast<unsigned char>(ch)));
+    }
+
+    return connection.find("close") != std::string::npos;
+}
+
+HttpResponse SocketTransport::Send(const HttpRequest& request)
+{
+    auto endpoint = GetEndpoint(request.url());
+    EnsureNativeScheme(endpoint);
+
+    const auto& body = request.body();
+    std::string send_buf;
+    send_buf.reserve(512);
+    AppendRequestHead(request, endpoint, send_buf);
+
+    // Every wait on the socket goes through the timer, which thus enforces the timeouts and
+    // cancellation.
+    RequestTimer timer(request.timeouts(), request.cancellation_token());
+    timer.CheckCancelled();
+
+    const auto& pool = request.connection_pool() ? request.connection_pool() :
+                                                   ConnectionPool::Default();
+    auto connection = pool->impl().Acquire(endpoint, true, &timer);
+
+    ReadBuffer buf(request.read_buffer_size());
+    size_t received = 0;
+
+    // A reused connection may have been closed by the server while it was idle; in that case
+    // the request is sent again on a new connection, as no response byte has been seen yet.
+    // Bodies that can't be replayed have only one shot. Any other failure, e.g. a timeout or
+    // a body that can't be read, isn't the connection's fault, and is thrown as it is.
+    if (connection.reused() && body.replayable()) {
+        try {
+            received = SendAndReceiveFirst(connection.get(), send_buf, body, buf.data(),
+                                           buf.size(), timer);
+        } catch (const ConnectionClosedError&) {
+            received = 0;
+        }
+
+        if (received == 0) {
+            timer.Enter(RequestTimer::Phase::Connect);
+            connection = pool->impl().Acquire(endpoint, false, &timer);
+        }
+    }
+
+    if (received == 0) {
+        received = SendAndReceiveFirst(connection.get(), send_buf, body, buf.data(),
+                                       buf.size(), timer);
+    }
+
+    timer.Enter(RequestTimer::Phase::Read);
+
+    const auto& read_handler = request.read_response_handler();
+    bool save_body = !(request.load_flags().flags & LoadFlags::DoNotSaveResponseBody);
+    ResponseBodyBuffer response_body(request);
+
+    HttpResponseParser parser(request.method() == HttpRequest::Method::Head);
+    ResponseBodyDecoder decoder(request);
+    auto on_decoded = [&](const char* data, size_t size) {
+        if (save_body) {
+            response_body.Reserve(parser.content_length());
+            response_body.Append(data, size);
+        }
+
+        if (read_handler && size > 0) {
+            read_handler(data, static_cast<int>(size));
+        }
+    };
+
+    auto on_body = [&](const char* data, size_t size) {
+        decoder.Feed(parser.headers(), data, size, on_decoded);
+    };
+
+    bool unexpected_data = false;
+    try {
+        while (true) {
+            if (received == 0) {
+                ENSURE(THROW, parser.FinishOnEOF())(parser.headers_complete()).Require();
+                break;
+            }
+
+            auto consumed = parser.Feed(buf.data(), received, on_body);
+            if (parser.message_complete()) {
+                unexpected_data = consumed != received;
+                break;
+            }
+
+            // Data may keep coming without the socket ever being waited on.
+            timer.CheckCancelled();
+            buf.OnRead(received);
+            received = ReceiveSome(connection.get(), buf.data(), buf.size(), &timer);
+        }
+
+        decoder.Finish();
+    } catch (...) {
+        if (read_handler) {
+            read_handler(nullptr, -1);
+        }
+
+        throw;
+    }
+
+    if (read_handler) {
+        read_handler(buf.data(), 0);
+    }
+
+    connection.set_reusable(parser.keep_alive() && !unexpected_data &&
+                            !RequestsConnectionClose(request.headers()));
+
+    return response_body.ToResponse(parser.status_code(), std::move(parser.headers()));
+}
+
+}   // namespace internal
+}   // namespace wat
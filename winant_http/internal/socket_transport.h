@@ -0,0 +1,63 @@
+/*
+ @ 0xCCCCCCCC
+*/
+
+#if defined(_MSC_VER)
+#pragma once
+#endif
+
+#ifndef WINANT_HTTP_INTERNAL_SOCKET_TRANSPORT_H_
+#define WINANT_HTTP_INTERNAL_SOCKET_TRANSPORT_H_
+
+#include <string>
+
+#include "kbase/basic_macros.h"
+#include "kbase/string_view.h"
+
+#include "winant_http/internal/http_transport.h"
+#include "winant_http/winant_common_types.h"
+
+namespace wat {
+namespace internal {
+
+struct Endpoint {
+    std::string scheme;
+    std::string host;
+    std::string port;
+    // host[:port] as it appeared in the url, used for the Host header.
+    std::string authority;
+    // path[?query], without the fragment.
+    std::string target;
+};
+
+// Gets the pieces needed to reach the origin of an http(s) url.
+// Throws if the url is not valid.
+Endpoint GetEndpoint(const Url& url);
+
+// Throws an UnsupportedSchemeError unless `endpoint` is plain http, as there is no TLS.
+void EnsureNativeScheme(const Endpoint& endpoint);
+
+// Appends the request line and header fields of `request` to `buf`, including the blank line
+// terminating the header section.
+void AppendRequestHead(const HttpRequest& request, const Endpoint& endpoint, std::string& buf);
+
+// True if the request asks for the connection to be closed after it.
+bool RequestsConnectionClose(const Headers& headers);
+
+// A native HTTP/1.1 transport on top of non-blocking BSD sockets.
+// Only plain-text HTTP is supported.
+class SocketTransport : public HttpTransport {
+public:
+    SocketTransport() = default;
+
+    ~SocketTransport() = default;
+
+    DISALLOW_COPY(SocketTransport);
+
+    HttpResponse Send(const HttpRequest& request) override;
+};
+
+}   // namespace internal
+}   // namespace wat
+
+#endif  // WINANT_HTTP_INTERNAL_SOCKET_TRANSPORT_H_
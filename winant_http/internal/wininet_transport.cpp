@@ -0,0 +1,389 @@
+/*
+ @ 0xCCCCCCCC
+*/
+
+#include "winant_http/internal/wininet_transport.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <limits>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <Windows.h>
+#include <WinInet.h>
+
+#include "kbase/error_exception_util.h"
+#include "kbase/string_format.h"
+#include "kbase/string_util.h"
+
+#include "winant_http/internal/read_buffer.h"
+#include "winant_http/internal/request_body_reader.h"
+#include "winant_http/internal/response_body_buffer.h"
+#include "winant_http/winant_common_types.h"
+#include "winant_http/winant_constants.h"
+#include "winant_http/winant_request.h"
+
+namespace {
+
+using wat::CancellationToken;
+using wat::Headers;
+using wat::ReadBufferSize;
+using wat::ReadResponseHandler;
+using wat::RequestBody;
+using wat::internal::ReadBuffer;
+using wat::internal::ResponseBodyBuffer;
+
+bool ReadResponseHeaders(HINTERNET request, Headers& headers)
+{
+    DWORD header_size = 0;
+
+    HttpQueryInfoA(request, HTTP_QUERY_RAW_HEADERS_CRLF, nullptr, &header_size, nullptr);
+    kbase::LastError error;
+    ENSURE(CHECK, error.error_code() == ERROR_INSUFFICIENT_BUFFER)(error).Require();
+
+    std::string header_buf;
+    auto buf = kbase::WriteInto(header_buf, header_size);
+    BOOL success = HttpQueryInfoA(request, HTTP_QUERY_RAW_HEADERS_CRLF, buf, &header_size, nullptr);
+    if (!success) {
+        return false;
+    }
+
+    header_buf.resize(header_size);
+
+    // Skip the status line; the rest is parsed in place.
+    auto status_end = header_buf.find('\n');
+    header_buf.erase(0, status_end == std::string::npos ? header_buf.size() : status_end + 1);
+    headers = Headers::Parse(std::move(header_buf));
+
+    return true;
+}
+
+// Returns -1 if the response has no Content-Length, e.g. when it is chunked.
+int64_t QueryContentLength(HINTERNET request)
+{
+    char buf[32] {0};
+    DWORD size = sizeof(buf);
+    if (!HttpQueryInfoA(request, HTTP_QUERY_CONTENT_LENGTH, buf, &size, nullptr)) {
+        return -1;
+    }
+
+    char* end = nullptr;
+    auto length = std::strtoll(buf, &end, 10);
+    return end != buf && length >= 0 ? length : -1;
+}
+
+void CheckCancelled(const CancellationToken* token)
+{
+    if (token && token->cancelled()) {
+        throw wat::CancelledError();
+    }
+}
+
+// `response_body` might be nullptr, if you decide not to save the response body.
+// Throws a CancelledError, between reads, once `token` is cancelled.
+bool ReadResponseBody(HINTERNET request, ReadBufferSize buf_size,
+                      ResponseBodyBuffer* response_body, const ReadResponseHandler& read_handler,
+                      const CancellationToken* token)
+{
+    constexpr size_t kMaxReadSize = 1U << 30;
+    buf_size.size = std::min(buf_size.size, kMaxReadSize);
+    buf_size.max_size = std::min(buf_size.max_size, kMaxReadSize);
+    ReadBuffer buf(buf_size);
+
+    if (response_body) {
+        response_body->Reserve(QueryContentLength(request));
+    }
+
+    BOOL success = FALSE;
+    bool cancelled = false;
+    while (true) {
+        if (token && token->cancelled()) {
+            success = FALSE;
+            cancelled = true;
+            break;
+        }
+
+        DWORD bytes_read = 0;
+        success = InternetReadFile(request, buf.data(), static_cast<DWORD>(buf.size()),
+                                   &bytes_read);
+        if (!success || bytes_read == 0) {
+            break;
+        }
+
+        if (response_body) {
+            response_body->Append(buf.data(), bytes_read);
+        }
+
+        if (read_handler) {
+            read_handler(buf.data(), static_cast<int>(bytes_read));
+        }
+
+        buf.OnRead(bytes_read);
+    }
+
+    if (read_handler) {
+        if (success) {
+            read_handler(buf.data(), 0);
+        } else {
+            read_handler(nullptr, -1);
+        }
+    }
+
+    if (cancelled) {
+        throw wat::CancelledError();
+    }
+
+    return success == TRUE;
+}
+
+// Failures to reach the server are told apart, for they are safe to retry.
+void EnsureRequestSent(BOOL success)
+{
+    if (success == TRUE) {
+        return;
+    }
+
+    kbase::LastError error;
+    auto code = error.error_code();
+    if (code == ERROR_INTERNET_CANNOT_CONNECT || code == ERROR_INTERNET_NAME_NOT_RESOLVED) {
+        throw wat::ConnectError("Failed to connect, error " + std::to_string(code));
+    }
+
+    ENSURE(THROW, kbase::NotReached())(error).Require();
+}
+
+void WriteRequestData(HINTERNET request, const char* data, size_t size)
+{
+    constexpr size_t kMaxWriteSize = 1U << 30;
+
+    while (size > 0) {
+        DWORD written = 0;
+        BOOL success = InternetWriteFile(request, data,
+                                         static_cast<DWORD>(std::min(size, kMaxWriteSize)),
+                                         &written);
+        ENSURE(THROW, success == TRUE)(kbase::LastError()).Require();
+        data += written;
+        size -= written;
+    }
+}
+
+// Streams the body with InternetWriteFile, so that it never has to be in memory as a whole.
+// WinINet knows nothing about chunked uploads, and thus we frame the chunks on our own.
+// Throws a CancelledError, between chunks, once `token` is cancelled.
+void SendStreamingBody(HINTERNET request, const RequestBody& body,
+                       const CancellationToken* token)
+{
+    constexpr size_t kChunkSize = 64 * 1024;
+
+    auto body_length = body.length();
+    bool chunked = body_length == RequestBody::kUnknownLength;
+    auto length_header = chunked ? std::string("Transfer-Encoding: chunked\r\n") :
+                                   "Content-Length: " + std::to_string(body_length) + "\r\n";
+    BOOL success = HttpAddRequestHeadersA(request,
+                                          length_header.data(),
+                                          static_cast<DWORD>(length_header.size()),
+                                          HTTP_ADDREQ_FLAG_ADD | HTTP_ADDREQ_FLAG_REPLACE);
+    ENSURE(THROW, success == TRUE)(kbase::LastError()).Require();
+
+    EnsureRequestSent(HttpSendRequestExA(request, nullptr, nullptr, 0, 0));
+
+    std::unique_ptr<char[]> buf(new char[kChunkSize]);
+    wat::internal::RequestBodyReader reader(body);
+    while (true) {
+        CheckCancelled(token);
+        auto chunk = reader.Next(buf.get(), kChunkSize);
+        if (chunk.empty()) {
+            break;
+        }
+
+        if (chunked) {
+            auto size_line = kbase::StringPrintf("%llx\r\n",
+                                                 static_cast<unsigned long long>(chunk.size()));
+            WriteRequestData(request, size_line.data(), size_line.size());
+            WriteRequestData(request, chunk.data(), chunk.size());
+            WriteRequestData(request, "\r\n", 2);
+        } else {
+            WriteRequestData(request, chunk.data(), chunk.size());
+        }
+    }
+
+    if (chunked) {
+        WriteRequestData(request, "0\r\n\r\n", 5);
+    }
+
+    success = HttpEndRequestW(request, nullptr, 0, 0);
+    ENSURE(THROW, success == TRUE)(kbase::LastError()).Require();
+}
+
+// WinINet decodes gzip and deflate bodies on its own, as they are read, once asked to; it doesn't
+// ask for them though.
+void EnableContentDecoding(HINTERNET request)
+{
+    BOOL enable = TRUE;
+    BOOL success = InternetSetOptionW(request, INTERNET_OPTION_HTTP_DECODING, &enable,
+                                      sizeof(enable));
+    ENSURE(THROW, success == TRUE)(kbase::LastError()).Require();
+
+    constexpr char kAcceptEncoding[] = "Accept-Encoding: gzip, deflate\r\n";
+    success = HttpAddRequestHeadersA(request, kAcceptEncoding, sizeof(kAcceptEncoding) - 1,
+                                     HTTP_ADDREQ_FLAG_ADD);
+    ENSURE(THROW, success == TRUE)(kbase::LastError()).Require();
+}
+
+// Limits left at 0 keep the defaults of WinINet, unless the total caps them.
+DWORD ToWinINetTimeout(wat::Timeouts::Duration timeout, wat::Timeouts::Duration total)
+{
+    if (total.count() > 0 && (timeout.count() == 0 || timeout > total)) {
+        timeout = total;
+    }
+
+    return static_cast<DWORD>(std::min<wat::Timeouts::Duration::rep>(
+        timeout.count(), std::numeric_limits<DWORD>::max()));
+}
+
+void SetTimeoutOption(HINTERNET request, DWORD option, DWORD timeout)
+{
+    if (timeout == 0) {
+        return;
+    }
+
+    BOOL success = InternetSetOptionW(request, option, &timeout, sizeof(timeout));
+    ENSURE(THROW, success == TRUE)(option)(kbase::LastError()).Require();
+}
+
+// WinINet has no deadlines, and thus each limit becomes the timeout of the calls it bounds.
+// The receive timeout covers both the wait for the response and gaps in it, and is set only if
+// both of them are bounded.
+void ApplyTimeouts(HINTERNET request, const wat::Timeouts& timeouts)
+{
+    auto receive = timeouts.first_byte.count() == 0 || timeouts.idle_read.count() == 0 ?
+                       wat::Timeouts::Duration(0) :
+                       std::max(timeouts.first_byte, timeouts.idle_read);
+    SetTimeoutOption(request, INTERNET_OPTION_CONNECT_TIMEOUT,
+                     ToWinINetTimeout(timeouts.connect, timeouts.total));
+    SetTimeoutOption(request, INTERNET_OPTION_SEND_TIMEOUT,
+                     ToWinINetTimeout(timeouts.write, timeouts.total));
+    SetTimeoutOption(request, INTERNET_OPTION_RECEIVE_TIMEOUT,
+                     ToWinINetTimeout(receive, timeouts.total));
+}
+
+// WinINet keeps alive connections only for as long as the handle returned by InternetOpen lives,
+// so all requests share one for the lifetime of the process.
+HINTERNET SharedInternetEnv()
+{
+    static wat::internal::ScopedInternetHandle inet_env(InternetOpenW(wat::kWinAntUserAgent,
+                                                                      INTERNET_OPEN_TYPE_DIRECT,
+                                                                      nullptr,
+                                                                      nullptr,
+                                                                      0));
+    ENSURE(THROW, !!inet_env)(kbase::LastError()).Require();
+    return inet_env.get();
+}
+
+}   // namespace
+
+namespace wat {
+namespace internal {
+
+HttpResponse WinINetTransport::Send(const HttpRequest& request)
+{
+    const auto& url = request.url();
+    ENSURE(THROW, url.is_valid())(url.spec()).Require();
+    auto port = url.EffectivePort();
+    ENSURE(THROW, port > 0)(url.spec()).Require();
+    CheckCancelled(request.cancellation_token());
+
+    // The request stays in narrow strings all the way; WinINet takes them as they are.
+    auto host = url.ascii_host();
+    std::string target;
+    auto path_and_query = url.path_and_query();
+    if (path_and_query.empty() || path_and_query.front() != '/') {
+        target.reserve(path_and_query.size() + 1);
+        target.push_back('/');
+    }
+
+    target.append(path_and_query.data(), path_and_query.size());
+
+    // Open a HTTP session.
+    conn_session_.reset(InternetConnectA(SharedInternetEnv(),
+                                         host.c_str(),
+                                         static_cast<INTERNET_PORT>(port),
+                                         nullptr,
+                                         nullptr,
+                                         INTERNET_SERVICE_HTTP,
+                                         0,
+                                         0));
+    ENSURE(THROW, !!conn_session_)(kbase::LastError()).Require();
+
+    // We finally can create a HTTP request now.
+    DWORD http_open_flag = url.SchemeIs("https") ? INTERNET_FLAG_SECURE : 0;
+    request_.reset(HttpOpenRequestA(conn_session_.get(),
+                                    MethodToVerb(request.method()),
+                                    target.c_str(),
+                                    nullptr,
+                                    nullptr,
+                                    nullptr,
+                                    http_open_flag,
+                                    0));
+    ENSURE(THROW, !!request_)(kbase::LastError()).Require();
+
+    if (!request.timeouts().empty()) {
+        ApplyTimeouts(request_.get(), request.timeouts());
+    }
+
+    if (!(request.load_flags().flags & LoadFlags::DoNotDecodeResponse) &&
+        !request.headers().HasHeader(Headers::Known::AcceptEncoding)) {
+        EnableContentDecoding(request_.get());
+    }
+
+    BOOL success = FALSE;
+    if (!request.headers().empty()) {
+        auto headers_content = request.headers().ToString();
+        success = HttpAddRequestHeadersA(request_.get(),
+                                         headers_content.data(),
+                                         static_cast<DWORD>(headers_content.size()),
+                                         HTTP_ADDREQ_FLAG_ADD | HTTP_ADDREQ_FLAG_REPLACE);
+        ENSURE(THROW, success == TRUE)(kbase::LastError())(headers_content).Require();
+    }
+
+    const auto& body = request.body();
+    kbase::StringView contiguous_body;
+    if (body.empty() || body.AsContiguous(contiguous_body)) {
+        ENSURE(CHECK, contiguous_body.size() <= std::numeric_limits<DWORD>::max())
+            (contiguous_body.size()).Require();
+        EnsureRequestSent(HttpSendRequestA(request_.get(), nullptr, 0,
+                                           const_cast<char*>(contiguous_body.data()),
+                                           static_cast<DWORD>(contiguous_body.size())));
+    } else {
+        SendStreamingBody(request_.get(), body, request.cancellation_token());
+    }
+
+    // Read response then.
+    CheckCancelled(request.cancellation_token());
+
+    int response_status_code = 0;
+    DWORD status_code_size = sizeof(response_status_code);
+    success = HttpQueryInfoW(request_.get(), HTTP_QUERY_STATUS_CODE | HTTP_QUERY_FLAG_NUMBER,
+                             &response_status_code, &status_code_size, nullptr);
+    ENSURE(THROW, success == TRUE)(kbase::LastError()).Require();
+
+    Headers response_headers;
+    bool complete = ReadResponseHeaders(request_.get(), response_headers);
+    ENSURE(CHECK, complete)(kbase::LastError()).Require();
+
+    ResponseBodyBuffer response_body(request);
+    auto body_ptr = (request.load_flags().flags & LoadFlags::DoNotSaveResponseBody) ?
+                        nullptr : &response_body;
+    complete = ReadResponseBody(request_.get(), request.read_buffer_size(), body_ptr,
+                                request.read_response_handler(), request.cancellation_token());
+    ENSURE(CHECK, complete)(kbase::LastError()).Require();
+
+    return response_body.ToResponse(response_status_code, std::move(response_headers));
+}
+
+}   // namespace internal
+}   // namespace wat
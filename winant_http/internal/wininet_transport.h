@@ -0,0 +1,40 @@
+/*
+ @ 0xCCCCCCCC
+*/
+
+#if defined(_MSC_VER)
+#pragma once
+#endif
+
+#ifndef WINANT_HTTP_INTERNAL_WININET_TRANSPORT_H_
+#define WINANT_HTTP_INTERNAL_WININET_TRANSPORT_H_
+
+#include "kbase/basic_macros.h"
+
+#include "winant_http/internal/http_transport.h"
+#include "winant_http/internal/scoped_internet_handle.h"
+
+namespace wat {
+namespace internal {
+
+// Carries out requests with WinINet, which also takes care of HTTPS and system proxy settings.
+// Connection reuse is left to WinINet, and `ConnectionPool` only applies to the native transport.
+class WinINetTransport : public HttpTransport {
+public:
+    WinINetTransport() = default;
+
+    ~WinINetTransport() = default;
+
+    DISALLOW_COPY(WinINetTransport);
+
+    HttpResponse Send(const HttpRequest& request) override;
+
+private:
+    ScopedInternetHandle conn_session_;
+    ScopedInternetHandle request_;
+};
+
+}   // namespace internal
+}   // namespace wat
+
+#endif  // WINANT_HTTP_INTERNAL_WININET_TRANSPORT_H_
@@ -0,0 +1,80 @@
+/*
+ @ 0xCCCCCCCC
+*/
+
+#include "winant_http/internal/worker_pool.h"
+
+#include <utility>
+
+#include "kbase/error_exception_util.h"
+
+namespace wat {
+namespace internal {
+
+WorkerPool::WorkerPool(size_t max_threads)
+    : max_threads_(max_threads), idle_threads_(0), quit_(false)
+{
+    ENSURE(CHECK, max_threads > 0).Require();
+}
+
+WorkerPool::~WorkerPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        quit_ = true;
+    }
+
+    task_available_.notify_all();
+    for (auto& thread : threads_) {
+        thread.join();
+    }
+}
+
+void WorkerPool::Post(std::function<void()> task)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        tasks_.push_back(std::move(task));
+        if (idle_threads_ < tasks_.size() && threads_.size() < max_threads_) {
+            try {
+                threads_.emplace_back(&WorkerPool::Work, this);
+            } catch (...) {
+                // The task waits for a running thread instead.
+                if (threads_.empty()) {
+                    tasks_.pop_back();
+                    throw;
+                }
+            }
+        }
+    }
+
+    task_available_.notify_one();
+}
+
+void WorkerPool::Work()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true) {
+        ++idle_threads_;
+        task_available_.wait(lock, [this] {
+            return quit_ || !tasks_.empty();
+        });
+        --idle_threads_;
+
+        if (quit_) {
+            return;
+        }
+
+        auto task = std::move(tasks_.front());
+        tasks_.pop_front();
+
+        lock.unlock();
+        task();
+        // Destroyed before the lock is taken again, as it may post tasks.
+        task = nullptr;
+        lock.lock();
+    }
+}
+
+}   // namespace internal
+}   // namespace wat
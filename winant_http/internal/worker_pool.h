@@ -0,0 +1,55 @@
+/*
+ @ 0xCCCCCCCC
+*/
+
+#if defined(_MSC_VER)
+#pragma once
+#endif
+
+#ifndef WINANT_HTTP_INTERNAL_WORKER_POOL_H_
+#define WINANT_HTTP_INTERNAL_WORKER_POOL_H_
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "kbase/basic_macros.h"
+
+namespace wat {
+namespace internal {
+
+// Runs blocking tasks, e.g. WinINet requests, on at most a given number of threads; tasks beyond
+// that wait in line. Threads are started as tasks come in, and kept for the life of the pool.
+class WorkerPool {
+public:
+    explicit WorkerPool(size_t max_threads);
+
+    // Waits for the running tasks to finish; pending ones are dropped.
+    ~WorkerPool();
+
+    DISALLOW_COPY(WorkerPool);
+
+    // `task` must not throw.
+    // Thread-safe.
+    void Post(std::function<void()> task);
+
+private:
+    void Work();
+
+private:
+    size_t max_threads_;
+    std::mutex mutex_;
+    std::condition_variable task_available_;
+    std::deque<std::function<void()>> tasks_;
+    std::vector<std::thread> threads_;
+    size_t idle_threads_;
+    bool quit_;
+};
+
+}   // namespace internal
+}   // namespace wat
+
+#endif  // WINANT_HTTP_INTERNAL_WORKER_POOL_H_
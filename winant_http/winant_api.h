@@ -9,6 +9,8 @@
 #ifndef WINANT_HTTP_WINANT_API_H_
 #define WINANT_HTTP_WINANT_API_H_
 
+#include <future>
+
 #include "winant_http/winant_request.h"
 #include "winant_http/winant_request_builder.h"
 #include "winant_http/winant_response.h"
@@ -65,6 +67,33 @@ HttpResponse Head(Args&&... args)
     return request.Start();
 }
 
+// Asynchronous variants return immediately, and the response is delivered through the future, or
+// additionally through a CompletionHandler option.
+
+template<typename ...Args>
+std::future<HttpResponse> GetAsync(Args&&... args)
+{
+    HttpRequest request = internal::BuildRequest(HttpRequest::Method::Get,
+                                                 std::forward<Args>(args)...);
+    return std::move(request).StartAsync();
+}
+
+template<typename ...Args>
+std::future<HttpResponse> PostAsync(Args&&... args)
+{
+    HttpRequest request = internal::BuildRequest(HttpRequest::Method::Post,
+                                                 std::forward<Args>(args)...);
+    return std::move(request).StartAsync();
+}
+
+template<typename ...Args>
+std::future<HttpResponse> HeadAsync(Args&&... args)
+{
+    HttpRequest request = internal::BuildRequest(HttpRequest::Method::Head,
+                                                 std::forward<Args>(args)...);
+    return std::move(request).StartAsync();
+}
+
 }   // namespace wat
 
 #endif  // WINANT_HTTP_WINANT_API_H_
@@ -0,0 +1,271 @@
+/*
+ @ 0xCCCCCCCC
+*/
+
+#include "winant_http/winant_batch.h"
+
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+
+#include "winant_http/internal/http_transport.h"
+#include "winant_http/internal/pipeline_exchange.h"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+// Requests started together; more than one request indicates a pipeline.
+using Unit = std::vector<size_t>;
+
+struct HostQueue {
+    std::deque<Unit> pending;
+    size_t in_flight {0};
+};
+
+// Shared with completion handlers, which may still be unwinding when Run() returns.
+struct RunState {
+    explicit RunState(size_t max_in_flight_per_host)
+        : max_in_flight_per_host(max_in_flight_per_host)
+    {}
+
+    // Called with the state locked.
+    void MarkReady(HostQueue& host)
+    {
+        if (!host.pending.empty() &&
+            (max_in_flight_per_host == 0 || host.in_flight < max_in_flight_per_host)) {
+            ready.emplace(host.pending.front().front(), &host);
+        }
+    }
+
+    std::mutex mutex;
+    std::condition_variable completion;
+    size_t max_in_flight_per_host;
+    size_t in_flight {0};
+    size_t completed {0};
+    std::unordered_map<std::string, HostQueue> hosts;
+    // Hosts that have a unit to start and room for it, by the first request of the unit, so that
+    // units are started in the order of their first requests and a completion only has to look
+    // at its own host.
+    std::map<size_t, HostQueue*> ready;
+    size_t resent {0};
+};
+
+std::string GetHostKey(const wat::HttpRequest& request)
+{
+    const auto& url = request.url();
+    if (!url.is_valid()) {
+        // The request is going to fail on its own.
+        return std::string();
+    }
+
+    return url.ascii_host() + ":" + std::to_string(url.EffectivePort());
+}
+
+}   // namespace
+
+namespace wat {
+
+Batch::Batch()
+    : Batch(Options())
+{}
+
+Batch::Batch(Options options)
+    : options_(std::move(options))
+{
+    options_.max_in_flight = std::max<size_t>(options_.max_in_flight, 1);
+    options_.max_pipeline_depth = std::max<size_t>(options_.max_pipeline_depth, 1);
+}
+
+Batch& Batch::Add(HttpRequest request)
+{
+    requests_.push_back(std::move(request));
+    return *this;
+}
+
+Batch& Batch::Add(std::vector<HttpRequest> requests)
+{
+    for (auto& request : requests) {
+        requests_.push_back(std::move(request));
+    }
+
+    return *this;
+}
+
+std::vector<BatchResult> Batch::Run()
+{
+    auto requests = std::move(requests_);
+    requests_.clear();
+
+    stats_ = BatchStats();
+    std::vector<BatchResult> results(requests.size());
+    if (requests.empty()) {
+        return results;
+    }
+
+    auto pool = options_.pool;
+    if (!pool) {
+        ConnectionPool::Options pool_options;
+        pool_options.max_idle_per_host = options_.max_in_flight_per_host != 0 ?
+            std::min(options_.max_in_flight_per_host, options_.max_in_flight) :
+            options_.max_in_flight;
+        pool = std::make_shared<ConnectionPool>(pool_options);
+    }
+
+    auto pool_stats = pool->stats();
+
+    std::vector<std::string> host_keys;
+    host_keys.reserve(requests.size());
+    for (auto& request : requests) {
+        host_keys.push_back(GetHostKey(request));
+        if (!request.connection_pool()) {
+            request.SetConnectionPool(pool);
+        }
+    }
+
+    auto state = std::make_shared<RunState>(options_.max_in_flight_per_host);
+    std::unordered_map<std::string, Unit*> open_pipelines;
+    for (size_t i = 0; i < requests.size(); ++i) {
+        auto& pending = state->hosts[host_keys[i]].pending;
+        if (!options_.pipelining || !internal::CanPipelineRequest(requests[i])) {
+            pending.push_back(Unit{i});
+            continue;
+        }
+
+        auto& pipeline = open_pipelines[host_keys[i]];
+        if (!pipeline || pipeline->size() == options_.max_pipeline_depth) {
+            pending.push_back(Unit());
+            pipeline = &pending.back();
+        }
+
+        pipeline->push_back(i);
+    }
+
+    for (auto& host : state->hosts) {
+        state->MarkReady(host.second);
+    }
+
+    auto start_time = Clock::now();
+
+    auto finish_unit = [state](const std::string& host_key, size_t resent) {
+        std::lock_guard<std::mutex> lock(state->mutex);
+        auto& host = state->hosts[host_key];
+        --state->in_flight;
+        --host.in_flight;
+        state->MarkReady(host);
+        state->resent += resent;
+        ++state->completed;
+        state->completion.notify_all();
+    };
+
+    auto start_request = [&](size_t index) {
+        auto started = Clock::now();
+        internal::SendHttpRequestAsync(
+            std::move(requests[index]),
+            [&results, &host_keys, finish_unit, index, started](HttpResponse* response,
+                                                                std::exception_ptr error) {
+                auto& result = results[index];
+                if (response) {
+                    result.response = std::move(*response);
+                } else {
+                    result.error = error;
+                }
+
+                result.latency = std::chrono::duration_cast<std::chrono::microseconds>(
+                    Clock::now() - started);
+                finish_unit(host_keys[index], 0);
+            });
+    };
+
+    auto start_pipeline = [&](const Unit& unit) {
+        auto started = Clock::now();
+        std::vector<HttpRequest> pipelined;
+        for (auto index : unit) {
+            pipelined.push_back(std::move(requests[index]));
+        }
+
+        const auto& host_key = host_keys[unit.front()];
+        internal::SendPipelinedAsync(
+            std::move(pipelined),
+            [&results, unit, started](size_t i, HttpResponse* response, std::exception_ptr error) {
+                // Each request of the unit is completed once and before the unit is done.
+                auto& result = results[unit[i]];
+                if (response) {
+                    result.response = std::move(*response);
+                } else {
+                    result.error = error;
+                }
+
+                result.latency = std::chrono::duration_cast<std::chrono::microseconds>(
+                    Clock::now() - started);
+            },
+            [finish_unit, host_key](size_t resent) {
+                finish_unit(host_key, resent);
+            });
+    };
+
+    std::unique_lock<std::mutex> lock(state->mutex);
+    while (true) {
+        auto completed = state->completed;
+        while (!state->ready.empty() && state->in_flight < options_.max_in_flight) {
+            auto next = state->ready.begin();
+            auto& host = *next->second;
+            state->ready.erase(next);
+
+            auto unit = std::move(host.pending.front());
+            host.pending.pop_front();
+            ++host.in_flight;
+            ++state->in_flight;
+            state->MarkReady(host);
+
+            // Starting a request may resolve names or wait for the pool.
+            lock.unlock();
+            if (unit.size() == 1) {
+                start_request(unit.front());
+            } else {
+                stats_.requests_pipelined += unit.size();
+                start_pipeline(unit);
+            }
+
+            lock.lock();
+        }
+
+        // With nothing in flight, every host has room, and thus is ready if it has units left.
+        if (state->ready.empty() && state->in_flight == 0) {
+            break;
+        }
+
+        state->completion.wait(lock, [&state, completed] {
+            return state->completed != completed;
+        });
+    }
+
+    stats_.requests_resent = state->resent;
+    lock.unlock();
+
+    stats_.elapsed = std::chrono::duration_cast<std::chrono::microseconds>(
+        Clock::now() - start_time);
+    stats_.min_latency = std::chrono::microseconds::max();
+    std::chrono::microseconds total_latency(0);
+    for (const auto& result : results) {
+        result.succeeded() ? ++stats_.succeeded : ++stats_.failed;
+        stats_.min_latency = std::min(stats_.min_latency, result.latency);
+        stats_.max_latency = std::max(stats_.max_latency, result.latency);
+        total_latency += result.latency;
+    }
+
+    stats_.mean_latency = total_latency / static_cast<int64_t>(results.size());
+
+    auto pool_stats_after = pool->stats();
+    stats_.connections_opened = pool_stats_after.misses - pool_stats.misses;
+    stats_.connections_reused = pool_stats_after.hits - pool_stats.hits;
+
+    return results;
+}
+
+}   // namespace wat
@@ -0,0 +1,149 @@
+/*
+ @ 0xCCCCCCCC
+*/
+
+#if defined(_MSC_VER)
+#pragma once
+#endif
+
+#ifndef WINANT_HTTP_WINANT_BATCH_H_
+#define WINANT_HTTP_WINANT_BATCH_H_
+
+#include <chrono>
+#include <cstdint>
+#include <exception>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "kbase/basic_macros.h"
+
+#include "winant_http/winant_api.h"
+#include "winant_http/winant_connection_pool.h"
+#include "winant_http/winant_request.h"
+#include "winant_http/winant_response.h"
+
+namespace wat {
+
+struct BatchResult {
+    // Meaningful only if `error` is null.
+    HttpResponse response;
+
+    // The exception the request failed with.
+    std::exception_ptr error;
+
+    // From the request being started until its response was complete.
+    std::chrono::microseconds latency;
+
+    BatchResult()
+        : response(0, Headers(), std::string()), latency(0)
+    {}
+
+    bool succeeded() const noexcept
+    {
+        return !error;
+    }
+};
+
+struct BatchStats {
+    size_t succeeded {0};
+    size_t failed {0};
+
+    // Wall time of the whole batch.
+    std::chrono::microseconds elapsed {0};
+
+    std::chrono::microseconds min_latency {0};
+    std::chrono::microseconds max_latency {0};
+    std::chrono::microseconds mean_latency {0};
+
+    // Connections the batch opened and reused, as seen by its connection pool.
+    uint64_t connections_opened {0};
+    uint64_t connections_reused {0};
+
+    // Requests sent in a pipeline, and the number of times pipelined requests were resent
+    // after a connection closed before answering them.
+    size_t requests_pipelined {0};
+    size_t requests_resent {0};
+};
+
+// Runs independent requests concurrently, bounded by a total and a per-host in-flight limit,
+// and collects their responses in the order the requests were added.
+// Requests without a connection pool of their own share the pool of the batch.
+class Batch {
+public:
+    struct Options {
+        // The max number of requests in flight.
+        size_t max_in_flight {16};
+
+        // The max number of requests in flight to the same host and port; 0 indicates no limit
+        // other than `max_in_flight`.
+        size_t max_in_flight_per_host {6};
+
+        // A pool private to the batch is used if not specified.
+        std::shared_ptr<ConnectionPool> pool;
+
+        // If enabled, consecutive GET and HEAD requests to the same host without a body are
+        // pipelined on one connection, in groups of up to `max_pipeline_depth` requests.
+        // A group counts as one request towards the in-flight limits.
+        // Servers that close the connection early are tolerated, since unanswered requests are
+        // sent again; but servers that mishandle pipelined requests are not.
+        bool pipelining {false};
+        size_t max_pipeline_depth {8};
+    };
+
+    Batch();
+
+    explicit Batch(Options options);
+
+    ~Batch() = default;
+
+    DISALLOW_COPY(Batch);
+
+    DEFAULT_MOVE(Batch);
+
+    Batch& Add(HttpRequest request);
+
+    Batch& Add(std::vector<HttpRequest> requests);
+
+    template<typename ...Args>
+    Batch& AddGet(Args&&... args)
+    {
+        return Add(internal::BuildRequest(HttpRequest::Method::Get, std::forward<Args>(args)...));
+    }
+
+    template<typename ...Args>
+    Batch& AddPost(Args&&... args)
+    {
+        return Add(internal::BuildRequest(HttpRequest::Method::Post, std::forward<Args>(args)...));
+    }
+
+    template<typename ...Args>
+    Batch& AddHead(Args&&... args)
+    {
+        return Add(internal::BuildRequest(HttpRequest::Method::Head, std::forward<Args>(args)...));
+    }
+
+    size_t size() const noexcept
+    {
+        return requests_.size();
+    }
+
+    // Runs all requests added so far and blocks until every one has finished.
+    // The batch is empty afterwards and can be reused.
+    std::vector<BatchResult> Run();
+
+    // Stats of the last run.
+    const BatchStats& stats() const noexcept
+    {
+        return stats_;
+    }
+
+private:
+    Options options_;
+    std::vector<HttpRequest> requests_;
+    BatchStats stats_;
+};
+
+}   // namespace wat
+
+#endif  // WINANT_HTTP_WINANT_BATCH_H_
@@ -0,0 +1,103 @@
+/*
+ @ 0xCCCCCCCC
+*/
+
+#include "winant_http/winant_buffer_pool.h"
+
+#include <algorithm>
+#include <new>
+
+namespace {
+
+// Smaller buffers are cheap to allocate and not worth keeping.
+constexpr size_t kMinRecycledSize = 1024;
+
+}   // namespace
+
+namespace wat {
+
+BufferPool::BufferPool()
+    : BufferPool(Options())
+{}
+
+BufferPool::BufferPool(const Options& options)
+    : options_(options)
+{}
+
+// static
+const std::shared_ptr<BufferPool>& BufferPool::Default()
+{
+    static const std::shared_ptr<BufferPool> default_pool = std::make_shared<BufferPool>();
+    return default_pool;
+}
+
+std::string BufferPool::Acquire(size_t size_hint)
+{
+    auto capacity = size_hint != 0 ? std::min(size_hint, options_.max_buffer_size) :
+                                     options_.initial_buffer_size;
+
+    std::string buf;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        ++stats_.acquired;
+        if (!idle_.empty()) {
+            // The smallest buffer that fits, or the largest one, which is grown below.
+            auto it = idle_.lower_bound(capacity);
+            if (it == idle_.end()) {
+                --it;
+            }
+
+            buf = std::move(it->second);
+            idle_.erase(it);
+            ++stats_.reused;
+        }
+    }
+
+    if (buf.capacity() < capacity) {
+        Grow(buf, capacity);
+    }
+
+    return buf;
+}
+
+void BufferPool::Grow(std::string& buf, size_t capacity)
+{
+    if (buf.capacity() >= capacity) {
+        return;
+    }
+
+    buf.reserve(std::max(capacity, buf.capacity() * 2));
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    ++stats_.allocations;
+}
+
+void BufferPool::Recycle(std::string buf) noexcept
+{
+    if (buf.capacity() < kMinRecycledSize || buf.capacity() > options_.max_buffer_size) {
+        return;
+    }
+
+    buf.clear();
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (idle_.size() < options_.max_idle_buffers) {
+        try {
+            idle_.emplace(buf.capacity(), std::move(buf));
+        } catch (const std::bad_alloc&) {}
+    }
+}
+
+BufferPool::Stats BufferPool::stats() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return stats_;
+}
+
+size_t BufferPool::idle_count() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return idle_.size();
+}
+
+}   // namespace wat
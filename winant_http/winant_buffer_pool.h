@@ -0,0 +1,92 @@
+/*
+ @ 0xCCCCCCCC
+*/
+
+#if defined(_MSC_VER)
+#pragma once
+#endif
+
+#ifndef WINANT_HTTP_WINANT_BUFFER_POOL_H_
+#define WINANT_HTTP_WINANT_BUFFER_POOL_H_
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+
+#include "kbase/basic_macros.h"
+
+namespace wat {
+
+// Recycles the storage of response bodies, so that a steady stream of responses doesn't
+// allocate and grow a fresh buffer for each body.
+// A response gives its body buffer back to the pool it came from when it is destroyed.
+// A pool is thread-safe and can be shared by requests through `HttpRequestBuilder::SetOption()`;
+// requests without an explicit pool use the process-wide default one.
+class BufferPool {
+public:
+    struct Options {
+        // The max number of idle buffers kept.
+        size_t max_idle_buffers {32};
+
+        // Buffers larger than this are released rather than kept.
+        // Also caps the capacity reserved upfront for a body of known length.
+        size_t max_buffer_size {4 * 1024 * 1024};
+
+        // The capacity of a buffer for a body of unknown length.
+        size_t initial_buffer_size {16 * 1024};
+    };
+
+    struct Stats {
+        // Buffers handed out.
+        uint64_t acquired {0};
+
+        // Buffers handed out from the idle ones.
+        uint64_t reused {0};
+
+        // Heap allocations, i.e. new buffers plus every time a buffer had to grow.
+        uint64_t allocations {0};
+    };
+
+    BufferPool();
+
+    explicit BufferPool(const Options& options);
+
+    ~BufferPool() = default;
+
+    DISALLOW_COPY(BufferPool);
+
+    DISALLOW_MOVE(BufferPool);
+
+    static const std::shared_ptr<BufferPool>& Default();
+
+    // Returns an empty buffer with at least the given capacity, or with the initial capacity if
+    // `size_hint` is 0.
+    std::string Acquire(size_t size_hint);
+
+    // Grows `buf`, which came from Acquire(), so that it can hold at least `capacity` bytes.
+    void Grow(std::string& buf, size_t capacity);
+
+    void Recycle(std::string buf) noexcept;
+
+    Stats stats() const;
+
+    size_t idle_count() const;
+
+    const Options& options() const noexcept
+    {
+        return options_;
+    }
+
+private:
+    Options options_;
+    mutable std::mutex mutex_;
+    // Idle buffers keyed by capacity.
+    std::multimap<size_t, std::string> idle_;
+    Stats stats_;
+};
+
+}   // namespace wat
+
+#endif  // WINANT_HTTP_WINANT_BUFFER_POOL_H_
@@ -0,0 +1,70 @@
+/*
+ @ 0xCCCCCCCC
+*/
+
+#include "winant_http/winant_cancellation_token.h"
+
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <utility>
+
+namespace wat {
+
+struct CancellationToken::State {
+    std::atomic<bool> cancelled {false};
+    std::mutex mutex;
+    uint64_t next_id {1};
+    std::map<uint64_t, Callback> callbacks;
+};
+
+CancellationToken::CancellationToken()
+    : state_(std::make_shared<State>())
+{}
+
+void CancellationToken::Cancel() const noexcept
+{
+    // Callbacks run under the lock, so that none is running once it has been removed.
+    std::lock_guard<std::mutex> lock(state_->mutex);
+    if (state_->cancelled.exchange(true)) {
+        return;
+    }
+
+    for (auto& callback : state_->callbacks) {
+        callback.second();
+    }
+
+    state_->callbacks.clear();
+}
+
+bool CancellationToken::cancelled() const noexcept
+{
+    return state_->cancelled.load(std::memory_order_acquire);
+}
+
+uint64_t CancellationToken::AddCallback(Callback callback) const
+{
+    {
+        std::lock_guard<std::mutex> lock(state_->mutex);
+        if (!state_->cancelled) {
+            auto id = state_->next_id++;
+            state_->callbacks.emplace(id, std::move(callback));
+            return id;
+        }
+    }
+
+    callback();
+    return 0;
+}
+
+void CancellationToken::RemoveCallback(uint64_t id) const noexcept
+{
+    if (id == 0) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(state_->mutex);
+    state_->callbacks.erase(id);
+}
+
+}   // namespace wat
@@ -0,0 +1,58 @@
+/*
+ @ 0xCCCCCCCC
+*/
+
+#if defined(_MSC_VER)
+#pragma once
+#endif
+
+#ifndef WINANT_HTTP_WINANT_CANCELLATION_TOKEN_H_
+#define WINANT_HTTP_WINANT_CANCELLATION_TOKEN_H_
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+
+#include "kbase/basic_macros.h"
+
+namespace wat {
+
+// Cancels the requests it is given to, from any thread. A cancelled request stops connecting,
+// sending or reading within milliseconds and fails with a CancelledError; its connection is
+// closed rather than returned to the pool, as it may be left amid an exchange.
+// Copies of a token share their state, and thus a token can cancel any number of requests at
+// once; a token once cancelled stays so.
+class CancellationToken {
+public:
+    using Callback = std::function<void()>;
+
+    CancellationToken();
+
+    ~CancellationToken() = default;
+
+    DEFAULT_COPY(CancellationToken);
+
+    DEFAULT_MOVE(CancellationToken);
+
+    // Thread-safe; cancelling more than once has no effect.
+    void Cancel() const noexcept;
+
+    bool cancelled() const noexcept;
+
+    // Runs `callback` on the thread that cancels the token, or at once if the token has been
+    // cancelled already, in which case 0 is returned. Callbacks must not throw nor call into
+    // the token.
+    uint64_t AddCallback(Callback callback) const;
+
+    // The callback is not running once this returns.
+    void RemoveCallback(uint64_t id) const noexcept;
+
+private:
+    struct State;
+
+    std::shared_ptr<State> state_;
+};
+
+}   // namespace wat
+
+#endif  // WINANT_HTTP_WINANT_CANCELLATION_TOKEN_H_
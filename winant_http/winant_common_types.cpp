@@ -4,32 +4,318 @@
 
 #include "winant_http/winant_common_types.h"
 
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <limits>
+#include <mutex>
 #include <numeric>
 #include <random>
 
 #include "kbase/error_exception_util.h"
 #include "kbase/string_format.h"
 
+#include "winant_http/internal/file_util.h"
+#include "winant_http/internal/request_body_reader.h"
 #include "winant_http/winant_utils.h"
 
 namespace {
 
-const wchar_t kContentTypeURLEncoded[] = L"Content-Type: application/x-www-form-urlencoded\r\n";
-const wchar_t kContentTypeJSON[] = L"Content-Type: application/json\r\n";
-const wchar_t kContentMultipart[] = L"Content-Type: multipart/form-data; boundary=";
+constexpr char kContentTypeURLEncoded[] = "application/x-www-form-urlencoded";
+constexpr char kContentTypeJSON[] = "application/json";
+constexpr char kContentMultipart[] = "multipart/form-data; boundary=";
+
+// Names of TimeoutError::Limit, in the same order.
+constexpr const char* kTimeoutLimitNames[] {
+    "connect", "write", "first byte", "idle read", "total"
+};
+
+// Names of Headers::Known, in the same order.
+constexpr std::array<const char*, static_cast<size_t>(wat::Headers::Known::Count)>
+    kKnownHeaderNames {{
+        "Accept-Encoding",
+        "Cache-Control",
+        "Connection",
+        "Content-Encoding",
+        "Content-Length",
+        "Content-Type",
+        "Date",
+        "ETag",
+        "Expires",
+        "Host",
+        "If-Modified-Since",
+        "If-None-Match",
+        "Last-Modified",
+        "Location",
+        "Set-Cookie",
+        "Transfer-Encoding",
+        "User-Agent"
+    }};
+
+constexpr size_t kMaxKnownHeaderLength = 17;
+
+// Most requests and responses carry fewer headers.
+constexpr size_t kInitialCapacity = 16;
+
+bool EqualsIgnoreCaseASCII(kbase::StringView lhs, kbase::StringView rhs) noexcept
+{
+    if (lhs.size() != rhs.size()) {
+        return false;
+    }
 
-std::string GenerateMultipartBoundary()
+    for (size_t i = 0; i < lhs.size(); ++i) {
+        auto l = static_cast<unsigned char>(lhs[i]);
+        auto r = static_cast<unsigned char>(rhs[i]);
+        if (l != r && ((l | 0x20) != (r | 0x20) || (l | 0x20) < 'a' || (l | 0x20) > 'z')) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool IsHeaderWhitespace(char ch) noexcept
+{
+    return ch == ' ' || ch == '\t';
+}
+
+kbase::StringView TrimHeaderWhitespace(kbase::StringView str) noexcept
+{
+    while (!str.empty() && IsHeaderWhitespace(str.front())) {
+        str.remove_prefix(1);
+    }
+
+    while (!str.empty() && IsHeaderWhitespace(str.back())) {
+        str.remove_suffix(1);
+    }
+
+    return str;
+}
+
+// `name=value` pairs joined by '&', as both query strings and form data are; a pair with an
+// empty value is encoded as `name` alone.
+using EncodedPairs = std::vector<std::pair<std::string, std::string>>;
+
+size_t EncodedFormSize(const EncodedPairs& pairs) noexcept
+{
+    size_t size = 0;
+    for (const auto& pair : pairs) {
+        if (size != 0) {
+            ++size;
+        }
+
+        size += wat::EscapedUrlSize(pair.first);
+        if (!pair.second.empty()) {
+            size += 1 + wat::EscapedUrlSize(pair.second);
+        }
+    }
+
+    return size;
+}
+
+void AppendEncodedForm(const EncodedPairs& pairs, std::string& out)
 {
-    const char* kBoundaryPrefix = "---------------------------";
+    out.reserve(out.size() + EncodedFormSize(pairs));
+    auto start = out.size();
+    for (const auto& pair : pairs) {
+        if (out.size() != start) {
+            out.push_back('&');
+        }
+
+        wat::AppendEscapedUrl(pair.first, out);
+        if (!pair.second.empty()) {
+            out.push_back('=');
+            wat::AppendEscapedUrl(pair.second, out);
+        }
+    }
+}
+
+constexpr char kMultipartBoundaryPrefix[] = "---------------------------";
+
+// The prefix followed by 16 hex digits.
+constexpr size_t kMultipartBoundaryLength = sizeof(kMultipartBoundaryPrefix) - 1 + 16;
 
-    std::random_device rd;
-    std::default_random_engine engine(rd());
+std::string GenerateMultipartBoundary()
+{
+    // Seeding from a random device is costly, and thus is done once per thread.
+    thread_local std::default_random_engine engine(std::random_device{}());
     std::uniform_int_distribution<> dist;
 
     int r0 = dist(engine);
     int r1 = dist(engine);
 
-    return kbase::StringPrintf("%s%08X%08X", kBoundaryPrefix, r0, r1);
+    return kbase::StringPrintf("%s%08X%08X", kMultipartBoundaryPrefix, r0, r1);
+}
+
+// Walks through the body of `multipart` in order, and hands boundary lines and part headers,
+// data of in-memory files, and local files to `sink`.
+template<typename Sink>
+void WalkMultipart(const wat::Multipart& multipart, kbase::StringView boundary, Sink& sink)
+{
+    auto begin_part = [&sink, boundary](kbase::StringView name) {
+        sink.Text("--");
+        sink.Text(boundary);
+        sink.Text("\r\nContent-Disposition: form-data; name=\"");
+        sink.Text(name);
+        sink.Text("\"");
+    };
+
+    auto file_headers = [&sink, &begin_part](const std::string& name, const std::string& filename,
+                                             const std::string& mime_type) {
+        begin_part(name);
+        sink.Text("; filename=\"");
+        sink.Text(filename);
+        sink.Text("\"\r\nContent-Type: ");
+        sink.Text(mime_type);
+        sink.Text("\r\n\r\n");
+    };
+
+    for (const auto& value : multipart.values) {
+        begin_part(value.first);
+        sink.Text("\r\n\r\n");
+        sink.Text(value.second);
+        sink.Text("\r\n");
+    }
+
+    for (size_t i = 0; i < multipart.files.size(); ++i) {
+        const auto& file = multipart.files[i];
+        file_headers(file.name, file.filename, file.mime_type);
+        sink.FileData(i);
+        sink.Text("\r\n");
+    }
+
+    for (const auto& file : multipart.local_files) {
+        file_headers(file.name, file.filename, file.mime_type);
+        sink.LocalFile(file);
+        sink.Text("\r\n");
+    }
+
+    sink.Text("--");
+    sink.Text(boundary);
+    sink.Text("--\r\n");
+}
+
+class MultipartSizer {
+public:
+    MultipartSizer(const wat::Multipart& multipart, bool count_files)
+        : multipart_(multipart), count_files_(count_files), size_(0)
+    {}
+
+    void Text(kbase::StringView text) noexcept
+    {
+        size_ += static_cast<int64_t>(text.size());
+    }
+
+    void FileData(size_t index) noexcept
+    {
+        if (count_files_) {
+            size_ += static_cast<int64_t>(multipart_.files[index].data.size());
+        }
+    }
+
+    void LocalFile(const wat::Multipart::LocalFile& file)
+    {
+        if (count_files_) {
+            size_ += static_cast<int64_t>(wat::internal::GetFileSize(file.path));
+        }
+    }
+
+    int64_t size() const noexcept
+    {
+        return size_;
+    }
+
+private:
+    const wat::Multipart& multipart_;
+    bool count_files_;
+    int64_t size_;
+};
+
+// Boundary lines and part headers are written into one buffer sized up front, and each run of
+// them between two files becomes a segment sharing the buffer.
+class MultipartBodyWriter {
+public:
+    // Data of files is moved out of `movable_files` if it is not null.
+    MultipartBodyWriter(const wat::Multipart& multipart,
+                        std::vector<wat::Multipart::File>* movable_files, size_t text_size)
+        : multipart_(multipart),
+          movable_files_(movable_files),
+          text_(std::make_shared<std::string>()),
+          flushed_(0)
+    {
+        text_->reserve(text_size);
+    }
+
+    void Text(kbase::StringView text)
+    {
+        // Must never grow, as segments refer to it.
+        ENSURE(CHECK, text_->size() + text.size() <= text_->capacity())
+            (text_->size())(text.size()).Require();
+        text_->append(text.data(), text.size());
+    }
+
+    void FileData(size_t index)
+    {
+        Flush();
+        if (movable_files_) {
+            body_.Append(std::move((*movable_files_)[index].data));
+        } else {
+            body_.Append(multipart_.files[index].data);
+        }
+    }
+
+    void LocalFile(const wat::Multipart::LocalFile& file)
+    {
+        Flush();
+        body_.AppendFile(file.path);
+    }
+
+    wat::RequestBody Finish()
+    {
+        Flush();
+        return std::move(body_);
+    }
+
+private:
+    void Flush()
+    {
+        if (flushed_ < text_->size()) {
+            body_.AppendShared(text_, kbase::StringView(text_->data() + flushed_,
+                                                        text_->size() - flushed_));
+            flushed_ = text_->size();
+        }
+    }
+
+private:
+    const wat::Multipart& multipart_;
+    std::vector<wat::Multipart::File>* movable_files_;
+    std::shared_ptr<std::string> text_;
+    size_t flushed_;
+    wat::RequestBody body_;
+};
+
+std::pair<std::string, wat::RequestBody> MakeMultipartBody(
+    const wat::Multipart& multipart, std::vector<wat::Multipart::File>* movable_files)
+{
+    auto boundary = GenerateMultipartBoundary();
+
+    MultipartSizer sizer(multipart, false);
+    WalkMultipart(multipart, boundary, sizer);
+
+    MultipartBodyWriter writer(multipart, movable_files, static_cast<size_t>(sizer.size()));
+    WalkMultipart(multipart, boundary, writer);
+
+    std::string content_type(kContentMultipart);
+    content_type.append(boundary);
+
+    return {std::move(content_type), writer.Finish()};
+}
+
+// Guards the snapshots const headers are iterated over, which are taken on first use.
+std::mutex& HeadersSnapshotMutex()
+{
+    static std::mutex mutex;
+    return mutex;
 }
 
 }   // namespace
@@ -38,42 +324,459 @@ namespace wat {
 
 // -*- Headers -*-
 
-bool Headers::HasHeader(const std::string& key) const
+Headers::Headers(std::initializer_list<value_type> init)
+{
+    entries_.reserve(init.size());
+    for (const auto& header : init) {
+        AddHeader(header.first, header.second);
+    }
+}
+
+Headers::Headers(const Headers& other)
+    : storage_(other.storage_),
+      entries_(other.entries_),
+      owned_entries_(other.owned_entries_),
+      owns_entries_(other.owns_entries_),
+      known_(other.known_)
+{}
+
+Headers& Headers::operator=(const Headers& other)
+{
+    if (this != &other) {
+        storage_ = other.storage_;
+        entries_ = other.entries_;
+        owned_entries_ = other.owned_entries_;
+        owns_entries_ = other.owns_entries_;
+        snapshot_.reset();
+        known_ = other.known_;
+    }
+
+    return *this;
+}
+
+// static
+Headers Headers::Parse(std::string raw)
+{
+    Headers headers;
+    headers.storage_ = std::move(raw);
+    auto& buf = headers.storage_;
+    ENSURE(CHECK, buf.size() <= std::numeric_limits<uint32_t>::max())(buf.size()).Require();
+
+    headers.entries_.reserve(std::min<size_t>(
+        std::count(buf.begin(), buf.end(), '\n') + 1, kInitialCapacity * 4));
+
+    // Whether the previous line was a header, which a folded line continues.
+    bool in_header = false;
+    size_t pos = 0;
+    while (pos < buf.size()) {
+        auto eol = buf.find('\n', pos);
+        auto next = eol == std::string::npos ? buf.size() : eol + 1;
+        auto line_end = eol == std::string::npos ? buf.size() : eol;
+        if (line_end > pos && buf[line_end - 1] == '\r') {
+            --line_end;
+        }
+
+        if (line_end == pos) {
+            break;
+        }
+
+        // A bare CR is no line break, and is taken as a space.
+        std::replace(buf.begin() + pos, buf.begin() + line_end, '\r', ' ');
+
+        if (IsHeaderWhitespace(buf[pos])) {
+            if (in_header) {
+                // Joins the value; line breaks in between become spaces.
+                auto& entry = headers.entries_.back();
+                for (auto i = entry.value_offset + entry.value_size; i < pos; ++i) {
+                    buf[i] = ' ';
+                }
+
+                auto value = TrimHeaderWhitespace(
+                    kbase::StringView(buf.data() + entry.value_offset, line_end - entry.value_offset));
+                entry.value_offset = static_cast<uint32_t>(value.data() - buf.data());
+                entry.value_size = static_cast<uint32_t>(value.size());
+            }
+
+            pos = next;
+            continue;
+        }
+
+        kbase::StringView line(buf.data() + pos, line_end - pos);
+        auto colon = line.find(':');
+        auto name = colon != kbase::StringView::npos ?
+                        TrimHeaderWhitespace(line.substr(0, colon)) : kbase::StringView();
+        in_header = !name.empty();
+        if (in_header) {
+            auto value = TrimHeaderWhitespace(line.substr(colon + 1));
+            headers.AddEntry(Entry {static_cast<uint32_t>(name.data() - buf.data()),
+                                    static_cast<uint32_t>(name.size()),
+                                    static_cast<uint32_t>(value.data() - buf.data()),
+                                    static_cast<uint32_t>(value.size())});
+        }
+
+        pos = next;
+    }
+
+    return headers;
+}
+
+// static
+Headers::Known Headers::LookupKnown(kbase::StringView name) noexcept
+{
+    // Bitmasks of well-known headers by name length, so that most names are compared against
+    // one or two candidates at most.
+    static const auto candidates_by_length = [] {
+        std::array<uint32_t, kMaxKnownHeaderLength + 1> candidates {};
+        for (size_t i = 0; i < kKnownHeaderNames.size(); ++i) {
+            candidates[std::strlen(kKnownHeaderNames[i])] |= 1U << i;
+        }
+
+        return candidates;
+    }();
+
+    if (name.size() > kMaxKnownHeaderLength) {
+        return Known::Count;
+    }
+
+    for (auto candidates = candidates_by_length[name.size()]; candidates != 0;
+         candidates &= candidates - 1) {
+        size_t i = 0;
+        while (!(candidates & (1U << i))) {
+            ++i;
+        }
+
+        if (EqualsIgnoreCaseASCII(name, kKnownHeaderNames[i])) {
+            return static_cast<Known>(i);
+        }
+    }
+
+    return Known::Count;
+}
+
+Headers::iterator Headers::begin()
+{
+    return OwnEntries().begin();
+}
+
+Headers::const_iterator Headers::begin() const
+{
+    return Entries().begin();
+}
+
+Headers::iterator Headers::end()
+{
+    return OwnEntries().end();
+}
+
+Headers::const_iterator Headers::end() const
+{
+    return Entries().end();
+}
+
+const Headers::data_type& Headers::Entries() const
+{
+    if (owns_entries_) {
+        return owned_entries_;
+    }
+
+    // Const objects may be iterated on several threads at once.
+    std::lock_guard<std::mutex> lock(HeadersSnapshotMutex());
+    if (!snapshot_) {
+        snapshot_ = std::make_unique<data_type>(CopyEntries());
+    }
+
+    return *snapshot_;
+}
+
+Headers::data_type& Headers::OwnEntries()
+{
+    if (!owns_entries_) {
+        owned_entries_ = snapshot_ ? std::move(*snapshot_) : CopyEntries();
+        owns_entries_ = true;
+        snapshot_.reset();
+        storage_ = std::string();
+        entries_ = std::vector<Entry>();
+    }
+
+    return owned_entries_;
+}
+
+Headers::data_type Headers::CopyEntries() const
+{
+    data_type entries;
+    entries.reserve(size());
+    for (auto header : views()) {
+        entries.emplace_back(header.first.ToString(), header.second.ToString());
+    }
+
+    return entries;
+}
+
+size_t Headers::FindIndex(kbase::StringView key) const
+{
+    auto known = LookupKnown(key);
+    if (known != Known::Count) {
+        auto index = known_[static_cast<size_t>(known)];
+        return index != 0 ? index - 1 : size();
+    }
+
+    for (size_t i = 0; i < size(); ++i) {
+        if (EqualsIgnoreCaseASCII(NameAt(i), key)) {
+            return i;
+        }
+    }
+
+    return size();
+}
+
+bool Headers::HasHeader(kbase::StringView key) const
+{
+    return FindIndex(key) != size();
+}
+
+bool Headers::GetHeader(kbase::StringView key, std::string& value) const
+{
+    kbase::StringView view;
+    if (!GetHeader(key, view)) {
+        return false;
+    }
+
+    value = view.ToString();
+
+    return true;
+}
+
+bool Headers::GetHeader(Known key, std::string& value) const
 {
-    return headers_.count(key) != 0;
+    kbase::StringView view;
+    if (!GetHeader(key, view)) {
+        return false;
+    }
+
+    value = view.ToString();
+
+    return true;
 }
 
-bool Headers::GetHeader(const std::string& key, std::string& value) const
+bool Headers::GetHeader(kbase::StringView key, kbase::StringView& value) const
 {
-    auto it = headers_.find(key);
-    if (it == headers_.cend()) {
+    auto index = FindIndex(key);
+    if (index == size()) {
         return false;
     }
 
-    value = it->second;
+    value = ValueAt(index);
 
     return true;
 }
 
-void Headers::SetHeader(const std::string& key, const std::string& value)
+bool Headers::GetHeader(Known key, kbase::StringView& value) const noexcept
+{
+    auto index = known_[static_cast<size_t>(key)];
+    if (index == 0) {
+        return false;
+    }
+
+    value = ValueAt(index - 1);
+
+    return true;
+}
+
+std::vector<std::string> Headers::GetHeaderValues(kbase::StringView key) const
+{
+    std::vector<std::string> values;
+    for (auto i = FindIndex(key); i < size(); ++i) {
+        if (EqualsIgnoreCaseASCII(NameAt(i), key)) {
+            values.push_back(ValueAt(i).ToString());
+        }
+    }
+
+    return values;
+}
+
+void Headers::SetHeader(kbase::StringView key, kbase::StringView value)
+{
+    auto index = FindIndex(key);
+    if (index == size()) {
+        AddHeader(key, value);
+        return;
+    }
+
+    // Both may refer to the headers.
+    std::string name_copy = key.ToString();
+    std::string value_copy = value.ToString();
+    snapshot_.reset();
+
+    if (owns_entries_) {
+        owned_entries_[index].first = name_copy;
+        owned_entries_[index].second = std::move(value_copy);
+        EraseNamed(index + 1, name_copy);
+        return;
+    }
+
+    auto& entry = entries_[index];
+    std::copy(name_copy.begin(), name_copy.end(), &storage_[entry.name_offset]);
+    if (value_copy.size() <= entry.value_size) {
+        std::copy(value_copy.begin(), value_copy.end(), &storage_[entry.value_offset]);
+    } else {
+        entry.value_offset = Store(value_copy);
+    }
+
+    entry.value_size = static_cast<uint32_t>(value_copy.size());
+    EraseNamed(index + 1, name_copy);
+    CompactIfNeeded();
+}
+
+void Headers::AddHeader(kbase::StringView key, kbase::StringView value)
+{
+    snapshot_.reset();
+    if (owns_entries_) {
+        // Copied before the entries grow, as both may refer to them.
+        value_type entry(key.ToString(), value.ToString());
+        IndexKnown(entry.first, owned_entries_.size());
+        owned_entries_.push_back(std::move(entry));
+        return;
+    }
+
+    // Views into the storage would dangle once it grows.
+    if (RefersToStorage(key) || RefersToStorage(value)) {
+        AddHeader(key.ToString(), value.ToString());
+        return;
+    }
+
+    auto name_offset = Store(key);
+    auto value_offset = Store(value);
+    AddEntry(Entry {name_offset, static_cast<uint32_t>(key.size()),
+                    value_offset, static_cast<uint32_t>(value.size())});
+}
+
+void Headers::RemoveHeader(kbase::StringView key)
+{
+    auto first = FindIndex(key);
+    if (first == size()) {
+        return;
+    }
+
+    snapshot_.reset();
+    EraseNamed(first, key.ToString());
+    CompactIfNeeded();
+}
+
+void Headers::EraseNamed(size_t first, kbase::StringView name)
+{
+    auto same_name = [name](kbase::StringView other) {
+        return EqualsIgnoreCaseASCII(other, name);
+    };
+
+    bool erased = false;
+    if (owns_entries_) {
+        auto rest = std::remove_if(owned_entries_.begin() + first, owned_entries_.end(),
+                                   [&same_name](const value_type& entry) {
+                                       return same_name(entry.first);
+                                   });
+        erased = rest != owned_entries_.end();
+        owned_entries_.erase(rest, owned_entries_.end());
+    } else {
+        auto rest = std::remove_if(entries_.begin() + first, entries_.end(),
+                                   [this, &same_name](const Entry& entry) {
+                                       return same_name(kbase::StringView(
+                                           storage_.data() + entry.name_offset, entry.name_size));
+                                   });
+        erased = rest != entries_.end();
+        entries_.erase(rest, entries_.end());
+    }
+
+    if (erased) {
+        RebuildKnownIndex();
+    }
+}
+
+bool Headers::RefersToStorage(kbase::StringView data) const noexcept
+{
+    return !data.empty() && data.data() >= storage_.data() &&
+           data.data() < storage_.data() + storage_.size();
+}
+
+uint32_t Headers::Store(kbase::StringView data)
+{
+    ENSURE(CHECK, storage_.size() + data.size() <= std::numeric_limits<uint32_t>::max())
+        (storage_.size())(data.size()).Require();
+    if (storage_.empty()) {
+        storage_.reserve(kInitialCapacity * 32);
+    }
+
+    auto offset = static_cast<uint32_t>(storage_.size());
+    storage_.append(data.data(), data.size());
+    return offset;
+}
+
+void Headers::AddEntry(const Entry& entry)
+{
+    if (entries_.empty()) {
+        entries_.reserve(kInitialCapacity);
+    }
+
+    IndexKnown(kbase::StringView(storage_.data() + entry.name_offset, entry.name_size),
+               entries_.size());
+    entries_.push_back(entry);
+}
+
+void Headers::IndexKnown(kbase::StringView name, size_t index) noexcept
+{
+    auto known = LookupKnown(name);
+    if (known != Known::Count && known_[static_cast<size_t>(known)] == 0) {
+        known_[static_cast<size_t>(known)] = static_cast<uint32_t>(index + 1);
+    }
+}
+
+void Headers::CompactIfNeeded()
 {
-    headers_[key] = value;
+    size_t live = 0;
+    for (const auto& entry : entries_) {
+        live += entry.name_size + entry.value_size;
+    }
+
+    if (storage_.size() <= kInitialCapacity * 64 || storage_.size() <= live * 2) {
+        return;
+    }
+
+    std::string storage;
+    storage.reserve(live);
+    for (auto& entry : entries_) {
+        auto name_offset = static_cast<uint32_t>(storage.size());
+        storage.append(storage_, entry.name_offset, entry.name_size);
+        auto value_offset = static_cast<uint32_t>(storage.size());
+        storage.append(storage_, entry.value_offset, entry.value_size);
+        entry.name_offset = name_offset;
+        entry.value_offset = value_offset;
+    }
+
+    storage_ = std::move(storage);
 }
 
-void Headers::RemoveHeader(const std::string& key)
+void Headers::RebuildKnownIndex() noexcept
 {
-    headers_.erase(key);
+    known_.fill(0);
+    for (size_t i = size(); i > 0; --i) {
+        auto known = LookupKnown(NameAt(i - 1));
+        if (known != Known::Count) {
+            known_[static_cast<size_t>(known)] = static_cast<uint32_t>(i);
+        }
+    }
 }
 
 std::string Headers::ToString() const
 {
     std::string content;
-    for (const auto& header : headers_) {
+    content.reserve(storage_.size() + size() * 4 + 2);
+    for (auto header : views()) {
+        content.append(header.first.data(), header.first.size());
         if (header.second.empty()) {
-            kbase::StringAppendPrintf(content, "%s:\r\n", header.first.c_str());
+            content.append(":\r\n");
         } else {
-            kbase::StringAppendPrintf(content, "%s: %s\r\n", header.first.c_str(),
-                                      header.second.c_str());
+            content.append(": ")
+                   .append(header.second.data(), header.second.size())
+                   .append("\r\n");
         }
     }
 
@@ -91,26 +794,20 @@ Parameters& Parameters::Add(Parameter param)
     return *this;
 }
 
-std::string Parameters::ToString() const
+size_t Parameters::EncodedSize() const noexcept
 {
-    if (params.empty()) {
-        return std::string();
-    }
-
-    constexpr size_t kReservedSize = 32U;
-    std::string content;
-    content.reserve(kReservedSize);
-    for (const auto& param : params) {
-        if (!content.empty()) {
-            content.append(1, '&');
-        }
+    return EncodedFormSize(params);
+}
 
-        content.append(EscapeUrl(param.first));
-        if (!param.second.empty()) {
-            content.append(1, '=').append(EscapeUrl(param.second));
-        }
-    }
+void Parameters::AppendTo(std::string& out) const
+{
+    AppendEncodedForm(params, out);
+}
 
+std::string Parameters::ToString() const
+{
+    std::string content;
+    AppendTo(content);
     return content;
 }
 
@@ -123,26 +820,24 @@ Payload& Payload::Add(Argument arg)
     return *this;
 }
 
+size_t Payload::EncodedSize() const noexcept
+{
+    return EncodedFormSize(data);
+}
+
+void Payload::AppendTo(std::string& out) const
+{
+    AppendEncodedForm(data, out);
+}
+
 RequestContent Payload::ToString() const
 {
     if (data.empty()) {
         return {};
     }
 
-    constexpr size_t kReservedSize = 32U;
     std::string content;
-    content.reserve(kReservedSize);
-    for (const auto& argument : data) {
-        if (!content.empty()) {
-            content.append(1, '&');
-        }
-
-        content.append(EscapeUrl(argument.first));
-        if (!argument.second.empty()) {
-            content.append(1, '=').append(EscapeUrl(argument.second));
-        }
-    }
-
+    AppendTo(content);
     return {kContentTypeURLEncoded, std::move(content)};
 }
 
@@ -176,40 +871,57 @@ Multipart& Multipart::AddPart(File&& file)
     return *this;
 }
 
-RequestContent Multipart::ToString() const
+Multipart& Multipart::AddPart(LocalFile local_file)
 {
-    auto boundary = GenerateMultipartBoundary();
-
-    std::wstring content_type(kContentMultipart);
-    content_type.append(kbase::ASCIIToWide(boundary)).append(L"\r\n");
+    local_files.push_back(std::move(local_file));
 
-    size_t reserved_size = 128U * files.size();
-    for (const auto& file : files) {
-        reserved_size += file.data.size();
-    }
+    return *this;
+}
 
-    std::string data;
-    data.reserve(reserved_size);
+RequestContent Multipart::ToString() const
+{
+    auto content = ToBody();
 
-    for (const auto& value : values) {
-        data.append("--").append(boundary).append("\r\n");
-        data.append("Content-Disposition: form-data; ")
-            .append("name=\"").append(value.first).append("\"\r\n\r\n")
-            .append(value.second).append("\r\n");
+    kbase::StringView data;
+    if (content.second.AsContiguous(data)) {
+        return {std::move(content.first), data.ToString()};
     }
 
-    for (const auto& file : files) {
-        data.append("--").append(boundary).append("\r\n");
-        data.append("Content-Disposition: form-data; ")
-            .append("name=\"").append(file.name).append("\"; ")
-            .append("filename=\"").append(file.filename).append("\"\r\n");
-        data.append("Content-Type: ").append(file.mime_type).append("\r\n\r\n");
-        data.append(file.data).append("\r\n");
+    std::string flattened;
+    flattened.reserve(static_cast<size_t>(content.second.length()));
+    internal::RequestBodyReader reader(content.second);
+    char buf[16 * 1024];
+    for (auto chunk = reader.Next(buf, sizeof(buf)); !chunk.empty();
+         chunk = reader.Next(buf, sizeof(buf))) {
+        flattened.append(chunk.data(), chunk.size());
     }
 
-    data.append("--").append(boundary).append("--\r\n");
+    return {std::move(content.first), std::move(flattened)};
+}
 
-    return {content_type, std::move(data)};
+std::pair<std::string, RequestBody> Multipart::ToBody() const &
+{
+    return MakeMultipartBody(*this, nullptr);
 }
 
+std::pair<std::string, RequestBody> Multipart::ToBody() &&
+{
+    return MakeMultipartBody(*this, &files);
+}
+
+int64_t Multipart::GetContentLength() const
+{
+    MultipartSizer sizer(*this, true);
+    WalkMultipart(*this, std::string(kMultipartBoundaryLength, '-'), sizer);
+    return sizer.size();
+}
+
+// -*- TimeoutError -*-
+
+TimeoutError::TimeoutError(Limit limit)
+    : std::runtime_error(std::string("Request timed out: ") + kTimeoutLimitNames[
+                             static_cast<size_t>(limit)]),
+      limit_(limit)
+{}
+
 }   // namespace wat
@@ -9,115 +9,324 @@
 #ifndef WINANT_HTTP_WINANT_COMMON_TYPES_H_
 #define WINANT_HTTP_WINANT_COMMON_TYPES_H_
 
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <exception>
 #include <functional>
-#include <map>
+#include <iterator>
+#include <memory>
+#include <stdexcept>
 #include <string>
+#include <utility>
 #include <vector>
 
 #include "kbase/basic_macros.h"
+#include "kbase/string_view.h"
+
+#include "winant_http/winant_request_body.h"
+#include "winant_http/winant_url.h"
 
 namespace wat {
 
-class Url {
+// Header names are compared case-insensitively, and entries are kept in insertion order.
+// A name may appear more than once, e.g. Set-Cookie in a response.
+// Names and values are packed into a single buffer; a parsed header block is adopted as the
+// buffer as it is. Iterating the headers yields std::string entries, which are copied out of the
+// buffer: iterating a const object copies them into a snapshot kept until the headers are
+// modified, while iterating a mutable one moves the headers over to the copies for good, as the
+// entries may then be modified through the iterators. views() iterates without copying.
+class Headers {
 public:
-    Url() = default;
-
-    explicit Url(std::string url)
-        : spec_(std::move(url))
-    {}
-
-    ~Url() = default;
+    // (name, value)
+    using value_type = std::pair<std::string, std::string>;
+    using data_type = std::vector<value_type>;
+    // Names must not be modified through iterators.
+    using iterator = data_type::iterator;
+    using const_iterator = data_type::const_iterator;
 
-    DEFAULT_COPY(Url);
+    // (name, value) as views into the headers, which stay valid until the headers are modified.
+    using view_type = std::pair<kbase::StringView, kbase::StringView>;
+
+    // Well-known headers, which are looked up without scanning the entries.
+    enum class Known : uint8_t {
+        AcceptEncoding = 0,
+        CacheControl,
+        Connection,
+        ContentEncoding,
+        ContentLength,
+        ContentType,
+        Date,
+        ETag,
+        Expires,
+        Host,
+        IfModifiedSince,
+        IfNoneMatch,
+        LastModified,
+        Location,
+        SetCookie,
+        TransferEncoding,
+        UserAgent,
+        Count
+    };
 
-    DEFAULT_MOVE(Url);
+    // Yields the entries by value, as views; entries can't be modified through it.
+    class view_iterator {
+    public:
+        // Holds the entry an arrow refers to, for the duration of the expression.
+        class arrow_proxy {
+        public:
+            explicit arrow_proxy(view_type entry) noexcept
+                : entry_(entry)
+            {}
+
+            const view_type* operator->() const noexcept
+            {
+                return &entry_;
+            }
+
+        private:
+            view_type entry_;
+        };
+
+        // Not a forward iterator, as dereferencing doesn't yield a reference.
+        using iterator_category = std::input_iterator_tag;
+        using value_type = view_type;
+        using difference_type = std::ptrdiff_t;
+        using pointer = arrow_proxy;
+        using reference = view_type;
+
+        view_iterator(const Headers* headers, size_t index) noexcept
+            : headers_(headers), index_(index)
+        {}
+
+        reference operator*() const noexcept
+        {
+            return headers_->ViewAt(index_);
+        }
+
+        pointer operator->() const noexcept
+        {
+            return arrow_proxy(headers_->ViewAt(index_));
+        }
+
+        view_iterator& operator++() noexcept
+        {
+            ++index_;
+            return *this;
+        }
+
+        view_iterator operator++(int) noexcept
+        {
+            auto prev = *this;
+            ++index_;
+            return prev;
+        }
+
+        friend bool operator==(const view_iterator& lhs, const view_iterator& rhs) noexcept
+        {
+            return lhs.index_ == rhs.index_ && lhs.headers_ == rhs.headers_;
+        }
+
+        friend bool operator!=(const view_iterator& lhs, const view_iterator& rhs) noexcept
+        {
+            return !(lhs == rhs);
+        }
+
+    private:
+        const Headers* headers_;
+        size_t index_;
+    };
 
-    bool empty() const noexcept
-    {
-        return spec_.empty();
-    }
+    class view_range {
+    public:
+        explicit view_range(const Headers* headers) noexcept
+            : headers_(headers)
+        {}
 
-    const std::string& spec() const noexcept
-    {
-        return spec_;
-    }
+        view_iterator begin() const noexcept
+        {
+            return view_iterator(headers_, 0);
+        }
 
-private:
-    std::string spec_;
-};
+        view_iterator end() const noexcept
+        {
+            return view_iterator(headers_, headers_->size());
+        }
 
-class Headers {
-public:
-    using data_type = std::map<std::string, std::string>;
-    using value_type = data_type::value_type;
-    using iterator = data_type::iterator;
-    using const_iterator = data_type::const_iterator;
+    private:
+        const Headers* headers_;
+    };
 
     Headers() = default;
 
-    Headers(std::initializer_list<value_type> init)
-        : headers_(init)
-    {}
+    Headers(std::initializer_list<value_type> init);
 
     ~Headers() = default;
 
-    DEFAULT_COPY(Headers);
+    // The snapshot isn't copied, as another thread may be taking it.
+    Headers(const Headers& other);
+
+    Headers& operator=(const Headers& other);
 
     DEFAULT_MOVE(Headers);
 
+    // Parses a raw header section, i.e. `name: value` lines separated by CRLF or LF, in place.
+    // Whitespace around names and values is optional, folded continuation lines are joined to
+    // the value they continue, and lines that aren't headers are skipped.
+    // Parsing stops at an empty line, if any.
+    static Headers Parse(std::string raw);
+
     bool empty() const noexcept
     {
-        return headers_.empty();
+        return size() == 0;
     }
 
-    void clear()
+    size_t size() const noexcept
     {
-        headers_.clear();
+        return owns_entries_ ? owned_entries_.size() : entries_.size();
     }
 
-    bool HasHeader(const std::string& key) const;
+    void clear() noexcept
+    {
+        entries_.clear();
+        storage_.clear();
+        owned_entries_.clear();
+        owns_entries_ = false;
+        snapshot_.reset();
+        known_.fill(0);
+    }
+
+    bool HasHeader(kbase::StringView key) const;
+
+    bool HasHeader(Known key) const noexcept
+    {
+        return known_[static_cast<size_t>(key)] != 0;
+    }
+
+    // Gets the value of the first header with the name.
+    bool GetHeader(kbase::StringView key, std::string& value) const;
+
+    bool GetHeader(Known key, std::string& value) const;
 
-    bool GetHeader(const std::string& key, std::string& value) const;
+    bool GetHeader(kbase::StringView key, kbase::StringView& value) const;
 
-    void SetHeader(const std::string& key, const std::string& value);
+    bool GetHeader(Known key, kbase::StringView& value) const noexcept;
 
+    // Gets values of all headers with the name, in order.
+    std::vector<std::string> GetHeaderValues(kbase::StringView key) const;
+
+    // Replaces all headers with the name, if any.
+    void SetHeader(kbase::StringView key, kbase::StringView value);
+
+    // Adds the header even if there are some with the same name.
+    void AddHeader(kbase::StringView key, kbase::StringView value);
+
+    // Removes all headers with the name.
     // This function does nothing if the header to be removed does not exist.
-    void RemoveHeader(const std::string& key);
+    void RemoveHeader(kbase::StringView key);
+
+    iterator begin();
 
-    iterator begin()
+    const_iterator begin() const;
+
+    const_iterator cbegin() const
     {
-        return headers_.begin();
+        return begin();
     }
 
-    const_iterator begin() const
+    iterator end();
+
+    const_iterator end() const;
+
+    const_iterator cend() const
     {
-        return headers_.begin();
+        return end();
     }
 
-    const_iterator cbegin() const
+    // The entries as views, without the copies iterating the headers makes.
+    view_range views() const noexcept
     {
-        return headers_.cbegin();
+        return view_range(this);
     }
 
-    iterator end()
+    std::string ToString() const;
+
+    // Returns Known::Count if `name` is not a well-known header.
+    static Known LookupKnown(kbase::StringView name) noexcept;
+
+private:
+    // Offsets into `storage_`.
+    struct Entry {
+        uint32_t name_offset;
+        uint32_t name_size;
+        uint32_t value_offset;
+        uint32_t value_size;
+    };
+
+    kbase::StringView NameAt(size_t index) const noexcept
     {
-        return headers_.end();
+        if (owns_entries_) {
+            return owned_entries_[index].first;
+        }
+
+        const auto& entry = entries_[index];
+        return kbase::StringView(storage_.data() + entry.name_offset, entry.name_size);
     }
 
-    const_iterator end() const
+    kbase::StringView ValueAt(size_t index) const noexcept
     {
-        return headers_.end();
+        if (owns_entries_) {
+            return owned_entries_[index].second;
+        }
+
+        const auto& entry = entries_[index];
+        return kbase::StringView(storage_.data() + entry.value_offset, entry.value_size);
     }
 
-    const_iterator cend() const
+    view_type ViewAt(size_t index) const noexcept
     {
-        return headers_.cend();
+        return view_type(NameAt(index), ValueAt(index));
     }
 
-    std::string ToString() const;
+    // The entries to iterate a const object over.
+    const data_type& Entries() const;
+
+    // Moves the headers over to std::string entries, unless they are already.
+    data_type& OwnEntries();
+
+    data_type CopyEntries() const;
+
+    size_t FindIndex(kbase::StringView key) const;
+
+    // Removes entries with the name from `first` on; `name` must not refer to the headers.
+    void EraseNamed(size_t first, kbase::StringView name);
+
+    bool RefersToStorage(kbase::StringView data) const noexcept;
+
+    // Appends `data` to the storage and returns its offset.
+    uint32_t Store(kbase::StringView data);
+
+    void AddEntry(const Entry& entry);
+
+    // Records the entry at `index` if it is the first of a well-known header.
+    void IndexKnown(kbase::StringView name, size_t index) noexcept;
+
+    // Drops data no longer referenced once it takes up most of the storage.
+    void CompactIfNeeded();
+
+    void RebuildKnownIndex() noexcept;
 
 private:
-    data_type headers_;
+    std::string storage_;
+    std::vector<Entry> entries_;
+    // Used instead of the packed entries once a mutable object has been iterated.
+    data_type owned_entries_;
+    bool owns_entries_ {false};
+    // Copies of the packed entries that const objects are iterated over.
+    mutable std::unique_ptr<data_type> snapshot_;
+    // Index + 1 of the first entry of each well-known header, or 0 if absent.
+    std::array<uint32_t, static_cast<size_t>(Known::Count)> known_ {};
 };
 
 struct Parameters {
@@ -139,11 +348,17 @@ struct Parameters {
 
     Parameters& Add(Parameter param);
 
+    // The exact size of the query string.
+    size_t EncodedSize() const noexcept;
+
+    // Appends the query string to `out`, growing it once at most.
+    void AppendTo(std::string& out) const;
+
     std::string ToString() const;
 };
 
-// (content-type header, content)
-using RequestContent = std::pair<std::wstring, std::string>;
+// (content type, content), e.g. ("application/json", "{}").
+using RequestContent = std::pair<std::string, std::string>;
 
 struct Payload {
     using Argument = std::pair<std::string, std::string>;
@@ -164,6 +379,12 @@ struct Payload {
 
     Payload& Add(Argument arg);
 
+    // The exact size of the form-urlencoded data.
+    size_t EncodedSize() const noexcept;
+
+    // Appends the form-urlencoded data to `out`, growing it once at most.
+    void AppendTo(std::string& out) const;
+
     RequestContent ToString() const;
 };
 
@@ -196,24 +417,50 @@ struct Multipart {
         static constexpr char kDefaultMimeType[] = "application/octet-stream";
     };
 
+    // A file part whose content stays on disk and is memory-mapped when the request is sent.
+    // `path` is in UTF-8.
+    struct LocalFile {
+        std::string name;
+        std::string filename;
+        std::string mime_type;
+        std::string path;
+    };
+
     // (name, value)
     using Value = std::pair<std::string, std::string>;
 
     std::vector<File> files;
+    std::vector<LocalFile> local_files;
     std::vector<Value> values;
 
     bool empty() const noexcept
     {
-        return files.empty() && values.empty();
+        return files.empty() && local_files.empty() && values.empty();
     }
 
     Multipart& AddPart(const File& file);
 
     Multipart& AddPart(File&& file);
 
+    Multipart& AddPart(LocalFile local_file);
+
     Multipart& AddPart(Value value);
 
+    // Content of local files is read into the string.
     RequestContent ToString() const;
+
+    // Same as ToString() except that the body is a sequence of segments: boundary lines and
+    // part headers share a single buffer, data of each file is a segment of its own, and local
+    // files are left on disk as file segments.
+    // (content type, body)
+    std::pair<std::string, RequestBody> ToBody() const &;
+
+    // Same as above, except that data of files is moved into the body rather than copied.
+    std::pair<std::string, RequestBody> ToBody() &&;
+
+    // The exact length of the body, computed without generating it.
+    // Throws if a local file can't be opened.
+    int64_t GetContentLength() const;
 };
 
 struct LoadFlags {
@@ -223,7 +470,17 @@ struct LoadFlags {
 
     enum : value_type {
         Normal = 0,
-        DoNotSaveResponseBody = 1 << 0
+        DoNotSaveResponseBody = 1 << 0,
+        // Bypasses WinINet and talks HTTP/1.1 over plain sockets; https urls still use WinINet.
+        // This is the only transport on platforms other than Windows.
+        UseNativeTransport = 1 << 1,
+        // Leaves a response body in the content coding it came in.
+        // By default, unless the request has an Accept-Encoding header, the transport asks for
+        // the codings it can decode, and decodes the body while reading it; headers of the
+        // response are left as they were received.
+        // The native transport decodes gzip and deflate if built with WINANT_HTTP_USE_ZLIB, and
+        // br if built with WINANT_HTTP_USE_BROTLI.
+        DoNotDecodeResponse = 1 << 2
     };
 
     LoadFlags()
@@ -235,11 +492,165 @@ struct LoadFlags {
     {}
 };
 
+// The size of the chunks a response body is read in, which is also the max size of the data
+// handed to a ReadResponseHandler at a time.
+// In adaptive mode, the size starts at `size` and doubles, up to `max_size`, whenever a read
+// fills the whole buffer; large transfers thus take fewer reads and handler calls.
+struct ReadBufferSize {
+    static constexpr size_t kDefaultSize = 16 * 1024;
+    static constexpr size_t kDefaultMaxSize = 1024 * 1024;
+
+    size_t size;
+    size_t max_size;
+
+    ReadBufferSize()
+        : size(kDefaultSize), max_size(kDefaultSize)
+    {}
+
+    explicit ReadBufferSize(size_t size)
+        : size(size), max_size(size)
+    {}
+
+    ReadBufferSize(size_t size, size_t max_size)
+        : size(size), max_size(max_size)
+    {}
+
+    static ReadBufferSize Adaptive(size_t size = kDefaultSize, size_t max_size = kDefaultMaxSize)
+    {
+        return ReadBufferSize(size, max_size);
+    }
+
+    bool adaptive() const noexcept
+    {
+        return max_size > size;
+    }
+};
+
+// Compresses a request body in gzip, and marks it with a Content-Encoding header, if the body is
+// at least `min_size` bytes; bodies whose length is unknown are always compressed.
+// A body made of memory segments only is compressed in one go, into a buffer drawn from the
+// buffer pool of the request, and is sent as it is if it doesn't shrink. Other bodies are
+// compressed as they are sent, with chunked transfer encoding, and can't be sent again on a
+// fresh connection.
+// The server has to accept the coding, as there is no telling beforehand.
+// Compression is available only when built with WINANT_HTTP_USE_ZLIB, and bodies are sent as
+// they are otherwise.
+struct RequestCompression {
+    static constexpr size_t kDefaultMinSize = 1024;
+    // Higher levels barely shrink typical JSON further, and take a lot longer.
+    static constexpr int kDefaultLevel = 1;
+
+    size_t min_size;
+    // From 1 (fastest) to 9 (smallest).
+    int level;
+
+    RequestCompression()
+        : min_size(kDefaultMinSize), level(kDefaultLevel)
+    {}
+
+    explicit RequestCompression(size_t min_size, int level = kDefaultLevel)
+        : min_size(min_size), level(level)
+    {}
+};
+
+// Limits on how long a request may take; a zero limit is no limit, which is the default.
+// The native transport keeps track of the limits on its I/O loop, or on the socket waits of a
+// synchronous request, and fails the request with a TimeoutError as soon as one runs out.
+// WinINet has no notion of deadlines, and gets the limits as its per-call timeouts instead, each
+// capped by the total.
+struct Timeouts {
+    using Duration = std::chrono::milliseconds;
+
+    // Establishing a new connection; reusing an idle one takes no time.
+    Duration connect;
+    // The longest the connection may go without taking any more of the request.
+    Duration write;
+    // From the whole request having been sent to the first byte of the response.
+    Duration first_byte;
+    // The longest the connection may go without delivering any more of the response.
+    Duration idle_read;
+    // The whole exchange, from the transport taking the request to the end of the response.
+    Duration total;
+
+    Timeouts()
+        : connect(0), write(0), first_byte(0), idle_read(0), total(0)
+    {}
+
+    // Sets the total only.
+    explicit Timeouts(Duration total)
+        : connect(0), write(0), first_byte(0), idle_read(0), total(total)
+    {}
+
+    bool empty() const noexcept
+    {
+        return connect.count() == 0 && write.count() == 0 && first_byte.count() == 0 &&
+               idle_read.count() == 0 && total.count() == 0;
+    }
+};
+
+// The error a request fails with when it runs out of one of its Timeouts.
+class TimeoutError : public std::runtime_error {
+public:
+    enum class Limit {
+        Connect,
+        Write,
+        FirstByte,
+        IdleRead,
+        Total
+    };
+
+    explicit TimeoutError(Limit limit);
+
+    Limit limit() const noexcept
+    {
+        return limit_;
+    }
+
+private:
+    Limit limit_;
+};
+
+// The error a request fails with when no connection to the server could be established, and
+// thus none of the request was sent.
+class ConnectError : public std::runtime_error {
+public:
+    explicit ConnectError(const std::string& what)
+        : std::runtime_error(what)
+    {}
+};
+
+// The error a request fails with when its transport can't handle the scheme of its url, e.g. an
+// https url on the native transport, which has no TLS.
+class UnsupportedSchemeError : public std::runtime_error {
+public:
+    explicit UnsupportedSchemeError(const std::string& what)
+        : std::runtime_error(what)
+    {}
+};
+
+// The error a request fails with once its CancellationToken is cancelled.
+class CancelledError : public std::runtime_error {
+public:
+    CancelledError()
+        : std::runtime_error("Request cancelled")
+    {}
+};
+
 // `bytes_read` indicates the number of bytes of `data` in a successful read.
 // A value of 0 indicates there is no more data available to read from the stream.
-// If an error occurred, `bytes_read` will be -1.
+// If an error occurred, `bytes_read` will be -1. A pipelined request whose response is cut off by
+// a lost connection is sent again, in which case -1 tells to drop the data read so far, and the
+// response is then read anew from the start.
 using ReadResponseHandler = std::function<void(const char* data, int bytes_read)>;
 
+class HttpResponse;
+
+// Invoked on the I/O thread when an asynchronous request finishes.
+// Either `response` is valid, or `error` holds the exception that failed the request and
+// `response` is nullptr. The handler should be brief and must not throw.
+using CompletionHandler = std::function<void(const HttpResponse* response,
+                                             std::exception_ptr error)>;
+
 }   // namespace wat
 
 #endif  // WINANT_HTTP_WINANT_COMMON_TYPES_H_
@@ -0,0 +1,44 @@
+/*
+ @ 0xCCCCCCCC
+*/
+
+#include "winant_http/winant_connection_pool.h"
+
+#include "winant_http/internal/connection_pool_impl.h"
+
+namespace wat {
+
+ConnectionPool::ConnectionPool()
+    : ConnectionPool(Options())
+{}
+
+ConnectionPool::ConnectionPool(const Options& options)
+    : impl_(std::make_unique<internal::ConnectionPoolImpl>(options))
+{}
+
+ConnectionPool::~ConnectionPool() = default;
+
+// static
+const std::shared_ptr<ConnectionPool>& ConnectionPool::Default()
+{
+    static const std::shared_ptr<ConnectionPool> default_pool =
+        std::make_shared<ConnectionPool>();
+    return default_pool;
+}
+
+ConnectionPool::Stats ConnectionPool::stats() const
+{
+    return impl_->stats();
+}
+
+size_t ConnectionPool::idle_count() const
+{
+    return impl_->idle_count();
+}
+
+void ConnectionPool::CloseIdleConnections()
+{
+    impl_->CloseIdleConnections();
+}
+
+}   // namespace wat
@@ -0,0 +1,85 @@
+/*
+ @ 0xCCCCCCCC
+*/
+
+#if defined(_MSC_VER)
+#pragma once
+#endif
+
+#ifndef WINANT_HTTP_WINANT_CONNECTION_POOL_H_
+#define WINANT_HTTP_WINANT_CONNECTION_POOL_H_
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+
+#include "kbase/basic_macros.h"
+
+namespace wat {
+
+namespace internal {
+
+class ConnectionPoolImpl;
+
+}   // namespace internal
+
+// Keeps idle keep-alive connections of the native transport, keyed by scheme/host/port, so that
+// subsequent requests to the same origin skip connection setup.
+// A pool is thread-safe and can be shared by requests through `HttpRequestBuilder::SetOption()`;
+// requests without an explicit pool use the process-wide default one.
+class ConnectionPool {
+public:
+    struct Options {
+        // Idle connections older than this are closed instead of being reused.
+        std::chrono::milliseconds idle_timeout {std::chrono::seconds(60)};
+
+        // The max number of idle connections kept for a host.
+        size_t max_idle_per_host {8};
+
+        // The max number of connections, either in use or idle, for a host.
+        // Requests beyond this limit wait for a connection to be returned.
+        // 0 indicates no limit.
+        size_t max_connections_per_host {0};
+    };
+
+    struct Stats {
+        // Requests served by a reused connection.
+        uint64_t hits {0};
+
+        // Requests that had to open a new connection.
+        uint64_t misses {0};
+
+        // Idle connections closed on checkout because they had expired or the peer had closed.
+        uint64_t discarded {0};
+    };
+
+    ConnectionPool();
+
+    explicit ConnectionPool(const Options& options);
+
+    ~ConnectionPool();
+
+    DISALLOW_COPY(ConnectionPool);
+
+    DISALLOW_MOVE(ConnectionPool);
+
+    static const std::shared_ptr<ConnectionPool>& Default();
+
+    Stats stats() const;
+
+    size_t idle_count() const;
+
+    void CloseIdleConnections();
+
+    internal::ConnectionPoolImpl& impl() const noexcept
+    {
+        return *impl_;
+    }
+
+private:
+    std::unique_ptr<internal::ConnectionPoolImpl> impl_;
+};
+
+}   // namespace wat
+
+#endif  // WINANT_HTTP_WINANT_CONNECTION_POOL_H_
@@ -13,6 +13,12 @@ namespace wat {
 
 constexpr wchar_t kWinAntUserAgent[] = L"WinAntHttp/1.0 (Windows)";
 
+#if defined(_WIN32)
+constexpr char kWinAntUserAgentA[] = "WinAntHttp/1.0 (Windows)";
+#else
+constexpr char kWinAntUserAgentA[] = "WinAntHttp/1.0 (POSIX)";
+#endif
+
 }   // namespace wat
 
 #endif  // WINANT_HTTP_WINANT_CONSTANTS_H_
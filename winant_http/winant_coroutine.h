@@ -0,0 +1,126 @@
+/*
+ @ 0xCCCCCCCC
+*/
+
+#if defined(_MSC_VER)
+#pragma once
+#endif
+
+#ifndef WINANT_HTTP_WINANT_COROUTINE_H_
+#define WINANT_HTTP_WINANT_COROUTINE_H_
+
+// Awaitable requests are available only when compiled as C++20 with coroutine support.
+#if defined(__cpp_impl_coroutine) && __has_include(<coroutine>)
+
+#define WINANT_HTTP_HAS_COROUTINE 1
+
+#include <coroutine>
+#include <exception>
+#include <functional>
+#include <optional>
+#include <utility>
+
+#include "kbase/basic_macros.h"
+
+#include "winant_http/internal/http_transport.h"
+#include "winant_http/winant_api.h"
+
+namespace wat {
+
+// Runs `task` on a thread of the executor's choice.
+using Executor = std::function<void(std::function<void()> task)>;
+
+// Sends the request when awaited, and resumes the awaiting coroutine with the response once it
+// is complete, or rethrows the error the request failed with.
+// Without an executor, the coroutine resumes on the I/O thread, where it should not block.
+class HttpAwaitable {
+public:
+    explicit HttpAwaitable(HttpRequest request)
+        : request_(std::move(request))
+    {}
+
+    ~HttpAwaitable() = default;
+
+    DISALLOW_COPY(HttpAwaitable);
+
+    DEFAULT_MOVE(HttpAwaitable);
+
+    HttpAwaitable&& ResumeOn(Executor executor) &&
+    {
+        executor_ = std::move(executor);
+        return std::move(*this);
+    }
+
+    bool await_ready() const noexcept
+    {
+        return false;
+    }
+
+    void await_suspend(std::coroutine_handle<> handle)
+    {
+        // The awaitable lives in the suspended coroutine frame, and thus outlives the request.
+        internal::SendHttpRequestAsync(std::move(request_),
+                                       [this, handle](HttpResponse* response,
+                                                      std::exception_ptr error) {
+            if (response) {
+                response_.emplace(std::move(*response));
+            } else {
+                error_ = error;
+            }
+
+            if (executor_) {
+                executor_([handle] { handle.resume(); });
+            } else {
+                handle.resume();
+            }
+        });
+    }
+
+    HttpResponse await_resume()
+    {
+        if (error_) {
+            std::rethrow_exception(error_);
+        }
+
+        return std::move(*response_);
+    }
+
+private:
+    HttpRequest request_;
+    Executor executor_;
+    std::optional<HttpResponse> response_;
+    std::exception_ptr error_;
+};
+
+namespace coro {
+
+// co_await wat::coro::Get(Url(...), ...) takes the same options as wat::Get().
+
+template<typename ...Args>
+HttpAwaitable Get(Args&&... args)
+{
+    return HttpAwaitable(internal::BuildRequest(HttpRequest::Method::Get,
+                                                std::forward<Args>(args)...));
+}
+
+template<typename ...Args>
+HttpAwaitable Post(Args&&... args)
+{
+    return HttpAwaitable(internal::BuildRequest(HttpRequest::Method::Post,
+                                                std::forward<Args>(args)...));
+}
+
+template<typename ...Args>
+HttpAwaitable Head(Args&&... args)
+{
+    return HttpAwaitable(internal::BuildRequest(HttpRequest::Method::Head,
+                                                std::forward<Args>(args)...));
+}
+
+}   // namespace coro
+
+}   // namespace wat
+
+#endif  // __cpp_impl_coroutine
+
+#endif  // WINANT_HTTP_WINANT_COROUTINE_H_
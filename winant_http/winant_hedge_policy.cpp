@@ -0,0 +1,93 @@
+/*
+ @ 0xCCCCCCCC
+*/
+
+#include "winant_http/winant_hedge_policy.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace wat {
+
+constexpr size_t HedgeTracker::kDefaultWindowSize;
+
+HedgeTracker::HedgeTracker()
+    : HedgeTracker(kDefaultWindowSize)
+{}
+
+HedgeTracker::HedgeTracker(size_t window_size)
+    : window_size_(std::max<size_t>(window_size, 1)), next_sample_(0)
+{
+    samples_.reserve(window_size_);
+}
+
+// static
+const std::shared_ptr<HedgeTracker>& HedgeTracker::Default()
+{
+    static const std::shared_ptr<HedgeTracker> default_tracker = std::make_shared<HedgeTracker>();
+    return default_tracker;
+}
+
+void HedgeTracker::Record(std::chrono::milliseconds time_to_headers)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (samples_.size() < window_size_) {
+        samples_.push_back(time_to_headers);
+    } else {
+        samples_[next_sample_] = time_to_headers;
+        next_sample_ = (next_sample_ + 1) % window_size_;
+    }
+}
+
+bool HedgeTracker::Percentile(double percentile, size_t min_samples,
+                              std::chrono::milliseconds& time_to_headers) const
+{
+    std::vector<std::chrono::milliseconds> samples;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (samples_.empty() || samples_.size() < min_samples) {
+            return false;
+        }
+
+        samples = samples_;
+    }
+
+    // Nearest-rank.
+    auto rank = static_cast<size_t>(std::ceil(percentile / 100 * samples.size()));
+    auto nth = samples.begin() + (std::min(std::max<size_t>(rank, 1), samples.size()) - 1);
+    std::nth_element(samples.begin(), nth, samples.end());
+    time_to_headers = *nth;
+    return true;
+}
+
+void HedgeTracker::OnRequest() noexcept
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    ++stats_.requests;
+}
+
+void HedgeTracker::OnHedge() noexcept
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    ++stats_.hedges;
+}
+
+void HedgeTracker::OnHedgeWon() noexcept
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    ++stats_.hedge_wins;
+}
+
+HedgeTracker::Stats HedgeTracker::stats() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return stats_;
+}
+
+size_t HedgeTracker::sample_count() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return samples_.size();
+}
+
+}   // namespace wat
@@ -0,0 +1,108 @@
+/*
+ @ 0xCCCCCCCC
+*/
+
+#if defined(_MSC_VER)
+#pragma once
+#endif
+
+#ifndef WINANT_HTTP_WINANT_HEDGE_POLICY_H_
+#define WINANT_HTTP_WINANT_HEDGE_POLICY_H_
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "kbase/basic_macros.h"
+
+namespace wat {
+
+// Keeps the times to response headers of recent hedged requests, from which their hedging delay
+// is taken, and counts how the hedges fared.
+// A tracker is thread-safe and can be shared by requests through their HedgePolicy; policies
+// without an explicit tracker use the process-wide default one. Requests to services that differ
+// in latency are better off with trackers of their own.
+class HedgeTracker {
+public:
+    struct Stats {
+        uint64_t requests {0};
+
+        // Hedges sent, i.e. requests that were slow to respond.
+        uint64_t hedges {0};
+
+        // Requests whose response came from the hedge.
+        uint64_t hedge_wins {0};
+    };
+
+    static constexpr size_t kDefaultWindowSize = 1000;
+
+    HedgeTracker();
+
+    // Keeps the latest `window_size` samples.
+    explicit HedgeTracker(size_t window_size);
+
+    ~HedgeTracker() = default;
+
+    DISALLOW_COPY(HedgeTracker);
+
+    DISALLOW_MOVE(HedgeTracker);
+
+    static const std::shared_ptr<HedgeTracker>& Default();
+
+    void Record(std::chrono::milliseconds time_to_headers);
+
+    // Returns false if there are fewer than `min_samples` samples.
+    bool Percentile(double percentile, size_t min_samples,
+                    std::chrono::milliseconds& time_to_headers) const;
+
+    void OnRequest() noexcept;
+
+    void OnHedge() noexcept;
+
+    void OnHedgeWon() noexcept;
+
+    Stats stats() const;
+
+    size_t sample_count() const;
+
+private:
+    mutable std::mutex mutex_;
+    size_t window_size_;
+    // A ring buffer once full.
+    std::vector<std::chrono::milliseconds> samples_;
+    size_t next_sample_;
+    Stats stats_;
+};
+
+// Cuts the tail latency of GET requests: if a request has gone without response headers for
+// longer than the given percentile of recent requests, an identical hedge is sent, possibly to
+// another host, and whichever responds first is taken while the other is abandoned. No hedge is
+// sent if its host has reached the connection limit of the pool.
+// Only GET requests without a body or a ReadResponseHandler, through the native transport, are
+// hedged; the option is ignored for others.
+// The two attempts count as one for the RetryPolicy of the request, if any.
+struct HedgePolicy {
+    // Of the times to response headers; e.g. 95 hedges about one request in twenty.
+    double percentile {95};
+
+    // Until the tracker has this many samples the hedging delay is `initial_delay`.
+    size_t min_samples {20};
+
+    std::chrono::milliseconds initial_delay {100};
+
+    // Keeps requests to a fast service from being hedged as a matter of course.
+    std::chrono::milliseconds min_delay {1};
+
+    // In the form of host[:port]; empty to send the hedge to the host of the request.
+    std::string alternate_host;
+
+    // nullptr to use the process-wide tracker.
+    std::shared_ptr<HedgeTracker> tracker;
+};
+
+}   // namespace wat
+
+#endif  // WINANT_HTTP_WINANT_HEDGE_POLICY_H_
@@ -10,6 +10,15 @@
 #define WINANT_HTTP_WINANT_HTTP_H_
 
 #include "winant_http/winant_api.h"
+#include "winant_http/winant_batch.h"
+#include "winant_http/winant_buffer_pool.h"
+#include "winant_http/winant_cancellation_token.h"
 #include "winant_http/winant_common_types.h"
+#include "winant_http/winant_connection_pool.h"
+#include "winant_http/winant_coroutine.h"
+#include "winant_http/winant_hedge_policy.h"
+#include "winant_http/winant_http_cache.h"
+#include "winant_http/winant_request_body.h"
+#include "winant_http/winant_retry_policy.h"
 
 #endif  // WINANT_HTTP_WINANT_HTTP_H_
@@ -0,0 +1,41 @@
+/*
+ @ 0xCCCCCCCC
+*/
+
+#include "winant_http/winant_http_cache.h"
+
+#include "winant_http/internal/http_cache_impl.h"
+
+namespace wat {
+
+HttpCache::HttpCache()
+    : HttpCache(Options())
+{}
+
+HttpCache::HttpCache(const Options& options)
+    : impl_(std::make_unique<internal::HttpCacheImpl>(options))
+{}
+
+HttpCache::~HttpCache() = default;
+
+HttpCache::Stats HttpCache::stats() const
+{
+    return impl_->stats();
+}
+
+size_t HttpCache::entry_count() const
+{
+    return impl_->entry_count();
+}
+
+size_t HttpCache::memory_size() const
+{
+    return impl_->memory_size();
+}
+
+void HttpCache::Clear()
+{
+    impl_->Clear();
+}
+
+}   // namespace wat
@@ -0,0 +1,104 @@
+/*
+ @ 0xCCCCCCCC
+*/
+
+#if defined(_MSC_VER)
+#pragma once
+#endif
+
+#ifndef WINANT_HTTP_WINANT_HTTP_CACHE_H_
+#define WINANT_HTTP_WINANT_HTTP_CACHE_H_
+
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include "kbase/basic_macros.h"
+
+namespace wat {
+
+namespace internal {
+
+class HttpCacheImpl;
+
+}   // namespace internal
+
+// Keeps responses to GET requests and serves them again as directed by Cache-Control, Expires
+// and Vary, as a private cache of RFC 7234 does.
+// A fresh response is served without contacting the server; a stale one that has an ETag or
+// Last-Modified is revalidated with a conditional request, and served again if the server
+// answers 304 Not Modified.
+// Responses are kept in memory, the least recently used evicted first, and evicted ones may spill
+// into files of a directory.
+// A cache is thread-safe and can be shared by requests through `HttpRequestBuilder::SetOption()`;
+// requests without one aren't cached.
+class HttpCache {
+public:
+    struct Options {
+        // The max total size of responses kept in memory, headers included.
+        size_t max_memory_size {16 * 1024 * 1024};
+
+        // The existing directory, in UTF-8, that responses evicted from memory are written to.
+        // Leave it empty to drop them instead.
+        // Files are removed along with their responses or with the cache, i.e. they don't outlive
+        // the process.
+        std::string disk_path;
+
+        // The max total size of responses kept on disk.
+        uint64_t max_disk_size {256 * 1024 * 1024};
+    };
+
+    struct Stats {
+        // Requests served from the cache without contacting the server.
+        uint64_t hits {0};
+
+        // Requests sent to the server without a response to revalidate.
+        uint64_t misses {0};
+
+        // Conditional requests sent to revalidate stale responses.
+        uint64_t revalidations {0};
+
+        // Revalidations answered with 304, and thus served from the cache.
+        uint64_t not_modified {0};
+
+        // Responses read back from disk, either to be served or revalidated.
+        uint64_t disk_hits {0};
+
+        uint64_t stores {0};
+
+        // Responses evicted from memory to make room, including those that went to disk.
+        uint64_t evictions {0};
+    };
+
+    HttpCache();
+
+    explicit HttpCache(const Options& options);
+
+    ~HttpCache();
+
+    DISALLOW_COPY(HttpCache);
+
+    DISALLOW_MOVE(HttpCache);
+
+    Stats stats() const;
+
+    // The number of responses in memory.
+    size_t entry_count() const;
+
+    size_t memory_size() const;
+
+    // Drops all responses, both in memory and on disk.
+    void Clear();
+
+    internal::HttpCacheImpl& impl() const noexcept
+    {
+        return *impl_;
+    }
+
+private:
+    std::unique_ptr<internal::HttpCacheImpl> impl_;
+};
+
+}   // namespace wat
+
+#endif  // WINANT_HTTP_WINANT_HTTP_CACHE_H_
@@ -9,12 +9,21 @@
 #ifndef WINANT_HTTP_WINANT_REQUEST_H_
 #define WINANT_HTTP_WINANT_REQUEST_H_
 
+#include <future>
+#include <memory>
+
 #include "kbase/basic_macros.h"
 #include "kbase/basic_types.h"
 
-#include "winant_http/internal/scoped_internet_handle.h"
+#include "winant_http/winant_buffer_pool.h"
+#include "winant_http/winant_cancellation_token.h"
 #include "winant_http/winant_common_types.h"
+#include "winant_http/winant_connection_pool.h"
+#include "winant_http/winant_hedge_policy.h"
+#include "winant_http/winant_http_cache.h"
+#include "winant_http/winant_request_body.h"
 #include "winant_http/winant_response.h"
+#include "winant_http/winant_retry_policy.h"
 
 namespace wat {
 
@@ -38,28 +47,160 @@ public:
 
     void SetHeaders(const Headers& headers);
 
+    // Removes all headers with the name.
+    void RemoveHeader(kbase::StringView name);
+
     void SetPayload(const Payload& payload);
 
     void SetJSON(const JSONContent& json);
 
     void SetMultipart(const Multipart& multipart);
 
+    // Data of in-memory files is moved into the body.
+    void SetMultipart(Multipart&& multipart);
+
+    void SetBody(RequestBody body);
+
     void SetReadResponseHandler(ReadResponseHandler handler);
 
+    void SetConnectionPool(std::shared_ptr<ConnectionPool> pool);
+
+    void SetBufferPool(std::shared_ptr<BufferPool> pool);
+
+    void SetReadBufferSize(ReadBufferSize size);
+
+    void SetCompletionHandler(CompletionHandler handler);
+
+    void SetHttpCache(std::shared_ptr<HttpCache> cache);
+
+    void SetTimeouts(const Timeouts& timeouts);
+
+    // Pass nullptr to send the request only once, which is the default.
+    void SetRetryPolicy(std::shared_ptr<const RetryPolicy> policy);
+
+    // Pass nullptr to send no hedges, which is the default.
+    void SetHedgePolicy(std::shared_ptr<const HedgePolicy> policy);
+
+    void SetCancellationToken(CancellationToken token);
+
+    // Compresses the body set so far, drawing the buffer from the buffer pool set so far.
+    void CompressBody(const RequestCompression& compression);
+
+    // A request with a cache may be served from the cache without being sent.
+    // A request with a retry policy waits on the calling thread between attempts.
+    // A hedged request is carried out on the I/O loop, and thus must not be started on the loop
+    // thread, e.g. from a completion handler.
     HttpResponse Start();
 
+    // Sends the request without blocking the calling thread.
+    // The request is moved into the I/O loop, which multiplexes all outstanding requests of the
+    // native transport on a single thread; other requests each take a worker thread.
+    // The future, as well as the completion handler if any, receives the response or the error.
+    std::future<HttpResponse> StartAsync() &&;
+
+    Method method() const noexcept
+    {
+        return method_;
+    }
+
+    const Url& url() const noexcept
+    {
+        return canonicalized_url_;
+    }
+
+    LoadFlags load_flags() const noexcept
+    {
+        return load_flags_;
+    }
+
+    const Headers& headers() const noexcept
+    {
+        return headers_;
+    }
+
+    const RequestBody& body() const noexcept
+    {
+        return body_;
+    }
+
+    const ReadResponseHandler& read_response_handler() const noexcept
+    {
+        return read_response_handler_;
+    }
+
+    // Returns nullptr if the request uses the default connection pool.
+    const std::shared_ptr<ConnectionPool>& connection_pool() const noexcept
+    {
+        return connection_pool_;
+    }
+
+    ReadBufferSize read_buffer_size() const noexcept
+    {
+        return read_buffer_size_;
+    }
+
+    // Returns nullptr if the request uses the default buffer pool.
+    const std::shared_ptr<BufferPool>& buffer_pool() const noexcept
+    {
+        return buffer_pool_;
+    }
+
+    const CompletionHandler& completion_handler() const noexcept
+    {
+        return completion_handler_;
+    }
+
+    // Returns nullptr if the request isn't cached.
+    const std::shared_ptr<HttpCache>& http_cache() const noexcept
+    {
+        return http_cache_;
+    }
+
+    const Timeouts& timeouts() const noexcept
+    {
+        return timeouts_;
+    }
+
+    // Returns nullptr if the request isn't retried.
+    const std::shared_ptr<const RetryPolicy>& retry_policy() const noexcept
+    {
+        return retry_policy_;
+    }
+
+    // Returns nullptr if the request isn't hedged.
+    const std::shared_ptr<const HedgePolicy>& hedge_policy() const noexcept
+    {
+        return hedge_policy_;
+    }
+
+    // Returns nullptr if the request can't be cancelled.
+    const CancellationToken* cancellation_token() const noexcept
+    {
+        return cancellation_token_.get();
+    }
+
 private:
     void SetContent(RequestContent&& content);
 
+    // `content_type` is the value of the header, e.g. "application/json".
+    void SetContentType(kbase::StringView content_type);
+
 private:
     Method method_;
     Url canonicalized_url_;
     LoadFlags load_flags_;
-    std::string body_;
+    Headers headers_;
+    RequestBody body_;
     ReadResponseHandler read_response_handler_;
-    internal::ScopedInternetHandle inet_env_;
-    internal::ScopedInternetHandle conn_session_;
-    internal::ScopedInternetHandle request_;
+    std::shared_ptr<ConnectionPool> connection_pool_;
+    std::shared_ptr<BufferPool> buffer_pool_;
+    ReadBufferSize read_buffer_size_;
+    CompletionHandler completion_handler_;
+    std::shared_ptr<HttpCache> http_cache_;
+    Timeouts timeouts_;
+    std::shared_ptr<const RetryPolicy> retry_policy_;
+    std::shared_ptr<const HedgePolicy> hedge_policy_;
+    std::unique_ptr<CancellationToken> cancellation_token_;
 };
 
 inline std::ostream& operator<<(std::ostream& out, HttpRequest::Method method)
@@ -68,6 +209,13 @@ inline std::ostream& operator<<(std::ostream& out, HttpRequest::Method method)
     return out;
 }
 
+namespace internal {
+
+// Returns the request method in its on-wire form, e.g. "GET".
+const char* MethodToVerb(HttpRequest::Method method);
+
+}   // namespace internal
+
 }   // namespace wat
 
 #endif  // WINANT_HTTP_WINANT_REQUEST_H_
@@ -0,0 +1,125 @@
+/*
+ @ 0xCCCCCCCC
+*/
+
+#include "winant_http/winant_request_body.h"
+
+#include <algorithm>
+
+#include "kbase/error_exception_util.h"
+
+#include "winant_http/internal/file_util.h"
+
+namespace wat {
+
+constexpr int64_t RequestBody::kUnknownLength;
+constexpr uint64_t RequestBody::kToEndOfFile;
+
+RequestBody& RequestBody::Append(std::string data)
+{
+    if (data.empty()) {
+        return *this;
+    }
+
+    auto owned = std::make_shared<const std::string>(std::move(data));
+    Segment segment(Segment::Type::Memory);
+    segment.data = *owned;
+    segment.owned_data = std::move(owned);
+    segment.length = static_cast<int64_t>(segment.data.size());
+    segments_.push_back(std::move(segment));
+
+    return *this;
+}
+
+RequestBody& RequestBody::AppendView(kbase::StringView data)
+{
+    if (data.empty()) {
+        return *this;
+    }
+
+    Segment segment(Segment::Type::Memory);
+    segment.data = data;
+    segment.length = static_cast<int64_t>(data.size());
+    segments_.push_back(std::move(segment));
+
+    return *this;
+}
+
+RequestBody& RequestBody::AppendShared(std::shared_ptr<const std::string> owner,
+                                       kbase::StringView data)
+{
+    ENSURE(CHECK, owner && data.data() >= owner->data() &&
+                  data.data() + data.size() <= owner->data() + owner->size()).Require();
+    AppendView(data);
+    if (!data.empty()) {
+        segments_.back().owned_data = std::move(owner);
+    }
+
+    return *this;
+}
+
+RequestBody& RequestBody::AppendFile(const std::string& path, uint64_t offset, uint64_t length)
+{
+    auto file_size = internal::GetFileSize(path);
+    ENSURE(CHECK, offset <= file_size)(path)(offset)(file_size).Require();
+    length = std::min(length, file_size - offset);
+    if (length == 0) {
+        return *this;
+    }
+
+    Segment segment(Segment::Type::File);
+    segment.path = path;
+    segment.offset = offset;
+    segment.length = static_cast<int64_t>(length);
+    segments_.push_back(std::move(segment));
+
+    return *this;
+}
+
+RequestBody& RequestBody::AppendSource(Source source, int64_t length)
+{
+    ENSURE(CHECK, !!source && length >= kUnknownLength)(length).Require();
+    if (length == 0) {
+        return *this;
+    }
+
+    Segment segment(Segment::Type::Source);
+    segment.source = std::make_shared<Source>(std::move(source));
+    segment.length = length;
+    segments_.push_back(std::move(segment));
+
+    return *this;
+}
+
+int64_t RequestBody::length() const noexcept
+{
+    int64_t total = 0;
+    for (const auto& segment : segments_) {
+        if (segment.length == kUnknownLength) {
+            return kUnknownLength;
+        }
+
+        total += segment.length;
+    }
+
+    return total;
+}
+
+bool RequestBody::replayable() const noexcept
+{
+    return std::none_of(segments_.begin(), segments_.end(), [](const Segment& segment) {
+        return segment.type == Segment::Type::Source;
+    });
+}
+
+bool RequestBody::AsContiguous(kbase::StringView& data) const noexcept
+{
+    if (segments_.size() != 1 || segments_.front().type != Segment::Type::Memory) {
+        return false;
+    }
+
+    data = segments_.front().data;
+    return true;
+}
+
+}   // namespace wat
@@ -0,0 +1,125 @@
+/*
+ @ 0xCCCCCCCC
+*/
+
+#if defined(_MSC_VER)
+#pragma once
+#endif
+
+#ifndef WINANT_HTTP_WINANT_REQUEST_BODY_H_
+#define WINANT_HTTP_WINANT_REQUEST_BODY_H_
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "kbase/basic_macros.h"
+#include "kbase/string_view.h"
+
+namespace wat {
+
+// A request body made of a sequence of segments, which are fed to the transport chunk by chunk
+// when the request is sent, so that the body never has to be materialized as a whole.
+// The body is sent with a Content-Length if the length of every segment is known up front, and
+// with chunked transfer encoding otherwise.
+class RequestBody {
+public:
+    // Fills `buf` with at most `size` bytes of data and returns the number of bytes filled.
+    // Returning 0 indicates the end of data. Throws to abort the request.
+    using Source = std::function<size_t(char* buf, size_t size)>;
+
+    static constexpr int64_t kUnknownLength = -1;
+
+    static constexpr uint64_t kToEndOfFile = static_cast<uint64_t>(-1);
+
+    struct Segment {
+        enum class Type {
+            Memory,
+            File,
+            Source
+        };
+
+        explicit Segment(Type type)
+            : type(type), offset(0), length(0)
+        {}
+
+        Type type;
+
+        // Memory segments either own their data or borrow it from the caller.
+        std::shared_ptr<const std::string> owned_data;
+        kbase::StringView data;
+
+        // `path` is in UTF-8.
+        std::string path;
+        uint64_t offset;
+
+        std::shared_ptr<Source> source;
+
+        // kUnknownLength only for a source segment whose length was not given.
+        int64_t length;
+    };
+
+    RequestBody() = default;
+
+    explicit RequestBody(std::string data)
+    {
+        Append(std::move(data));
+    }
+
+    ~RequestBody() = default;
+
+    DEFAULT_COPY(RequestBody);
+
+    DEFAULT_MOVE(RequestBody);
+
+    RequestBody& Append(std::string data);
+
+    // The data is not copied, and it must stay alive until the request completes.
+    RequestBody& AppendView(kbase::StringView data);
+
+    // The data is not copied; it is part of `owner`, which the body keeps alive.
+    RequestBody& AppendShared(std::shared_ptr<const std::string> owner, kbase::StringView data);
+
+    // Sends `length` bytes of the file starting at `offset`.
+    // The file size is taken when appending; throws if the file can't be opened.
+    RequestBody& AppendFile(const std::string& path, uint64_t offset = 0,
+                            uint64_t length = kToEndOfFile);
+
+    // Pulls data from `source` until it reports the end of data, or until `length` bytes have
+    // been pulled, if the length is known.
+    RequestBody& AppendSource(Source source, int64_t length = kUnknownLength);
+
+    bool empty() const noexcept
+    {
+        return segments_.empty();
+    }
+
+    void clear() noexcept
+    {
+        segments_.clear();
+    }
+
+    // Returns kUnknownLength if any segment has unknown length.
+    int64_t length() const noexcept;
+
+    // A body can be sent more than once unless it has source segments, whose data is gone
+    // once pulled.
+    bool replayable() const noexcept;
+
+    // Returns true and sets `data` if the body is a single memory segment.
+    bool AsContiguous(kbase::StringView& data) const noexcept;
+
+    const std::vector<Segment>& segments() const noexcept
+    {
+        return segments_;
+    }
+
+private:
+    std::vector<Segment> segments_;
+};
+
+}   // namespace wat
+
+#endif  // WINANT_HTTP_WINANT_REQUEST_BODY_H_
@@ -13,12 +13,17 @@ using wat::Url;
 
 Url CanonicalizeUrl(const Url& original, const Parameters& params)
 {
-    std::string canonilized = original.spec();
-    if (!params.empty()) {
-        canonilized.append(1, '?').append(params.ToString());
+    if (params.empty()) {
+        return original;
     }
 
-    return Url(canonilized);
+    // The query string is encoded right onto the url.
+    std::string canonicalized;
+    canonicalized.reserve(original.spec().size() + 1 + params.EncodedSize());
+    canonicalized.append(original.spec()).append(1, '?');
+    params.AppendTo(canonicalized);
+
+    return Url(std::move(canonicalized));
 }
 
 }   // namespace
@@ -26,7 +31,7 @@ Url CanonicalizeUrl(const Url& original, const Parameters& params)
 namespace wat {
 
 HttpRequestBuilder::HttpRequestBuilder(HttpRequest::Method method)
-    : method_(method), content_type_(ContentType::None)
+    : method_(method), content_type_(ContentType::None), compress_body_(false)
 {}
 
 void HttpRequestBuilder::SetOption(Url url)
@@ -82,6 +87,16 @@ void HttpRequestBuilder::SetOption(Multipart multipart)
     content_type_ = ContentType::Multipart;
 }
 
+void HttpRequestBuilder::SetOption(RequestBody body)
+{
+    ENSURE(CHECK, method_ == HttpRequest::Method::Post).Require();
+    ENSURE(CHECK, content_type_ == ContentType::None).Require();
+    ENSURE(CHECK, !body.empty()).Require();
+
+    body_ = std::move(body);
+    content_type_ = ContentType::Body;
+}
+
 void HttpRequestBuilder::SetRequestContent(HttpRequest& request) const
 {
     switch (content_type_) {
@@ -97,6 +112,10 @@ void HttpRequestBuilder::SetRequestContent(HttpRequest& request) const
             request.SetMultipart(multipart_);
             break;
 
+        case ContentType::Body:
+            request.SetBody(body_);
+            break;
+
         default:
             ENSURE(CHECK, kbase::NotReached())(kbase::enum_cast(content_type_)).Require();
     }
@@ -107,6 +126,70 @@ void HttpRequestBuilder::SetOption(ReadResponseHandler handler)
     read_handler_ = std::move(handler);
 }
 
+void HttpRequestBuilder::SetOption(std::shared_ptr<ConnectionPool> pool)
+{
+    ENSURE(CHECK, pool != nullptr).Require();
+    connection_pool_ = std::move(pool);
+}
+
+void HttpRequestBuilder::SetOption(std::shared_ptr<BufferPool> pool)
+{
+    ENSURE(CHECK, pool != nullptr).Require();
+    buffer_pool_ = std::move(pool);
+}
+
+void HttpRequestBuilder::SetOption(ReadBufferSize size)
+{
+    read_buffer_size_ = size;
+}
+
+void HttpRequestBuilder::SetOption(CompletionHandler handler)
+{
+    completion_handler_ = std::move(handler);
+}
+
+void HttpRequestBuilder::SetOption(RequestCompression compression)
+{
+    ENSURE(CHECK, method_ == HttpRequest::Method::Post).Require();
+    ENSURE(CHECK, compression.level >= 1 && compression.level <= 9)(compression.level).Require();
+
+    compression_ = compression;
+    compress_body_ = true;
+}
+
+void HttpRequestBuilder::SetOption(std::shared_ptr<HttpCache> cache)
+{
+    ENSURE(CHECK, cache != nullptr).Require();
+    http_cache_ = std::move(cache);
+}
+
+void HttpRequestBuilder::SetOption(Timeouts timeouts)
+{
+    ENSURE(CHECK, timeouts.connect.count() >= 0 && timeouts.write.count() >= 0 &&
+                  timeouts.first_byte.count() >= 0 && timeouts.idle_read.count() >= 0 &&
+                  timeouts.total.count() >= 0).Require();
+    timeouts_ = timeouts;
+}
+
+void HttpRequestBuilder::SetOption(RetryPolicy policy)
+{
+    ENSURE(CHECK, policy.max_attempts >= 1)(policy.max_attempts).Require();
+    ENSURE(CHECK, policy.jitter >= 0 && policy.jitter <= 1)(policy.jitter).Require();
+    retry_policy_ = std::make_shared<const RetryPolicy>(std::move(policy));
+}
+
+void HttpRequestBuilder::SetOption(HedgePolicy policy)
+{
+    ENSURE(CHECK, policy.percentile > 0 && policy.percentile <= 100)(policy.percentile).Require();
+    ENSURE(CHECK, policy.initial_delay.count() >= 0 && policy.min_delay.count() >= 0).Require();
+    hedge_policy_ = std::make_shared<const HedgePolicy>(std::move(policy));
+}
+
+void HttpRequestBuilder::SetOption(CancellationToken token)
+{
+    cancellation_token_ = std::make_unique<CancellationToken>(std::move(token));
+}
+
 HttpRequest HttpRequestBuilder::Build() const
 {
     HttpRequest request(method_, CanonicalizeUrl(url_, parameters_));
@@ -127,6 +210,45 @@ HttpRequest HttpRequestBuilder::Build() const
         request.SetReadResponseHandler(read_handler_);
     }
 
+    if (connection_pool_) {
+        request.SetConnectionPool(connection_pool_);
+    }
+
+    if (buffer_pool_) {
+        request.SetBufferPool(buffer_pool_);
+    }
+
+    request.SetReadBufferSize(read_buffer_size_);
+
+    if (completion_handler_) {
+        request.SetCompletionHandler(completion_handler_);
+    }
+
+    if (http_cache_) {
+        request.SetHttpCache(http_cache_);
+    }
+
+    if (!timeouts_.empty()) {
+        request.SetTimeouts(timeouts_);
+    }
+
+    if (retry_policy_) {
+        request.SetRetryPolicy(retry_policy_);
+    }
+
+    if (hedge_policy_) {
+        request.SetHedgePolicy(hedge_policy_);
+    }
+
+    if (cancellation_token_) {
+        request.SetCancellationToken(*cancellation_token_);
+    }
+
+    // The buffer comes from the pool of the request.
+    if (compress_body_ && content_type_ != ContentType::None) {
+        request.CompressBody(compression_);
+    }
+
     return request;
 }
 
@@ -9,8 +9,16 @@
 #ifndef WINANT_HTTP_WINANT_REQUEST_BUILDER_H_
 #define WINANT_HTTP_WINANT_REQUEST_BUILDER_H_
 
+#include <memory>
+
+#include "winant_http/winant_buffer_pool.h"
+#include "winant_http/winant_cancellation_token.h"
 #include "winant_http/winant_common_types.h"
+#include "winant_http/winant_connection_pool.h"
+#include "winant_http/winant_http_cache.h"
 #include "winant_http/winant_request.h"
+#include "winant_http/winant_request_body.h"
+#include "winant_http/winant_retry_policy.h"
 
 namespace wat {
 
@@ -20,7 +28,8 @@ private:
         None,
         Payload,
         JSON,
-        Multipart
+        Multipart,
+        Body
     };
 
 public:
@@ -42,8 +51,30 @@ public:
 
     void SetOption(Multipart multipart);
 
+    void SetOption(RequestBody body);
+
     void SetOption(ReadResponseHandler handler);
 
+    void SetOption(std::shared_ptr<ConnectionPool> pool);
+
+    void SetOption(std::shared_ptr<BufferPool> pool);
+
+    void SetOption(ReadBufferSize size);
+
+    void SetOption(CompletionHandler handler);
+
+    void SetOption(RequestCompression compression);
+
+    void SetOption(std::shared_ptr<HttpCache> cache);
+
+    void SetOption(Timeouts timeouts);
+
+    void SetOption(RetryPolicy policy);
+
+    void SetOption(HedgePolicy policy);
+
+    void SetOption(CancellationToken token);
+
     HttpRequest Build() const;
 
 private:
@@ -59,7 +90,20 @@ private:
     Payload payload_;
     JSONContent json_;
     Multipart multipart_;
+    RequestBody body_;
     ReadResponseHandler read_handler_;
+    std::shared_ptr<ConnectionPool> connection_pool_;
+    std::shared_ptr<BufferPool> buffer_pool_;
+    ReadBufferSize read_buffer_size_;
+    CompletionHandler completion_handler_;
+    bool compress_body_;
+    RequestCompression compression_;
+    std::shared_ptr<HttpCache> http_cache_;
+    Timeouts timeouts_;
+    // Shared by the requests built.
+    std::shared_ptr<const RetryPolicy> retry_policy_;
+    std::shared_ptr<const HedgePolicy> hedge_policy_;
+    std::unique_ptr<CancellationToken> cancellation_token_;
 };
 
 }   // namespace wat
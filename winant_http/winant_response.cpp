@@ -10,6 +10,26 @@ HttpResponse::HttpResponse(int status_code, Headers headers, std::string body)
     : status_code_(status_code), headers_(std::move(headers)), body_(std::move(body))
 {}
 
+HttpResponse::HttpResponse(int status_code, Headers headers, std::string body,
+                           std::shared_ptr<BufferPool> buffer_pool)
+    : status_code_(status_code),
+      headers_(std::move(headers)),
+      body_(std::move(body)),
+      buffer_pool_(std::move(buffer_pool))
+{}
+
+HttpResponse::HttpResponse(int status_code, Headers headers,
+                           std::shared_ptr<const std::string> body)
+    : status_code_(status_code), headers_(std::move(headers)), shared_body_(std::move(body))
+{}
+
+HttpResponse::~HttpResponse()
+{
+    if (buffer_pool_) {
+        buffer_pool_->Recycle(std::move(body_));
+    }
+}
+
 int HttpResponse::status_code() const noexcept
 {
     return status_code_;
@@ -22,7 +42,19 @@ const Headers& HttpResponse::headers() const noexcept
 
 const std::string& HttpResponse::text() const noexcept
 {
-    return body_;
+    return shared_body_ ? *shared_body_ : body_;
+}
+
+std::shared_ptr<const std::string> HttpResponse::ShareBody()
+{
+    if (!shared_body_) {
+        // The buffer now belongs to whoever shares it last.
+        shared_body_ = std::make_shared<std::string>(std::move(body_));
+        body_ = std::string();
+        buffer_pool_ = nullptr;
+    }
+
+    return shared_body_;
 }
 
 }   // namespace wat
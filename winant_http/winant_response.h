@@ -9,10 +9,12 @@
 #ifndef WINANT_HTTP_WINANT_RESPONSE_H_
 #define WINANT_HTTP_WINANT_RESPONSE_H_
 
+#include <memory>
 #include <string>
 
 #include "kbase/basic_macros.h"
 
+#include "winant_http/winant_buffer_pool.h"
 #include "winant_http/winant_common_types.h"
 
 namespace wat {
@@ -21,7 +23,14 @@ class HttpResponse {
 public:
     HttpResponse(int status_code, Headers headers, std::string body);
 
-    ~HttpResponse() = default;
+    // The body buffer is given back to `buffer_pool` when the response is destroyed.
+    HttpResponse(int status_code, Headers headers, std::string body,
+                 std::shared_ptr<BufferPool> buffer_pool);
+
+    // The body is shared with others, e.g. a cache entry, rather than copied.
+    HttpResponse(int status_code, Headers headers, std::shared_ptr<const std::string> body);
+
+    ~HttpResponse();
 
     DEFAULT_COPY(HttpResponse);
 
@@ -33,10 +42,17 @@ public:
 
     const std::string& text() const noexcept;
 
+    // Moves the body into a buffer that can be shared without copying, and which the response
+    // keeps referring to.
+    std::shared_ptr<const std::string> ShareBody();
+
 private:
     int status_code_;
     Headers headers_;
     std::string body_;
+    std::shared_ptr<BufferPool> buffer_pool_;
+    // Supersedes `body_` if set.
+    std::shared_ptr<const std::string> shared_body_;
 };
 
 }   // namespace wat
@@ -0,0 +1,66 @@
+/*
+ @ 0xCCCCCCCC
+*/
+
+#include "winant_http/winant_retry_policy.h"
+
+#include <algorithm>
+
+namespace wat {
+
+RetryBudget::RetryBudget()
+    : RetryBudget(Options())
+{}
+
+RetryBudget::RetryBudget(const Options& options)
+    : options_(options), tokens_(options.max_tokens), last_refill_(Clock::now())
+{}
+
+// static
+const std::shared_ptr<RetryBudget>& RetryBudget::Default()
+{
+    static const std::shared_ptr<RetryBudget> default_budget = std::make_shared<RetryBudget>();
+    return default_budget;
+}
+
+void RetryBudget::Deposit() noexcept
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    tokens_ = std::min(tokens_ + options_.retry_ratio, options_.max_tokens);
+}
+
+bool RetryBudget::TryWithdraw() noexcept
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    Refill(Clock::now());
+    if (tokens_ < 1) {
+        ++stats_.rejected;
+        return false;
+    }
+
+    tokens_ -= 1;
+    ++stats_.retries;
+    return true;
+}
+
+RetryBudget::Stats RetryBudget::stats() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return stats_;
+}
+
+double RetryBudget::tokens() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return tokens_;
+}
+
+void RetryBudget::Refill(Clock::time_point now) noexcept
+{
+    std::chrono::duration<double> elapsed = now - last_refill_;
+    last_refill_ = now;
+    tokens_ = std::min(tokens_ + elapsed.count() * options_.min_retries_per_second,
+                       options_.max_tokens);
+}
+
+}   // namespace wat
@@ -0,0 +1,130 @@
+/*
+ @ 0xCCCCCCCC
+*/
+
+#if defined(_MSC_VER)
+#pragma once
+#endif
+
+#ifndef WINANT_HTTP_WINANT_RETRY_POLICY_H_
+#define WINANT_HTTP_WINANT_RETRY_POLICY_H_
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "kbase/basic_macros.h"
+
+namespace wat {
+
+// A token bucket that caps the retries of the requests sharing it, so that retries can't
+// multiply the load on a server that is failing already.
+// Every retry takes a token. Every request deposits a fraction of a token when it is sent for the
+// first time, and tokens also trickle in at a steady rate, so that a client sending few requests
+// can still retry a few.
+// A budget is thread-safe and can be shared by requests through their RetryPolicy; policies
+// without an explicit budget use the process-wide default one.
+class RetryBudget {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    struct Options {
+        // Tokens deposited by every request; e.g. 0.2 lets retries add 20% to the requests.
+        double retry_ratio {0.2};
+
+        // Tokens added every second regardless of traffic.
+        double min_retries_per_second {10};
+
+        // The bucket starts full.
+        double max_tokens {100};
+    };
+
+    struct Stats {
+        uint64_t retries {0};
+
+        // Retries turned down for want of tokens.
+        uint64_t rejected {0};
+    };
+
+    RetryBudget();
+
+    explicit RetryBudget(const Options& options);
+
+    ~RetryBudget() = default;
+
+    DISALLOW_COPY(RetryBudget);
+
+    DISALLOW_MOVE(RetryBudget);
+
+    static const std::shared_ptr<RetryBudget>& Default();
+
+    // Called for every request sent for the first time.
+    void Deposit() noexcept;
+
+    // Takes a token for a retry; returns false if none is left.
+    bool TryWithdraw() noexcept;
+
+    Stats stats() const;
+
+    double tokens() const;
+
+    const Options& options() const noexcept
+    {
+        return options_;
+    }
+
+private:
+    void Refill(Clock::time_point now) noexcept;
+
+private:
+    Options options_;
+    mutable std::mutex mutex_;
+    double tokens_;
+    Clock::time_point last_refill_;
+    Stats stats_;
+};
+
+// Tells which failed attempts of a request are tried again, and how long to wait in between.
+// Attempts that failed to connect, and thus sent nothing, are always safe to retry. Others are
+// retried only for GET and HEAD, unless `retry_non_idempotent` is set, and only if the body of
+// the request can be sent again; a RequestBody holds serialized payloads, multiparts and file
+// ranges as they are, and replays them without building them again.
+// The delay grows exponentially, with jitter, and a Retry-After of a response being retried is
+// honored. Every attempt has the Timeouts of the request to itself.
+// A ReadResponseHandler sees every attempt, each ended with either 0 or -1.
+struct RetryPolicy {
+    // Includes the first attempt.
+    int max_attempts {3};
+
+    std::chrono::milliseconds initial_backoff {100};
+
+    std::chrono::milliseconds max_backoff {10000};
+
+    double backoff_multiplier {2.0};
+
+    // The fraction of each delay that is randomized away, from 0 (none) to 1 (full jitter).
+    double jitter {0.5};
+
+    // Responses with these status codes are retried.
+    std::vector<int> retry_status_codes {502, 503, 504};
+
+    // A response asking to retry after longer than this is returned as it is.
+    std::chrono::milliseconds max_retry_after {30000};
+
+    // Retries attempts that couldn't connect, including those that ran out of the connect timeout.
+    bool retry_connect_failures {true};
+
+    // Retries attempts that ran out of other timeouts.
+    bool retry_timeouts {true};
+
+    bool retry_non_idempotent {false};
+
+    // nullptr to use the process-wide budget.
+    std::shared_ptr<RetryBudget> budget;
+};
+
+}   // namespace wat
+
+#endif  // WINANT_HTTP_WINANT_RETRY_POLICY_H_
@@ -0,0 +1,432 @@
+/*
+ @ 0xCCCCCCCC
+*/
+
+#include "winant_http/winant_url.h"
+
+#include <algorithm>
+#include <iterator>
+#include <limits>
+#include <vector>
+
+namespace {
+
+constexpr uint32_t kMaxPort = 65535;
+
+// Punycode parameters, see RFC 3492.
+constexpr uint32_t kPunycodeBase = 36;
+constexpr uint32_t kPunycodeTMin = 1;
+constexpr uint32_t kPunycodeTMax = 26;
+constexpr uint32_t kPunycodeSkew = 38;
+constexpr uint32_t kPunycodeDamp = 700;
+constexpr uint32_t kPunycodeInitialBias = 72;
+constexpr uint32_t kPunycodeInitialN = 128;
+
+bool IsAlpha(char ch) noexcept
+{
+    return (ch >= 'a' && ch <= 'z') || (ch >= 'A' && ch <= 'Z');
+}
+
+bool IsDigit(char ch) noexcept
+{
+    return ch >= '0' && ch <= '9';
+}
+
+bool IsHexDigit(char ch) noexcept
+{
+    return IsDigit(ch) || ((ch | 0x20) >= 'a' && (ch | 0x20) <= 'f');
+}
+
+char ToLowerASCII(char ch) noexcept
+{
+    return ch >= 'A' && ch <= 'Z' ? static_cast<char>(ch | 0x20) : ch;
+}
+
+bool IsASCII(kbase::StringView str) noexcept
+{
+    return std::all_of(str.begin(), str.end(), [](char ch) {
+        return static_cast<unsigned char>(ch) < 0x80;
+    });
+}
+
+size_t FindFirstOf(const std::string& str, size_t pos, size_t end, kbase::StringView chars) noexcept
+{
+    for (; pos < end; ++pos) {
+        if (chars.find(str[pos]) != kbase::StringView::npos) {
+            return pos;
+        }
+    }
+
+    return end;
+}
+
+// Decodes the UTF-8 sequence at `ptr` and advances it; returns false if the sequence is
+// malformed.
+bool DecodeUTF8(const char*& ptr, const char* end, uint32_t& code_point) noexcept
+{
+    auto lead = static_cast<unsigned char>(*ptr++);
+    if (lead < 0x80) {
+        code_point = lead;
+        return true;
+    }
+
+    int trailing;
+    uint32_t min_code_point;
+    if ((lead & 0xE0) == 0xC0) {
+        trailing = 1;
+        min_code_point = 0x80;
+        code_point = lead & 0x1F;
+    } else if ((lead & 0xF0) == 0xE0) {
+        trailing = 2;
+        min_code_point = 0x800;
+        code_point = lead & 0x0F;
+    } else if ((lead & 0xF8) == 0xF0) {
+        trailing = 3;
+        min_code_point = 0x10000;
+        code_point = lead & 0x07;
+    } else {
+        return false;
+    }
+
+    for (int i = 0; i < trailing; ++i) {
+        if (ptr == end || (static_cast<unsigned char>(*ptr) & 0xC0) != 0x80) {
+            return false;
+        }
+
+        code_point = (code_point << 6) | (static_cast<unsigned char>(*ptr++) & 0x3F);
+    }
+
+    // Overlong forms, surrogates and out of range code points.
+    return code_point >= min_code_point && code_point <= 0x10FFFF &&
+           (code_point < 0xD800 || code_point > 0xDFFF);
+}
+
+bool IsValidUTF8(kbase::StringView str) noexcept
+{
+    auto ptr = str.data();
+    auto end = ptr + str.size();
+    uint32_t code_point;
+    while (ptr != end) {
+        if (!DecodeUTF8(ptr, end, code_point)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+char EncodePunycodeDigit(uint32_t digit) noexcept
+{
+    return static_cast<char>(digit < 26 ? 'a' + digit : '0' + (digit - 26));
+}
+
+uint32_t AdaptPunycodeBias(uint64_t delta, uint64_t num_points, bool first) noexcept
+{
+    delta = first ? delta / kPunycodeDamp : delta / 2;
+    delta += delta / num_points;
+
+    uint32_t k = 0;
+    while (delta > ((kPunycodeBase - kPunycodeTMin) * kPunycodeTMax) / 2) {
+        delta /= kPunycodeBase - kPunycodeTMin;
+        k += kPunycodeBase;
+    }
+
+    return static_cast<uint32_t>(
+        k + (kPunycodeBase - kPunycodeTMin + 1) * delta / (delta + kPunycodeSkew));
+}
+
+// Appends the punycode form of a label, without the "xn--" prefix. The label must be valid UTF-8.
+void AppendPunycode(kbase::StringView label, std::string& out)
+{
+    std::vector<uint32_t> code_points;
+    code_points.reserve(label.size());
+    auto ptr = label.data();
+    auto end = ptr + label.size();
+    while (ptr != end) {
+        uint32_t code_point;
+        DecodeUTF8(ptr, end, code_point);
+        code_points.push_back(code_point < 0x80 ?
+                                  static_cast<uint32_t>(ToLowerASCII(static_cast<char>(code_point))) :
+                                  code_point);
+    }
+
+    size_t basic_count = 0;
+    for (auto code_point : code_points) {
+        if (code_point < 0x80) {
+            out.push_back(static_cast<char>(code_point));
+            ++basic_count;
+        }
+    }
+
+    if (basic_count > 0) {
+        out.push_back('-');
+    }
+
+    uint32_t n = kPunycodeInitialN;
+    uint32_t bias = kPunycodeInitialBias;
+    uint64_t delta = 0;
+    for (size_t handled = basic_count; handled < code_points.size(); ++delta, ++n) {
+        uint32_t next = std::numeric_limits<uint32_t>::max();
+        for (auto code_point : code_points) {
+            if (code_point >= n) {
+                next = std::min(next, code_point);
+            }
+        }
+
+        delta += static_cast<uint64_t>(next - n) * (handled + 1);
+        n = next;
+        for (auto code_point : code_points) {
+            if (code_point < n) {
+                ++delta;
+            } else if (code_point == n) {
+                auto q = delta;
+                for (auto k = kPunycodeBase; ; k += kPunycodeBase) {
+                    uint32_t t = k <= bias ? kPunycodeTMin :
+                                 k >= bias + kPunycodeTMax ? kPunycodeTMax : k - bias;
+                    if (q < t) {
+                        break;
+                    }
+
+                    out.push_back(EncodePunycodeDigit(
+                        static_cast<uint32_t>(t + (q - t) % (kPunycodeBase - t))));
+                    q = (q - t) / (kPunycodeBase - t);
+                }
+
+                out.push_back(EncodePunycodeDigit(static_cast<uint32_t>(q)));
+                bias = AdaptPunycodeBias(delta, handled + 1, handled == basic_count);
+                delta = 0;
+                ++handled;
+            }
+        }
+    }
+}
+
+}   // namespace
+
+namespace wat {
+
+Url::Url(std::string url)
+    : spec_(std::move(url))
+{
+    valid_ = Parse();
+    if (!valid_) {
+        scheme_ = userinfo_ = host_ = port_ = path_ = query_ = fragment_ = Component();
+    }
+}
+
+bool Url::Parse() noexcept
+{
+    const auto& s = spec_;
+    auto n = s.size();
+    if (n == 0 || n > static_cast<size_t>(std::numeric_limits<int32_t>::max())) {
+        return false;
+    }
+
+    auto make_component = [](size_t begin, size_t end) {
+        Component component;
+        component.begin = static_cast<uint32_t>(begin);
+        component.size = static_cast<int32_t>(end - begin);
+        return component;
+    };
+
+    // Neither spaces nor control characters are allowed anywhere.
+    if (std::any_of(s.begin(), s.end(), [](char ch) {
+            return static_cast<unsigned char>(ch) <= 0x20 || ch == 0x7F;
+        })) {
+        return false;
+    }
+
+    // scheme = ALPHA *( ALPHA / DIGIT / "+" / "-" / "." )
+    if (!IsAlpha(s[0])) {
+        return false;
+    }
+
+    size_t pos = 1;
+    while (pos < n && (IsAlpha(s[pos]) || IsDigit(s[pos]) || s[pos] == '+' || s[pos] == '-' ||
+                       s[pos] == '.')) {
+        ++pos;
+    }
+
+    if (pos == n || s[pos] != ':') {
+        return false;
+    }
+
+    scheme_ = make_component(0, pos);
+
+    // Only urls with an authority are supported.
+    if (n - pos < 3 || s[pos + 1] != '/' || s[pos + 2] != '/') {
+        return false;
+    }
+
+    auto authority_begin = pos + 3;
+    auto authority_end = FindFirstOf(s, authority_begin, n, "/?#");
+
+    auto host_begin = authority_begin;
+    auto at = s.rfind('@', authority_end - 1);
+    if (at != std::string::npos && at >= authority_begin) {
+        userinfo_ = make_component(authority_begin, at);
+        host_begin = at + 1;
+    }
+
+    auto port_delim = std::string::npos;
+    if (host_begin < authority_end && s[host_begin] == '[') {
+        auto bracket = FindFirstOf(s, host_begin, authority_end, "]");
+        if (bracket == authority_end) {
+            return false;
+        }
+
+        host_ = make_component(host_begin + 1, bracket);
+        auto literal = host();
+        if (literal.find(':') == kbase::StringView::npos ||
+            !std::all_of(literal.begin(), literal.end(), [](char ch) {
+                return IsHexDigit(ch) || ch == ':' || ch == '.';
+            })) {
+            return false;
+        }
+
+        if (bracket + 1 < authority_end) {
+            if (s[bracket + 1] != ':') {
+                return false;
+            }
+
+            port_delim = bracket + 1;
+        }
+    } else {
+        auto colon = s.rfind(':', authority_end - 1);
+        auto host_end = authority_end;
+        if (colon != std::string::npos && colon >= host_begin) {
+            port_delim = colon;
+            host_end = colon;
+        }
+
+        host_ = make_component(host_begin, host_end);
+        auto name = host();
+        if (name.find_first_of("[]") != kbase::StringView::npos || !IsValidUTF8(name)) {
+            return false;
+        }
+    }
+
+    if (host_.size <= 0) {
+        return false;
+    }
+
+    // An empty port is the same as no port.
+    if (port_delim != std::string::npos && port_delim + 1 < authority_end) {
+        port_ = make_component(port_delim + 1, authority_end);
+        uint32_t value = 0;
+        for (auto ch : port()) {
+            if (!IsDigit(ch)) {
+                return false;
+            }
+
+            value = value * 10 + static_cast<uint32_t>(ch - '0');
+            if (value > kMaxPort) {
+                return false;
+            }
+        }
+
+        if (value == 0) {
+            return false;
+        }
+    }
+
+    auto path_end = FindFirstOf(s, authority_end, n, "?#");
+    path_ = make_component(authority_end, path_end);
+    pos = path_end;
+
+    if (pos < n && s[pos] == '?') {
+        auto query_end = FindFirstOf(s, pos + 1, n, "#");
+        query_ = make_component(pos + 1, query_end);
+        pos = query_end;
+    }
+
+    if (pos < n) {
+        fragment_ = make_component(pos + 1, n);
+    }
+
+    return true;
+}
+
+bool Url::SchemeIs(kbase::StringView scheme) const noexcept
+{
+    auto own = this->scheme();
+    return own.size() == scheme.size() &&
+           std::equal(own.begin(), own.end(), scheme.begin(), [](char lhs, char rhs) {
+               return ToLowerASCII(lhs) == rhs;
+           });
+}
+
+std::string Url::ascii_host() const
+{
+    auto host = this->host();
+
+    std::string ascii;
+    ascii.reserve(host.size());
+    size_t label_begin = 0;
+    while (true) {
+        auto dot = host.find('.', label_begin);
+        auto label = host.substr(label_begin, dot == kbase::StringView::npos ?
+                                                  kbase::StringView::npos : dot - label_begin);
+        if (IsASCII(label)) {
+            std::transform(label.begin(), label.end(), std::back_inserter(ascii), ToLowerASCII);
+        } else {
+            ascii.append("xn--");
+            AppendPunycode(label, ascii);
+        }
+
+        if (dot == kbase::StringView::npos) {
+            break;
+        }
+
+        ascii.push_back('.');
+        label_begin = dot + 1;
+    }
+
+    return ascii;
+}
+
+int Url::EffectivePort() const noexcept
+{
+    if (port_.size > 0) {
+        int value = 0;
+        for (auto ch : port()) {
+            value = value * 10 + (ch - '0');
+        }
+
+        return value;
+    }
+
+    if (SchemeIs("http")) {
+        return 80;
+    }
+
+    if (SchemeIs("https")) {
+        return 443;
+    }
+
+    return -1;
+}
+
+kbase::StringView Url::host_and_port() const noexcept
+{
+    if (!valid_) {
+        return kbase::StringView();
+    }
+
+    uint32_t bracket = HostIsIPv6Literal() ? 1 : 0;
+    auto begin = host_.begin - bracket;
+    auto end = port_.size > 0 ? port_.end() : host_.end() + bracket;
+    return kbase::StringView(spec_.data() + begin, end - begin);
+}
+
+kbase::StringView Url::path_and_query() const noexcept
+{
+    if (!valid_) {
+        return kbase::StringView();
+    }
+
+    auto end = has_query() ? query_.end() : path_.end();
+    return kbase::StringView(spec_.data() + path_.begin, end - path_.begin);
+}
+
+}   // namespace wat
@@ -0,0 +1,161 @@
+/*
+ @ 0xCCCCCCCC
+*/
+
+#if defined(_MSC_VER)
+#pragma once
+#endif
+
+#ifndef WINANT_HTTP_WINANT_URL_H_
+#define WINANT_HTTP_WINANT_URL_H_
+
+#include <cstdint>
+#include <string>
+
+#include "kbase/basic_macros.h"
+#include "kbase/string_view.h"
+
+namespace wat {
+
+// An absolute url, i.e. scheme://[userinfo@]host[:port][/path][?query][#fragment], as described
+// in RFC 3986.
+// The url is parsed once on construction, and only offsets of its components are kept, so
+// that reading them never parses or allocates again. A url that fails to parse is kept as it is
+// but is not valid.
+// The spec is not canonicalized; the scheme and the host are compared case-insensitively.
+class Url {
+public:
+    Url() = default;
+
+    explicit Url(std::string url);
+
+    ~Url() = default;
+
+    DEFAULT_COPY(Url);
+
+    DEFAULT_MOVE(Url);
+
+    bool empty() const noexcept
+    {
+        return spec_.empty();
+    }
+
+    // True if the url has a scheme and a host, and its port, if any, is a valid one.
+    bool is_valid() const noexcept
+    {
+        return valid_;
+    }
+
+    const std::string& spec() const noexcept
+    {
+        return spec_;
+    }
+
+    kbase::StringView scheme() const noexcept
+    {
+        return Slice(scheme_);
+    }
+
+    // Compares case-insensitively; `scheme` is expected to be in lowercase.
+    bool SchemeIs(kbase::StringView scheme) const noexcept;
+
+    kbase::StringView userinfo() const noexcept
+    {
+        return Slice(userinfo_);
+    }
+
+    // An IPv6 literal comes without its brackets.
+    kbase::StringView host() const noexcept
+    {
+        return Slice(host_);
+    }
+
+    bool HostIsIPv6Literal() const noexcept
+    {
+        return host_.begin > 0 && spec_[host_.begin - 1] == '[';
+    }
+
+    // The host in ASCII, as used for connecting and in the Host header: letters are lowercased,
+    // and labels with non-ASCII characters are converted to punycode, e.g. "xn--fiqs8s".
+    // Non-ASCII characters are taken as they are, i.e. without IDNA mapping or normalization.
+    std::string ascii_host() const;
+
+    // Empty if the url has no explicit port.
+    kbase::StringView port() const noexcept
+    {
+        return Slice(port_);
+    }
+
+    // The explicit port, or the default one of the scheme; -1 if neither is known.
+    int EffectivePort() const noexcept;
+
+    // host[:port] as it appears in the url, brackets of an IPv6 literal included.
+    kbase::StringView host_and_port() const noexcept;
+
+    kbase::StringView path() const noexcept
+    {
+        return Slice(path_);
+    }
+
+    bool has_query() const noexcept
+    {
+        return query_.size >= 0;
+    }
+
+    // Without the leading '?'.
+    kbase::StringView query() const noexcept
+    {
+        return Slice(query_);
+    }
+
+    // path[?query], i.e. the request target, except that the path may be empty.
+    kbase::StringView path_and_query() const noexcept;
+
+    bool has_fragment() const noexcept
+    {
+        return fragment_.size >= 0;
+    }
+
+    // Without the leading '#'.
+    kbase::StringView fragment() const noexcept
+    {
+        return Slice(fragment_);
+    }
+
+private:
+    // A range of the spec; `size` is -1 if the component is absent.
+    struct Component {
+        uint32_t begin {0};
+        int32_t size {-1};
+
+        uint32_t end() const noexcept
+        {
+            return begin + static_cast<uint32_t>(size < 0 ? 0 : size);
+        }
+    };
+
+    bool Parse() noexcept;
+
+    kbase::StringView Slice(const Component& component) const noexcept
+    {
+        return component.size < 0 ?
+                   kbase::StringView() :
+                   kbase::StringView(spec_.data() + component.begin,
+                                     static_cast<size_t>(component.size));
+    }
+
+private:
+    std::string spec_;
+    bool valid_ {false};
+    Component scheme_;
+    Component userinfo_;
+    Component host_;
+    Component port_;
+    Component path_;
+    Component query_;
+    Component fragment_;
+};
+
+}   // namespace wat
+
+#endif  // WINANT_HTTP_WINANT_URL_H_
@@ -4,28 +4,202 @@
 
 #include "winant_http/winant_utils.h"
 
-#include "kbase/string_format.h"
+#include <array>
+#include <cstring>
+
+#if defined(_M_X64) || defined(_M_IX86_FP) || defined(__SSE2__)
+#define WINANT_HTTP_USE_SSE2 1
+#include <emmintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#endif
+
+namespace {
+
+constexpr char kHexDigits[] = "0123456789ABCDEF";
+
+constexpr bool IsUnreserved(unsigned char ch) noexcept
+{
+    return (ch >= 'A' && ch <= 'Z') || (ch >= 'a' && ch <= 'z') || (ch >= '0' && ch <= '9') ||
+           ch == '-' || ch == '_' || ch == '.' || ch == '~';
+}
+
+struct UnreservedTable {
+    std::array<bool, 256> table;
+
+    UnreservedTable() noexcept
+        : table()
+    {
+        for (size_t i = 0; i < table.size(); ++i) {
+            table[i] = IsUnreserved(static_cast<unsigned char>(i));
+        }
+    }
+
+    bool operator[](char ch) const noexcept
+    {
+        return table[static_cast<unsigned char>(ch)];
+    }
+};
+
+const UnreservedTable kUnreserved;
+
+// Returns -1 if `ch` is not a hex digit.
+int HexDigitValue(char ch) noexcept
+{
+    if (ch >= '0' && ch <= '9') {
+        return ch - '0';
+    }
+
+    auto lower = ch | 0x20;
+    if (lower >= 'a' && lower <= 'f') {
+        return lower - 'a' + 10;
+    }
+
+    return -1;
+}
+
+#if defined(WINANT_HTTP_USE_SSE2)
+
+unsigned int CountTrailingZeros(unsigned int value) noexcept
+{
+#if defined(_MSC_VER)
+    unsigned long index;
+    _BitScanForward(&index, value);
+    return index;
+#else
+    return static_cast<unsigned int>(__builtin_ctz(value));
+#endif
+}
+
+// Sets bytes of unreserved characters to 0xFF.
+__m128i ClassifyUnreserved(__m128i chars) noexcept
+{
+    auto in_range = [chars](__m128i value, char low, char high) {
+        return _mm_and_si128(_mm_cmpgt_epi8(value, _mm_set1_epi8(low - 1)),
+                             _mm_cmplt_epi8(value, _mm_set1_epi8(high + 1)));
+    };
+
+    // Bytes above 0x7F are negative, and thus out of every range.
+    auto letters = in_range(_mm_or_si128(chars, _mm_set1_epi8(0x20)), 'a', 'z');
+    auto digits = in_range(chars, '0', '9');
+    auto marks = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(chars, _mm_set1_epi8('-')),
+                                           _mm_cmpeq_epi8(chars, _mm_set1_epi8('_'))),
+                              _mm_or_si128(_mm_cmpeq_epi8(chars, _mm_set1_epi8('.')),
+                                           _mm_cmpeq_epi8(chars, _mm_set1_epi8('~'))));
+    return _mm_or_si128(_mm_or_si128(letters, digits), marks);
+}
+
+#endif
+
+// Returns the length of the run of unreserved characters at the start of [begin, end).
+size_t UnreservedRunLength(const char* begin, const char* end) noexcept
+{
+    auto ptr = begin;
+
+#if defined(WINANT_HTTP_USE_SSE2)
+    constexpr size_t kBlockSize = sizeof(__m128i);
+    while (static_cast<size_t>(end - ptr) >= kBlockSize) {
+        auto chars = _mm_loadu_si128(reinterpret_cast<const __m128i*>(ptr));
+        auto mask = static_cast<unsigned int>(_mm_movemask_epi8(ClassifyUnreserved(chars)));
+        if (mask != 0xFFFF) {
+            return static_cast<size_t>(ptr - begin) + CountTrailingZeros(~mask);
+        }
+
+        ptr += kBlockSize;
+    }
+#endif
+
+    while (ptr != end && kUnreserved[*ptr]) {
+        ++ptr;
+    }
+
+    return static_cast<size_t>(ptr - begin);
+}
+
+}   // namespace
 
 namespace wat {
 
 std::string EscapeUrl(kbase::StringView str)
 {
-    constexpr kbase::StringView kUnreserved("ABCDEFGHIJKLMNOPQRSTUVWXYZ"
-                                            "abcdefghijklmnopqrstuvwxyz"
-                                            "0123456789"
-                                            "-_.~");
-
     std::string escaped;
-    for (auto ch : str) {
-        if (kUnreserved.find_first_of(ch) != kbase::StringView::npos) {
-            escaped.push_back(ch);
-        } else {
-            escaped.append(1, '%')
-                   .append(kbase::StringPrintf("%.2X", static_cast<unsigned char>(ch)));
+    AppendEscapedUrl(str, escaped);
+    return escaped;
+}
+
+size_t EscapedUrlSize(kbase::StringView str) noexcept
+{
+    auto end = str.data() + str.size();
+    size_t escaped_size = str.size();
+    for (auto ptr = str.data(); ptr != end; ++ptr) {
+        ptr += UnreservedRunLength(ptr, end);
+        if (ptr == end) {
+            break;
         }
+
+        escaped_size += 2;
     }
 
-    return escaped;
+    return escaped_size;
+}
+
+void AppendEscapedUrl(kbase::StringView str, std::string& out)
+{
+    auto begin = str.data();
+    auto end = begin + str.size();
+
+    // Sizes the output exactly, so that it is written in one go.
+    auto offset = out.size();
+    out.resize(offset + EscapedUrlSize(str));
+    auto dest = &out[offset];
+    for (auto ptr = begin; ptr != end; ++ptr) {
+        auto run = UnreservedRunLength(ptr, end);
+        std::memcpy(dest, ptr, run);
+        dest += run;
+        ptr += run;
+        if (ptr == end) {
+            break;
+        }
+
+        auto ch = static_cast<unsigned char>(*ptr);
+        dest[0] = '%';
+        dest[1] = kHexDigits[ch >> 4];
+        dest[2] = kHexDigits[ch & 0x0F];
+        dest += 3;
+    }
+}
+
+std::string UnescapeUrl(kbase::StringView str)
+{
+    auto ptr = str.data();
+    auto end = ptr + str.size();
+
+    std::string unescaped;
+    unescaped.reserve(str.size());
+    while (ptr != end) {
+        auto percent = static_cast<const char*>(std::memchr(ptr, '%', end - ptr));
+        if (!percent) {
+            unescaped.append(ptr, end);
+            break;
+        }
+
+        unescaped.append(ptr, percent);
+        ptr = percent + 1;
+
+        int high = end - ptr >= 2 ? HexDigitValue(ptr[0]) : -1;
+        int low = high >= 0 ? HexDigitValue(ptr[1]) : -1;
+        if (low < 0) {
+            // Not an escape sequence; kept as it is.
+            unescaped.push_back('%');
+            continue;
+        }
+
+        unescaped.push_back(static_cast<char>((high << 4) | low));
+        ptr += 2;
+    }
+
+    return unescaped;
 }
 
 }   // namespace wat
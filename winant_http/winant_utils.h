@@ -15,8 +15,19 @@
 
 namespace wat {
 
+// Percent-encodes every byte but unreserved characters, i.e. ALPHA, DIGIT and "-._~".
 std::string EscapeUrl(kbase::StringView str);
 
+// The exact size of EscapeUrl(str).
+size_t EscapedUrlSize(kbase::StringView str) noexcept;
+
+// Appends EscapeUrl(str) to `out`, growing it once at most.
+void AppendEscapedUrl(kbase::StringView str, std::string& out);
+
+// Decodes %XX escape sequences; a '%' that doesn't start one is kept as it is.
+// '+' is not taken as a space.
+std::string UnescapeUrl(kbase::StringView str);
+
 }   // namespace wat
 
 #endif  // WINANT_HTTP_WINANT_UTILS_H_